@@ -1,14 +1,40 @@
 #include <climits>
+#include <string.h>
 #include <math.h>
+#include <sstream>
+#include <string>
+#include <vector>
 #include "CMoAxis.hpp"
+#include "CMoCan.h"
+#include "CMoMemory.hpp"
+#include "CMoLoad.hpp"
+#include "CMoNetwork.h"
+#include "CMoOpcodes.hpp"
+#include "CMoPrefetch.hpp"
+#include "CMoReactor.hpp"
+#include "CMoReconnect.hpp"
+#include "CMoSnapshot.hpp"
+#include "CMoStop.hpp"
+#include "CMoWait.hpp"
 #include "c-motion/PMDdiag.h"
 
 #ifdef WIN32
-#   ifdef _MSC_VER
+#   if defined(_MSC_VER) && !defined(CMO_NATIVE_CMOTION)
 #	pragma comment (lib, "C-Motion.lib")
 #   endif
 #endif
 
+// windows.h supplies these through basetsd.h; elsewhere take them from
+// climits.
+#ifndef MAXINT32
+#   define MAXINT32	INT_MAX
+#   define MININT32	INT_MIN
+#   define MAXUINT32	UINT_MAX
+#   define MAXINT16	SHRT_MAX
+#   define MININT16	SHRT_MIN
+#   define MAXUINT16	USHRT_MAX
+#endif
+
 // The transport in use is considered to be an external hook.
 // We will use the native Win32 method for now until I write
 // a Tcl one that, will of course, be universal.  Even more
@@ -19,9 +45,16 @@
 #include "c-motion/PMDW32Ser.h"
 
 CMoAxis::CMoAxis(Tcl_Interp* interp)
+    : moveQueue(&hAxis), savedTransportData(0L)
 {
 
-#if defined PMD_CAN_INTERFACE
+#if defined PMD_CAN_INTERFACE && defined __linux__
+    // SocketCAN on can0 and NodeID=0 (CMoCan.h).  The bit rate belongs
+    // to the interface: ip link set can0 type can bitrate ...
+    memset(&hAxis, 0, sizeof(hAxis));
+    hAxis.axis = PMDAxis1;
+    CMoCan_Open(&hAxis, "can0", 0);
+#elif defined PMD_CAN_INTERFACE
     // open the CAN interface at 20,000 baud and NodeID=0
     PMDSetupAxisInterface_CAN(&hAxis, PMDAxis, PMDCANBaud20000, 0);
 #elif defined PMD_W32SERIAL_INTERFACE
@@ -34,10 +67,82 @@ CMoAxis::CMoAxis(Tcl_Interp* interp)
     PMDSetupAxisInterface_SPI(&hAxis, PMDAxis, 0);
 #endif
 
+    // A serial port is armed for this thread only until it is attached to
+    // the reactor; [$axis StopStats] says which it is.
+    const char* why;
+    CMoStop::Arm(&hAxis, &why);
+};
+
+// An axis with no port at all.  Everything it sends goes to the capture,
+// which is how prepared programs get their packets encoded.
+CMoAxis::CMoAxis(CMoCapture* capture)
+    : moveQueue(&hAxis), savedTransportData(0L)
+{
+    memset(&hAxis, 0, sizeof(hAxis));
+    hAxis.axis = PMDAxis1;
+    hAxis.transport.SendCommand = CMoCapture::SendCommand;
+    hAxis.transport_data = capture;
 };
 
 CMoAxis::~CMoAxis()
 {
+    CMoStop::Disarm(&hAxis);
+    CMoWait::Cancel(&hAxis);
+    CMoReconnect::Release(&hAxis);
+    CMoPrefetch::Release(&hAxis);
+    CMoReactor::Detach(&hAxis);
+    if (hAxis.transport.SendCommand == CMoNetwork_SendCommand)
+    {
+	CMoNetwork_Close(hAxis.transport_data);
+    }
+    else if (hAxis.transport.SendCommand == CMoCan_SendCommand)
+    {
+	CMoCan_Close(hAxis.transport_data);
+    }
+};
+
+void
+CMoAxis::BeginCapture(CMoCapture* capture)
+{
+    savedTransport = hAxis.transport;
+    savedTransportData = hAxis.transport_data;
+    hAxis.transport.SendCommand = CMoCapture::SendCommand;
+    hAxis.transport_data = capture;
+};
+
+void
+CMoAxis::EndCapture()
+{
+    hAxis.transport = savedTransport;
+    hAxis.transport_data = savedTransportData;
+};
+
+PMDAxisHandle*
+CMoAxis::Handle()
+{
+    return &hAxis;
+};
+
+int
+CMoAxis::Invoke(Tcl_Interp* interp, Method method, Tcl_Obj* words)
+{
+    Tcl_Obj** objv;
+    Tcl_Obj* msg;
+    int objc;
+
+    if (TCL_OK != Tcl_ListObjGetElements(interp, words, &objc, &objv))
+    {
+	return TCL_ERROR;
+    }
+    if (TCL_OK != (this->*method)(interp, objc, objv))
+    {
+	msg = Tcl_NewStringObj(Tcl_GetString(objv[0]), -1);
+	Tcl_AppendToObj(msg, ": ", 2);
+	Tcl_AppendObjToObj(msg, Tcl_GetObjResult(interp));
+	Tcl_SetObjResult(interp, msg);
+	return TCL_ERROR;
+    }
+    return TCL_OK;
 };
 
 int
@@ -110,7 +215,8 @@ CMoAxis::PMDGetProfileMode(Tcl_Interp* interp, int objc, struct Tcl_Obj* const o
 	case PMDProfileModeElectronicGear:
 	    pm = Tcl_NewStringObj("electronic-gear", -1); break;
 	default:
-	    Tcl_Panic("unknown profile mode");
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf("unknown profile mode %d", mode));
+	    return TCL_ERROR;
     }
 
     Tcl_SetObjResult(interp, pm);
@@ -125,11 +231,11 @@ CMoAxis::PMDSetPosition(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv
 
     if (objc != 2)
     {
-	Tcl_WrongNumArgs(interp, 2, objv, "position");
+	Tcl_WrongNumArgs(interp, 1, objv, "position");
 	return TCL_ERROR;
     }
 
-    if (TCL_OK != Tcl_GetLongFromObj(interp, objv[2], &position))
+    if (TCL_OK != Tcl_GetLongFromObj(interp, objv[1], &position))
     {
 	return TCL_ERROR;
     }
@@ -170,11 +276,11 @@ CMoAxis::PMDSetVelocity(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv
 
     if (objc != 2)
     {
-	Tcl_WrongNumArgs(interp, 2, objv, "velocity");
+	Tcl_WrongNumArgs(interp, 1, objv, "velocity");
 	return TCL_ERROR;
     }
 
-    if (TCL_OK != Tcl_GetLongFromObj(interp, objv[2], &temp))
+    if (TCL_OK != Tcl_GetLongFromObj(interp, objv[1], &temp))
     {
 	return TCL_ERROR;
     }
@@ -233,7 +339,7 @@ CMoAxis::PMDSetStartVelocity(Tcl_Interp* interp, int objc, struct Tcl_Obj* const
 
     if (objc != 2)
     {
-	Tcl_WrongNumArgs(interp, 2, objv, "velocity");
+	Tcl_WrongNumArgs(interp, 1, objv, "velocity");
 	return TCL_ERROR;
     }
 
@@ -610,7 +716,8 @@ CMoAxis::PMDGetStopMode(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv
     case PMDStopModeSmooth:
 	sm = Tcl_NewStringObj("smooth", -1); break;
     default:
-	Tcl_Panic("unknown stop mode");
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf("unknown stop mode %d", mode));
+	return TCL_ERROR;
     }
 
     Tcl_SetObjResult(interp, sm);
@@ -1096,7 +1203,8 @@ CMoAxis::PMDGetMotionCompleteMode(Tcl_Interp* interp, int objc, struct Tcl_Obj*
     case PMDMotionCompleteModeActualPosition:
 	pm = Tcl_NewStringObj("actual", -1); break;
     default:
-	Tcl_Panic("bad motion complete mode");
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf("bad motion complete mode %d", mode));
+	return TCL_ERROR;
     }
     Tcl_SetObjResult(interp, pm);
     return TCL_OK;
@@ -1190,10 +1298,96 @@ CMoAxis::PMDGetSampleTime(Tcl_Interp* interp, int objc, struct Tcl_Obj* const ob
     return TCL_OK;
 };
 
+// Names used by the breakpoint methods.  The order of each table matches
+// the encoding the chip uses, so the index from Tcl_GetIndexFromObj is the
+// value sent and a value read back is an index into the table.
+static const char* bpAxes[] =
+{
+    "axis1", "axis2", "axis3", "axis4", 0L
+};
+static const char* bpActions[] =
+{
+    "none", "update", "abruptStop", "smoothStop", "motorOff", "disablePos",
+    "disableCurrent", "disableMotor", "abruptStopClear", 0L
+};
+static const char* bpTriggers[] =
+{
+    "disable", "gtCmddPos", "ltCmddPos", "gtActualPos", "ltActualPos",
+    "CmddPosX", "actualPosX", "time", "event", "activity", "signal",
+    "drive", 0L
+};
+static const char* bpUpdateMasks[] =
+{
+    "trajectory", "position-loop", "current-loop", 0L
+};
+static const PMDuint16 bpUpdateMaskBits[] =
+{
+    PMDUpdateMaskTrajectory, PMDUpdateMaskPositionLoop,
+    PMDUpdateMaskCurrentLoop
+};
+
+int
+CMoAxis::GetBreakpointIDFromObj(Tcl_Interp* interp, Tcl_Obj* obj, PMDuint16* id)
+{
+    int idraw;
+
+    if (TCL_OK != Tcl_GetIntFromObj(interp, obj, &idraw))
+    {
+	return TCL_ERROR;
+    }
+
+    switch (idraw)
+    {
+    case 1:
+	*id = PMDBreakpoint1; break;
+    case 2:
+	*id = PMDBreakpoint2; break;
+    default:
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("breakpointID must be 1 or 2", -1));
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+};
+
 int 
 CMoAxis::PMDSetBreakpoint(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
 {
-    return TCL_ERROR;
+    PMDresult result;
+    PMDuint16 id;
+    int axis, action, trigger;
+
+    if (objc != 5)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "breakpointID sourceAxis action trigger");
+	return TCL_ERROR;
+    }
+
+    if (TCL_OK != GetBreakpointIDFromObj(interp, objv[1], &id))
+    {
+	return TCL_ERROR;
+    }
+
+    if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[2],
+	    (const char**)bpAxes, "sourceAxis", 0, &axis) ||
+	TCL_OK != Tcl_GetIndexFromObj(interp, objv[3],
+	    (const char**)bpActions, "action", 0, &action) ||
+	TCL_OK != Tcl_GetIndexFromObj(interp, objv[4],
+	    (const char**)bpTriggers, "trigger", 0, &trigger))
+    {
+	return TCL_ERROR;
+    }
+
+    if (PMD_NOERROR != (result = ::PMDSetBreakpoint(&hAxis, id,
+	    static_cast<PMDAxis>(axis), static_cast<PMDuint8>(action),
+	    static_cast<PMDuint8>(trigger))))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
 };
 
 int
@@ -1201,11 +1395,9 @@ CMoAxis::PMDGetBreakpoint(Tcl_Interp* interp, int objc, struct Tcl_Obj* const ob
 {
     PMDresult result;
     PMDuint16 id;
-    int idraw;
     PMDAxis axis;
     PMDuint8 action, trigger;
-    Tcl_Obj *returnList, *axisObj, *actionObj, *triggerObj;
-
+    Tcl_Obj *returnList;
 
     if (objc != 2)
     {
@@ -1213,113 +1405,52 @@ CMoAxis::PMDGetBreakpoint(Tcl_Interp* interp, int objc, struct Tcl_Obj* const ob
 	return TCL_ERROR;
     }
 
-    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[1], &idraw))
+    if (TCL_OK != GetBreakpointIDFromObj(interp, objv[1], &id))
     {
 	return TCL_ERROR;
     }
 
-    switch (idraw)
+    if (PMD_NOERROR != (result = 
+	    ::PMDGetBreakpoint(&hAxis, id, &axis, &action, &trigger)))
     {
-    case 1:
-	id = PMDBreakpoint1; break;
-    case 2:
-	id = PMDBreakpoint2; break;
-    default:
 	Tcl_SetObjResult(interp,
-	    Tcl_NewStringObj("breakpointID must be 1 or 2", -1));
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
 	return TCL_ERROR;
-
     }
 
-    if (PMD_NOERROR != (result = 
-	    ::PMDGetBreakpoint(&hAxis, id, &axis, &action, &trigger)))
+    // Don't trust the chip to stay inside our tables.  A firmware newer
+    // than this extension is an error for the script, not a reason to
+    // take the whole process down.
+    if ((axis & ~PMDAtlasAxisMask) > PMDAxis4 ||
+	action >= (sizeof(bpActions) / sizeof(bpActions[0])) - 1 ||
+	trigger >= (sizeof(bpTriggers) / sizeof(bpTriggers[0])) - 1)
     {
-	Tcl_SetObjResult(interp,
-	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	std::ostringstream msg;
+	msg << "unknown breakpoint setting: axis " << axis << ", action "
+	    << (int)action << ", trigger " << (int)trigger;
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(msg.str().c_str(), -1));
 	return TCL_ERROR;
     }
 
     // start an empty list that we add to
     returnList = Tcl_NewListObj(0, 0L);
 
-    switch (axis)
-    {
-    case PMDAxis1:
-	axisObj = Tcl_NewStringObj("axis1", -1); break;
-    case PMDAxis2:
-	axisObj = Tcl_NewStringObj("axis2", -1); break;
-    case PMDAxis3:
-	axisObj = Tcl_NewStringObj("axis3", -1); break;
-    case PMDAxis4:
-	axisObj = Tcl_NewStringObj("axis4", -1); break;
-    case PMDAtlasAxis1:
-	axisObj = Tcl_NewStringObj("atlasAxis1", -1); break;
-    case PMDAtlasAxis2:
-	axisObj = Tcl_NewStringObj("atlasAxis2", -1); break;
-    case PMDAtlasAxis3:
-	axisObj = Tcl_NewStringObj("atlasAxis3", -1); break;
-    case PMDAtlasAxis4:
-	axisObj = Tcl_NewStringObj("atlasAxis4", -1); break;
-    default:
-	Tcl_Panic("bad stuff !TODO!");
-    }
-    Tcl_ListObjAppendElement(interp, returnList, axisObj);
-
-    switch (action)
-    {
-    case PMDBreakpointActionNone:
-	actionObj = Tcl_NewStringObj("none", -1); break;
-    case PMDBreakpointActionUpdate:
-	actionObj = Tcl_NewStringObj("update", -1); break;
-    case PMDBreakpointActionAbruptStop:
-	actionObj = Tcl_NewStringObj("abruptStop", -1); break;
-    case PMDBreakpointActionSmoothStop:
-	actionObj = Tcl_NewStringObj("smoothStop", -1); break;
-    case PMDBreakpointActionMotorOff:
-	actionObj = Tcl_NewStringObj("motorOff", -1); break;
-    case PMDBreakpointActionDisablePositionLoopAndHigherModules:
-	actionObj = Tcl_NewStringObj("disablePos", -1); break;
-    case PMDBreakpointActionDisableCurrentLoopAndHigherModules:
-	actionObj = Tcl_NewStringObj("disableCurrent", -1); break;
-    case PMDBreakpointActionDisableMotorOutputAndHigherModules:
-	actionObj = Tcl_NewStringObj("disableMotor", -1); break;
-    case PMDBreakpointActionAbruptStopWithPositionErrorClear:
-	actionObj = Tcl_NewStringObj("abruptStopClear", -1); break;
-    default:
-	Tcl_Panic("bad stuff !TODO!");
-    }
-    Tcl_ListObjAppendElement(interp, returnList, actionObj);
-
-    switch (trigger)
-    {
-    case PMDBreakpointTriggerDisable:
-	triggerObj = Tcl_NewStringObj("disable", -1); break;
-    case PMDBreakpointTriggerGreaterOrEqualCommandedPosition:
-	triggerObj = Tcl_NewStringObj("gtCmddPos", -1); break;
-    case PMDBreakpointTriggerLessOrEqualCommandedPosition:
-	triggerObj = Tcl_NewStringObj("ltCmddPos", -1); break;
-    case PMDBreakpointTriggerGreaterOrEqualActualPosition:
-	triggerObj = Tcl_NewStringObj("gtActualPos", -1); break;
-    case PMDBreakpointTriggerLessOrEqualActualPosition:
-	triggerObj = Tcl_NewStringObj("ltActualPos", -1); break;
-    case PMDBreakpointTriggerCommandedPositionCrossed:
-	triggerObj = Tcl_NewStringObj("CmddPosX", -1); break;
-    case PMDBreakpointTriggerActualPositionCrossed:
-	triggerObj = Tcl_NewStringObj("actualPosX", -1); break;
-    case PMDBreakpointTriggerTime:
-	triggerObj = Tcl_NewStringObj("time", -1); break;
-    case PMDBreakpointTriggerEventStatus:
-	triggerObj = Tcl_NewStringObj("event", -1); break;
-    case PMDBreakpointTriggerActivityStatus:
-	triggerObj = Tcl_NewStringObj("activity", -1); break;
-    case PMDBreakpointTriggerSignalStatus:
-	triggerObj = Tcl_NewStringObj("signal", -1); break;
-    case PMDBreakpointTriggerDriveStatus:
-	triggerObj = Tcl_NewStringObj("drive", -1); break;
-    default:
-	Tcl_Panic("bad stuff !TODO!");
+    if (axis & PMDAtlasAxisMask)
+    {
+	std::string atlas("atlasAxis");
+	atlas += static_cast<char>('1' + (axis & ~PMDAtlasAxisMask));
+	Tcl_ListObjAppendElement(interp, returnList,
+	    Tcl_NewStringObj(atlas.c_str(), -1));
+    }
+    else
+    {
+	Tcl_ListObjAppendElement(interp, returnList,
+	    Tcl_NewStringObj(bpAxes[axis], -1));
     }
-    Tcl_ListObjAppendElement(interp, returnList, triggerObj);
+    Tcl_ListObjAppendElement(interp, returnList,
+	Tcl_NewStringObj(bpActions[action], -1));
+    Tcl_ListObjAppendElement(interp, returnList,
+	Tcl_NewStringObj(bpTriggers[trigger], -1));
 
     Tcl_SetObjResult(interp, returnList);
     return TCL_OK;
@@ -1328,7 +1459,43 @@ CMoAxis::PMDGetBreakpoint(Tcl_Interp* interp, int objc, struct Tcl_Obj* const ob
 int
 CMoAxis::PMDSetBreakpointValue(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
 {
-    return TCL_ERROR;
+    PMDresult result;
+    PMDuint16 id;
+    Tcl_WideInt temp;
+
+    if (objc != 3)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "breakpointID value");
+	return TCL_ERROR;
+    }
+
+    if (TCL_OK != GetBreakpointIDFromObj(interp, objv[1], &id))
+    {
+	return TCL_ERROR;
+    }
+
+    if (TCL_OK != Tcl_GetWideIntFromObj(interp, objv[2], &temp))
+    {
+	return TCL_ERROR;
+    }
+
+    // Positions and times are signed, but the status triggers pack two
+    // 16 bit masks so allow the full unsigned range too.
+    if (temp < MININT32 || temp > MAXUINT32)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("value out of range", -1));
+	return TCL_ERROR;
+    }
+
+    if (PMD_NOERROR != (result = ::PMDSetBreakpointValue(&hAxis, id,
+	    static_cast<PMDint32>(temp))))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
 };
 
 int
@@ -1337,7 +1504,6 @@ CMoAxis::PMDGetBreakpointValue(Tcl_Interp* interp, int objc, struct Tcl_Obj* con
     PMDresult result;
     PMDuint16 id;
     PMDint32 value;
-    int idraw;
     
     if (objc != 2)
     {
@@ -1345,22 +1511,9 @@ CMoAxis::PMDGetBreakpointValue(Tcl_Interp* interp, int objc, struct Tcl_Obj* con
 	return TCL_ERROR;
     }
 
-    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[1], &idraw))
-    {
-	return TCL_ERROR;
-    }
-
-    switch (idraw)
+    if (TCL_OK != GetBreakpointIDFromObj(interp, objv[1], &id))
     {
-    case 1:
-	id = PMDBreakpoint1; break;
-    case 2:
-	id = PMDBreakpoint2; break;
-    default:
-	Tcl_SetObjResult(interp,
-	    Tcl_NewStringObj("breakpointID must be 1 or 2", -1));
 	return TCL_ERROR;
-
     }
 
     if (PMD_NOERROR != (result =
@@ -1371,20 +1524,94 @@ CMoAxis::PMDGetBreakpointValue(Tcl_Interp* interp, int objc, struct Tcl_Obj* con
 	return TCL_ERROR;
     }
 
-    //  TODO!
-
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(value));
+    return TCL_OK;
 };
 
 int
 CMoAxis::PMDSetBreakpointUpdateMask(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
 {
-    return TCL_ERROR;
+    PMDresult result;
+    PMDuint16 id, mask = 0;
+    Tcl_Obj** elems;
+    int count, i, index;
+
+    if (objc != 3)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "breakpointID maskList");
+	return TCL_ERROR;
+    }
+
+    if (TCL_OK != GetBreakpointIDFromObj(interp, objv[1], &id))
+    {
+	return TCL_ERROR;
+    }
+
+    if (TCL_OK != Tcl_ListObjGetElements(interp, objv[2], &count, &elems))
+    {
+	return TCL_ERROR;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+	if (TCL_OK != Tcl_GetIndexFromObj(interp, elems[i],
+	    (const char**)bpUpdateMasks, "mask", 0, &index))
+	{
+	    return TCL_ERROR;
+	}
+	mask |= bpUpdateMaskBits[index];
+    }
+
+    if (PMD_NOERROR != (result =
+	::PMDSetBreakpointUpdateMask(&hAxis, id, mask)))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+
+    return TCL_OK;
 };
 
 int
 CMoAxis::PMDGetBreakpointUpdateMask(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
 {
-    return TCL_ERROR;
+    PMDresult result;
+    PMDuint16 id, mask;
+    Tcl_Obj* returnList;
+    int i;
+
+    if (objc != 2)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "breakpointID");
+	return TCL_ERROR;
+    }
+
+    if (TCL_OK != GetBreakpointIDFromObj(interp, objv[1], &id))
+    {
+	return TCL_ERROR;
+    }
+
+    if (PMD_NOERROR != (result =
+	::PMDGetBreakpointUpdateMask(&hAxis, id, &mask)))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+
+    returnList = Tcl_NewListObj(0, 0L);
+    for (i = 0; bpUpdateMasks[i] != 0L; i++)
+    {
+	if (mask & bpUpdateMaskBits[i])
+	{
+	    Tcl_ListObjAppendElement(interp, returnList,
+		Tcl_NewStringObj(bpUpdateMasks[i], -1));
+	}
+    }
+
+    Tcl_SetObjResult(interp, returnList);
+    return TCL_OK;
 };
 
 int
@@ -1406,8 +1633,23 @@ CMoAxis::PMDMultiUpdate(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv
 {
     PMDresult result;
     PMDuint16 mask;
+    int temp;
 
-    //TODO mask
+    if (objc != 2)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "mask");
+	return TCL_ERROR;
+    }
+    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[1], &temp))
+    {
+	return TCL_ERROR;
+    }
+    if (temp < 0 || temp > MAXUINT16)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("value out of range", -1));
+	return TCL_ERROR;
+    }
+    mask = static_cast<PMDuint16>(temp);
 
     if (PMD_NOERROR != (result = ::PMDMultiUpdate(&hAxis, mask)))
     {
@@ -1451,13 +1693,35 @@ CMoAxis::PMDResetEventStatus(Tcl_Interp* interp, int objc, struct Tcl_Obj* const
 int
 CMoAxis::PMDGetEventStatus(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
 {
-    return TCL_ERROR;
+    PMDresult result;
+    PMDuint16 status;
+
+    if (PMD_NOERROR != (result = ::PMDGetEventStatus(&hAxis, &status)))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(status));
+    return TCL_OK;
 };
 
 int
 CMoAxis::PMDGetActivityStatus(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
 {
-    return TCL_ERROR;
+    PMDresult result;
+    PMDuint16 status;
+
+    if (PMD_NOERROR != (result = ::PMDGetActivityStatus(&hAxis, &status)))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(status));
+    return TCL_OK;
 };
 
 int
@@ -1493,7 +1757,18 @@ CMoAxis::PMDSetActualPosition(Tcl_Interp* interp, int objc, struct Tcl_Obj* cons
 int
 CMoAxis::PMDGetActualPosition(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
 {
-    return TCL_ERROR;
+    PMDresult result;
+    PMDint32 position;
+
+    if (PMD_NOERROR != (result = ::PMDGetActualPosition(&hAxis, &position)))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(position));
+    return TCL_OK;
 };
 
 int
@@ -1559,12 +1834,23 @@ CMoAxis::PMDGetEncoderToStepRatio(Tcl_Interp* interp, int objc, struct Tcl_Obj*
 int
 CMoAxis::PMDGetActualVelocity(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
 {
-    return TCL_ERROR;
-};
+    PMDresult result;
+    PMDint32 velocity;
 
-int
-CMoAxis::PMDGetCaptureValue(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
-{
+    if (PMD_NOERROR != (result = ::PMDGetActualVelocity(&hAxis, &velocity)))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(velocity));
+    return TCL_OK;
+};
+
+int
+CMoAxis::PMDGetCaptureValue(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
     return TCL_ERROR;
 };
 
@@ -1661,7 +1947,8 @@ CMoAxis::PMDGetMotorType(Tcl_Interp* interp, int objc, struct Tcl_Obj* const obj
     case PMDMotorTypeDCBrush:
 	mt = Tcl_NewStringObj("brush-DC", -1); break;
     default:
-	Tcl_Panic("unknown motor type");
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf("unknown motor type %d", type));
+	return TCL_ERROR;
     }
 
     Tcl_SetObjResult(interp, mt);
@@ -2538,3 +2825,1898 @@ CMoAxis::PMDGetCurrentLimit(Tcl_Interp* interp, int objc, struct Tcl_Obj* const
     return TCL_ERROR;
 };
 
+
+// Move queue.  Segments are given in the same units as SetPosition,
+// SetVelocity, SetAcceleration, SetDeceleration and SetJerk.
+
+int
+CMoAxis::QueueMove(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* options[] = {"-jerk", "-trigger", 0L};
+    enum options {OPT_JERK, OPT_TRIGGER};
+    CMoMoveQueue::Segment seg;
+    Tcl_WideInt temp;
+    double jerk;
+    int i, index, trigger;
+
+    if (objc < 5)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv,
+	    "position velocity acceleration deceleration ?-jerk jerk? "
+	    "?-trigger trigger value?");
+	return TCL_ERROR;
+    }
+
+    seg.jerk = 0;
+    seg.trigger = PMDBreakpointTriggerCommandedPositionCrossed;
+    seg.value = 0;
+    seg.chained = true;
+
+    if (TCL_OK != Tcl_GetWideIntFromObj(interp, objv[1], &temp))
+    {
+	return TCL_ERROR;
+    }
+    if (temp < MININT32 || temp > MAXINT32)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("position out of range", -1));
+	return TCL_ERROR;
+    }
+    seg.position = static_cast<PMDint32>(temp);
+
+    // Use scaling factor of 1/2^16
+    if (TCL_OK != Tcl_GetWideIntFromObj(interp, objv[2], &temp))
+    {
+	return TCL_ERROR;
+    }
+    temp = temp * 65536;
+    if (temp < MININT32 || temp > MAXINT32)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("velocity out of range", -1));
+	return TCL_ERROR;
+    }
+    seg.velocity = static_cast<PMDint32>(temp);
+
+    if (TCL_OK != Tcl_GetWideIntFromObj(interp, objv[3], &temp))
+    {
+	return TCL_ERROR;
+    }
+    temp = temp * 65536;
+    if (temp < 0 || temp > MAXUINT32)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("acceleration out of range", -1));
+	return TCL_ERROR;
+    }
+    seg.acceleration = static_cast<PMDuint32>(temp);
+
+    if (TCL_OK != Tcl_GetWideIntFromObj(interp, objv[4], &temp))
+    {
+	return TCL_ERROR;
+    }
+    temp = temp * 65536;
+    if (temp < 0 || temp > MAXUINT32)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("deceleration out of range", -1));
+	return TCL_ERROR;
+    }
+    seg.deceleration = static_cast<PMDuint32>(temp);
+
+    for (i = 5; i < objc; i++)
+    {
+	if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option",
+		0, &index))
+	{
+	    return TCL_ERROR;
+	}
+
+	switch ((enum options) index)
+	{
+	case OPT_JERK:
+	    if (++i >= objc)
+	    {
+		Tcl_WrongNumArgs(interp, 1, objv, "... -jerk jerk");
+		return TCL_ERROR;
+	    }
+	    if (TCL_OK != Tcl_GetDoubleFromObj(interp, objv[i], &jerk))
+	    {
+		return TCL_ERROR;
+	    }
+	    // apply scaling factor of 1/2^32
+	    jerk = jerk * 4294967296;
+	    if (jerk < 0 || jerk > MAXUINT32)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("jerk out of range", -1));
+		return TCL_ERROR;
+	    }
+	    seg.jerk = static_cast<PMDuint32>(jerk);
+	    break;
+
+	case OPT_TRIGGER:
+	    if (i + 2 >= objc)
+	    {
+		Tcl_WrongNumArgs(interp, 1, objv, "... -trigger trigger value");
+		return TCL_ERROR;
+	    }
+	    if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[++i],
+		    (const char**)bpTriggers, "trigger", 0, &trigger))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (trigger == PMDBreakpointTriggerDisable)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("a queued move needs a trigger", -1));
+		return TCL_ERROR;
+	    }
+	    if (TCL_OK != Tcl_GetWideIntFromObj(interp, objv[++i], &temp))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (temp < MININT32 || temp > MAXUINT32)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("value out of range", -1));
+		return TCL_ERROR;
+	    }
+	    seg.trigger = static_cast<PMDuint8>(trigger);
+	    seg.value = static_cast<PMDint32>(temp);
+	    seg.chained = false;
+	    break;
+	}
+    }
+
+    moveQueue.Add(seg);
+    return TCL_OK;
+};
+
+int
+CMoAxis::QueueStart(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* options[] = {"-interval", "-command", 0L};
+    enum options {OPT_INTERVAL, OPT_COMMAND};
+    PMDresult result;
+    Tcl_Obj* command = 0L;
+    int i, index, interval = 5;
+
+    if (objc % 2 != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "?-interval ms? ?-command script?");
+	return TCL_ERROR;
+    }
+
+    for (i = 1; i < objc; i += 2)
+    {
+	if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option",
+		0, &index))
+	{
+	    return TCL_ERROR;
+	}
+
+	switch ((enum options) index)
+	{
+	case OPT_INTERVAL:
+	    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &interval))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (interval < 0)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("interval can't be negative", -1));
+		return TCL_ERROR;
+	    }
+	    break;
+
+	case OPT_COMMAND:
+	    command = objv[i+1];
+	    break;
+	}
+    }
+
+    if (PMD_NOERROR != (result = moveQueue.Start(interp, interval, command)))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+};
+
+int
+CMoAxis::QueueStop(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    PMDresult result;
+
+    if (PMD_NOERROR != (result = moveQueue.Stop()))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+};
+
+// For use with "-interval 0", when the caller wants to drive the queue
+// from its own polling loop.
+int
+CMoAxis::QueueService(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    PMDresult result;
+
+    if (PMD_NOERROR != (result = moveQueue.Service()))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, moveQueue.Status());
+    return TCL_OK;
+};
+
+int
+CMoAxis::QueueStatus(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    Tcl_SetObjResult(interp, moveQueue.Status());
+    return TCL_OK;
+};
+
+// Like fconfigure for the port behind this axis.  With no options it
+// returns all of them.  With -adaptive on, each reply is waited for as
+// long as round trips of its shape have been taking (PMDSerial_RttSample),
+// never less than -mintimeout nor more than -timeout.  -attempts above 1
+// sends a packet again after a transient error, -backoff microseconds
+// after the first retry and twice as long each time after that (see
+// CMoRetry.hpp).  -reconnect keeps the drive's settings and brings the
+// port back when it goes, with calls waiting that many ms for it (see
+// CMoReconnect.hpp).  -loadceiling is the percentage of the line that
+// periodic polls may take it to, 0 for no limit (see CMoLoad.hpp).
+int
+CMoAxis::SerialConfigure(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* options[] = {"-adaptive", "-attempts", "-backoff",
+	"-baud", "-loadceiling", "-lowlatency", "-mintimeout", "-reconnect",
+	"-timeout", 0L};
+    enum options {OPT_ADAPTIVE, OPT_ATTEMPTS, OPT_BACKOFF, OPT_BAUD,
+	OPT_LOADCEILING, OPT_LOWLATENCY, OPT_MINTIMEOUT, OPT_RECONNECT,
+	OPT_TIMEOUT};
+    PMDSerialIOData* SIOtransport_data;
+    PMDuint32 attempts;
+    Tcl_Obj* resultList;
+    int i, index, flag, timeout, baud, count;
+    bool attached, ok;
+
+    if (hAxis.transport.SendCommand != PMDSerial_Send &&
+	hAxis.transport.SendCommand != CMoReactor_SendCommand)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("axis is not on a serial port", -1));
+	return TCL_ERROR;
+    }
+    SIOtransport_data = (PMDSerialIOData*)hAxis.transport_data;
+
+    if (objc == 1)
+    {
+	resultList = Tcl_NewListObj(0, 0L);
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-adaptive", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewBooleanObj(SIOtransport_data->bAdaptive));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-attempts", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(SIOtransport_data->retry.attempts));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-backoff", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(SIOtransport_data->retry.backoffUs));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-baud", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(SIOtransport_data->baud));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-loadceiling", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(SIOtransport_data->load.ceiling));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-lowlatency", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewBooleanObj(SIOtransport_data->bLowLatency));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-mintimeout", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(SIOtransport_data->minTimeout));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-reconnect", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(SIOtransport_data->reconnect.waitMs));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-timeout", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(SIOtransport_data->timeout));
+	Tcl_SetObjResult(interp, resultList);
+	return TCL_OK;
+    }
+
+    if (objc % 2 == 0)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv,
+	    "?-adaptive bool? ?-attempts n? ?-backoff us? ?-baud rate|auto? "
+	    "?-loadceiling percent? ?-lowlatency bool? ?-mintimeout ms? "
+	    "?-reconnect ms? ?-timeout ms?");
+	return TCL_ERROR;
+    }
+
+    for (i = 1; i < objc; i += 2)
+    {
+	if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option",
+		0, &index))
+	{
+	    return TCL_ERROR;
+	}
+
+	switch ((enum options) index)
+	{
+	case OPT_ADAPTIVE:
+	    if (TCL_OK != Tcl_GetBooleanFromObj(interp, objv[i+1], &flag))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (!PMDSerial_SetAdaptive(SIOtransport_data, flag, 0) && flag)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("adaptive timeouts not supported", -1));
+		return TCL_ERROR;
+	    }
+	    break;
+
+	case OPT_ATTEMPTS:
+	case OPT_BACKOFF:
+	    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &count))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (count < (index == OPT_ATTEMPTS ? 1 : 0))
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj(index == OPT_ATTEMPTS
+		    ? "invalid attempts" : "invalid backoff", -1));
+		return TCL_ERROR;
+	    }
+	    if (index == OPT_ATTEMPTS)
+	    {
+		SIOtransport_data->retry.attempts = count;
+	    }
+	    else
+	    {
+		SIOtransport_data->retry.backoffUs = count;
+	    }
+	    break;
+
+	case OPT_MINTIMEOUT:
+	    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &timeout))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (timeout <= 0)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("invalid timeout", -1));
+		return TCL_ERROR;
+	    }
+	    SIOtransport_data->minTimeout = timeout;
+	    break;
+
+	case OPT_RECONNECT:
+	    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &timeout))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (timeout < 0)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("invalid reconnect time", -1));
+		return TCL_ERROR;
+	    }
+	    CMoReconnect::Enable(&hAxis, timeout);
+	    break;
+
+	case OPT_LOADCEILING:
+	    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &count))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (count < 0 || count > 100)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("invalid load ceiling", -1));
+		return TCL_ERROR;
+	    }
+	    CMoLoad::SetCeiling(&hAxis, count);
+	    break;
+
+	case OPT_BAUD:
+	    // The negotiation works the port directly, so the reactor
+	    // lets go of it meanwhile.  Its probes are meant to fail at
+	    // the wrong rate and must not be retried.
+	    attempts = SIOtransport_data->retry.attempts;
+	    SIOtransport_data->retry.attempts = 1;
+	    if (strcmp(Tcl_GetString(objv[i+1]), "auto") == 0)
+	    {
+		attached = CMoReactor::Detach(&hAxis);
+		ok = SerialNegotiate(0);
+		if (attached) CMoReactor::Attach(&hAxis);
+		SIOtransport_data->retry.attempts = attempts;
+		if (!ok)
+		{
+		    Tcl_SetObjResult(interp,
+			Tcl_NewStringObj("no reply from the drive", -1));
+		    return TCL_ERROR;
+		}
+		break;
+	    }
+	    SIOtransport_data->retry.attempts = attempts;
+	    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &baud))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (SerialRateCode(baud) < 0)
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid baud rate, "
+		    "must be 1200, 2400, 9600, 19200, 57600, 115200, 230400, "
+		    "460800 or auto", -1));
+		return TCL_ERROR;
+	    }
+	    SIOtransport_data->retry.attempts = 1;
+	    attached = CMoReactor::Detach(&hAxis);
+	    ok = SerialNegotiate(baud);
+	    if (attached) CMoReactor::Attach(&hAxis);
+	    SIOtransport_data->retry.attempts = attempts;
+	    if (!ok)
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    SIOtransport_data->baud == (PMDuint32) baud
+		    ? "no reply from the drive"
+		    : "drive did not take the new rate", -1));
+		return TCL_ERROR;
+	    }
+	    break;
+
+	case OPT_LOWLATENCY:
+	    if (TCL_OK != Tcl_GetBooleanFromObj(interp, objv[i+1], &flag))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (!PMDSerial_SetLowLatency(SIOtransport_data, flag) && flag)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("low latency mode not supported", -1));
+		return TCL_ERROR;
+	    }
+	    break;
+
+	case OPT_TIMEOUT:
+	    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &timeout))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (timeout <= 0 || !PMDSerial_SetTimeout(SIOtransport_data, timeout))
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("invalid timeout", -1));
+		return TCL_ERROR;
+	    }
+	    break;
+	}
+    }
+    return TCL_OK;
+};
+
+// What the resynchronisation of this axis' serial port has cost so far,
+// see PMDSerial_Resync, the round trips learned for each packet shape
+// that has been timed, keyed by "command words,reply words", and what the
+// retry policy has done.
+int
+CMoAxis::SerialStats(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* causes[PMDSerialSyncCauses] = {"requested",
+	"checksum", "lostReply", "badSerialChecksum", "invalidInstruction",
+	"invalidAxis", "hardFault"};
+    PMDSerialSyncStats* stats;
+    PMDSerialRtt* rtt;
+    PMDSerialRetry* policy;
+    PMDSerialReconnect* link;
+    Tcl_Obj *result, *byCause, *byShape, *shape, *retry, *reconnect;
+    int i, x, r;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (hAxis.transport.SendCommand != PMDSerial_Send &&
+	hAxis.transport.SendCommand != CMoReactor_SendCommand)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("axis is not on a serial port", -1));
+	return TCL_ERROR;
+    }
+    stats = &((PMDSerialIOData*)hAxis.transport_data)->sync;
+    rtt = ((PMDSerialIOData*)hAxis.transport_data)->rtt;
+    policy = &((PMDSerialIOData*)hAxis.transport_data)->retry;
+    link = &((PMDSerialIOData*)hAxis.transport_data)->reconnect;
+
+    byCause = Tcl_NewDictObj();
+    for (i = 0; i < PMDSerialSyncCauses; i++)
+    {
+	Tcl_DictObjPut(0L, byCause, Tcl_NewStringObj(causes[i], -1),
+	    Tcl_NewLongObj(stats->cause[i]));
+    }
+    result = Tcl_NewDictObj();
+#define SyncPut(f) \
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(stats->f))
+    SyncPut(count);
+    SyncPut(failed);
+    SyncPut(lastUs);
+    SyncPut(maxUs);
+    SyncPut(totalUs);
+#undef SyncPut
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj("causes", -1), byCause);
+
+    byShape = Tcl_NewDictObj();
+    for (x = 1; x <= 4; x++)
+    {
+	for (r = 0; r <= 4; r++)
+	{
+	    PMDSerialRtt* c = &rtt[PMD_SERIAL_RTT_CLASS(x, r)];
+	    if (c->samples == 0 && c->timeouts == 0)
+	    {
+		continue;
+	    }
+	    shape = Tcl_NewDictObj();
+#define RttPut(f) \
+	    Tcl_DictObjPut(0L, shape, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(c->f))
+	    RttPut(srtt);
+	    RttPut(rttvar);
+	    RttPut(rto);
+	    RttPut(samples);
+	    RttPut(timeouts);
+#undef RttPut
+	    Tcl_DictObjPut(0L, byShape, Tcl_ObjPrintf("%d,%d", x, r), shape);
+	}
+    }
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj("rtt", -1), byShape);
+
+    retry = Tcl_NewDictObj();
+#define RetryPut(f) \
+    Tcl_DictObjPut(0L, retry, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(policy->f))
+    RetryPut(retries);
+    RetryPut(recovered);
+    RetryPut(exhausted);
+    RetryPut(refused);
+#undef RetryPut
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj("retry", -1), retry);
+
+    reconnect = Tcl_NewDictObj();
+#define ReconnectPut(f) \
+    Tcl_DictObjPut(0L, reconnect, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(link->f))
+    ReconnectPut(losses);
+    ReconnectPut(resets);
+    ReconnectPut(reopened);
+    ReconnectPut(replayed);
+    ReconnectPut(lastMs);
+#undef ReconnectPut
+    Tcl_DictObjPut(0L, reconnect, Tcl_NewStringObj("journal", -1),
+	Tcl_NewIntObj(CMoReconnect::Journalled(&hAxis)));
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj("reconnect", -1), reconnect);
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+};
+
+// The rates SetSerialPortMode can select, indexed by PMDSerialBaud.
+static const PMDuint32 serialRates[] =
+{
+    1200, 2400, 9600, 19200, 57600, 115200, 230400, 460800
+};
+#define NUM_SERIAL_RATES (sizeof(serialRates) / sizeof(serialRates[0]))
+
+// How long the drive gets to switch its UART after acknowledging
+// SetSerialPortMode.
+#define SERIAL_SETTLE_MS 10
+
+int
+CMoAxis::SerialRateCode(PMDuint32 baud)
+{
+    int code;
+
+    for (code = 0; code < (int) NUM_SERIAL_RATES; code++)
+    {
+	if (serialRates[code] == baud)
+	{
+	    return code;
+	}
+    }
+    return -1;
+};
+
+// Does the drive answer at the rate the host side is set to?  GetVersion
+// brings back a few words, so a rate that only mostly works is caught too.
+bool
+CMoAxis::SerialVerify()
+{
+    PMDuint16 family, motorType, numberAxes, special, custom, major, minor;
+
+    PMDSerial_FlushRecv(hAxis.transport_data);
+    return ::PMDNoOperation(&hAxis) == PMD_NOERROR
+	&& ::PMDGetVersion(&hAxis, &family, &motorType, &numberAxes, &special,
+	    &custom, &major, &minor) == PMD_NOERROR;
+};
+
+// Find the rate the drive is listening at, trying the host's current
+// rate first.  The host side is left at that rate, or where it started
+// if the drive never answers.
+bool
+CMoAxis::SerialProbe()
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)hAxis.transport_data;
+    PMDuint32 start = SIOtransport_data->baud;
+    int code;
+
+    if (SerialVerify())
+    {
+	return true;
+    }
+    for (code = NUM_SERIAL_RATES - 1; code >= 0; code--)
+    {
+	if (serialRates[code] != start
+		&& PMDSerial_SetConfig(SIOtransport_data, serialRates[code],
+		    SIOtransport_data->parity)
+		&& SerialVerify())
+	{
+	    return true;
+	}
+    }
+    PMDSerial_SetConfig(SIOtransport_data, start, SIOtransport_data->parity);
+    return false;
+};
+
+// Move both ends of the link to baud, or with baud of 0 to the fastest
+// rate the host port takes.  Parity, stop bits, protocol and multi-drop
+// address stay as the drive has them.  A rate the drive doesn't come up
+// at is backed out of and the next lower one tried; for auto the link is
+// left at the rate it was found at if nothing faster works.  Returns
+// false only if the drive can't be reached at all or the rate asked for
+// didn't take.
+bool
+CMoAxis::SerialNegotiate(PMDuint32 baud)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)hAxis.transport_data;
+    PMDuint8 rate, parity, stopBits, protocol, multiDropID;
+    PMDuint32 found;
+    PMDresult result;
+    int code;
+
+    if (!SerialProbe()
+	    || ::PMDGetSerialPortMode(&hAxis, &rate, &parity, &stopBits,
+		&protocol, &multiDropID) != PMD_NOERROR)
+    {
+	return false;
+    }
+    found = SIOtransport_data->baud;
+    if (baud == found)
+    {
+	return true;
+    }
+
+    for (code = NUM_SERIAL_RATES - 1; code >= 0; code--)
+    {
+	if (baud != 0 ? serialRates[code] != baud : serialRates[code] <= found)
+	{
+	    continue;
+	}
+
+	// Can the host port do this rate at all?
+	if (!PMDSerial_SetConfig(SIOtransport_data, serialRates[code],
+		SIOtransport_data->parity))
+	{
+	    PMDSerial_SetConfig(SIOtransport_data, found, SIOtransport_data->parity);
+	    continue;
+	}
+	PMDSerial_SetConfig(SIOtransport_data, found, SIOtransport_data->parity);
+
+	// The drive acknowledges at the old rate and then switches.  A rate
+	// it refuses leaves it where it was, but a lost acknowledgement
+	// doesn't mean it stayed put, so that is left to the verify.
+	result = ::PMDSetSerialPortMode(&hAxis, (PMDuint8) code, parity,
+	    stopBits, protocol, multiDropID);
+	if (result != PMD_NOERROR && result < PMD_ERR_InvalidOperation)
+	{
+	    continue;
+	}
+	Tcl_Sleep(SERIAL_SETTLE_MS);
+
+	PMDSerial_SetConfig(SIOtransport_data, serialRates[code],
+	    SIOtransport_data->parity);
+	if (SerialVerify())
+	{
+	    return true;
+	}
+
+	// Didn't come up there.  Find it again and put it back.
+	PMDSerial_SetConfig(SIOtransport_data, found, SIOtransport_data->parity);
+	if (!SerialProbe())
+	{
+	    return false;
+	}
+	if (SIOtransport_data->baud != found)
+	{
+	    ::PMDSetSerialPortMode(&hAxis, (PMDuint8) SerialRateCode(found),
+		parity, stopBits, protocol, multiDropID);
+	    Tcl_Sleep(SERIAL_SETTLE_MS);
+	    PMDSerial_SetConfig(SIOtransport_data, found,
+		SIOtransport_data->parity);
+	    if (!SerialProbe())
+	    {
+		return false;
+	    }
+	    found = SIOtransport_data->baud;
+	}
+    }
+    return baud == 0;
+};
+
+// Talk to the axis over Ethernet from now on instead of its serial port.
+// proto is tcp or udp; port defaults to CMO_NETWORK_PORT.
+int
+CMoAxis::NetworkConnect(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* protocols[] = {"tcp", "udp", 0L};
+    int protocol, port = CMO_NETWORK_PORT;
+    const char* why;
+    PMDresult result;
+
+    if (objc != 3 && objc != 4)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "tcp|udp host ?port?");
+	return TCL_ERROR;
+    }
+    if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[1], protocols, "protocol",
+	    0, &protocol))
+    {
+	return TCL_ERROR;
+    }
+    if (objc == 4 && TCL_OK != Tcl_GetIntFromObj(interp, objv[3], &port))
+    {
+	return TCL_ERROR;
+    }
+    if (port <= 0 || port > 65535)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid port", -1));
+	return TCL_ERROR;
+    }
+
+    // Whatever looks after the serial port lets go of it first.
+    CMoStop::Disarm(&hAxis);
+    CMoWait::Cancel(&hAxis);
+    CMoReconnect::Release(&hAxis);
+    CMoReactor::Detach(&hAxis);
+    result = CMoNetwork_Open(&hAxis, protocol == 0 ? CMoNetworkTCP : CMoNetworkUDP,
+	Tcl_GetString(objv[2]), (PMDuint16) port);
+    CMoStop::Arm(&hAxis, &why);
+    if (result != PMD_NOERROR)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+};
+
+// Like fconfigure for the network connection (see CMoNetwork.h).  -window
+// packets are kept in flight, each reply is waited for -timeout ms, and over
+// UDP a packet that may be sent twice goes again -retransmits times before
+// it is given up.  -attempts and -backoff are the retry policy of
+// SerialConfigure, for a call that still fails after that.
+int
+CMoAxis::NetworkConfigure(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* options[] = {"-attempts", "-backoff", "-retransmits",
+	"-timeout", "-window", 0L};
+    enum options {OPT_ATTEMPTS, OPT_BACKOFF, OPT_RETRANSMITS, OPT_TIMEOUT,
+	OPT_WINDOW};
+    CMoNetworkData* net;
+    Tcl_Obj* resultList;
+    int i, index, value;
+
+    if (hAxis.transport.SendCommand != CMoNetwork_SendCommand)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("axis is not on a network connection", -1));
+	return TCL_ERROR;
+    }
+    net = (CMoNetworkData*)hAxis.transport_data;
+
+    if (objc == 1)
+    {
+	resultList = Tcl_NewListObj(0, 0L);
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-attempts", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(net->retry.attempts));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-backoff", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(net->retry.backoffUs));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-protocol", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj(net->protocol == CMoNetworkTCP ? "tcp" : "udp", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-retransmits", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(net->retransmits));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-timeout", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(net->timeout));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-window", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(net->window));
+	Tcl_SetObjResult(interp, resultList);
+	return TCL_OK;
+    }
+
+    if (objc % 2 == 0)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv,
+	    "?-attempts n? ?-backoff us? ?-retransmits n? ?-timeout ms? "
+	    "?-window n?");
+	return TCL_ERROR;
+    }
+
+    for (i = 1; i < objc; i += 2)
+    {
+	if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option",
+		0, &index) ||
+	    TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &value))
+	{
+	    return TCL_ERROR;
+	}
+
+	switch ((enum options) index)
+	{
+	case OPT_ATTEMPTS:
+	    if (value < 1)
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid attempts", -1));
+		return TCL_ERROR;
+	    }
+	    net->retry.attempts = value;
+	    break;
+
+	case OPT_BACKOFF:
+	    if (value < 0)
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid backoff", -1));
+		return TCL_ERROR;
+	    }
+	    net->retry.backoffUs = value;
+	    break;
+
+	case OPT_RETRANSMITS:
+	    if (value < 0)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("invalid retransmits", -1));
+		return TCL_ERROR;
+	    }
+	    net->retransmits = value;
+	    break;
+
+	case OPT_TIMEOUT:
+	    if (value <= 0)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("invalid timeout", -1));
+		return TCL_ERROR;
+	    }
+	    net->timeout = value;
+	    break;
+
+	case OPT_WINDOW:
+	    if (value <= 0)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("invalid window", -1));
+		return TCL_ERROR;
+	    }
+	    net->window = value;
+	    break;
+	}
+    }
+    return TCL_OK;
+};
+
+// What the network connection has carried and what it cost.
+int
+CMoAxis::NetworkStats(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    CMoNetworkStats* stats;
+    PMDSerialRetry* policy;
+    Tcl_Obj *result, *retry;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (hAxis.transport.SendCommand != CMoNetwork_SendCommand)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("axis is not on a network connection", -1));
+	return TCL_ERROR;
+    }
+    stats = &((CMoNetworkData*)hAxis.transport_data)->stats;
+    policy = &((CMoNetworkData*)hAxis.transport_data)->retry;
+
+    result = Tcl_NewDictObj();
+#define NetPut(f) \
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(stats->f))
+    NetPut(batches);
+    NetPut(packets);
+    NetPut(retransmits);
+    NetPut(refused);
+    NetPut(duplicates);
+    NetPut(timeouts);
+    NetPut(reconnects);
+    NetPut(maxInFlight);
+    NetPut(bytesOut);
+    NetPut(bytesIn);
+#undef NetPut
+
+    retry = Tcl_NewDictObj();
+#define RetryPut(f) \
+    Tcl_DictObjPut(0L, retry, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(policy->f))
+    RetryPut(retries);
+    RetryPut(recovered);
+    RetryPut(exhausted);
+    RetryPut(refused);
+#undef RetryPut
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj("retry", -1), retry);
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+};
+
+// Talk to the axis over a CAN bus from now on, through SocketCAN on the
+// named interface (can0, vcan0, ...).  node defaults to 0.
+int
+CMoAxis::CanConnect(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    int node = 0;
+    const char* why;
+    PMDresult result;
+
+    if (objc != 2 && objc != 3)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "interface ?node?");
+	return TCL_ERROR;
+    }
+    if (objc == 3 && TCL_OK != Tcl_GetIntFromObj(interp, objv[2], &node))
+    {
+	return TCL_ERROR;
+    }
+    if (node < 0 || node >= CMO_CAN_NODES)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid node", -1));
+	return TCL_ERROR;
+    }
+
+    // Whatever looks after the serial port lets go of it first.
+    CMoStop::Disarm(&hAxis);
+    CMoWait::Cancel(&hAxis);
+    CMoReconnect::Release(&hAxis);
+    CMoReactor::Detach(&hAxis);
+    result = CMoCan_Open(&hAxis, Tcl_GetString(objv[1]), (PMDuint8) node);
+    CMoStop::Arm(&hAxis, &why);
+    if (result != PMD_NOERROR)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+};
+
+// Like fconfigure for the CAN bus (see CMoCan.h).  Each reply is waited
+// for -timeout ms; -interface and -node are read only.  -bitrate and
+// -loadceiling are the bus's, shared by every node on it (see
+// CMoLoad.hpp); a bus whose -bitrate is 0 has no ceiling.  -attempts and
+// -backoff are the node's retry policy, as in SerialConfigure.
+int
+CMoAxis::CanConfigure(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* options[] = {"-attempts", "-backoff", "-bitrate",
+	"-loadceiling", "-timeout", 0L};
+    enum options {OPT_ATTEMPTS, OPT_BACKOFF, OPT_BITRATE, OPT_LOADCEILING,
+	OPT_TIMEOUT};
+    CMoCanData* can;
+    CMoLoad::Stats load;
+    Tcl_Obj* resultList;
+    int i, index, value;
+
+    if (hAxis.transport.SendCommand != CMoCan_SendCommand)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("axis is not on a CAN bus", -1));
+	return TCL_ERROR;
+    }
+    can = (CMoCanData*)hAxis.transport_data;
+
+    if (objc == 1)
+    {
+	if (!CMoLoad::GetStats(&hAxis, &load))
+	{
+	    memset(&load, 0, sizeof(load));
+	}
+	resultList = Tcl_NewListObj(0, 0L);
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-attempts", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(can->retry.attempts));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-backoff", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(can->retry.backoffUs));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-bitrate", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(load.bitRate));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-interface", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj(CMoCan_Interface(can), -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-node", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewIntObj(can->node));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-loadceiling", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(load.ceiling));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-timeout", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(can->timeout));
+	Tcl_SetObjResult(interp, resultList);
+	return TCL_OK;
+    }
+
+    if (objc % 2 == 0)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv,
+	    "?-attempts n? ?-backoff us? ?-bitrate bps? "
+	    "?-loadceiling percent? ?-timeout ms?");
+	return TCL_ERROR;
+    }
+
+    for (i = 1; i < objc; i += 2)
+    {
+	if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option",
+		0, &index) ||
+	    TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &value))
+	{
+	    return TCL_ERROR;
+	}
+	switch ((enum options) index)
+	{
+	case OPT_ATTEMPTS:
+	    if (value < 1)
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid attempts", -1));
+		return TCL_ERROR;
+	    }
+	    can->retry.attempts = value;
+	    break;
+
+	case OPT_BACKOFF:
+	    if (value < 0)
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid backoff", -1));
+		return TCL_ERROR;
+	    }
+	    can->retry.backoffUs = value;
+	    break;
+
+	case OPT_BITRATE:
+	    if (value < 0)
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid bit rate", -1));
+		return TCL_ERROR;
+	    }
+	    CMoLoad::SetBitRate(&hAxis, value);
+	    break;
+
+	case OPT_LOADCEILING:
+	    if (value < 0 || value > 100)
+	    {
+		Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("invalid load ceiling", -1));
+		return TCL_ERROR;
+	    }
+	    CMoLoad::SetCeiling(&hAxis, value);
+	    break;
+
+	case OPT_TIMEOUT:
+	    if (value <= 0)
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid timeout", -1));
+		return TCL_ERROR;
+	    }
+	    can->timeout = value;
+	    break;
+	}
+    }
+    return TCL_OK;
+};
+
+// What the bus the axis is on has carried, for all of its nodes.
+int
+CMoAxis::CanStats(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    CMoCanStats stats;
+    PMDSerialRetry* policy;
+    Tcl_Obj *result, *retry;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (hAxis.transport.SendCommand != CMoCan_SendCommand)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("axis is not on a CAN bus", -1));
+	return TCL_ERROR;
+    }
+    CMoCan_GetStats(hAxis.transport_data, &stats);
+    policy = &((CMoCanData*)hAxis.transport_data)->retry;
+
+    result = Tcl_NewDictObj();
+#define CanPut(f) \
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(stats.f))
+    CanPut(batches);
+    CanPut(frames);
+    CanPut(sendCalls);
+    CanPut(recvCalls);
+    CanPut(timeouts);
+    CanPut(stray);
+    CanPut(maxOutstanding);
+    CanPut(nodes);
+    CanPut(coalesced);
+#undef CanPut
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj("waits", -1),
+	CMoWaitStats_NewObj(stats.waits));
+
+    retry = Tcl_NewDictObj();
+#define RetryPut(f) \
+    Tcl_DictObjPut(0L, retry, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(policy->f))
+    RetryPut(retries);
+    RetryPut(recovered);
+    RetryPut(exhausted);
+    RetryPut(refused);
+#undef RetryPut
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj("retry", -1), retry);
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+};
+
+// The region argument of ReadMemory and WriteMemory: dpram, or the ID of
+// one of the chip's external memory buffers.
+static int
+GetMemoryRegionFromObj(Tcl_Interp* interp, Tcl_Obj* obj, int* region)
+{
+    if (strcmp(Tcl_GetString(obj), "dpram") == 0)
+    {
+	*region = CMoMemory::DPRAM;
+	return TCL_OK;
+    }
+    if (TCL_OK != Tcl_GetIntFromObj(0L, obj, region) ||
+	*region < 0 || *region > MAXUINT16)
+    {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+	    "expected dpram or a buffer ID but got \"%s\"", Tcl_GetString(obj)));
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+static int
+GetMemoryCountFromObj(Tcl_Interp* interp, Tcl_Obj* obj, PMDuint32* value)
+{
+    Tcl_WideInt wide;
+
+    if (TCL_OK != Tcl_GetWideIntFromObj(interp, obj, &wide))
+    {
+	return TCL_ERROR;
+    }
+    if (wide < 0 || wide > MAXUINT32)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("value out of range", -1));
+	return TCL_ERROR;
+    }
+    *value = (PMDuint32) wide;
+    return TCL_OK;
+}
+
+// Whether count words from offset stay within the 32 bit word offsets a
+// region has.
+static int
+CheckMemorySpan(Tcl_Interp* interp, PMDuint32 offset, PMDuint32 count)
+{
+    if (count > MAXUINT32 - offset)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("offset and count go past the end of memory", -1));
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+static int
+MemoryError(Tcl_Interp* interp, PMDresult result, PMDuint32 done)
+{
+    Tcl_SetObjResult(interp, Tcl_ObjPrintf("%s after %lu words",
+	::PMDGetErrorMessage(result), (unsigned long) done));
+    return TCL_ERROR;
+}
+
+// Read count 32 bit words from a region of device memory (see
+// CMoMemory.hpp), starting offset words in.  They come back as a
+// bytearray of little endian words, for [binary scan iu*], or go to a
+// binary channel, when the result is the number of words.
+int
+CMoAxis::ReadMemory(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    std::vector<PMDuint32> words;
+    Tcl_Channel channel = 0L;
+    Tcl_Obj* bytes = 0L;
+    unsigned char* p;
+    PMDuint32 offset, count, done, n, i;
+    PMDresult result;
+    int region, mode;
+
+    if ((objc != 4 && objc != 6) ||
+	(objc == 6 && strcmp(Tcl_GetString(objv[4]), "-channel") != 0))
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "region offset count ?-channel chan?");
+	return TCL_ERROR;
+    }
+    if (TCL_OK != GetMemoryRegionFromObj(interp, objv[1], &region) ||
+	TCL_OK != GetMemoryCountFromObj(interp, objv[2], &offset) ||
+	TCL_OK != GetMemoryCountFromObj(interp, objv[3], &count) ||
+	TCL_OK != CheckMemorySpan(interp, offset, count))
+    {
+	return TCL_ERROR;
+    }
+    if (objc == 4 && count > MAXINT32 / 4)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	    "too many words for a bytearray, read them to a -channel", -1));
+	return TCL_ERROR;
+    }
+    if (objc == 6)
+    {
+	if ((channel = Tcl_GetChannel(interp, Tcl_GetString(objv[5]), &mode)) == 0L)
+	{
+	    return TCL_ERROR;
+	}
+	if (!(mode & TCL_WRITABLE))
+	{
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"channel \"%s\" wasn't opened for writing", Tcl_GetString(objv[5])));
+	    return TCL_ERROR;
+	}
+    }
+    else
+    {
+	bytes = Tcl_NewByteArrayObj(0L, 0);
+	Tcl_IncrRefCount(bytes);
+	Tcl_SetByteArrayLength(bytes, (int)(4 * count));
+    }
+
+    words.resize(count < CMoMemory::BLOCK ? count : CMoMemory::BLOCK);
+    std::vector<unsigned char> block(4 * words.size());
+    for (done = 0; done < count; done += n)
+    {
+	n = count - done < CMoMemory::BLOCK ? count - done : CMoMemory::BLOCK;
+	result = CMoMemory::Read(&hAxis, region, offset + done, &words[0], n);
+	if (result != PMD_NOERROR)
+	{
+	    if (bytes != 0L) Tcl_DecrRefCount(bytes);
+	    return MemoryError(interp, result, done);
+	}
+	p = bytes != 0L ? Tcl_GetByteArrayFromObj(bytes, 0L) + 4 * done : &block[0];
+	for (i = 0; i < n; i++)
+	{
+	    p[4*i] = (unsigned char)(words[i] & 0xFF);
+	    p[4*i + 1] = (unsigned char)((words[i] >> 8) & 0xFF);
+	    p[4*i + 2] = (unsigned char)((words[i] >> 16) & 0xFF);
+	    p[4*i + 3] = (unsigned char)(words[i] >> 24);
+	}
+	if (channel != 0L && Tcl_Write(channel, (const char*)p, (int)(4 * n)) < 0)
+	{
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf("error writing \"%s\": %s",
+		Tcl_GetString(objv[5]), Tcl_PosixError(interp)));
+	    return TCL_ERROR;
+	}
+    }
+
+    if (bytes != 0L)
+    {
+	Tcl_SetObjResult(interp, bytes);
+	Tcl_DecrRefCount(bytes);
+    }
+    else
+    {
+	Tcl_SetObjResult(interp, Tcl_NewWideIntObj(count));
+    }
+    return TCL_OK;
+};
+
+// Write 32 bit words into a region of device memory, starting offset
+// words in: a bytearray of little endian words, as [binary format iu*]
+// makes, or what a binary channel has left, count words of it at most.
+// The result is the number of words written.
+int
+CMoAxis::WriteMemory(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    std::vector<PMDuint32> words(CMoMemory::BLOCK);
+    std::vector<unsigned char> block(4 * CMoMemory::BLOCK);
+    Tcl_Channel channel = 0L;
+    const unsigned char* p;
+    PMDuint32 offset, count = MAXUINT32, done, n, i;
+    PMDresult result;
+    int region, mode, length = 0, got;
+
+    if (objc == 4)
+    {
+	p = Tcl_GetByteArrayFromObj(objv[3], &length);
+	if (length % 4 != 0)
+	{
+	    Tcl_SetObjResult(interp,
+		Tcl_NewStringObj("data isn't a whole number of words", -1));
+	    return TCL_ERROR;
+	}
+	count = length / 4;
+    }
+    else if ((objc != 5 && objc != 6) ||
+	strcmp(Tcl_GetString(objv[3]), "-channel") != 0)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "region offset data|-channel chan ?count?");
+	return TCL_ERROR;
+    }
+    if (TCL_OK != GetMemoryRegionFromObj(interp, objv[1], &region) ||
+	TCL_OK != GetMemoryCountFromObj(interp, objv[2], &offset) ||
+	(objc == 6 && TCL_OK != GetMemoryCountFromObj(interp, objv[5], &count)))
+    {
+	return TCL_ERROR;
+    }
+    // A channel without a count goes on to the end of memory at most.
+    if (objc == 5)
+    {
+	count = MAXUINT32 - offset;
+    }
+    if (TCL_OK != CheckMemorySpan(interp, offset, count))
+    {
+	return TCL_ERROR;
+    }
+    if (objc != 4)
+    {
+	if ((channel = Tcl_GetChannel(interp, Tcl_GetString(objv[4]), &mode)) == 0L)
+	{
+	    return TCL_ERROR;
+	}
+	if (!(mode & TCL_READABLE))
+	{
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"channel \"%s\" wasn't opened for reading", Tcl_GetString(objv[4])));
+	    return TCL_ERROR;
+	}
+    }
+
+    // The data is only looked at again after each block has gone out, so
+    // the bytearray is fetched again each time round.
+    for (done = 0; done < count; done += n)
+    {
+	n = count - done < CMoMemory::BLOCK ? count - done : CMoMemory::BLOCK;
+	if (channel != 0L)
+	{
+	    got = Tcl_Read(channel, (char*)&block[0], (int)(4 * n));
+	    if (got < 0)
+	    {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf("error reading \"%s\": %s",
+		    Tcl_GetString(objv[4]), Tcl_PosixError(interp)));
+		return TCL_ERROR;
+	    }
+	    if (got % 4 != 0)
+	    {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "channel \"%s\" ends part way through a word", Tcl_GetString(objv[4])));
+		return TCL_ERROR;
+	    }
+	    if ((n = got / 4) == 0)
+	    {
+		break;
+	    }
+	    p = &block[0];
+	}
+	else
+	{
+	    p = Tcl_GetByteArrayFromObj(objv[3], 0L) + 4 * done;
+	}
+	for (i = 0; i < n; i++)
+	{
+	    words[i] = (PMDuint32)p[4*i] | ((PMDuint32)p[4*i + 1] << 8) |
+		((PMDuint32)p[4*i + 2] << 16) | ((PMDuint32)p[4*i + 3] << 24);
+	}
+	result = CMoMemory::Write(&hAxis, region, offset + done, &words[0], n);
+	if (result != PMD_NOERROR)
+	{
+	    return MemoryError(interp, result, done);
+	}
+    }
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(done));
+    return TCL_OK;
+};
+
+// Wait until the event status has any of the bits in mask, for up to
+// -timeout ms (0, the default, waits for as long as it takes), reading it
+// every -interval ms.  The result is the event status.  With -command the
+// wait goes on in the background (see CMoWait.hpp) and the script is
+// called with "ok" and the status, "timeout" and the status, or "error"
+// and the message.  Under a -loadceiling the polls may be made less
+// frequent, or refused (CMoLoad.hpp).
+int
+CMoAxis::WaitForEvent(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* options[] = {"-command", "-interval", "-timeout", 0L};
+    enum options {OPT_COMMAND, OPT_INTERVAL, OPT_TIMEOUT};
+    Tcl_Obj* command = 0L;
+    CMoLoad::Booking booking;
+    PMDuint32 timeout = 0, interval = 5;
+    PMDuint16 status;
+    PMDresult result;
+    int i, index, mask, value;
+
+    if (objc < 2 || objc % 2 != 0)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv,
+	    "mask ?-timeout ms? ?-interval ms? ?-command script?");
+	return TCL_ERROR;
+    }
+    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[1], &mask))
+    {
+	return TCL_ERROR;
+    }
+    if (mask <= 0 || mask > MAXUINT16)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid event mask", -1));
+	return TCL_ERROR;
+    }
+    for (i = 2; i < objc; i += 2)
+    {
+	if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option",
+		0, &index))
+	{
+	    return TCL_ERROR;
+	}
+	if (index == OPT_COMMAND)
+	{
+	    command = objv[i+1];
+	    continue;
+	}
+	if (TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &value))
+	{
+	    return TCL_ERROR;
+	}
+	if (value < (index == OPT_INTERVAL ? 1 : 0))
+	{
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf("invalid %s",
+		index == OPT_INTERVAL ? "interval" : "timeout"));
+	    return TCL_ERROR;
+	}
+	if (index == OPT_INTERVAL)
+	{
+	    interval = value;
+	}
+	else
+	{
+	    timeout = value;
+	}
+    }
+
+    if (!CMoLoad::Admit(&hAxis, CMoOp::GetEventStatus, &interval, &booking))
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	    "polling would take the bus past its load ceiling", -1));
+	return TCL_ERROR;
+    }
+    if (command != 0L)
+    {
+	CMoWait::Start(interp, &hAxis, (PMDuint16) mask, timeout, interval,
+	    booking, command);
+	return TCL_OK;
+    }
+    switch (CMoWait::Block(&hAxis, (PMDuint16) mask, timeout, interval,
+	booking, &status, &result))
+    {
+    case CMoWait::Happened:
+	Tcl_SetObjResult(interp, Tcl_NewLongObj(status));
+	return TCL_OK;
+
+    case CMoWait::TimedOut:
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+	    "timed out waiting for events 0x%04X, status 0x%04X", mask, status));
+	return TCL_ERROR;
+
+    default:
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	return TCL_ERROR;
+    }
+};
+
+// Keep the axis' state in the snapshot table (CMoSnapshot.hpp) for any
+// thread to read with [cmotion::snapshot].  -interval ms polls it that
+// often, booked on the wire as WaitForEvent's polls are, and returns its
+// slot; -interval 0 stops.  Without arguments, {-interval ms -slot n},
+// the slot being -1 when the axis isn't published.
+int
+CMoAxis::Publish(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    CMoLoad::Booking booking;
+    Tcl_Obj* resultList;
+    PMDuint32 interval = 0;
+    int slot, value;
+
+    if (objc == 1)
+    {
+	slot = CMoWait::Published(&hAxis, &interval);
+	resultList = Tcl_NewListObj(0, 0L);
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-interval", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(interval));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-slot", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewIntObj(slot));
+	Tcl_SetObjResult(interp, resultList);
+	return TCL_OK;
+    }
+    if (objc != 3 || strcmp(Tcl_GetString(objv[1]), "-interval") != 0)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "?-interval ms?");
+	return TCL_ERROR;
+    }
+    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[2], &value))
+    {
+	return TCL_ERROR;
+    }
+    if (value < 0)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid interval", -1));
+	return TCL_ERROR;
+    }
+    if (value == 0)
+    {
+	CMoWait::Unpublish(&hAxis);
+	return TCL_OK;
+    }
+
+    // What it had booked goes first, or it would count against itself.
+    CMoWait::Unpublish(&hAxis);
+    interval = value;
+    if (!CMoLoad::Admit(&hAxis, CMoSnapshot::Opcodes, CMO_SNAPSHOT_PACKETS,
+	    &interval, &booking))
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	    "polling would take the bus past its load ceiling", -1));
+	return TCL_ERROR;
+    }
+    if ((slot = CMoWait::Publish(&hAxis, interval, booking)) < 0)
+    {
+	CMoLoad::Release(&booking);
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("no snapshot slot is free", -1));
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(slot));
+    return TCL_OK;
+};
+
+// How busy the wire behind this axis is (CMoLoad.hpp): its bitRate, the
+// bitsPerSecond it carried in the last whole second and the pollBits a
+// second booked by the periodic polls running, with utilisation and polls
+// as percentages of the rate, the -loadceiling and what admission has
+// done so far.  -plan {method periodMs ...} adds the planBits a second
+// those polls would take, as plan, and projected, the utilisation with
+// them on top.
+int
+CMoAxis::BusLoad(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    CMoLoad::Stats stats;
+    Tcl_Obj* result;
+    Tcl_Obj** plan;
+    const char* method;
+    double planBits = 0.0, used;
+    int i, op, count, period;
+
+    if (objc != 1 && (objc != 3 || strcmp(Tcl_GetString(objv[1]), "-plan") != 0))
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "?-plan {method periodMs ...}?");
+	return TCL_ERROR;
+    }
+    if (!CMoLoad::GetStats(&hAxis, &stats))
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	    "axis is not on a serial port or a CAN bus", -1));
+	return TCL_ERROR;
+    }
+    if (objc == 3)
+    {
+	if (TCL_OK != Tcl_ListObjGetElements(interp, objv[2], &count, &plan))
+	{
+	    return TCL_ERROR;
+	}
+	if (count % 2 != 0)
+	{
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"plan must be a list of methods and periods", -1));
+	    return TCL_ERROR;
+	}
+	for (i = 0; i < count; i += 2)
+	{
+	    method = Tcl_GetString(plan[i]);
+	    for (op = 0; op < 256; op++)
+	    {
+		if (CMoOpcodes[op].name != 0L && strcmp(CMoOpcodes[op].name, method) == 0)
+		{
+		    break;
+		}
+	    }
+	    if (op == 256)
+	    {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf("unknown method \"%s\"", method));
+		return TCL_ERROR;
+	    }
+	    if (TCL_OK != Tcl_GetIntFromObj(interp, plan[i+1], &period))
+	    {
+		return TCL_ERROR;
+	    }
+	    if (period <= 0)
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid period", -1));
+		return TCL_ERROR;
+	    }
+	    planBits += CMoLoad::PacketBits(&hAxis, (PMDuint8) op) * 1000.0 / period;
+	}
+    }
+
+    result = Tcl_NewDictObj();
+#define LoadPut(f) \
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(stats.f))
+#define LoadPercent(f, bits) \
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj(#f, -1), Tcl_NewDoubleObj( \
+	stats.bitRate == 0 ? 0.0 : 100.0 * (bits) / stats.bitRate))
+    LoadPut(bitRate);
+    LoadPut(bitsPerSecond);
+    LoadPercent(utilisation, stats.bitsPerSecond);
+    LoadPut(pollBits);
+    LoadPercent(polls, stats.pollBits);
+    LoadPut(ceiling);
+    LoadPut(admitted);
+    LoadPut(downrated);
+    LoadPut(refused);
+    if (objc == 3)
+    {
+	used = stats.bitsPerSecond > stats.pollBits ? stats.bitsPerSecond : stats.pollBits;
+	Tcl_DictObjPut(0L, result, Tcl_NewStringObj("planBits", -1),
+	    Tcl_NewLongObj((long) (planBits + 0.5)));
+	LoadPercent(plan, planBits);
+	LoadPercent(projected, used + planBits);
+    }
+#undef LoadPercent
+#undef LoadPut
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+};
+
+// How the emergency stops went for this axis (CMoStop.hpp): how many there
+// were, how many the drive didn't answer, and the last and worst time in
+// microseconds from [cmotion::estop] to its answer.  preempt is 1 when a
+// stop from any thread goes ahead of the port's queue, and 0, with the
+// reason in why, when only the thread that owns the port can stop it.
+int
+CMoAxis::StopStats(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    CMoStop::Stats stats;
+    Tcl_Obj* result;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (!CMoStop::GetStats(&hAxis, &stats))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("axis has no stop armed", -1));
+	return TCL_ERROR;
+    }
+
+    result = Tcl_NewDictObj();
+#define StopPut(f) \
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(stats.f))
+    StopPut(stops);
+    StopPut(failures);
+    StopPut(lastUs);
+    StopPut(worstUs);
+#undef StopPut
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj("preempt", -1),
+	Tcl_NewBooleanObj(stats.why == 0L));
+    if (stats.why != 0L)
+    {
+	Tcl_DictObjPut(0L, result, Tcl_NewStringObj("why", -1),
+	    Tcl_NewStringObj(stats.why, -1));
+    }
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+};
+
+// Reading ahead what the script reads together (CMoPrefetch.hpp).  Off
+// until -enable 1; -ttl is how long a prefetched reply is good for, and
+// how close together two reads have to be to count as a pattern, and
+// -depth how many followers may go out with a read.  -enable 0 forgets
+// what was learned.
+int
+CMoAxis::PrefetchConfigure(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* options[] = {"-depth", "-enable", "-ttl", 0L};
+    enum options {OPT_DEPTH, OPT_ENABLE, OPT_TTL};
+    CMoPrefetch::Config config;
+    Tcl_Obj* resultList;
+    bool enabled;
+    int i, index, value;
+
+    enabled = CMoPrefetch::GetConfig(&hAxis, &config);
+    if (!enabled)
+    {
+	config.ttlMs = 20;
+	config.depth = 2;
+    }
+
+    if (objc == 1)
+    {
+	resultList = Tcl_NewListObj(0, 0L);
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-depth", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(config.depth));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-enable", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewBooleanObj(enabled));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewStringObj("-ttl", -1));
+	Tcl_ListObjAppendElement(interp, resultList,
+	    Tcl_NewLongObj(config.ttlMs));
+	Tcl_SetObjResult(interp, resultList);
+	return TCL_OK;
+    }
+
+    if (objc % 2 == 0)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "?-depth n? ?-enable bool? ?-ttl ms?");
+	return TCL_ERROR;
+    }
+
+    for (i = 1; i < objc; i += 2)
+    {
+	if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option",
+		0, &index))
+	{
+	    return TCL_ERROR;
+	}
+	if (index == OPT_ENABLE)
+	{
+	    if (TCL_OK != Tcl_GetBooleanFromObj(interp, objv[i+1], &value))
+	    {
+		return TCL_ERROR;
+	    }
+	    enabled = value != 0;
+	    continue;
+	}
+	if (TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &value))
+	{
+	    return TCL_ERROR;
+	}
+	switch ((enum options) index)
+	{
+	case OPT_DEPTH:
+	    if (value < 1 || value > CMO_PREFETCH_MAX_DEPTH)
+	    {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "invalid depth: must be 1 to %d", CMO_PREFETCH_MAX_DEPTH));
+		return TCL_ERROR;
+	    }
+	    config.depth = value;
+	    break;
+
+	case OPT_TTL:
+	    if (value <= 0)
+	    {
+		Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid ttl", -1));
+		return TCL_ERROR;
+	    }
+	    config.ttlMs = value;
+	    break;
+
+	case OPT_ENABLE:
+	    break;
+	}
+    }
+
+    if (!enabled)
+    {
+	CMoPrefetch::Release(&hAxis);
+    }
+    else if (!CMoPrefetch::Enable(&hAxis, config))
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	    "axis is not on a transport that pipelines", -1));
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+};
+
+// How the read-ahead is doing (CMoPrefetch.hpp): reads seen, the batches
+// that carried followers and how many, how many of those were used (hits,
+// and hitRate as a percentage of prefetched) or thrown away (wasted and
+// wastedBytes), and the patterns it would prefetch for now.
+int
+CMoAxis::PrefetchStats(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    CMoPrefetch::Stats stats;
+    Tcl_Obj* result;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (!CMoPrefetch::GetStats(&hAxis, &stats))
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("axis is not prefetching", -1));
+	return TCL_ERROR;
+    }
+
+    result = Tcl_NewDictObj();
+#define PrefetchPut(f) \
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj(#f, -1), Tcl_NewLongObj(stats.f))
+    PrefetchPut(reads);
+    PrefetchPut(batches);
+    PrefetchPut(prefetched);
+    PrefetchPut(hits);
+    Tcl_DictObjPut(0L, result, Tcl_NewStringObj("hitRate", -1),
+	Tcl_NewDoubleObj(stats.prefetched == 0 ? 0.0
+	    : 100.0 * stats.hits / stats.prefetched));
+    PrefetchPut(wasted);
+    PrefetchPut(wastedBytes);
+    PrefetchPut(patterns);
+#undef PrefetchPut
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+};
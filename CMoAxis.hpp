@@ -1,12 +1,29 @@
+#ifndef INC_CMoAxis_hpp__
+#define INC_CMoAxis_hpp__
+
 #include "tcl.h"
 #include "c-motion/c-motion.h"
+#include "CMoMoveQueue.hpp"
+#include "CMoCapture.hpp"
 
 class CMoAxis
 {
 public:
+    typedef int (CMoAxis::*Method)(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
     CMoAxis(Tcl_Interp* interp);
+    CMoAxis(CMoCapture* capture);
     ~CMoAxis();
 
+    // Send the packets to a capture instead of the port for a while.
+    void BeginCapture(CMoCapture* capture);
+    void EndCapture();
+    PMDAxisHandle* Handle();
+
+    // Call a method with its name and arguments in a list, prefixing an
+    // error with the method name.
+    int Invoke(Tcl_Interp* interp, Method method, Tcl_Obj* words);
+
     int PMDSetProfileMode(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
     int PMDGetProfileMode(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
     int PMDSetPosition(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
@@ -251,6 +268,60 @@ public:
     int PMDSetCurrentLimit(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
     int PMDGetCurrentLimit(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
 
+    // Move queue
+    int QueueMove(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int QueueStart(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int QueueStop(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int QueueService(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int QueueStatus(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Host side serial port settings
+    int SerialConfigure(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int SerialStats(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Host side network connection
+    int NetworkConnect(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int NetworkConfigure(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int NetworkStats(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Host side CAN bus
+    int CanConnect(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int CanConfigure(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int CanStats(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Block transfers to and from device memory
+    int ReadMemory(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int WriteMemory(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Waiting for events without polling from the script
+    int WaitForEvent(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Polled state for every thread to read, see CMoSnapshot.hpp
+    int Publish(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Emergency stops, see [cmotion::estop]
+    int StopStats(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Wire utilisation and poll admission, see CMoLoad.hpp
+    int BusLoad(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Learned read-ahead of co-read registers, see CMoPrefetch.hpp
+    int PrefetchConfigure(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int PrefetchStats(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
 private:
+    int GetBreakpointIDFromObj(Tcl_Interp* interp, Tcl_Obj* obj, PMDuint16* id);
+
+    // Serial rate negotiation, see SerialConfigure -baud
+    static int SerialRateCode(PMDuint32 baud);
+    bool SerialVerify();
+    bool SerialProbe();
+    bool SerialNegotiate(PMDuint32 baud);
+
     PMDAxisHandle hAxis;
+    CMoMoveQueue moveQueue;
+    PMDIOTransport savedTransport;
+    void* savedTransportData;
 };
+
+#endif	// #ifndef INC_CMoAxis_hpp__
@@ -0,0 +1,272 @@
+/*
+ * CMoBatch.cpp --
+ *
+ *	Batched pmd::cmotion calls.  See CMoBatch.hpp.
+ */
+
+#include "CMoBatch.hpp"
+#include "CMoCan.h"
+#include "CMoPrefetch.hpp"
+#include "CMoRetry.hpp"
+#include "CMoReconnect.hpp"
+#include <string.h>
+#include <sstream>
+
+static const char placeholderPrefix[] = "cmotion:pending:";
+
+CMoBatch::CMoBatch()
+    : placeholders(0)
+{
+}
+
+CMoBatch::~CMoBatch()
+{
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+	Tcl_DecrRefCount(entries[i].words);
+	if (entries[i].placeholder != 0L) Tcl_DecrRefCount(entries[i].placeholder);
+	if (entries[i].value != 0L) Tcl_DecrRefCount(entries[i].value);
+    }
+}
+
+int
+CMoBatch::Call(Tcl_Interp* interp, CMoAxis* axis, CMoAxis::Method method,
+	int objc, struct Tcl_Obj* const objv[])
+{
+    Entry entry;
+    bool reads = false;
+    int code;
+
+    // The method checks its arguments as usual, but the packets stop here.
+    capture.Record();
+    axis->BeginCapture(&capture);
+    code = (axis->*method)(interp, objc, objv);
+    axis->EndCapture();
+
+    if (code != TCL_OK || capture.frames.empty())
+    {
+	return code;
+    }
+
+    entry.axis = axis;
+    entry.method = method;
+    entry.words = Tcl_NewListObj(objc, objv);
+    Tcl_IncrRefCount(entry.words);
+    entry.placeholder = 0L;
+    entry.value = 0L;
+    entry.first = frames.size();
+    entry.count = capture.frames.size();
+    frames.insert(frames.end(), capture.frames.begin(), capture.frames.end());
+
+    for (size_t i = 0; i < capture.frames.size(); i++)
+    {
+	if (capture.frames[i].rCt > 0) reads = true;
+    }
+    if (reads)
+    {
+	std::ostringstream token;
+	token << placeholderPrefix << ++placeholders;
+	entry.placeholder = Tcl_NewStringObj(token.str().c_str(), -1);
+	Tcl_IncrRefCount(entry.placeholder);
+	Tcl_SetObjResult(interp, entry.placeholder);
+    }
+
+    entries.push_back(entry);
+    return TCL_OK;
+}
+
+// The axis is going away in the middle of the batch.
+void
+CMoBatch::Forget(CMoAxis* axis)
+{
+    std::vector<Entry>::iterator it = entries.begin();
+
+    while (it != entries.end())
+    {
+	if (it->axis != axis)
+	{
+	    ++it;
+	    continue;
+	}
+	Tcl_DecrRefCount(it->words);
+	if (it->placeholder != 0L) Tcl_DecrRefCount(it->placeholder);
+	it = entries.erase(it);
+    }
+}
+
+CMoBatch::Entry*
+CMoBatch::Lookup(Tcl_Obj* value)
+{
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+	Tcl_Obj* placeholder = entries[i].placeholder;
+
+	if (placeholder == 0L) continue;
+	if (value == placeholder)
+	{
+	    return &entries[i];
+	}
+	// A copy of the string, but don't make a string out of a big list
+	// or number just to find out it isn't ours.
+	if (value->bytes != 0L &&
+	    strncmp(value->bytes, placeholderPrefix, sizeof(placeholderPrefix) - 1) == 0 &&
+	    strcmp(value->bytes, Tcl_GetString(placeholder)) == 0)
+	{
+	    return &entries[i];
+	}
+    }
+    return 0L;
+}
+
+void
+CMoBatch::ResolveVariables(Tcl_Interp* interp)
+{
+    Tcl_Obj *names, *value;
+    Tcl_Obj** objv;
+    Entry* entry;
+    int objc, i;
+
+    if (TCL_OK != Tcl_EvalEx(interp, "info vars", -1, 0))
+    {
+	Tcl_ResetResult(interp);
+	return;
+    }
+    names = Tcl_GetObjResult(interp);
+    Tcl_IncrRefCount(names);
+    Tcl_ListObjGetElements(0L, names, &objc, &objv);
+
+    for (i = 0; i < objc; i++)
+    {
+	// Arrays give back NULL here and are left alone.
+	value = Tcl_ObjGetVar2(interp, objv[i], 0L, 0);
+	if (value != 0L && (entry = Lookup(value)) != 0L && entry->value != 0L)
+	{
+	    Tcl_ObjSetVar2(interp, objv[i], 0L, entry->value, 0);
+	}
+    }
+
+    Tcl_DecrRefCount(names);
+    Tcl_ResetResult(interp);
+}
+
+int
+CMoBatch::Commit(Tcl_Interp* interp)
+{
+    std::vector<bool> sent(entries.size(), false);
+    std::vector<Group> groups;
+    std::vector<CMoCanJob> jobs;
+    Tcl_Obj *error = 0L, *values;
+    size_t i, j, k, n;
+
+    // One pipelined send for each transport, in the order the calls were made.
+    for (i = 0; i < entries.size(); i++)
+    {
+	if (sent[i]) continue;
+	groups.push_back(Group());
+	Group& group = groups.back();
+	group.handle = entries[i].axis->Handle();
+	group.sent = false;
+
+	for (j = i; j < entries.size(); j++)
+	{
+	    if (sent[j] ||
+		entries[j].axis->Handle()->transport_data != group.handle->transport_data)
+	    {
+		continue;
+	    }
+	    sent[j] = true;
+	    group.members.push_back(j);
+	    group.batch.insert(group.batch.end(), frames.begin() + entries[j].first,
+		frames.begin() + entries[j].first + entries[j].count);
+	}
+    }
+
+    // The drives on a CAN bus work at once, so theirs go out together.
+    for (i = 0; i < groups.size(); i++)
+    {
+	if (groups[i].sent) continue;
+	if (groups[i].handle->transport.SendCommand != CMoCan_SendCommand)
+	{
+	    CMoTransport_SendFrames(groups[i].handle, &groups[i].batch[0],
+		static_cast<int>(groups[i].batch.size()));
+	    continue;
+	}
+	jobs.clear();
+	for (j = i; j < groups.size(); j++)
+	{
+	    PMDAxisHandle* handle = groups[j].handle;
+	    CMoCanJob job;
+
+	    if (groups[j].sent ||
+		handle->transport.SendCommand != CMoCan_SendCommand ||
+		CMoCan_Bus(handle->transport_data) !=
+		    CMoCan_Bus(groups[i].handle->transport_data))
+	    {
+		continue;
+	    }
+	    groups[j].sent = true;
+	    job.transport_data = handle->transport_data;
+	    job.frames = &groups[j].batch[0];
+	    job.count = static_cast<int>(groups[j].batch.size());
+	    jobs.push_back(job);
+	}
+	CMoCan_SendJobs(&jobs[0], static_cast<int>(jobs.size()));
+    }
+
+    for (i = 0; i < groups.size(); i++)
+    {
+	Group& group = groups[i];
+	int count = static_cast<int>(group.batch.size());
+
+	CMoRetry::Frames(group.handle, &group.batch[0], count);
+	CMoReconnect::Record(group.handle, &group.batch[0], count);
+	CMoPrefetch::Sent(group.handle, &group.batch[0], count);
+
+	for (k = 0, n = 0; k < group.members.size(); k++)
+	{
+	    Entry& entry = entries[group.members[k]];
+	    for (j = 0; j < entry.count; j++)
+	    {
+		frames[entry.first + j] = group.batch[n++];
+	    }
+	}
+    }
+
+    // Now let each method decode its own replies.
+    values = Tcl_NewDictObj();
+    for (i = 0; i < entries.size(); i++)
+    {
+	Entry& entry = entries[i];
+
+	capture.Replay(&frames[entry.first], entry.count);
+	entry.axis->BeginCapture(&capture);
+	if (TCL_OK != entry.axis->Invoke(interp, entry.method, entry.words))
+	{
+	    if (error == 0L)
+	    {
+		error = Tcl_GetObjResult(interp);
+		Tcl_IncrRefCount(error);
+	    }
+	}
+	else if (entry.placeholder != 0L)
+	{
+	    entry.value = Tcl_GetObjResult(interp);
+	    Tcl_IncrRefCount(entry.value);
+	    Tcl_DictObjPut(0L, values, entry.placeholder, entry.value);
+	}
+	entry.axis->EndCapture();
+	Tcl_ResetResult(interp);
+    }
+
+    ResolveVariables(interp);
+
+    if (error != 0L)
+    {
+	Tcl_DecrRefCount(values);
+	Tcl_SetObjResult(interp, error);
+	Tcl_DecrRefCount(error);
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, values);
+    return TCL_OK;
+}
@@ -0,0 +1,60 @@
+/*
+ * CMoBatch.hpp --
+ *
+ *	The transaction behind [cmotion::batch script].
+ *
+ * While the script runs, each pmd::cmotion API call is checked and
+ * recorded instead of sent.  Calls that read something return a
+ * placeholder such as "cmotion:pending:3".  When the script is done the
+ * packets for each transport go out as one pipelined batch (for all the
+ * drives on a CAN bus at once), the replies are decoded by the same
+ * methods, and any scalar variable in the caller's scope holding a
+ * placeholder gets the real value.
+ */
+#ifndef INC_CMoBatch_hpp__
+#define INC_CMoBatch_hpp__
+
+#include "CMoAxis.hpp"
+#include <vector>
+
+class CMoBatch
+{
+public:
+    CMoBatch();
+    ~CMoBatch();
+
+    int Call(Tcl_Interp* interp, CMoAxis* axis, CMoAxis::Method method,
+	    int objc, struct Tcl_Obj* const objv[]);
+    void Forget(CMoAxis* axis);
+    int Commit(Tcl_Interp* interp);
+
+private:
+    struct Entry
+    {
+	CMoAxis* axis;
+	CMoAxis::Method method;
+	Tcl_Obj* words;		// method name and arguments
+	Tcl_Obj* placeholder;	// 0L for calls that only write
+	Tcl_Obj* value;		// what the placeholder resolved to
+	size_t first, count;	// frames recorded for this call
+    };
+
+    // The calls going out on one transport.
+    struct Group
+    {
+	PMDAxisHandle* handle;
+	std::vector<size_t> members;	// entries
+	std::vector<CMoFrame> batch;
+	bool sent;
+    };
+
+    Entry* Lookup(Tcl_Obj* value);
+    void ResolveVariables(Tcl_Interp* interp);
+
+    CMoCapture capture;
+    std::vector<Entry> entries;
+    std::vector<CMoFrame> frames;
+    unsigned long placeholders;
+};
+
+#endif	// #ifndef INC_CMoBatch_hpp__
@@ -0,0 +1,945 @@
+// SocketCAN transport, see CMoCan.h.
+
+#if defined(__linux__)
+#   ifndef _GNU_SOURCE
+#	define _GNU_SOURCE	// sendmmsg and recvmmsg
+#   endif
+#   include <errno.h>
+#   include <poll.h>
+#   include <pthread.h>
+#   include <time.h>
+#   include <unistd.h>
+#   include <net/if.h>
+#   include <sys/eventfd.h>
+#   include <sys/ioctl.h>
+#   include <sys/socket.h>
+#   include <linux/can.h>
+#   include <linux/can/raw.h>
+#endif
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CMoCan.h"
+#include "CMoReplyStamp.h"
+
+#if defined(__linux__)
+
+// Defaults for a new handle.
+#define CMO_CAN_TIMEOUT_MS 100
+
+// Frames handed to the kernel in one call, either way.  More than the
+// nodes a bus can have, so one call covers every node.
+#define CMO_CAN_BATCH 128
+
+// The frame IDs in a kernel filter: standard, not remote.
+#define CMO_CAN_MASK (CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG)
+
+// Frames for one handle, waiting or under way.
+typedef struct Job {
+    CMoCanData* can;
+    CMoFrame* frames;
+    int count;
+    int sent;			// frames put on the bus so far
+    int answered;
+    int urgent;			// goes out even to a node that timed out
+    int priority;		// class, see CMoPriority.h
+    unsigned long long queued;	// us, when it came in
+    unsigned long long stamp;	// when it was done, see CMoReplyStamp_Now
+    int* left;			// the caller's count of unfinished jobs
+    pthread_cond_t* done;	// signalled when that comes to 0
+    struct Job* joined;		// reads that share this one's reply
+    struct Job* next;
+} Job;
+
+// Where each node is at.
+typedef struct Slot {
+    Job* job;			// whose command the node has, NULL for none
+    PMDuint32 due;		// when that command, or a stale reply, times out
+    int stale;			// timed out, and the reply may yet turn up
+    unsigned long long served[CMO_PRIORITIES];	// us, when each class last had the node
+} Slot;
+
+struct CMoCanBus {
+    char name[IFNAMSIZ];
+    int socket;
+    int kick;			// wakes the pump for jobs that came in meanwhile
+    int kicked;
+    int refs;
+    int users[CMO_CAN_NODES];	// open handles on each node
+    pthread_mutex_t lock;
+    int pumping;		// someone is running the bus
+    Job* jobs;			// oldest first
+    Slot slots[CMO_CAN_NODES];
+    int outstanding;
+    CMoCanStats stats;
+    CMoCanLoad load;
+    struct CMoCanBus* next;
+};
+
+static pthread_mutex_t busesLock = PTHREAD_MUTEX_INITIALIZER;
+static struct CMoCanBus* buses = NULL;
+
+static PMDuint32
+Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (PMDuint32)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static unsigned long long
+Micros(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// A second at a time, like PMDSerial_CountBytes.
+static void
+CountBits(struct CMoCanBus* bus, PMDuint32 bits)
+{
+    PMDuint32 ms = Now();
+
+    if (ms - bus->load.secondMs >= 1000)
+    {
+	bus->load.lastBits = ms - bus->load.secondMs < 2000 ? bus->load.secondBits : 0;
+	bus->load.secondMs = ms;
+	bus->load.secondBits = 0;
+    }
+    bus->load.secondBits += bits;
+}
+
+// Let through the replies of the nodes in use.  A socket that isn't CAN
+// (a test's socketpair) says no, and Receive checks the IDs anyway.
+static void
+Filter(struct CMoCanBus* bus)
+{
+    struct can_filter filters[CMO_CAN_NODES];
+    int n = 0, node;
+
+    for (node = 0; node < CMO_CAN_NODES; node++)
+    {
+	if (bus->users[node] > 0)
+	{
+	    filters[n].can_id = CMO_CAN_REPLY_ID + node;
+	    filters[n].can_mask = CMO_CAN_MASK;
+	    n++;
+	}
+    }
+    setsockopt(bus->socket, SOL_CAN_RAW, CAN_RAW_FILTER,
+	n ? filters : NULL, n * sizeof(filters[0]));
+}
+
+static int
+OpenSocket(const char* interface)
+{
+    struct sockaddr_can address;
+    struct ifreq ifr;
+    int s;
+
+    if (strlen(interface) >= IFNAMSIZ ||
+	(s = socket(PF_CAN, SOCK_RAW, CAN_RAW)) < 0)
+    {
+	return -1;
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    strcpy(ifr.ifr_name, interface);
+    memset(&address, 0, sizeof(address));
+    address.can_family = AF_CAN;
+    if (ioctl(s, SIOCGIFINDEX, &ifr) < 0 ||
+	(address.can_ifindex = ifr.ifr_ifindex,
+	 bind(s, (struct sockaddr*)&address, sizeof(address)) < 0))
+    {
+	close(s);
+	return -1;
+    }
+    return s;
+}
+
+// The bus called interface, opened on socket s (or a new socket when s is
+// -1) if it isn't open already.  busesLock is held.
+static struct CMoCanBus*
+FindBus(const char* interface, int s)
+{
+    struct CMoCanBus* bus;
+
+    for (bus = buses; bus != NULL; bus = bus->next)
+    {
+	if (strcmp(bus->name, interface) == 0)
+	{
+	    return bus;
+	}
+    }
+    if (strlen(interface) >= IFNAMSIZ ||
+	(s < 0 && (s = OpenSocket(interface)) < 0))
+    {
+	return NULL;
+    }
+    if ((bus = (struct CMoCanBus*)calloc(1, sizeof(*bus))) == NULL ||
+	(bus->kick = eventfd(0, EFD_NONBLOCK)) < 0)
+    {
+	free(bus);
+	close(s);
+	return NULL;
+    }
+    strcpy(bus->name, interface);
+    bus->socket = s;
+    pthread_mutex_init(&bus->lock, NULL);
+    Filter(bus);
+    bus->next = buses;
+    buses = bus;
+    return bus;
+}
+
+static PMDresult
+Join(PMDAxisHandle* handle, int s, const char* interface, PMDuint8 node)
+{
+    struct CMoCanBus* bus;
+    CMoCanData* can;
+
+    if (node >= CMO_CAN_NODES ||
+	(can = (CMoCanData*)calloc(1, sizeof(CMoCanData))) == NULL)
+    {
+	return PMD_ERR_OpeningPort;
+    }
+    pthread_mutex_lock(&busesLock);
+    if ((bus = FindBus(interface, s)) == NULL)
+    {
+	pthread_mutex_unlock(&busesLock);
+	free(can);
+	return PMD_ERR_OpeningPort;
+    }
+    pthread_mutex_lock(&bus->lock);
+    bus->refs++;
+    bus->stats.nodes++;
+    if (bus->users[node]++ == 0)
+    {
+	Filter(bus);
+    }
+    pthread_mutex_unlock(&bus->lock);
+    pthread_mutex_unlock(&busesLock);
+
+    can->bus = bus;
+    can->node = node;
+    can->timeout = CMO_CAN_TIMEOUT_MS;
+    can->retry.attempts = 1;
+
+    // Only now that there is something to replace it with.
+    if (handle->transport.Close != NULL && handle->transport_data != NULL)
+    {
+	handle->transport.Close(handle->transport_data);
+    }
+    memset(&handle->transport, 0, sizeof(handle->transport));
+    handle->transport.SendCommand = CMoCan_SendCommand;
+    handle->transport.Close = CMoCan_Close;
+    handle->transport_data = can;
+    return PMD_ERR_OK;
+}
+
+PMDresult
+CMoCan_Open(PMDAxisHandle* handle, const char* interface, PMDuint8 node)
+{
+    return Join(handle, -1, interface, node);
+}
+
+PMDresult
+CMoCan_Attach(PMDAxisHandle* handle, int socket, const char* interface, PMDuint8 node)
+{
+    return Join(handle, socket, interface, node);
+}
+
+PMDresult
+CMoCan_Close(void* transport_data)
+{
+    CMoCanData* can = (CMoCanData*)transport_data;
+    struct CMoCanBus* bus, **link;
+    int last;
+
+    if (can == NULL)
+    {
+	return PMD_ERR_OK;
+    }
+    bus = can->bus;
+    pthread_mutex_lock(&busesLock);
+    pthread_mutex_lock(&bus->lock);
+    bus->stats.nodes--;
+    if (--bus->users[can->node] == 0)
+    {
+	Filter(bus);
+    }
+    last = --bus->refs == 0;
+    if (last)
+    {
+	for (link = &buses; *link != bus; link = &(*link)->next)
+	    ;
+	*link = bus->next;
+    }
+    pthread_mutex_unlock(&bus->lock);
+    pthread_mutex_unlock(&busesLock);
+
+    if (last)
+    {
+	close(bus->socket);
+	close(bus->kick);
+	pthread_mutex_destroy(&bus->lock);
+	free(bus);
+    }
+    free(can);
+    return PMD_ERR_OK;
+}
+
+// ------------------------------------------------------------------------
+// Running the bus.  Everything here is called with bus->lock held.
+// ------------------------------------------------------------------------
+
+static void
+Encode(const CMoFrame* frame, PMDuint8 node, struct can_frame* out)
+{
+    int i;
+
+    memset(out, 0, sizeof(*out));
+    out->can_id = CMO_CAN_COMMAND_ID + node;
+    out->can_dlc = (PMDuint8)(2 * frame->xCt);
+    for (i = 0; i < frame->xCt; i++)
+    {
+	out->data[2*i] = (PMDuint8)(frame->xDat[i] >> 8);
+	out->data[2*i + 1] = (PMDuint8)(frame->xDat[i] & 0xFF);
+    }
+}
+
+static void
+Decode(CMoFrame* frame, const struct can_frame* in)
+{
+    int i;
+
+    if (in->can_dlc < 2 || (in->data[0] == 0 && in->can_dlc < 2 + 2 * frame->rCt))
+    {
+	frame->result = PMD_ERR_CommunicationsError;
+	return;
+    }
+    frame->result = in->data[0];
+    for (i = 0; i < frame->rCt && !in->data[0]; i++)
+    {
+	frame->rDat[i] = (PMDuint16)((in->data[2 + 2*i] << 8) | in->data[3 + 2*i]);
+    }
+}
+
+// Done with job: whatever didn't come back gets result, and the reads
+// that joined it get the same answer.
+static void
+Finish(struct CMoCanBus* bus, Job* job, PMDresult result)
+{
+    Job** link;
+    Job* joined;
+    int n;
+
+    for (n = job->answered; n < job->count; n++)
+    {
+	job->frames[n].result = result;
+    }
+    job->stamp = CMoReplyStamp_Now();
+    for (link = &bus->jobs; *link != job; link = &(*link)->next)
+	;
+    *link = job->next;
+    for (joined = job->joined; joined != NULL; joined = joined->joined)
+    {
+	joined->frames[0] = job->frames[0];
+	joined->stamp = job->stamp;
+	if (--*joined->left == 0)
+	{
+	    pthread_cond_signal(joined->done);
+	}
+    }
+    if (--*job->left == 0)
+    {
+	pthread_cond_signal(job->done);
+    }
+}
+
+// A job whose reply a lone read can have: for the same node, the same
+// single command, not answered yet, and on its way or in a class no worse
+// than the read's.
+static Job*
+Shared(struct CMoCanBus* bus, const Job* read)
+{
+    const CMoFrame* frame = &read->frames[0];
+    const CMoFrame* other;
+    Job* job;
+
+    if (read->count != 1 || read->urgent || frame->xCt == 0 ||
+	!CMoOpcodes_IsRead((PMDuint8)(frame->xDat[0] & 0xFF)))
+    {
+	return NULL;
+    }
+    for (job = bus->jobs; job != NULL; job = job->next)
+    {
+	other = &job->frames[0];
+	if (job->can->node == read->can->node && job->count == 1 &&
+	    job->answered == 0 && !job->urgent &&
+	    (job->sent > 0 || job->priority <= read->priority) &&
+	    other->xCt == frame->xCt && other->rCt == frame->rCt &&
+	    memcmp(other->xDat, frame->xDat, frame->xCt * sizeof(PMDuint16)) == 0)
+	{
+	    return job;
+	}
+    }
+    return NULL;
+}
+
+// The next frame for every node that is free, into out: from the job for
+// it in the best class, counting how long each class has been passed over
+// on the node (CMoPriority_Aged), and the one passed over longer when two
+// stand level.  An urgent job beats them all.
+static int
+Start(struct CMoCanBus* bus, struct can_frame* out, Job** owners)
+{
+    PMDuint32 now = Now();
+    unsigned long long us = Micros();
+    Job* best[CMO_CAN_NODES];
+    int bestAged[CMO_CAN_NODES];
+    unsigned long long bestSince[CMO_CAN_NODES];
+    unsigned long long since;
+    Slot* slot;
+    Job* job;
+    int n = 0, node, aged;
+
+    memset(best, 0, sizeof(best));
+    for (job = bus->jobs; job != NULL; job = job->next)
+    {
+	node = job->can->node;
+	slot = &bus->slots[node];
+	if (job->sent == job->count || slot->job != NULL ||
+	    (slot->stale && !job->urgent))
+	{
+	    continue;
+	}
+	since = job->queued > slot->served[job->priority]
+	    ? job->queued : slot->served[job->priority];
+	aged = job->urgent ? INT_MIN
+	    : CMoPriority_Aged(job->priority, (PMDuint32)(us - since));
+	if (best[node] == NULL || aged < bestAged[node] ||
+	    (aged == bestAged[node] && since < bestSince[node]))
+	{
+	    best[node] = job;
+	    bestAged[node] = aged;
+	    bestSince[node] = since;
+	}
+    }
+    for (node = 0; node < CMO_CAN_NODES && n < CMO_CAN_BATCH; node++)
+    {
+	if ((job = best[node]) == NULL)
+	{
+	    continue;
+	}
+	if (job->sent == 0)
+	{
+	    CMoWaitStats_Note(&bus->stats.waits[job->priority],
+		(PMDuint32)(us - job->queued));
+	}
+	slot = &bus->slots[node];
+	slot->served[job->priority] = us;
+	slot->stale = 0;
+	Encode(&job->frames[job->sent++], node, &out[n]);
+	slot->job = job;
+	slot->due = now + job->can->timeout;
+	owners[n++] = job;
+	bus->outstanding++;
+    }
+    if ((PMDuint32)bus->outstanding > bus->stats.maxOutstanding)
+    {
+	bus->stats.maxOutstanding = bus->outstanding;
+    }
+    return n;
+}
+
+// Frames from first on that the kernel didn't take go back to waiting,
+// or fail when it won't take any.
+static void
+Unsent(struct CMoCanBus* bus, Job** owners, int first, int count, int error)
+{
+    Slot* slot;
+    Job* job;
+    int n;
+
+    for (n = first; n < count; n++)
+    {
+	job = owners[n];
+	slot = &bus->slots[job->can->node];
+	slot->job = NULL;
+	job->sent--;
+	bus->outstanding--;
+	if (error)
+	{
+	    Finish(bus, job, PMD_ERR_CommunicationsError);
+	}
+    }
+}
+
+static void
+Receive(struct CMoCanBus* bus, const struct can_frame* in)
+{
+    PMDuint32 id = in->can_id & CMO_CAN_MASK;
+    Slot* slot;
+    Job* job;
+
+    if (id < CMO_CAN_REPLY_ID || id >= CMO_CAN_REPLY_ID + CMO_CAN_NODES)
+    {
+	bus->stats.stray++;
+	return;
+    }
+    slot = &bus->slots[id - CMO_CAN_REPLY_ID];
+    if ((job = slot->job) == NULL)
+    {
+	// The late reply a timeout left behind, or nothing we asked for.
+	slot->stale = 0;
+	bus->stats.stray++;
+	return;
+    }
+    slot->job = NULL;
+    bus->outstanding--;
+    Decode(&job->frames[job->answered++], in);
+    if (job->answered == job->count)
+    {
+	Finish(bus, job, PMD_ERR_OK);
+    }
+}
+
+// Give up on the commands that are past due, and forget the late replies
+// that never came.  Returns ms to the next deadline, -1 for none.
+static int
+Expire(struct CMoCanBus* bus)
+{
+    PMDuint32 now = Now();
+    int node, wait = -1, left;
+    Slot* slot;
+
+    for (node = 0; node < CMO_CAN_NODES; node++)
+    {
+	slot = &bus->slots[node];
+	if (slot->job == NULL && !slot->stale)
+	{
+	    continue;
+	}
+	if ((int)(slot->due - now) > 0)
+	{
+	    left = (int)(slot->due - now);
+	    wait = (wait < 0 || left < wait) ? left : wait;
+	    continue;
+	}
+	if (slot->job != NULL)
+	{
+	    bus->stats.timeouts++;
+	    bus->outstanding--;
+	    slot->stale = 1;
+	    slot->due = now + slot->job->can->timeout;
+	    Finish(bus, slot->job, PMD_ERR_CommTimeoutError);
+	    slot->job = NULL;
+	    wait = 0;
+	}
+	else
+	{
+	    slot->stale = 0;
+	}
+    }
+    return wait;
+}
+
+// Run the bus, for everybody, until none of the caller's jobs are left.
+static void
+Pump(struct CMoCanBus* bus, const int* left)
+{
+    struct can_frame out[CMO_CAN_BATCH], in[CMO_CAN_BATCH];
+    struct mmsghdr msgs[CMO_CAN_BATCH];
+    struct iovec iov[CMO_CAN_BATCH];
+    Job* owners[CMO_CAN_BATCH];
+    struct pollfd pfd[2];
+    eventfd_t count;
+    int n, i, sent, got, wait, failed;
+
+    while (*left > 0)
+    {
+	n = Start(bus, out, owners);
+	wait = Expire(bus);
+	pthread_mutex_unlock(&bus->lock);
+
+	sent = 0;
+	if (n > 0)
+	{
+	    memset(msgs, 0, n * sizeof(msgs[0]));
+	    for (i = 0; i < n; i++)
+	    {
+		iov[i].iov_base = &out[i];
+		iov[i].iov_len = sizeof(out[i]);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	    }
+	    while (sent < n &&
+		(i = sendmmsg(bus->socket, msgs + sent, n - sent, MSG_DONTWAIT)) > 0)
+	    {
+		sent += i;
+		bus->stats.sendCalls++;
+	    }
+	}
+
+	// A full transmit queue only means later; anything else means never.
+	failed = sent < n && errno != EAGAIN && errno != ENOBUFS && errno != EINTR;
+	pfd[0].fd = bus->socket;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = bus->kick;
+	pfd[1].events = POLLIN;
+	pfd[0].revents = pfd[1].revents = 0;
+	if (sent < n && !failed)
+	{
+	    wait = 1;
+	}
+	got = 0;
+	poll(pfd, 2, wait);
+	if (pfd[1].revents & POLLIN)
+	{
+	    eventfd_read(bus->kick, &count);
+	}
+	if (pfd[0].revents & POLLIN)
+	{
+	    memset(msgs, 0, sizeof(msgs));
+	    for (got = 0; got < CMO_CAN_BATCH; got++)
+	    {
+		iov[got].iov_base = &in[got];
+		iov[got].iov_len = sizeof(in[got]);
+		msgs[got].msg_hdr.msg_iov = &iov[got];
+		msgs[got].msg_hdr.msg_iovlen = 1;
+	    }
+	    got = recvmmsg(bus->socket, msgs, CMO_CAN_BATCH, MSG_DONTWAIT, NULL);
+	}
+
+	pthread_mutex_lock(&bus->lock);
+	if (pfd[1].revents & POLLIN)
+	{
+	    bus->kicked = 0;
+	}
+	bus->stats.frames += sent;
+	for (i = 0; i < sent; i++)
+	{
+	    CountBits(bus, CMO_CAN_FRAME_BITS(out[i].can_dlc));
+	}
+	Unsent(bus, owners, sent, n, failed);
+	if (got > 0)
+	{
+	    bus->stats.recvCalls++;
+	    for (i = 0; i < got; i++)
+	    {
+		if (msgs[i].msg_len == sizeof(in[i]))
+		{
+		    CountBits(bus, CMO_CAN_FRAME_BITS(in[i].can_dlc));
+		    Receive(bus, &in[i]);
+		}
+	    }
+	}
+    }
+}
+
+// Whatever the ordinary jobs for node haven't sent yet won't go.
+static void
+Cut(struct CMoCanBus* bus, PMDuint8 node)
+{
+    Job* job, *next;
+    int n;
+
+    for (job = bus->jobs; job != NULL; job = next)
+    {
+	next = job->next;
+	if (job->urgent || job->can->node != node || job->sent == job->count)
+	{
+	    continue;
+	}
+	for (n = job->sent; n < job->count; n++)
+	{
+	    job->frames[n].result = PMD_ERR_WaitCancelled;
+	}
+	job->count = job->sent;
+	if (job->answered == job->count)
+	{
+	    Finish(bus, job, PMD_ERR_OK);
+	}
+    }
+}
+
+static PMDresult
+Send(CMoCanJob* jobs, int count, int urgent)
+{
+    struct CMoCanBus* bus;
+    PMDresult first = PMD_ERR_OK;
+    pthread_cond_t done;
+    Job* mine, **tail, *leader, **link;
+    unsigned long long stamp = 0;
+    int n, i, left = 0;
+
+    for (n = 0; n < count; n++)
+    {
+	for (i = 0; i < jobs[n].count; i++)
+	{
+	    if (jobs[n].frames[i].xCt > CMO_CAN_COMMAND_WORDS ||
+		jobs[n].frames[i].rCt > CMO_CAN_REPLY_WORDS)
+	    {
+		for (n = 0; n < count; n++)
+		{
+		    for (i = 0; i < jobs[n].count; i++)
+		    {
+			jobs[n].frames[i].result = PMD_ERR_CommandError;
+		    }
+		}
+		return PMD_ERR_CommandError;
+	    }
+	}
+    }
+    if (count <= 0)
+    {
+	return PMD_ERR_OK;
+    }
+    if ((mine = (Job*)calloc(count, sizeof(Job))) == NULL)
+    {
+	return PMD_ERR_CommunicationsError;
+    }
+    bus = ((CMoCanData*)jobs[0].transport_data)->bus;
+
+    pthread_mutex_lock(&bus->lock);
+    bus->stats.batches++;
+    tail = &bus->jobs;
+    while (!urgent && *tail != NULL)
+    {
+	tail = &(*tail)->next;
+    }
+    for (n = 0; n < count; n++)
+    {
+	if (jobs[n].count <= 0)
+	{
+	    continue;
+	}
+	mine[n].can = (CMoCanData*)jobs[n].transport_data;
+	mine[n].frames = jobs[n].frames;
+	mine[n].count = jobs[n].count;
+	mine[n].urgent = urgent;
+	mine[n].priority = urgent ? CMoControl : CMoPriority_Get();
+	mine[n].queued = Micros();
+	mine[n].left = &left;
+	mine[n].done = &done;
+	left++;
+	if ((leader = Shared(bus, &mine[n])) != NULL)
+	{
+	    for (link = &leader->joined; *link != NULL; link = &(*link)->joined)
+		;
+	    *link = &mine[n];
+	    bus->stats.coalesced++;
+	    continue;
+	}
+	if (urgent)
+	{
+	    Cut(bus, mine[n].can->node);
+	}
+	mine[n].next = *tail;
+	*tail = &mine[n];
+	tail = &mine[n].next;
+    }
+    if (bus->pumping && !bus->kicked && left > 0)
+    {
+	// So that ours go out now rather than after the next reply.
+	eventfd_write(bus->kick, 1);
+	bus->kicked = 1;
+    }
+    pthread_cond_init(&done, NULL);
+    while (left > 0)
+    {
+	if (bus->pumping)
+	{
+	    // Whoever is running the bus is sending ours too, and wakes us
+	    // when they're done or when it's our turn to run it.
+	    pthread_cond_wait(&done, &bus->lock);
+	    continue;
+	}
+	bus->pumping = 1;
+	Pump(bus, &left);
+	bus->pumping = 0;
+	if (bus->jobs != NULL)
+	{
+	    pthread_cond_signal(bus->jobs->done);
+	}
+    }
+    pthread_mutex_unlock(&bus->lock);
+    pthread_cond_destroy(&done);
+    for (n = 0; n < count; n++)
+    {
+	if (jobs[n].count > 0 && (stamp == 0 || mine[n].stamp < stamp))
+	{
+	    stamp = mine[n].stamp;
+	}
+    }
+    if (stamp != 0)
+    {
+	CMoReplyStamp_Set(stamp);
+    }
+    free(mine);
+
+    for (n = 0; n < count && first == PMD_ERR_OK; n++)
+    {
+	for (i = 0; i < jobs[n].count && first == PMD_ERR_OK; i++)
+	{
+	    first = jobs[n].frames[i].result;
+	}
+    }
+    return first;
+}
+
+PMDresult
+CMoCan_SendJobs(CMoCanJob* jobs, int count)
+{
+    return Send(jobs, count, 0);
+}
+
+PMDresult
+CMoCan_SendUrgent(CMoCanJob* jobs, int count)
+{
+    return Send(jobs, count, 1);
+}
+
+void*
+CMoCan_Bus(void* transport_data)
+{
+    return ((CMoCanData*)transport_data)->bus;
+}
+
+const char*
+CMoCan_Interface(void* transport_data)
+{
+    return ((CMoCanData*)transport_data)->bus->name;
+}
+
+void
+CMoCan_GetStats(void* transport_data, CMoCanStats* stats)
+{
+    struct CMoCanBus* bus = ((CMoCanData*)transport_data)->bus;
+
+    pthread_mutex_lock(&bus->lock);
+    *stats = bus->stats;
+    pthread_mutex_unlock(&bus->lock);
+}
+
+CMoCanLoad*
+CMoCan_Load(void* transport_data)
+{
+    return &((CMoCanData*)transport_data)->bus->load;
+}
+
+PMDuint32
+CMoCan_BitsPerSecond(void* transport_data)
+{
+    struct CMoCanBus* bus = ((CMoCanData*)transport_data)->bus;
+    PMDuint32 ms, bits;
+
+    pthread_mutex_lock(&bus->lock);
+    ms = Now() - bus->load.secondMs;
+    bits = ms < 1000 ? bus->load.lastBits : ms < 2000 ? bus->load.secondBits : 0;
+    pthread_mutex_unlock(&bus->lock);
+    return bits;
+}
+
+#else	// !__linux__
+
+// There is no SocketCAN anywhere else.  The entry points are still here
+// for the callers that compare against them.
+
+PMDresult
+CMoCan_Open(PMDAxisHandle* handle, const char* interface, PMDuint8 node)
+{
+    return PMD_ERR_OpeningPort;
+}
+
+PMDresult
+CMoCan_Attach(PMDAxisHandle* handle, int socket, const char* interface, PMDuint8 node)
+{
+    return PMD_ERR_OpeningPort;
+}
+
+PMDresult
+CMoCan_Close(void* transport_data)
+{
+    return PMD_ERR_OK;
+}
+
+PMDresult
+CMoCan_SendJobs(CMoCanJob* jobs, int count)
+{
+    return PMD_ERR_NotConnected;
+}
+
+PMDresult
+CMoCan_SendUrgent(CMoCanJob* jobs, int count)
+{
+    return PMD_ERR_NotConnected;
+}
+
+void*
+CMoCan_Bus(void* transport_data)
+{
+    return NULL;
+}
+
+const char*
+CMoCan_Interface(void* transport_data)
+{
+    return "";
+}
+
+void
+CMoCan_GetStats(void* transport_data, CMoCanStats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+CMoCanLoad*
+CMoCan_Load(void* transport_data)
+{
+    return NULL;
+}
+
+PMDuint32
+CMoCan_BitsPerSecond(void* transport_data)
+{
+    return 0;
+}
+
+#endif	// __linux__
+
+PMDresult
+CMoCan_SendFrames(void* transport_data, CMoFrame* frames, int count)
+{
+    CMoCanJob job;
+
+    job.transport_data = transport_data;
+    job.frames = frames;
+    job.count = count;
+    return CMoCan_SendJobs(&job, 1);
+}
+
+PMDresult
+CMoCan_SendCommand(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat)
+{
+    CMoFrame frame;
+    PMDresult result;
+
+    if (xCt > CMO_CAN_COMMAND_WORDS || rCt > CMO_CAN_REPLY_WORDS)
+    {
+	return PMD_ERR_CommandError;
+    }
+    frame.xCt = xCt;
+    frame.rCt = rCt;
+    memcpy(frame.xDat, xDat, xCt * sizeof(PMDuint16));
+    frame.result = PMD_ERR_OK;
+    if ((result = CMoCan_SendFrames(transport_data, &frame, 1)) == PMD_ERR_OK)
+    {
+	memcpy(rDat, frame.rDat, rCt * sizeof(PMDuint16));
+    }
+    return result;
+}
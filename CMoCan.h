@@ -0,0 +1,134 @@
+#ifndef INC_CMoCan_h__
+#define INC_CMoCan_h__
+
+// SocketCAN transport for drives on a CAN bus, Linux only.
+//
+// The chip takes its commands on CAN ID 0x600 + node ID and answers on
+// 0x580 + node ID.  A command is the words SendCommand is given, big
+// endian, one frame each: the command word and up to three arguments.
+// The answer is the status byte, a spare byte and up to three reply words.
+// CAN does its own checksumming, so there is no address or checksum byte.
+//
+// Every axis on the same interface shares one raw socket, whose kernel
+// filter lets through the reply IDs of the nodes that are open and nothing
+// else.  A node answers one command at a time, but the nodes of a bus all
+// work at once: whichever caller finds the bus idle sends the next frame
+// for every idle node with one sendmmsg and collects the replies with
+// recvmmsg, for its own requests and for anyone else's that are waiting,
+// and hands over once its own are done.  [cmotion::batch] sends the calls
+// for all the drives on a bus that way in one go.
+//
+// Jobs for the same node go in the order of their priority class
+// (CMoPriority.h), the caller's, so a command from the operator gets
+// ahead of a long upload or the polling at the next frame.  A lone read
+// that is the same command to the same node as a job already on its way,
+// or waiting in as good a class, isn't sent again but answered with that
+// job's reply.
+//
+// A node that times out gets nothing more until its late reply turns up
+// or another timeout has passed, so that the reply can't be taken for the
+// answer to a later command.
+
+#include "CMoTransport.h"
+#include "c-motion/PMDW32Ser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Node IDs are seven bits.
+#define CMO_CAN_NODES 128
+#define CMO_CAN_COMMAND_ID 0x600
+#define CMO_CAN_REPLY_ID 0x580
+
+// What fits in the eight data bytes of a frame.
+#define CMO_CAN_COMMAND_WORDS 4
+#define CMO_CAN_REPLY_WORDS 3
+
+// For the whole bus, not one node.
+typedef struct CMoCanStats {
+    PMDuint32 batches;
+    PMDuint32 frames;		// commands put on the bus
+    PMDuint32 sendCalls;	// sendmmsg calls it took
+    PMDuint32 recvCalls;	// recvmmsg calls that brought something back
+    PMDuint32 timeouts;
+    PMDuint32 stray;		// replies nobody was waiting for
+    PMDuint32 maxOutstanding;	// nodes with a command out at once
+    PMDuint32 nodes;		// open handles on the bus
+    PMDuint32 coalesced;	// reads given another job's reply
+    CMoWaitStats waits[CMO_PRIORITIES];	// from Send to the first frame
+} CMoCanStats;
+
+// Bits on the wire for a standard data frame with dlc bytes, with as
+// much bit stuffing as there can be.
+#define CMO_CAN_FRAME_BITS(dlc) (47 + 8 * (dlc) + (34 + 8 * (dlc) - 1) / 4)
+
+// How busy the bus is, as this host sees it: the bits of the frames it
+// sent and took in, counted a second at a time, and the periodic polls
+// CMoLoad.hpp has let onto it under its ceiling.
+typedef struct CMoCanLoad {
+    PMDuint32 bitRate;		// of the bus, 0 until it is configured
+    PMDuint32 secondMs;		// when the second being counted began
+    PMDuint32 secondBits;	// so far in it
+    PMDuint32 lastBits;		// in the whole second before it
+    PMDuint32 ceiling;		// percent of the bus polls may fill, 0 for any
+    PMDuint32 pollBits;		// a second, booked by the polls let on
+    PMDuint32 admitted;
+    PMDuint32 downrated;	// let on at a longer period than asked for
+    PMDuint32 refused;
+} CMoCanLoad;
+
+typedef struct CMoCanData {
+    struct CMoCanBus* bus;
+    PMDuint8 node;
+    PMDuint32 timeout;		// ms to wait for each reply
+    PMDSerialRetry retry;	// after a failed call, see CMoRetry.hpp
+} CMoCanData;
+
+// Frames for one axis, for CMoCan_SendJobs.
+typedef struct CMoCanJob {
+    void* transport_data;
+    CMoFrame* frames;
+    int count;
+} CMoCanJob;
+
+// Put handle on node of the named interface (can0, vcan0, ...), replacing
+// whatever transport it had.  handle->transport.Close lets go of the bus.
+PMDresult CMoCan_Open(PMDAxisHandle* handle, const char* interface, PMDuint8 node);
+
+// The same, on a socket the caller has already bound.  The socket is only
+// taken when there isn't a bus by that name yet, and is closed with it.
+PMDresult CMoCan_Attach(PMDAxisHandle* handle, int socket, const char* interface, PMDuint8 node);
+
+PMDresult CMoCan_SendCommand(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat);
+PMDresult CMoCan_SendFrames(void* transport_data, CMoFrame* frames, int count);
+PMDresult CMoCan_Close(void* transport_data);
+
+// Send the frames of several axes on one bus together; each job's frames
+// get their results.  The first error among them comes back.
+PMDresult CMoCan_SendJobs(CMoCanJob* jobs, int count);
+
+// The same, ahead of everything else on the bus, for the stops of
+// CMoStop.hpp.  Frames that other jobs for those nodes haven't sent yet
+// fail with PMD_ERR_WaitCancelled, and a node that timed out isn't given
+// time for its late reply.  A command a node already has is still
+// answered first.
+PMDresult CMoCan_SendUrgent(CMoCanJob* jobs, int count);
+
+// Which bus a handle's transport_data is on, to group jobs by.
+void* CMoCan_Bus(void* transport_data);
+const char* CMoCan_Interface(void* transport_data);
+void CMoCan_GetStats(void* transport_data, CMoCanStats* stats);
+
+// The bus's load, shared by every node on it; the counting is done under
+// the bus's lock and the rest is left to CMoLoad.hpp.  NULL without
+// SocketCAN.
+CMoCanLoad* CMoCan_Load(void* transport_data);
+// In the last whole second.
+PMDuint32 CMoCan_BitsPerSecond(void* transport_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// #ifndef INC_CMoCan_h__
@@ -0,0 +1,67 @@
+/*
+ * CMoCapture.cpp --
+ *
+ *	Record and replay transport.  See CMoCapture.hpp.
+ */
+
+#include "CMoCapture.hpp"
+#include <string.h>
+
+CMoCapture::CMoCapture()
+    : replaying(false), replay(0L), replayCount(0), replayed(0)
+{
+}
+
+void
+CMoCapture::Record()
+{
+    replaying = false;
+    frames.clear();
+}
+
+void
+CMoCapture::Replay(const CMoFrame* _frames, size_t count)
+{
+    replaying = true;
+    replay = _frames;
+    replayCount = count;
+    replayed = 0;
+}
+
+PMDresult
+CMoCapture::SendCommand(void* transport_data, PMDuint8 xCt, PMDuint16* xDat,
+	PMDuint8 rCt, PMDuint16* rDat)
+{
+    CMoCapture* capture = static_cast<CMoCapture*>(transport_data);
+    CMoFrame frame;
+
+    if (xCt > CMO_FRAME_WORDS || rCt > CMO_FRAME_WORDS)
+    {
+	return PMD_ERR_InvalidOperation;
+    }
+
+    if (capture->replaying)
+    {
+	// The method has to ask for the same packets, in the same order,
+	// as when it was recorded.
+	if (capture->replayed >= capture->replayCount ||
+	    capture->replay[capture->replayed].xCt != xCt ||
+	    capture->replay[capture->replayed].rCt != rCt)
+	{
+	    return PMD_ERR_CommunicationsError;
+	}
+	frame = capture->replay[capture->replayed++];
+	memcpy(rDat, frame.rDat, rCt * sizeof(PMDuint16));
+	return frame.result;
+    }
+
+    memset(&frame, 0, sizeof(frame));
+    frame.xCt = xCt;
+    frame.rCt = rCt;
+    memcpy(frame.xDat, xDat, xCt * sizeof(PMDuint16));
+    capture->frames.push_back(frame);
+
+    // Reads get zeros back; the real values come later by replay.
+    memset(rDat, 0, rCt * sizeof(PMDuint16));
+    return PMD_ERR_OK;
+}
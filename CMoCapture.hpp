@@ -0,0 +1,41 @@
+/*
+ * CMoCapture.hpp --
+ *
+ *	A stand-in PMDIOTransport that records the packets the C-Motion
+ *	calls would have sent, or plays back replies collected earlier.
+ *
+ * The CMoAxis methods already know how to check their arguments, scale
+ * them and pack them with the C-Motion API.  Rather than repeat that for
+ * prepared programs and batches, the method is run against a capture.
+ * In record mode every packet is kept and a zero reply is handed back.
+ * In replay mode the method gets the real replies from a pipelined send,
+ * so it decodes and scales them exactly as if it had done the I/O itself.
+ */
+#ifndef INC_CMoCapture_hpp__
+#define INC_CMoCapture_hpp__
+
+#include "CMoTransport.h"
+#include <stddef.h>
+#include <vector>
+
+class CMoCapture
+{
+public:
+    CMoCapture();
+
+    void Record();
+    void Replay(const CMoFrame* frames, size_t count);
+
+    std::vector<CMoFrame> frames;
+
+    static PMDresult SendCommand(void* transport_data, PMDuint8 xCt,
+	    PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat);
+
+private:
+    bool replaying;
+    const CMoFrame* replay;
+    size_t replayCount;
+    size_t replayed;
+};
+
+#endif	// #ifndef INC_CMoCapture_hpp__
@@ -0,0 +1,633 @@
+/*
+ * CMoDevice.cpp --
+ *
+ *	On-device user code through C-Motion.dll.  See CMoDevice.hpp.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "CMoDevice.hpp"
+#include "CMoDeviceApi.h"
+#include "CMoNetwork.h"
+#include "CMoWait.hpp"
+#include "c-motion/PMDdiag.h"
+
+// Room for the strings the DLL copies out, with plenty to spare.
+#define USER_CODE_STRING 256
+
+// How long a packet over TCP gets.
+#define DEVICE_TCP_TIMEOUT_MS 1000
+
+// PMDTaskGetState's answers, in order.
+static const char* taskStates[] =
+{
+    "invalid", "nocode", "running", "notstarted", "aborted"
+};
+#define NUM_TASK_STATES (int)(sizeof(taskStates) / sizeof(taskStates[0]))
+
+CMoDevice::CMoDevice()
+    : hPeriph(0L), hDevice(0L)
+{
+    memset(hMemory, 0, sizeof(hMemory));
+};
+
+CMoDevice::~CMoDevice()
+{
+    Close();
+};
+
+void
+CMoDevice::Close()
+{
+    int i;
+
+    if (hDevice != 0L)
+    {
+	CMoWait::CancelDevice(hDevice);
+    }
+    for (i = 0; i < NUM_REGIONS; i++)
+    {
+	if (hMemory[i] != 0L)
+	{
+	    PMDMemoryClose(hMemory[i]);
+	    PMDMemoryFree(hMemory[i]);
+	    hMemory[i] = 0L;
+	}
+    }
+    if (hDevice != 0L)
+    {
+	PMDDeviceClose(hDevice);
+	PMDDeviceFree(hDevice);
+	hDevice = 0L;
+    }
+    if (hPeriph != 0L)
+    {
+	PMDPeriphClose(hPeriph);
+	PMDPeriphFree(hPeriph);
+	hPeriph = 0L;
+    }
+};
+
+int
+CMoDevice::Error(Tcl_Interp* interp, PMDresult result)
+{
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+    return TCL_ERROR;
+};
+
+bool
+CMoDevice::Connected(Tcl_Interp* interp)
+{
+    if (hDevice == 0L)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("device is not connected", -1));
+	return false;
+    }
+    return true;
+};
+
+// Open the link to the device and the device on it, in place of any
+// earlier one:
+//	Connect serial port ?baud?	(port 0 is COM1)
+//	Connect tcp address ?port?
+int
+CMoDevice::Connect(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* kinds[] = {"serial", "tcp", 0L};
+    enum kinds {KIND_SERIAL, KIND_TCP};
+    unsigned int a, b, c, d;
+    void *periph, *device;
+    PMDresult result;
+    int kind, port, baud = 57600, tcpPort = CMO_NETWORK_PORT;
+    char tail;
+
+    if (objc != 3 && objc != 4)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "serial port ?baud?|tcp address ?port?");
+	return TCL_ERROR;
+    }
+    if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[1], kinds, "link", 0, &kind))
+    {
+	return TCL_ERROR;
+    }
+    if (kind == KIND_SERIAL)
+    {
+	if (TCL_OK != Tcl_GetIntFromObj(interp, objv[2], &port) ||
+	    (objc == 4 && TCL_OK != Tcl_GetIntFromObj(interp, objv[3], &baud)))
+	{
+	    return TCL_ERROR;
+	}
+	if (port < 0 || baud <= 0)
+	{
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		port < 0 ? "invalid port" : "invalid baud rate", -1));
+	    return TCL_ERROR;
+	}
+    }
+    else
+    {
+	if (sscanf(Tcl_GetString(objv[2]), "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4 ||
+	    a > 255 || b > 255 || c > 255 || d > 255)
+	{
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"expected an IPv4 address but got \"%s\"", Tcl_GetString(objv[2])));
+	    return TCL_ERROR;
+	}
+	if (objc == 4 && TCL_OK != Tcl_GetIntFromObj(interp, objv[3], &tcpPort))
+	{
+	    return TCL_ERROR;
+	}
+	if (tcpPort <= 0 || tcpPort > 65535)
+	{
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid port", -1));
+	    return TCL_ERROR;
+	}
+    }
+
+#ifndef CMO_DEVICE_DLL
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	"on-device user code needs C-Motion.dll", -1));
+    return TCL_ERROR;
+#endif
+
+    Close();
+    periph = PMDPeriphAlloc();
+    device = PMDDeviceAlloc();
+    if (periph == 0L || device == 0L)
+    {
+	if (periph != 0L) PMDPeriphFree(periph);
+	if (device != 0L) PMDDeviceFree(device);
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("out of memory", -1));
+	return TCL_ERROR;
+    }
+    if (kind == KIND_SERIAL)
+    {
+	result = PMDPeriphOpenCOM(periph, 0L, port, baud, 0, 0);
+    }
+    else
+    {
+	result = PMDPeriphOpenTCP(periph, 0L, (a << 24) | (b << 16) | (c << 8) | d,
+	    tcpPort, DEVICE_TCP_TIMEOUT_MS);
+    }
+    if (result == PMD_NOERROR &&
+	(result = PMDRPDeviceOpen(device, periph)) != PMD_NOERROR)
+    {
+	PMDPeriphClose(periph);
+    }
+    if (result != PMD_NOERROR)
+    {
+	PMDPeriphFree(periph);
+	PMDDeviceFree(device);
+	return Error(interp, result);
+    }
+    hPeriph = periph;
+    hDevice = device;
+    return TCL_OK;
+};
+
+int
+CMoDevice::Disconnect(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    Close();
+    return TCL_OK;
+};
+
+// Download user code (the .bin the C-Motion Engine tools build, as a
+// bytearray) to the device's flash.  Any running task is stopped first,
+// as the device won't take code while it runs.
+int
+CMoDevice::StoreUserCode(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    unsigned char* data;
+    PMDresult result;
+    int length;
+
+    if (objc != 2)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "code");
+	return TCL_ERROR;
+    }
+    if (!Connected(interp))
+    {
+	return TCL_ERROR;
+    }
+    data = Tcl_GetByteArrayFromObj(objv[1], &length);
+    if (length == 0)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("no code to store", -1));
+	return TCL_ERROR;
+    }
+    PMDTaskStop(hDevice);
+    if ((result = PMDDeviceStoreUserCode(hDevice, (char*)data, length)) != PMD_NOERROR)
+    {
+	return Error(interp, result);
+    }
+    return TCL_OK;
+};
+
+int
+CMoDevice::GetUserCodeFileName(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    char name[USER_CODE_STRING];
+    PMDresult result;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (!Connected(interp))
+    {
+	return TCL_ERROR;
+    }
+    memset(name, 0, sizeof(name));
+    if ((result = PMDGetUserCodeFileName(hDevice, name)) != PMD_NOERROR)
+    {
+	return Error(interp, result);
+    }
+    name[sizeof(name) - 1] = '\0';
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(name, -1));
+    return TCL_OK;
+};
+
+int
+CMoDevice::GetUserCodeFileVersion(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    PMDuint32 version;
+    PMDresult result;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (!Connected(interp))
+    {
+	return TCL_ERROR;
+    }
+    if ((result = PMDGetUserCodeFileVersion(hDevice, &version)) != PMD_NOERROR)
+    {
+	return Error(interp, result);
+    }
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(version));
+    return TCL_OK;
+};
+
+int
+CMoDevice::GetUserCodeFileDate(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    char date[USER_CODE_STRING];
+    PMDresult result;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (!Connected(interp))
+    {
+	return TCL_ERROR;
+    }
+    memset(date, 0, sizeof(date));
+    if ((result = PMDGetUserCodeFileDate(hDevice, date)) != PMD_NOERROR)
+    {
+	return Error(interp, result);
+    }
+    date[sizeof(date) - 1] = '\0';
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(date, -1));
+    return TCL_OK;
+};
+
+int
+CMoDevice::TaskStart(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    PMDresult result;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (!Connected(interp))
+    {
+	return TCL_ERROR;
+    }
+    if ((result = PMDTaskStart(hDevice)) != PMD_NOERROR)
+    {
+	return Error(interp, result);
+    }
+    return TCL_OK;
+};
+
+int
+CMoDevice::TaskStop(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    PMDresult result;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (!Connected(interp))
+    {
+	return TCL_ERROR;
+    }
+    if ((result = PMDTaskStop(hDevice)) != PMD_NOERROR)
+    {
+	return Error(interp, result);
+    }
+    return TCL_OK;
+};
+
+// The task's state by name: nocode, notstarted, running or aborted.  A
+// state this doesn't know comes back as its number.
+int
+CMoDevice::TaskGetState(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    PMDresult result;
+    int state;
+
+    if (objc != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "");
+	return TCL_ERROR;
+    }
+    if (!Connected(interp))
+    {
+	return TCL_ERROR;
+    }
+    if ((result = PMDTaskGetState(hDevice, &state)) != PMD_NOERROR)
+    {
+	return Error(interp, result);
+    }
+    if (state >= 0 && state < NUM_TASK_STATES)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(taskStates[state], -1));
+    }
+    else
+    {
+	Tcl_SetObjResult(interp, Tcl_NewIntObj(state));
+    }
+    return TCL_OK;
+};
+
+int
+CMoDevice::GetRegionFromObj(Tcl_Interp* interp, Tcl_Obj* obj, int* region)
+{
+    static const char* regions[] = {"dpram", "nvram", 0L};
+
+    return Tcl_GetIndexFromObj(interp, obj, regions, "region", 0, region);
+};
+
+// The device memory handle for a region, opened the first time.
+void*
+CMoDevice::Memory(int region, PMDresult* result)
+{
+    void* hMem;
+
+    *result = PMD_NOERROR;
+    if (hMemory[region] == 0L)
+    {
+	if ((hMem = PMDMemoryAlloc()) == 0L)
+	{
+	    *result = PMD_ERR_InvalidOperation;
+	    return 0L;
+	}
+	*result = PMDMemoryOpen(hMem, hDevice, PMDDataSize_32Bit,
+	    region == DPRAM ? PMDMemoryType_DPRAM : PMDMemoryType_NVRAM);
+	if (*result != PMD_NOERROR)
+	{
+	    PMDMemoryFree(hMem);
+	    return 0L;
+	}
+	hMemory[region] = hMem;
+    }
+    return hMemory[region];
+};
+
+// Read count 32 bit words of dpram or nvram, offset words in, as a
+// bytearray of little endian words the way pmd::cmotion's ReadMemory
+// gives them.
+int
+CMoDevice::ReadMemory(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    std::vector<PMDuint32> words;
+    Tcl_WideInt offset, count;
+    Tcl_Obj* bytes;
+    unsigned char* p;
+    PMDresult result;
+    void* hMem;
+    int region, i;
+
+    if (objc != 4)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "region offset count");
+	return TCL_ERROR;
+    }
+    if (TCL_OK != GetRegionFromObj(interp, objv[1], &region) ||
+	TCL_OK != Tcl_GetWideIntFromObj(interp, objv[2], &offset) ||
+	TCL_OK != Tcl_GetWideIntFromObj(interp, objv[3], &count))
+    {
+	return TCL_ERROR;
+    }
+    if (offset < 0 || offset > 0xFFFFFFFF || count < 0 || count > 0x1FFFFFFF)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("value out of range", -1));
+	return TCL_ERROR;
+    }
+    if (offset + count > 0xFFFFFFFF)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("offset and count go past the end of memory", -1));
+	return TCL_ERROR;
+    }
+    if (!Connected(interp))
+    {
+	return TCL_ERROR;
+    }
+    if ((hMem = Memory(region, &result)) == 0L)
+    {
+	return Error(interp, result);
+    }
+    words.resize(count > 0 ? (size_t)count : 1);
+    if (count > 0 &&
+	(result = PMDMemoryRead(hMem, &words[0], (PMDuint32)offset, (PMDuint32)count))
+	    != PMD_NOERROR)
+    {
+	return Error(interp, result);
+    }
+    bytes = Tcl_NewByteArrayObj(0L, 0);
+    p = Tcl_SetByteArrayLength(bytes, (int)(4 * count));
+    for (i = 0; i < count; i++)
+    {
+	p[4*i] = (unsigned char)(words[i] & 0xFF);
+	p[4*i + 1] = (unsigned char)((words[i] >> 8) & 0xFF);
+	p[4*i + 2] = (unsigned char)((words[i] >> 16) & 0xFF);
+	p[4*i + 3] = (unsigned char)(words[i] >> 24);
+    }
+    Tcl_SetObjResult(interp, bytes);
+    return TCL_OK;
+};
+
+// Write a bytearray of little endian 32 bit words to dpram or nvram,
+// offset words in.  The result is the number of words written.
+int
+CMoDevice::WriteMemory(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    std::vector<PMDuint32> words;
+    const unsigned char* p;
+    Tcl_WideInt offset;
+    PMDresult result;
+    void* hMem;
+    int region, length, count, i;
+
+    if (objc != 4)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "region offset data");
+	return TCL_ERROR;
+    }
+    if (TCL_OK != GetRegionFromObj(interp, objv[1], &region) ||
+	TCL_OK != Tcl_GetWideIntFromObj(interp, objv[2], &offset))
+    {
+	return TCL_ERROR;
+    }
+    if (offset < 0 || offset > 0xFFFFFFFF)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("value out of range", -1));
+	return TCL_ERROR;
+    }
+    p = Tcl_GetByteArrayFromObj(objv[3], &length);
+    if (length % 4 != 0)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("data isn't a whole number of words", -1));
+	return TCL_ERROR;
+    }
+    if (offset + length / 4 > 0xFFFFFFFF)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj("offset and count go past the end of memory", -1));
+	return TCL_ERROR;
+    }
+    if (!Connected(interp))
+    {
+	return TCL_ERROR;
+    }
+    if ((hMem = Memory(region, &result)) == 0L)
+    {
+	return Error(interp, result);
+    }
+    count = length / 4;
+    words.resize(count > 0 ? count : 1);
+    for (i = 0; i < count; i++)
+    {
+	words[i] = (PMDuint32)p[4*i] | ((PMDuint32)p[4*i + 1] << 8) |
+	    ((PMDuint32)p[4*i + 2] << 16) | ((PMDuint32)p[4*i + 3] << 24);
+    }
+    if (count > 0 &&
+	(result = PMDMemoryWrite(hMem, &words[0], (PMDuint32)offset, count))
+	    != PMD_NOERROR)
+    {
+	return Error(interp, result);
+    }
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(count));
+    return TCL_OK;
+};
+
+// Wait until the axis (1 to 4) raises an event with any of the bits in
+// mask, for up to -timeout ms (0, the default, waits for as long as it
+// takes).  The device tells the DLL of each event itself, so nothing is
+// sent while waiting; the axis' SetInterruptMask has to include the bits.
+// The result is the event's bits.  With -command the wait goes on in the
+// background and the script is called as pmd::cmotion's WaitForEvent
+// calls it.  An axis reached some other way can only be polled, with
+// [$axis WaitForEvent].
+int
+CMoDevice::WaitForEvent(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[])
+{
+    static const char* options[] = {"-command", "-timeout", 0L};
+    enum options {OPT_COMMAND, OPT_TIMEOUT};
+    Tcl_Obj* command = 0L;
+    PMDuint32 timeout = 0;
+    PMDuint16 status;
+    PMDresult result;
+    int i, index, axis, mask, value;
+
+    if (objc < 3 || objc % 2 != 1)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv,
+	    "axis mask ?-timeout ms? ?-command script?");
+	return TCL_ERROR;
+    }
+    if (TCL_OK != Tcl_GetIntFromObj(interp, objv[1], &axis) ||
+	TCL_OK != Tcl_GetIntFromObj(interp, objv[2], &mask))
+    {
+	return TCL_ERROR;
+    }
+    if (axis < 1 || axis > 4)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid axis", -1));
+	return TCL_ERROR;
+    }
+    if (mask <= 0 || mask > 0xFFFF)
+    {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid event mask", -1));
+	return TCL_ERROR;
+    }
+    for (i = 3; i < objc; i += 2)
+    {
+	if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[i], options, "option",
+		0, &index))
+	{
+	    return TCL_ERROR;
+	}
+	if (index == OPT_COMMAND)
+	{
+	    command = objv[i+1];
+	    continue;
+	}
+	if (TCL_OK != Tcl_GetIntFromObj(interp, objv[i+1], &value))
+	{
+	    return TCL_ERROR;
+	}
+	if (value < 0)
+	{
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid timeout", -1));
+	    return TCL_ERROR;
+	}
+	timeout = value;
+    }
+    if (!Connected(interp))
+    {
+	return TCL_ERROR;
+    }
+
+    if (command != 0L)
+    {
+	CMoWait::StartDevice(interp, hDevice, (PMDAxis)(axis - 1),
+	    (PMDuint16) mask, timeout, command);
+	return TCL_OK;
+    }
+    switch (CMoWait::BlockDevice(hDevice, (PMDAxis)(axis - 1),
+	(PMDuint16) mask, timeout, &status, &result))
+    {
+    case CMoWait::Happened:
+	Tcl_SetObjResult(interp, Tcl_NewLongObj(status));
+	return TCL_OK;
+
+    case CMoWait::TimedOut:
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+	    "timed out waiting for events 0x%04X", mask));
+	return TCL_ERROR;
+
+    default:
+	return Error(interp, result);
+    }
+};
@@ -0,0 +1,68 @@
+/*
+ * CMoDevice.hpp --
+ *
+ *	One pmd::device object: a motion card or module with a C-Motion
+ *	Engine, which runs user code of its own next to the chip.
+ *
+ * Logic that has to react within a servo cycle or two (a retract on a
+ * capture, an I/O interlock, gearing in and out) costs a round trip per
+ * decision when a script does it over the link.  Downloaded to the device
+ * as user code it runs at the device's speed and sends nothing.  The
+ * script stores the code, starts and stops its task, asks what state it
+ * is in and trades parameters with it through the device's memory.
+ *
+ * These go to the device rather than to an axis, through the resource
+ * protocol that C-Motion.dll speaks, so they need the DLL: it exports
+ * PMDDeviceStoreUserCode, PMDTaskStart and the rest though c-motion.h
+ * doesn't declare them (CMoDeviceApi.h does).  Where CMoNative.cpp stands
+ * in for the DLL, Connect says so.
+ */
+#ifndef INC_CMoDevice_hpp__
+#define INC_CMoDevice_hpp__
+
+#include "tcl.h"
+#include "c-motion/c-motion.h"
+
+class CMoDevice
+{
+public:
+    CMoDevice();
+    ~CMoDevice();
+
+    // Connection
+    int Connect(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int Disconnect(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // User code and its task
+    int StoreUserCode(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int GetUserCodeFileName(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int GetUserCodeFileVersion(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int GetUserCodeFileDate(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int TaskStart(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int TaskStop(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int TaskGetState(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Parameters shared with the task
+    int ReadMemory(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+    int WriteMemory(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+    // Events its axes raise
+    int WaitForEvent(Tcl_Interp* interp, int objc, struct Tcl_Obj* const objv[]);
+
+private:
+    enum {DPRAM, NVRAM, NUM_REGIONS};
+
+    bool Connected(Tcl_Interp* interp);
+    int GetRegionFromObj(Tcl_Interp* interp, Tcl_Obj* obj, int* region);
+    void* Memory(int region, PMDresult* result);
+    int Error(Tcl_Interp* interp, PMDresult result);
+    void Close();
+
+    // The DLL's own handles, from PMDDeviceAlloc and friends, 0L when
+    // not connected.
+    void* hPeriph;
+    void* hDevice;
+    void* hMemory[NUM_REGIONS];
+};
+
+#endif	// #ifndef INC_CMoDevice_hpp__
@@ -0,0 +1,100 @@
+#ifndef INC_CMoDeviceApi_h__
+#define INC_CMoDeviceApi_h__
+
+// The device handle API of C-Motion.dll, which c-motion.h leaves out.
+//
+// These are the exports of the DLL that goes with c-motion.h 5.8 (the
+// dump at the end of CMoTcl.cpp), declared here by hand to match it.  A
+// DLL of another version is refused by Cmotcl_Init before any of them is
+// called.  The handles are the DLL's own, sized and freed by the DLL, so
+// they are only ever pointers here.
+//
+// Without the DLL (CMoNative.cpp standing in for it, or anything but
+// Windows) each call fails with PMD_ERR_InvalidOperation, so that the
+// callers can be the same everywhere and only check CMO_DEVICE_DLL to say
+// why.
+
+#include "c-motion/c-motion.h"
+
+#if defined(_WIN32) && !defined(CMO_NATIVE_CMOTION)
+#   define CMO_DEVICE_DLL
+#endif
+
+enum {
+    PMDDataSize_32Bit = 4
+};
+enum {
+    PMDMemoryType_DPRAM = 0,
+    PMDMemoryType_NVRAM = 1
+};
+
+// What PMDWaitForEvent fills in: the axis that raised the host interrupt
+// and the bits of its event status that did.
+typedef struct tagPMDEvent {
+    PMDAxis axis;
+    PMDuint16 eventmask;
+} PMDEvent;
+
+#ifdef CMO_DEVICE_DLL
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+PMD_API void* PMD_CCONV PMDPeriphAlloc(void);
+PMD_API void* PMD_CCONV PMDDeviceAlloc(void);
+PMD_API void* PMD_CCONV PMDMemoryAlloc(void);
+PMD_API void PMD_CCONV PMDPeriphFree(void* handle);
+PMD_API void PMD_CCONV PMDDeviceFree(void* handle);
+PMD_API void PMD_CCONV PMDMemoryFree(void* handle);
+PMDCFunc PMDPeriphOpenCOM(void* hPeriph, void* hDevice, PMDparam portnum, PMDparam baud, PMDparam parity, PMDparam stopbits);
+PMDCFunc PMDPeriphOpenTCP(void* hPeriph, void* hDevice, PMDparam ipaddress, PMDparam portnum, PMDparam timeout);
+PMDCFunc PMDPeriphClose(void* hPeriph);
+PMDCFunc PMDRPDeviceOpen(void* hDevice, void* hPeriph);
+PMDCFunc PMDDeviceClose(void* hDevice);
+PMDCFunc PMDDeviceStoreUserCode(void* hDevice, char* pdata, int length);
+PMDCFunc PMDGetUserCodeFileName(void* hDevice, char* filename);
+PMDCFunc PMDGetUserCodeFileVersion(void* hDevice, PMDuint32* version);
+PMDCFunc PMDGetUserCodeFileDate(void* hDevice, char* date);
+PMDCFunc PMDTaskStart(void* hDevice);
+PMDCFunc PMDTaskStop(void* hDevice);
+PMDCFunc PMDTaskGetState(void* hDevice, int* state);
+PMDCFunc PMDMemoryOpen(void* hMemory, void* hDevice, int datasize, int memorytype);
+PMDCFunc PMDMemoryRead(void* hMemory, void* data, PMDuint32 offset, PMDuint32 length);
+PMDCFunc PMDMemoryWrite(void* hMemory, void* data, PMDuint32 offset, PMDuint32 length);
+PMDCFunc PMDMemoryClose(void* hMemory);
+PMDCFunc PMDWaitForEvent(void* hDevice, PMDEvent* event, PMDuint32 timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+static inline void* PMDPeriphAlloc(void) { return 0; }
+static inline void* PMDDeviceAlloc(void) { return 0; }
+static inline void* PMDMemoryAlloc(void) { return 0; }
+static inline void PMDPeriphFree(void* h) { (void)h; }
+static inline void PMDDeviceFree(void* h) { (void)h; }
+static inline void PMDMemoryFree(void* h) { (void)h; }
+static inline PMDresult PMDPeriphOpenCOM(void* p, void* d, PMDparam n, PMDparam b, PMDparam y, PMDparam s) { (void)p; (void)d; (void)n; (void)b; (void)y; (void)s; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDPeriphOpenTCP(void* p, void* d, PMDparam a, PMDparam n, PMDparam t) { (void)p; (void)d; (void)a; (void)n; (void)t; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDPeriphClose(void* p) { (void)p; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDRPDeviceOpen(void* d, void* p) { (void)d; (void)p; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDDeviceClose(void* d) { (void)d; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDDeviceStoreUserCode(void* d, char* c, int n) { (void)d; (void)c; (void)n; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDGetUserCodeFileName(void* d, char* s) { (void)d; (void)s; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDGetUserCodeFileVersion(void* d, PMDuint32* v) { (void)d; (void)v; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDGetUserCodeFileDate(void* d, char* s) { (void)d; (void)s; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDTaskStart(void* d) { (void)d; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDTaskStop(void* d) { (void)d; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDTaskGetState(void* d, int* s) { (void)d; (void)s; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDMemoryOpen(void* m, void* d, int z, int t) { (void)m; (void)d; (void)z; (void)t; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDMemoryRead(void* m, void* p, PMDuint32 o, PMDuint32 n) { (void)m; (void)p; (void)o; (void)n; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDMemoryWrite(void* m, void* p, PMDuint32 o, PMDuint32 n) { (void)m; (void)p; (void)o; (void)n; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDMemoryClose(void* m) { (void)m; return PMD_ERR_InvalidOperation; }
+static inline PMDresult PMDWaitForEvent(void* d, PMDEvent* e, PMDuint32 t) { (void)d; (void)e; (void)t; return PMD_ERR_InvalidOperation; }
+
+#endif	// #ifdef CMO_DEVICE_DLL
+
+#endif	// #ifndef INC_CMoDeviceApi_h__
@@ -0,0 +1,228 @@
+/*
+ * CMoLoad.cpp --
+ *
+ *	Wire utilisation and admission for periodic polls.  See CMoLoad.hpp.
+ */
+
+#include "CMoLoad.hpp"
+#include "CMoCan.h"
+#include "CMoOpcodes.hpp"
+#include "c-motion/PMDW32Ser.h"
+#include <mutex>
+
+// The wire behind a handle.  The counting is the transport's; the
+// ceiling, the bookings and their counts are changed here, under mutex.
+struct Wire
+{
+    PMDuint32 bitRate;
+    PMDuint32 bitsPerSecond;
+    PMDuint32 packetBits[2];	// command and reply framing, then per word
+    PMDuint32* ceiling;
+    PMDuint32* pollBits;
+    PMDuint32* admitted;
+    PMDuint32* downrated;
+    PMDuint32* refused;
+};
+
+// A plain mutex rather than Tcl's: nothing here needs an interpreter, and
+// tests/CMoLoadTest runs it without one.
+static std::mutex mutex;
+
+template <class Load>
+static void
+Bind(Wire* wire, Load* load)
+{
+    wire->ceiling = &load->ceiling;
+    wire->pollBits = &load->pollBits;
+    wire->admitted = &load->admitted;
+    wire->downrated = &load->downrated;
+    wire->refused = &load->refused;
+}
+
+static bool
+Find(PMDAxisHandle* handle, Wire* wire)
+{
+    PMDSerialIOData* sio;
+    CMoCanLoad* can;
+    PMDuint32 bits;
+
+    if (handle->transport.SendCommand == PMDSerial_Send ||
+	handle->transport.SendCommand == CMoReactor_SendCommand)
+    {
+	sio = (PMDSerialIOData*)handle->transport_data;
+	bits = PMDSerial_BitsPerByte(sio);
+	wire->bitRate = sio->baud;
+	wire->bitsPerSecond = PMDSerial_BytesPerSecond(sio) * bits;
+	// Address, checksum and command word out; status and checksum
+	// back, after the drive's address with idle line multidrop.
+	wire->packetBits[0] = (4 + 2 + (sio->protocol ==
+	    PMDSerialProtocolMultiDropUsingIdleLineDetection ? 1 : 0)) * bits;
+	wire->packetBits[1] = 2 * bits;
+	Bind(wire, &sio->load);
+	return true;
+    }
+    if (handle->transport.SendCommand == CMoCan_SendCommand &&
+	(can = CMoCan_Load(handle->transport_data)) != 0L)
+    {
+	wire->bitRate = can->bitRate;
+	wire->bitsPerSecond = CMoCan_BitsPerSecond(handle->transport_data);
+	// One frame each way: packetBits[1] isn't used.
+	wire->packetBits[0] = wire->packetBits[1] = 0;
+	Bind(wire, can);
+	return true;
+    }
+    return false;
+}
+
+static PMDuint32
+Bits(PMDAxisHandle* handle, const Wire* wire, PMDuint8 opcode)
+{
+    const CMoOpcode& op = CMoOpcodes[opcode];
+
+    if (handle->transport.SendCommand == CMoCan_SendCommand)
+    {
+	return CMO_CAN_FRAME_BITS(2 * (1 + op.xWords)) +
+	    CMO_CAN_FRAME_BITS(2 + 2 * op.rWords);
+    }
+    return wire->packetBits[0] + (op.xWords + op.rWords) * wire->packetBits[1];
+}
+
+bool
+CMoLoad::GetStats(PMDAxisHandle* handle, Stats* stats)
+{
+    Wire wire;
+
+    if (!Find(handle, &wire))
+    {
+	return false;
+    }
+    stats->bitRate = wire.bitRate;
+    stats->bitsPerSecond = wire.bitsPerSecond;
+    mutex.lock();
+    stats->pollBits = *wire.pollBits;
+    stats->ceiling = *wire.ceiling;
+    stats->admitted = *wire.admitted;
+    stats->downrated = *wire.downrated;
+    stats->refused = *wire.refused;
+    mutex.unlock();
+    return true;
+}
+
+PMDuint32
+CMoLoad::PacketBits(PMDAxisHandle* handle, PMDuint8 opcode)
+{
+    Wire wire;
+
+    return Find(handle, &wire) ? Bits(handle, &wire, opcode) : 0;
+}
+
+bool
+CMoLoad::Admit(PMDAxisHandle* handle, PMDuint8 opcode, PMDuint32* periodMs,
+	Booking* booking)
+{
+    return Admit(handle, &opcode, 1, periodMs, booking);
+}
+
+bool
+CMoLoad::Admit(PMDAxisHandle* handle, const PMDuint8* opcodes, int count,
+	PMDuint32* periodMs, Booking* booking)
+{
+    Wire wire;
+    PMDuint32 bits = 0;
+    unsigned long long limit, used, cost;
+    bool admitted = true;
+    int i;
+
+    booking->pollBits = 0L;
+    booking->bits = 0;
+    if (!Find(handle, &wire))
+    {
+	return true;
+    }
+    for (i = 0; i < count; i++)
+    {
+	bits += Bits(handle, &wire, opcodes[i]);
+    }
+    if (*periodMs == 0)
+    {
+	*periodMs = 1;
+    }
+
+    mutex.lock();
+    cost = ((unsigned long long)bits * 1000 + *periodMs - 1) / *periodMs;
+    if (*wire.ceiling != 0 && wire.bitRate != 0)
+    {
+	limit = (unsigned long long)wire.bitRate * *wire.ceiling / 100;
+	used = wire.bitsPerSecond > *wire.pollBits ?
+	    wire.bitsPerSecond : *wire.pollBits;
+	if (used >= limit)
+	{
+	    admitted = false;
+	}
+	else if (used + cost > limit)
+	{
+	    // The shortest period whose bits still fit.
+	    *periodMs = (PMDuint32)(((unsigned long long)bits * 1000 +
+		(limit - used) - 1) / (limit - used));
+	    cost = ((unsigned long long)bits * 1000 + *periodMs - 1) / *periodMs;
+	    (*wire.downrated)++;
+	}
+    }
+    if (admitted)
+    {
+	booking->pollBits = wire.pollBits;
+	booking->bits = (PMDuint32)cost;
+	*wire.pollBits += booking->bits;
+	(*wire.admitted)++;
+    }
+    else
+    {
+	(*wire.refused)++;
+    }
+    mutex.unlock();
+    return admitted;
+}
+
+void
+CMoLoad::Release(Booking* booking)
+{
+    if (booking->pollBits == 0L)
+    {
+	return;
+    }
+    mutex.lock();
+    *booking->pollBits -= booking->bits;
+    mutex.unlock();
+    booking->pollBits = 0L;
+}
+
+bool
+CMoLoad::SetCeiling(PMDAxisHandle* handle, PMDuint32 percent)
+{
+    Wire wire;
+
+    if (!Find(handle, &wire))
+    {
+	return false;
+    }
+    mutex.lock();
+    *wire.ceiling = percent;
+    mutex.unlock();
+    return true;
+}
+
+bool
+CMoLoad::SetBitRate(PMDAxisHandle* handle, PMDuint32 bitRate)
+{
+    CMoCanLoad* can;
+
+    if (handle->transport.SendCommand != CMoCan_SendCommand ||
+	(can = CMoCan_Load(handle->transport_data)) == 0L)
+    {
+	return false;
+    }
+    mutex.lock();
+    can->bitRate = bitRate;
+    mutex.unlock();
+    return true;
+}
@@ -0,0 +1,72 @@
+/*
+ * CMoLoad.hpp --
+ *
+ *	How busy a serial line or a CAN bus is, and admission for the
+ *	periodic polls that would make it busier.
+ *
+ * Each port counts what goes over its wire a second at a time: bytes on a
+ * serial line (PMDSerialLoad), frames on a CAN bus (CMoCanLoad).  With the
+ * configured rate, each byte's start, parity and stop bits and each
+ * frame's header, CRC and worst case stuffing, that is how much of the
+ * wire is in use, and a packet's opcode (CMoOpcodes.hpp) is enough to say
+ * what one more poll every so many ms would add.  [$axis BusLoad] shows
+ * both, and for a -plan of polls, what the wire would come to.
+ *
+ * A port can have a ceiling, a percentage of the wire ([SerialConfigure
+ * -loadceiling], [CanConfigure -loadceiling]).  A periodic poll
+ * ([WaitForEvent -interval]) books its bits a second for as long as it
+ * runs; one that would take the wire past the ceiling, counting what is
+ * measured or booked already, whichever is more, is let on at the
+ * shortest period that still fits, or refused when nothing is left.  A bus
+ * whose rate isn't known (a CAN bus not given -bitrate) and a network
+ * connection, which has no wire of its own to fill, are never refused.
+ */
+#ifndef INC_CMoLoad_hpp__
+#define INC_CMoLoad_hpp__
+
+#include "CMoTransport.h"
+
+class CMoLoad
+{
+public:
+    struct Stats
+    {
+	PMDuint32 bitRate;	// of the wire, 0 when not known
+	PMDuint32 bitsPerSecond;	// in the last whole second
+	PMDuint32 pollBits;	// a second, booked by the polls running
+	PMDuint32 ceiling;	// percent, 0 for none
+	PMDuint32 admitted;
+	PMDuint32 downrated;
+	PMDuint32 refused;
+    };
+
+    // What a poll holds on the wire while it runs.
+    struct Booking
+    {
+	PMDuint32* pollBits;	// 0L for nothing booked
+	PMDuint32 bits;
+    };
+
+    // False for a transport without a wire of its own.
+    static bool GetStats(PMDAxisHandle* handle, Stats* stats);
+
+    // Bits on the wire for one packet with opcode and its reply, 0 when
+    // the transport has no wire.
+    static PMDuint32 PacketBits(PMDAxisHandle* handle, PMDuint8 opcode);
+
+    // Whether a poll with opcode every *periodMs may go on the wire,
+    // lengthening *periodMs to fit under the ceiling.  The booking is let
+    // go with Release, before the port can go away.
+    static bool Admit(PMDAxisHandle* handle, PMDuint8 opcode,
+	    PMDuint32* periodMs, Booking* booking);
+    // The same for a poll of several packets at once.
+    static bool Admit(PMDAxisHandle* handle, const PMDuint8* opcodes,
+	    int count, PMDuint32* periodMs, Booking* booking);
+    static void Release(Booking* booking);
+
+    // False for a transport they don't apply to.
+    static bool SetCeiling(PMDAxisHandle* handle, PMDuint32 percent);
+    static bool SetBitRate(PMDAxisHandle* handle, PMDuint32 bitRate);
+};
+
+#endif	// #ifndef INC_CMoLoad_hpp__
@@ -0,0 +1,127 @@
+/*
+ * CMoMemory.cpp --
+ *
+ *	Block transfers to and from device memory.  See CMoMemory.hpp.
+ */
+
+#include "CMoMemory.hpp"
+#include "CMoOpcodes.hpp"
+#include "CMoReconnect.hpp"
+#include "CMoRetry.hpp"
+#include <vector>
+
+static inline PMDuint16
+Command(PMDAxisHandle* handle, PMDuint8 op)
+{
+    return (PMDuint16)((handle->axis << 8) | op);
+}
+
+// The index frame that starts a block, then one frame per word.
+static void
+Frames(PMDAxisHandle* handle, std::vector<CMoFrame>& frames, bool write,
+    PMDuint16 buffer, PMDuint32 offset, const PMDuint32* data, PMDuint32 count)
+{
+    PMDuint32 i;
+
+    frames.resize(count + 1);
+    frames[0].xCt = 4;
+    frames[0].rCt = 0;
+    frames[0].xDat[0] = Command(handle,
+	write ? CMoOp::SetBufferWriteIndex : CMoOp::SetBufferReadIndex);
+    frames[0].xDat[1] = buffer;
+    frames[0].xDat[2] = (PMDuint16)(offset >> 16);
+    frames[0].xDat[3] = (PMDuint16)(offset & 0xFFFF);
+    for (i = 1; i <= count; i++)
+    {
+	CMoFrame& frame = frames[i];
+
+	frame.xDat[0] = Command(handle, write ? CMoOp::WriteBuffer : CMoOp::ReadBuffer);
+	frame.xDat[1] = buffer;
+	if (write)
+	{
+	    frame.xCt = 4;
+	    frame.rCt = 0;
+	    frame.xDat[2] = (PMDuint16)(data[i - 1] >> 16);
+	    frame.xDat[3] = (PMDuint16)(data[i - 1] & 0xFFFF);
+	}
+	else
+	{
+	    frame.xCt = 2;
+	    frame.rCt = 2;
+	}
+    }
+}
+
+// Move one block through a buffer, going again from the first word that
+// failed for as long as the port's policy lets it.
+static PMDresult
+Buffer(PMDAxisHandle* handle, bool write, PMDuint16 buffer, PMDuint32 offset,
+    PMDuint32* data, PMDuint32 count)
+{
+    std::vector<CMoFrame> frames;
+    PMDuint32 done = 0, attempt, i;
+    PMDresult result = PMD_ERR_OK;
+
+    for (attempt = 1; done < count; attempt++)
+    {
+	Frames(handle, frames, write, buffer, offset + done, data + done, count - done);
+	CMoTransport_SendFrames(handle, &frames[0], (int)frames.size());
+
+	result = frames[0].result;
+	for (i = 1; result == PMD_ERR_OK && i < frames.size(); i++)
+	{
+	    if ((result = frames[i].result) == PMD_ERR_OK && !write)
+	    {
+		data[done + i - 1] =
+		    ((PMDuint32)frames[i].rDat[0] << 16) | frames[i].rDat[1];
+	    }
+	}
+	if (result == PMD_ERR_OK)
+	{
+	    break;
+	}
+
+	// i - 2 words made it before the one that failed, if the index did.
+	if (frames[0].result == PMD_ERR_OK)
+	{
+	    done += i - 2;
+	}
+	if (!CMoRetry::Resume(handle, result, attempt))
+	{
+	    break;
+	}
+    }
+    return result;
+}
+
+PMDresult
+CMoMemory::Read(PMDAxisHandle* handle, int region, PMDuint32 offset,
+    PMDuint32* data, PMDuint32 count)
+{
+    if (region == DPRAM)
+    {
+	if (!handle->transport.bHasDPRAM || handle->transport.ReadDPRAM == 0L)
+	{
+	    return PMD_ERR_NoDPRAM;
+	}
+	return handle->transport.ReadDPRAM(handle->transport_data, data,
+	    offset, count);
+    }
+    return Buffer(handle, false, (PMDuint16)region, offset, data, count);
+}
+
+PMDresult
+CMoMemory::Write(PMDAxisHandle* handle, int region, PMDuint32 offset,
+    const PMDuint32* data, PMDuint32 count)
+{
+    if (region == DPRAM)
+    {
+	if (!handle->transport.bHasDPRAM || handle->transport.WriteDPRAM == 0L)
+	{
+	    return PMD_ERR_NoDPRAM;
+	}
+	return handle->transport.WriteDPRAM(handle->transport_data,
+	    (PMDuint32*)data, offset, count);
+    }
+    return Buffer(handle, true, (PMDuint16)region, offset, (PMDuint32*)data, count);
+}
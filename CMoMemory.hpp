@@ -0,0 +1,44 @@
+/*
+ * CMoMemory.hpp --
+ *
+ *	Moving blocks of 32 bit words to and from device memory, behind
+ *	[ReadMemory] and [WriteMemory].
+ *
+ * A region is either one of the chip's external memory buffers or the
+ * dual port RAM of a transport that has one.  Dual port RAM goes through
+ * the transport's own ReadDPRAM and WriteDPRAM a block at a time.  A
+ * buffer goes through the chip: a SetBufferReadIndex (or WriteIndex) and
+ * then one ReadBuffer (or WriteBuffer) per word, as pipelined frames, so
+ * a serial port or a network connection carries thousands of them per
+ * round trip.
+ *
+ * Each block says where it starts, so after a transient error or a lost
+ * port the transfer picks up at the first word that didn't make it, as
+ * often as the retry policy of the serial port, network connection or CAN
+ * node allows (-attempts, see CMoRetry.hpp), instead of failing the lot.
+ *
+ * C-Motion.dll's PMDMemoryRead and PMDMemoryWrite take a device handle,
+ * not an axis, so they are behind pmd::device's methods of the same name
+ * (CMoDevice.hpp) rather than these.
+ */
+#ifndef INC_CMoMemory_hpp__
+#define INC_CMoMemory_hpp__
+
+#include "CMoTransport.h"
+
+class CMoMemory
+{
+public:
+    // region is a buffer ID, or this for dual port RAM.
+    enum {DPRAM = -1};
+
+    // Words per block; a longer transfer is a run of these.
+    enum {BLOCK = 4096};
+
+    static PMDresult Read(PMDAxisHandle* handle, int region, PMDuint32 offset,
+	    PMDuint32* data, PMDuint32 count);
+    static PMDresult Write(PMDAxisHandle* handle, int region, PMDuint32 offset,
+	    const PMDuint32* data, PMDuint32 count);
+};
+
+#endif	// #ifndef INC_CMoMemory_hpp__
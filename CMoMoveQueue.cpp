@@ -0,0 +1,275 @@
+/*
+ * CMoMoveQueue.cpp --
+ *
+ *	Breakpoint chained move queue.  See CMoMoveQueue.hpp for the idea.
+ */
+
+#include "CMoMoveQueue.hpp"
+#include "c-motion/PMDdiag.h"
+
+CMoMoveQueue::CMoMoveQueue(PMDAxisHandle* _hAxis)
+    : hAxis(_hAxis), interp(0L), command(0L), timer(0L), interval(5),
+    running(false), armed(false), lastTarget(0), completed(0)
+{
+}
+
+CMoMoveQueue::~CMoMoveQueue()
+{
+    if (timer != 0L) Tcl_DeleteTimerHandler(timer);
+    if (command != 0L) Tcl_DecrRefCount(command);
+}
+
+void
+CMoMoveQueue::Add(const Segment& seg)
+{
+    pending.push_back(seg);
+}
+
+// Write a segment into the double buffered profile registers.  Nothing
+// moves until an Update or a breakpoint with the update action.
+PMDresult
+CMoMoveQueue::Load(const Segment& seg)
+{
+    PMDresult result;
+
+    if (PMD_NOERROR != (result = ::PMDSetPosition(hAxis, seg.position)) ||
+	PMD_NOERROR != (result = ::PMDSetVelocity(hAxis, seg.velocity)) ||
+	PMD_NOERROR != (result = ::PMDSetAcceleration(hAxis, seg.acceleration)) ||
+	PMD_NOERROR != (result = ::PMDSetDeceleration(hAxis, seg.deceleration)))
+    {
+	return result;
+    }
+    if (seg.jerk != 0)
+    {
+	return ::PMDSetJerk(hAxis, seg.jerk);
+    }
+    return PMD_NOERROR;
+}
+
+// Preload the next segment and arm breakpoint 1 to swap it in.
+PMDresult
+CMoMoveQueue::ArmNext()
+{
+    PMDresult result;
+    Segment seg;
+
+    if (pending.empty())
+    {
+	armed = false;
+	return PMD_NOERROR;
+    }
+    seg = pending.front();
+
+    if (seg.chained)
+    {
+	// Start the moment the commanded position reaches the target of
+	// the segment that is running now.  The chip turns "crossed" into
+	// the right >= or <= comparison for the direction of travel.
+	seg.trigger = PMDBreakpointTriggerCommandedPositionCrossed;
+	seg.value = lastTarget;
+    }
+
+    // Clear a stale breakpoint event so only this arming is seen.  Bits
+    // that are 0 in the mask are the ones reset.
+    if (PMD_NOERROR != (result = ::PMDResetEventStatus(hAxis,
+	    static_cast<PMDuint16>(~PMDEventStatusBreakpoint1))) ||
+	PMD_NOERROR != (result = Load(seg)) ||
+	// the manual insists the value is loaded before the trigger
+	PMD_NOERROR != (result = ::PMDSetBreakpointValue(hAxis,
+	    PMDBreakpoint1, seg.value)) ||
+	PMD_NOERROR != (result = ::PMDSetBreakpointUpdateMask(hAxis,
+	    PMDBreakpoint1, PMDUpdateMaskTrajectory)) ||
+	PMD_NOERROR != (result = ::PMDSetBreakpoint(hAxis, PMDBreakpoint1,
+	    hAxis->axis, PMDBreakpointActionUpdate, seg.trigger)))
+    {
+	return result;
+    }
+
+    pending.pop_front();
+    lastTarget = seg.position;
+    armed = true;
+    return PMD_NOERROR;
+}
+
+PMDresult
+CMoMoveQueue::Start(Tcl_Interp* _interp, int _interval, Tcl_Obj* _command)
+{
+    PMDresult result;
+    Segment seg;
+
+    if (running || pending.empty())
+    {
+	return PMD_ERR_InvalidOperation;
+    }
+
+    interp = _interp;
+    interval = _interval;
+    if (command != 0L) Tcl_DecrRefCount(command);
+    command = _command;
+    if (command != 0L) Tcl_IncrRefCount(command);
+
+    // The first segment starts right now with a plain update.
+    seg = pending.front();
+    if (PMD_NOERROR != (result = ::PMDSetBreakpoint(hAxis, PMDBreakpoint1,
+	    hAxis->axis, PMDBreakpointActionNone, PMDBreakpointTriggerDisable)) ||
+	PMD_NOERROR != (result = Load(seg)) ||
+	PMD_NOERROR != (result = ::PMDUpdate(hAxis)))
+    {
+	return result;
+    }
+    pending.pop_front();
+    lastTarget = seg.position;
+    completed = 0;
+    running = true;
+
+    if (PMD_NOERROR != (result = ArmNext()))
+    {
+	running = false;
+	return result;
+    }
+
+    if (interval > 0)
+    {
+	timer = Tcl_CreateTimerHandler(interval, Tick, this);
+    }
+    return PMD_NOERROR;
+}
+
+PMDresult
+CMoMoveQueue::Stop()
+{
+    if (timer != 0L)
+    {
+	Tcl_DeleteTimerHandler(timer);
+	timer = 0L;
+    }
+    pending.clear();
+    running = false;
+
+    // Disarm so a preloaded segment can't start behind our back.  The
+    // segment already running is left alone, use SetStopMode for that.
+    if (armed)
+    {
+	armed = false;
+	return ::PMDSetBreakpoint(hAxis, PMDBreakpoint1, hAxis->axis,
+	    PMDBreakpointActionNone, PMDBreakpointTriggerDisable);
+    }
+    return PMD_NOERROR;
+}
+
+// Check if the armed breakpoint fired and refill one segment ahead.
+PMDresult
+CMoMoveQueue::Service()
+{
+    PMDresult result;
+    PMDuint16 status;
+
+    if (!running)
+    {
+	return PMD_NOERROR;
+    }
+
+    if (!armed)
+    {
+	// The last segment is on the chip; nothing left for us to do.
+	running = false;
+	return PMD_NOERROR;
+    }
+
+    if (PMD_NOERROR != (result = ::PMDGetEventStatus(hAxis, &status)))
+    {
+	return result;
+    }
+
+    if (status & PMDEventStatusBreakpoint1)
+    {
+	completed++;
+	return ArmNext();
+    }
+    return PMD_NOERROR;
+}
+
+Tcl_Obj*
+CMoMoveQueue::Status()
+{
+    Tcl_Obj* status = Tcl_NewListObj(0, 0L);
+
+    Tcl_ListObjAppendElement(0L, status, Tcl_NewStringObj("running", -1));
+    Tcl_ListObjAppendElement(0L, status, Tcl_NewBooleanObj(running));
+    Tcl_ListObjAppendElement(0L, status, Tcl_NewStringObj("armed", -1));
+    Tcl_ListObjAppendElement(0L, status, Tcl_NewBooleanObj(armed));
+    Tcl_ListObjAppendElement(0L, status, Tcl_NewStringObj("pending", -1));
+    Tcl_ListObjAppendElement(0L, status,
+	Tcl_NewIntObj(static_cast<int>(pending.size())));
+    Tcl_ListObjAppendElement(0L, status, Tcl_NewStringObj("advanced", -1));
+    Tcl_ListObjAppendElement(0L, status, Tcl_NewLongObj(completed));
+    return status;
+}
+
+void
+CMoMoveQueue::Tick(ClientData clientData)
+{
+    CMoMoveQueue* queue = static_cast<CMoMoveQueue*>(clientData);
+    unsigned long before = queue->completed;
+    bool wasRunning = queue->running;
+    Tcl_Interp* interp = queue->interp;
+    Tcl_Obj* cmd = 0L;
+    PMDresult result;
+
+    queue->timer = 0L;
+    result = queue->Service();
+    if (result != PMD_NOERROR)
+    {
+	queue->Stop();
+    }
+    else if (queue->running)
+    {
+	queue->timer = Tcl_CreateTimerHandler(queue->interval, Tick, queue);
+    }
+
+    // Build the callback now.  Once it runs the script is free to delete
+    // the axis, and us with it, so don't touch 'queue' after that.
+    if (queue->command != 0L)
+    {
+	cmd = Tcl_DuplicateObj(queue->command);
+	Tcl_IncrRefCount(cmd);
+	if (result != PMD_NOERROR)
+	{
+	    Tcl_ListObjAppendElement(0L, cmd, Tcl_NewStringObj("error", -1));
+	    Tcl_ListObjAppendElement(0L, cmd,
+		Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	}
+	else if (queue->completed != before)
+	{
+	    Tcl_ListObjAppendElement(0L, cmd, Tcl_NewStringObj("advance", -1));
+	    Tcl_ListObjAppendElement(0L, cmd, Tcl_NewLongObj(queue->completed));
+	}
+	else if (wasRunning && !queue->running)
+	{
+	    Tcl_ListObjAppendElement(0L, cmd, Tcl_NewStringObj("drained", -1));
+	    Tcl_ListObjAppendElement(0L, cmd, Tcl_NewLongObj(queue->completed));
+	}
+	else
+	{
+	    Tcl_DecrRefCount(cmd);
+	    cmd = 0L;
+	}
+    }
+
+    if (cmd != 0L)
+    {
+	Tcl_Preserve(interp);
+	if (TCL_OK != Tcl_EvalObjEx(interp, cmd, TCL_EVAL_GLOBAL))
+	{
+	    Tcl_BackgroundError(interp);
+	}
+	Tcl_Release(interp);
+	Tcl_DecrRefCount(cmd);
+    }
+    else if (result != PMD_NOERROR)
+    {
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(::PMDGetErrorMessage(result), -1));
+	Tcl_BackgroundError(interp);
+    }
+}
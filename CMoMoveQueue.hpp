@@ -0,0 +1,62 @@
+/*
+ * CMoMoveQueue.hpp --
+ *
+ *	A queue of profile segments that are chained on the chip itself.
+ *
+ * The Magellan profile registers are double buffered.  While one segment
+ * runs, the next segment's position, velocity, acceleration, deceleration
+ * and jerk are written to the buffered registers and breakpoint 1 is armed
+ * with the "update" action.  When the trigger condition occurs the chip
+ * swaps the buffers in on that exact servo cycle, so there is no host
+ * round trip between segments.  The host only has to notice the breakpoint
+ * fired and refill one segment ahead before the next one is due.
+ */
+#ifndef INC_CMoMoveQueue_hpp__
+#define INC_CMoMoveQueue_hpp__
+
+#include "tcl.h"
+#include "c-motion/c-motion.h"
+#include <deque>
+
+class CMoMoveQueue
+{
+public:
+    struct Segment
+    {
+	PMDint32 position;
+	PMDint32 velocity;	    // already scaled by 2^16
+	PMDuint32 acceleration;	    // already scaled by 2^16
+	PMDuint32 deceleration;	    // already scaled by 2^16
+	PMDuint32 jerk;		    // already scaled by 2^32, 0 for none
+	PMDuint8 trigger;	    // PMDBreakpointTrigger that starts this segment
+	PMDint32 value;		    // breakpoint value for the trigger
+	bool chained;		    // start when the previous target is crossed
+    };
+
+    CMoMoveQueue(PMDAxisHandle* hAxis);
+    ~CMoMoveQueue();
+
+    void Add(const Segment& seg);
+    PMDresult Start(Tcl_Interp* interp, int interval, Tcl_Obj* command);
+    PMDresult Stop();
+    PMDresult Service();
+    Tcl_Obj* Status();
+
+private:
+    PMDresult Load(const Segment& seg);
+    PMDresult ArmNext();
+    static Tcl_TimerProc Tick;
+
+    PMDAxisHandle* hAxis;
+    std::deque<Segment> pending;
+    Tcl_Interp* interp;
+    Tcl_Obj* command;
+    Tcl_TimerToken timer;
+    int interval;
+    bool running;
+    bool armed;
+    PMDint32 lastTarget;
+    unsigned long completed;
+};
+
+#endif	// #ifndef INC_CMoMoveQueue_hpp__
@@ -0,0 +1,1231 @@
+/*
+ * CMoNative.cpp --
+ *
+ *	An open implementation of the C-Motion API declared in c-motion.h.
+ *
+ * C-Motion.dll is a thin layer over the transport: each call packs its
+ * arguments into 16 bit words, hands one packet to the axis' SendCommand
+ * and unpacks the reply.  Doing that here removes the only thing that
+ * tied the extension to Windows and lets the compiler see (and inline)
+ * the encode path.  The PMDtrans.h SendCommand* primitives are defined
+ * first; every API call goes through one of them by way of a small
+ * template that checks the packet shape against CMoOpcodes.hpp when it is
+ * compiled.
+ *
+ * This file is used everywhere but Windows.  A Windows build can use it
+ * instead of the DLL by defining CMO_NATIVE_CMOTION.
+ */
+
+#if !defined(_WIN32) || defined(CMO_NATIVE_CMOTION)
+
+#include <stdint.h>
+#include <string.h>
+#include "CMoOpcodes.hpp"
+#include "c-motion/c-motion.h"
+#include "c-motion/PMDdiag.h"
+#include "CMoPrefetch.hpp"
+#include "CMoRetry.hpp"
+#include "CMoReconnect.hpp"
+#include "CMoReplyStamp.h"
+
+// ------------------------------------------------------------------------
+// PMDtrans.h
+// ------------------------------------------------------------------------
+
+static inline PMDresult
+Transact(PMDAxisInterface axis_intf, PMDuint16 OPCode, PMDuint8 xCt,
+    PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat)
+{
+    PMDresult result;
+
+    // The reactor, a CAN bus and the prefetcher stamp the reply they
+    // used, which may be older than the command; for the rest it is now.
+    CMoReplyStamp_Set(0);
+    xDat[0] = BuildCommand(OPCode, axis_intf->axis);
+    if (!CMoPrefetch::Answer(axis_intf, xCt, xDat, rCt, rDat, &result))
+    {
+	result = axis_intf->transport.SendCommand(axis_intf->transport_data,
+	    xCt, xDat, rCt, rDat);
+    }
+    if (CMoRetry::Transient(result) || CMoReconnect::Lost(result))
+    {
+	CMoReplyStamp_Set(0);
+	result = CMoRetry::Again(axis_intf, result, xCt, xDat, rCt, rDat);
+    }
+    if (result == PMD_NOERROR)
+    {
+	CMoReconnect::Record(axis_intf, xCt, xDat);
+	if (CMoReplyStamp_Get() == 0)
+	{
+	    CMoReplyStamp_Set(CMoReplyStamp_Now());
+	}
+    }
+    else
+    {
+	CMoReplyStamp_Set(0);
+    }
+    return result;
+}
+
+static inline PMDuint16 High(PMDuint32 v) { return (PMDuint16)((v >> 16) & 0xFFFF); }
+static inline PMDuint16 Low(PMDuint32 v) { return (PMDuint16)(v & 0xFFFF); }
+
+static inline PMDuint32
+Join(PMDuint16 high, PMDuint16 low)
+{
+    return ((PMDuint32)high << 16) | low;
+}
+
+extern "C" {
+
+PMDuint16
+BuildCommand(PMDuint16 OPCode, PMDAxis axis)
+{
+    return (PMDuint16)((axis << 8) | (OPCode & 0xFF));
+}
+
+PMDresult
+SendCommand(PMDAxisInterface axis_intf, PMDuint16 OPCode)
+{
+    PMDuint16 x[1];
+
+    return Transact(axis_intf, OPCode, 1, x, 0, 0L);
+}
+
+PMDresult
+SendCommandWord(PMDAxisInterface axis_intf, PMDuint16 OPCode, PMDuint16 data1)
+{
+    PMDuint16 x[2] = {0, data1};
+
+    return Transact(axis_intf, OPCode, 2, x, 0, 0L);
+}
+
+PMDresult
+SendCommandWordWord(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint16 data1, PMDuint16 data2)
+{
+    PMDuint16 x[3] = {0, data1, data2};
+
+    return Transact(axis_intf, OPCode, 3, x, 0, 0L);
+}
+
+PMDresult
+SendCommandWordWordWord(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint16 data1, PMDuint16 data2, PMDuint16 data3)
+{
+    PMDuint16 x[4] = {0, data1, data2, data3};
+
+    return Transact(axis_intf, OPCode, 4, x, 0, 0L);
+}
+
+PMDresult
+SendCommandLong(PMDAxisInterface axis_intf, PMDuint16 OPCode, PMDuint32 data1)
+{
+    PMDuint16 x[3] = {0, High(data1), Low(data1)};
+
+    return Transact(axis_intf, OPCode, 3, x, 0, 0L);
+}
+
+PMDresult
+SendCommandLongWord(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint32 data1, PMDuint16 data2)
+{
+    PMDuint16 x[4] = {0, High(data1), Low(data1), data2};
+
+    return Transact(axis_intf, OPCode, 4, x, 0, 0L);
+}
+
+PMDresult
+SendCommandWordLong(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint16 data1, PMDuint32 data2)
+{
+    PMDuint16 x[4] = {0, data1, High(data2), Low(data2)};
+
+    return Transact(axis_intf, OPCode, 4, x, 0, 0L);
+}
+
+PMDresult
+SendCommandGetWord(PMDAxisInterface axis_intf, PMDuint16 OPCode, PMDuint16* data1)
+{
+    PMDuint16 x[1];
+    PMDuint16 r[1] = {0};
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = Transact(axis_intf, OPCode, 1, x, 1, r)))
+    {
+	*data1 = r[0];
+    }
+    return result;
+}
+
+PMDresult
+SendCommandGetWordWord(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint16* data1, PMDuint16* data2)
+{
+    PMDuint16 x[1];
+    PMDuint16 r[2] = {0, 0};
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = Transact(axis_intf, OPCode, 1, x, 2, r)))
+    {
+	*data1 = r[0];
+	*data2 = r[1];
+    }
+    return result;
+}
+
+PMDresult
+SendCommandGetWordWordWord(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint16* data1, PMDuint16* data2, PMDuint16* data3)
+{
+    PMDuint16 x[1];
+    PMDuint16 r[3] = {0, 0, 0};
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = Transact(axis_intf, OPCode, 1, x, 3, r)))
+    {
+	*data1 = r[0];
+	*data2 = r[1];
+	*data3 = r[2];
+    }
+    return result;
+}
+
+PMDresult
+SendCommandGetLong(PMDAxisInterface axis_intf, PMDuint16 OPCode, PMDuint32* data1)
+{
+    PMDuint16 x[1];
+    PMDuint16 r[2] = {0, 0};
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = Transact(axis_intf, OPCode, 1, x, 2, r)))
+    {
+	*data1 = Join(r[0], r[1]);
+    }
+    return result;
+}
+
+PMDresult
+SendCommandGetWordLong(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint16* data1, PMDuint32* data2)
+{
+    PMDuint16 x[1];
+    PMDuint16 r[3] = {0, 0, 0};
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = Transact(axis_intf, OPCode, 1, x, 3, r)))
+    {
+	*data1 = r[0];
+	*data2 = Join(r[1], r[2]);
+    }
+    return result;
+}
+
+PMDresult
+SendCommandWordGetWord(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint16 data1, PMDuint16* data2)
+{
+    PMDuint16 x[2] = {0, data1};
+    PMDuint16 r[1] = {0};
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = Transact(axis_intf, OPCode, 2, x, 1, r)))
+    {
+	*data2 = r[0];
+    }
+    return result;
+}
+
+PMDresult
+SendCommandWordGetLong(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint16 data1, PMDuint32* data2)
+{
+    PMDuint16 x[2] = {0, data1};
+    PMDuint16 r[2] = {0, 0};
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = Transact(axis_intf, OPCode, 2, x, 2, r)))
+    {
+	*data2 = Join(r[0], r[1]);
+    }
+    return result;
+}
+
+PMDresult
+SendCommandLongGetWord(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint32 data1, PMDuint16* data2)
+{
+    PMDuint16 x[3] = {0, High(data1), Low(data1)};
+    PMDuint16 r[1] = {0};
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = Transact(axis_intf, OPCode, 3, x, 1, r)))
+    {
+	*data2 = r[0];
+    }
+    return result;
+}
+
+PMDresult
+SendCommandWordWordGetWord(PMDAxisInterface axis_intf, PMDuint16 OPCode,
+    PMDuint16 data1, PMDuint16 data2, PMDuint16* data3)
+{
+    PMDuint16 x[3] = {0, data1, data2};
+    PMDuint16 r[1] = {0};
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = Transact(axis_intf, OPCode, 3, x, 1, r)))
+    {
+	*data3 = r[0];
+    }
+    return result;
+}
+
+}   // extern "C"
+
+// ------------------------------------------------------------------------
+// Packet shapes.  Each one is a PMDtrans.h primitive bound to an opcode at
+// compile time, so a wrapper that sends the wrong number of words for its
+// opcode is a compile error rather than a hung serial line.
+// ------------------------------------------------------------------------
+
+#define CMO_SHAPE(x, r) \
+    static_assert(CMoOpcodeShape(Op, x, r), "packet does not match CMoOpcodes.hpp")
+
+// PMDint32 is a long, which is 64 bits on LP64 systems.  A 32 bit reply has
+// to be sign extended by hand there.
+static inline void Store(PMDint32* v, PMDuint32 u) { *v = (PMDint32)(int32_t)(uint32_t)u; }
+static inline void Store(PMDuint32* v, PMDuint32 u) { *v = u; }
+static inline void Store(PMDint16* v, PMDuint16 u) { *v = (PMDint16)u; }
+static inline void Store(PMDuint16* v, PMDuint16 u) { *v = u; }
+
+template <PMDuint8 Op>
+static inline PMDresult
+Send(PMDAxisInterface axis_intf)
+{
+    CMO_SHAPE(0, 0);
+    return SendCommand(axis_intf, Op);
+}
+
+template <PMDuint8 Op>
+static inline PMDresult
+SendWord(PMDAxisInterface axis_intf, PMDuint16 data1)
+{
+    CMO_SHAPE(1, 0);
+    return SendCommandWord(axis_intf, Op, data1);
+}
+
+template <PMDuint8 Op>
+static inline PMDresult
+SendWordWord(PMDAxisInterface axis_intf, PMDuint16 data1, PMDuint16 data2)
+{
+    CMO_SHAPE(2, 0);
+    return SendCommandWordWord(axis_intf, Op, data1, data2);
+}
+
+template <PMDuint8 Op>
+static inline PMDresult
+SendWordWordWord(PMDAxisInterface axis_intf, PMDuint16 data1, PMDuint16 data2,
+    PMDuint16 data3)
+{
+    CMO_SHAPE(3, 0);
+    return SendCommandWordWordWord(axis_intf, Op, data1, data2, data3);
+}
+
+template <PMDuint8 Op>
+static inline PMDresult
+SendLong(PMDAxisInterface axis_intf, PMDuint32 data1)
+{
+    CMO_SHAPE(2, 0);
+    return SendCommandLong(axis_intf, Op, data1);
+}
+
+template <PMDuint8 Op>
+static inline PMDresult
+SendWordLong(PMDAxisInterface axis_intf, PMDuint16 data1, PMDuint32 data2)
+{
+    CMO_SHAPE(3, 0);
+    return SendCommandWordLong(axis_intf, Op, data1, data2);
+}
+
+template <PMDuint8 Op, typename T>
+static inline PMDresult
+GetWord(PMDAxisInterface axis_intf, T* data1)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    CMO_SHAPE(0, 1);
+    if (PMD_NOERROR == (result = SendCommandGetWord(axis_intf, Op, &w)))
+    {
+	Store(data1, w);
+    }
+    return result;
+}
+
+template <PMDuint8 Op>
+static inline PMDresult
+GetWordWord(PMDAxisInterface axis_intf, PMDuint16* data1, PMDuint16* data2)
+{
+    CMO_SHAPE(0, 2);
+    return SendCommandGetWordWord(axis_intf, Op, data1, data2);
+}
+
+template <PMDuint8 Op>
+static inline PMDresult
+GetWordWordWord(PMDAxisInterface axis_intf, PMDuint16* data1, PMDuint16* data2,
+    PMDuint16* data3)
+{
+    CMO_SHAPE(0, 3);
+    return SendCommandGetWordWordWord(axis_intf, Op, data1, data2, data3);
+}
+
+template <PMDuint8 Op, typename T>
+static inline PMDresult
+GetLong(PMDAxisInterface axis_intf, T* data1)
+{
+    PMDuint32 l;
+    PMDresult result;
+
+    CMO_SHAPE(0, 2);
+    if (PMD_NOERROR == (result = SendCommandGetLong(axis_intf, Op, &l)))
+    {
+	Store(data1, l);
+    }
+    return result;
+}
+
+template <PMDuint8 Op, typename T>
+static inline PMDresult
+WordGetWord(PMDAxisInterface axis_intf, PMDuint16 data1, T* data2)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    CMO_SHAPE(1, 1);
+    if (PMD_NOERROR == (result = SendCommandWordGetWord(axis_intf, Op, data1, &w)))
+    {
+	Store(data2, w);
+    }
+    return result;
+}
+
+template <PMDuint8 Op, typename T>
+static inline PMDresult
+WordGetLong(PMDAxisInterface axis_intf, PMDuint16 data1, T* data2)
+{
+    PMDuint32 l;
+    PMDresult result;
+
+    CMO_SHAPE(1, 2);
+    if (PMD_NOERROR == (result = SendCommandWordGetLong(axis_intf, Op, data1, &l)))
+    {
+	Store(data2, l);
+    }
+    return result;
+}
+
+// ------------------------------------------------------------------------
+// c-motion.h
+// ------------------------------------------------------------------------
+
+extern "C" {
+
+PMDCFunc PMDGetCMotionVersion(PMDuint32* MajorVersion, PMDuint32* MinorVersion)
+{
+    *MajorVersion = CMOTION_MAJOR_VERSION;
+    *MinorVersion = CMOTION_MINOR_VERSION;
+    return PMD_NOERROR;
+}
+
+// Profile Generation
+PMDCFunc PMDSetProfileMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetProfileMode>(axis_intf, mode); }
+PMDCFunc PMDGetProfileMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetProfileMode>(axis_intf, mode); }
+PMDCFunc PMDSetPosition(PMDAxisInterface axis_intf, PMDint32 position)
+{ return SendLong<CMoOp::SetPosition>(axis_intf, (PMDuint32)position); }
+PMDCFunc PMDGetPosition(PMDAxisInterface axis_intf, PMDint32* position)
+{ return GetLong<CMoOp::GetPosition>(axis_intf, position); }
+PMDCFunc PMDSetVelocity(PMDAxisInterface axis_intf, PMDint32 velocity)
+{ return SendLong<CMoOp::SetVelocity>(axis_intf, (PMDuint32)velocity); }
+PMDCFunc PMDGetVelocity(PMDAxisInterface axis_intf, PMDint32* velocity)
+{ return GetLong<CMoOp::GetVelocity>(axis_intf, velocity); }
+PMDCFunc PMDSetStartVelocity(PMDAxisInterface axis_intf, PMDuint32 velocity)
+{ return SendLong<CMoOp::SetStartVelocity>(axis_intf, velocity); }
+PMDCFunc PMDGetStartVelocity(PMDAxisInterface axis_intf, PMDuint32* velocity)
+{ return GetLong<CMoOp::GetStartVelocity>(axis_intf, velocity); }
+PMDCFunc PMDSetAcceleration(PMDAxisInterface axis_intf, PMDuint32 acceleration)
+{ return SendLong<CMoOp::SetAcceleration>(axis_intf, acceleration); }
+PMDCFunc PMDGetAcceleration(PMDAxisInterface axis_intf, PMDuint32* acceleration)
+{ return GetLong<CMoOp::GetAcceleration>(axis_intf, acceleration); }
+PMDCFunc PMDSetDeceleration(PMDAxisInterface axis_intf, PMDuint32 deceleration)
+{ return SendLong<CMoOp::SetDeceleration>(axis_intf, deceleration); }
+PMDCFunc PMDGetDeceleration(PMDAxisInterface axis_intf, PMDuint32* deceleration)
+{ return GetLong<CMoOp::GetDeceleration>(axis_intf, deceleration); }
+PMDCFunc PMDSetJerk(PMDAxisInterface axis_intf, PMDuint32 jerk)
+{ return SendLong<CMoOp::SetJerk>(axis_intf, jerk); }
+PMDCFunc PMDGetJerk(PMDAxisInterface axis_intf, PMDuint32* jerk)
+{ return GetLong<CMoOp::GetJerk>(axis_intf, jerk); }
+PMDCFunc PMDSetGearRatio(PMDAxisInterface axis_intf, PMDint32 ratio)
+{ return SendLong<CMoOp::SetGearRatio>(axis_intf, (PMDuint32)ratio); }
+PMDCFunc PMDGetGearRatio(PMDAxisInterface axis_intf, PMDint32* ratio)
+{ return GetLong<CMoOp::GetGearRatio>(axis_intf, ratio); }
+
+PMDCFunc PMDSetGearMaster(PMDAxisInterface axis_intf, PMDAxis masterAxis, PMDuint16 source)
+{
+    return SendWord<CMoOp::SetGearMaster>(axis_intf,
+	(PMDuint16)(((source & nibbleMask) << 8) | (masterAxis & nibbleMask)));
+}
+
+PMDCFunc PMDGetGearMaster(PMDAxisInterface axis_intf, PMDAxis* masterAxis, PMDuint16* source)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = GetWord<CMoOp::GetGearMaster>(axis_intf, &w)))
+    {
+	*masterAxis = w & nibbleMask;
+	*source = (w >> 8) & nibbleMask;
+    }
+    return result;
+}
+
+PMDCFunc PMDSetStopMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetStopMode>(axis_intf, mode); }
+PMDCFunc PMDGetStopMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetStopMode>(axis_intf, mode); }
+PMDCFunc PMDGetCommandedPosition(PMDAxisInterface axis_intf, PMDint32* position)
+{ return GetLong<CMoOp::GetCommandedPosition>(axis_intf, position); }
+PMDCFunc PMDGetCommandedVelocity(PMDAxisInterface axis_intf, PMDint32* velocity)
+{ return GetLong<CMoOp::GetCommandedVelocity>(axis_intf, velocity); }
+PMDCFunc PMDGetCommandedAcceleration(PMDAxisInterface axis_intf, PMDint32* acceleration)
+{ return GetLong<CMoOp::GetCommandedAcceleration>(axis_intf, acceleration); }
+
+// Position Loop
+PMDCFunc PMDSetMotorLimit(PMDAxisInterface axis_intf, PMDuint16 limit)
+{ return SendWord<CMoOp::SetMotorLimit>(axis_intf, limit); }
+PMDCFunc PMDGetMotorLimit(PMDAxisInterface axis_intf, PMDuint16* limit)
+{ return GetWord<CMoOp::GetMotorLimit>(axis_intf, limit); }
+PMDCFunc PMDSetMotorBias(PMDAxisInterface axis_intf, PMDint16 bias)
+{ return SendWord<CMoOp::SetMotorBias>(axis_intf, (PMDuint16)bias); }
+PMDCFunc PMDGetMotorBias(PMDAxisInterface axis_intf, PMDint16* bias)
+{ return GetWord<CMoOp::GetMotorBias>(axis_intf, bias); }
+PMDCFunc PMDSetPositionErrorLimit(PMDAxisInterface axis_intf, PMDuint32 limit)
+{ return SendLong<CMoOp::SetPositionErrorLimit>(axis_intf, limit); }
+PMDCFunc PMDGetPositionErrorLimit(PMDAxisInterface axis_intf, PMDuint32* limit)
+{ return GetLong<CMoOp::GetPositionErrorLimit>(axis_intf, limit); }
+PMDCFunc PMDSetSettleTime(PMDAxisInterface axis_intf, PMDuint16 time)
+{ return SendWord<CMoOp::SetSettleTime>(axis_intf, time); }
+PMDCFunc PMDGetSettleTime(PMDAxisInterface axis_intf, PMDuint16* time)
+{ return GetWord<CMoOp::GetSettleTime>(axis_intf, time); }
+PMDCFunc PMDSetSettleWindow(PMDAxisInterface axis_intf, PMDuint16 window)
+{ return SendWord<CMoOp::SetSettleWindow>(axis_intf, window); }
+PMDCFunc PMDGetSettleWindow(PMDAxisInterface axis_intf, PMDuint16* window)
+{ return GetWord<CMoOp::GetSettleWindow>(axis_intf, window); }
+PMDCFunc PMDSetTrackingWindow(PMDAxisInterface axis_intf, PMDuint16 window)
+{ return SendWord<CMoOp::SetTrackingWindow>(axis_intf, window); }
+PMDCFunc PMDGetTrackingWindow(PMDAxisInterface axis_intf, PMDuint16* window)
+{ return GetWord<CMoOp::GetTrackingWindow>(axis_intf, window); }
+PMDCFunc PMDSetMotionCompleteMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetMotionCompleteMode>(axis_intf, mode); }
+PMDCFunc PMDGetMotionCompleteMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetMotionCompleteMode>(axis_intf, mode); }
+PMDCFunc PMDClearPositionError(PMDAxisInterface axis_intf)
+{ return Send<CMoOp::ClearPositionError>(axis_intf); }
+PMDCFunc PMDGetPositionError(PMDAxisInterface axis_intf, PMDint32* error)
+{ return GetLong<CMoOp::GetPositionError>(axis_intf, error); }
+PMDCFunc PMDSetSampleTime(PMDAxisInterface axis_intf, PMDuint32 time)
+{ return SendLong<CMoOp::SetSampleTime>(axis_intf, time); }
+PMDCFunc PMDGetSampleTime(PMDAxisInterface axis_intf, PMDuint32* time)
+{ return GetLong<CMoOp::GetSampleTime>(axis_intf, time); }
+
+// Parameter Update & Breakpoints
+PMDCFunc PMDSetBreakpoint(PMDAxisInterface axis_intf, PMDuint16 breakpointID,
+    PMDAxis sourceAxis, PMDuint8 action, PMDuint8 trigger)
+{
+    return SendWordWord<CMoOp::SetBreakpoint>(axis_intf, breakpointID,
+	(PMDuint16)((trigger << 8) | ((action & nibbleMask) << 4) |
+	(sourceAxis & nibbleMask)));
+}
+
+PMDCFunc PMDGetBreakpoint(PMDAxisInterface axis_intf, PMDuint16 breakpointID,
+    PMDAxis* sourceAxis, PMDuint8* action, PMDuint8* trigger)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = WordGetWord<CMoOp::GetBreakpoint>(axis_intf,
+	    breakpointID, &w)))
+    {
+	*sourceAxis = w & nibbleMask;
+	*action = (PMDuint8)((w >> 4) & nibbleMask);
+	*trigger = (PMDuint8)(w >> 8);
+    }
+    return result;
+}
+
+PMDCFunc PMDSetBreakpointValue(PMDAxisInterface axis_intf, PMDuint16 breakpointID, PMDint32 value)
+{ return SendWordLong<CMoOp::SetBreakpointValue>(axis_intf, breakpointID, (PMDuint32)value); }
+PMDCFunc PMDGetBreakpointValue(PMDAxisInterface axis_intf, PMDuint16 breakpointID, PMDint32* value)
+{ return WordGetLong<CMoOp::GetBreakpointValue>(axis_intf, breakpointID, value); }
+PMDCFunc PMDSetBreakpointUpdateMask(PMDAxisInterface axis_intf, PMDuint16 breakpointID, PMDuint16 mask)
+{ return SendWordWord<CMoOp::SetBreakpointUpdateMask>(axis_intf, breakpointID, mask); }
+PMDCFunc PMDGetBreakpointUpdateMask(PMDAxisInterface axis_intf, PMDuint16 breakpointID, PMDuint16* mask)
+{ return WordGetWord<CMoOp::GetBreakpointUpdateMask>(axis_intf, breakpointID, mask); }
+PMDCFunc PMDUpdate(PMDAxisInterface axis_intf)
+{ return Send<CMoOp::Update>(axis_intf); }
+PMDCFunc PMDMultiUpdate(PMDAxisInterface axis_intf, PMDuint16 mask)
+{ return SendWord<CMoOp::MultiUpdate>(axis_intf, mask); }
+
+// Interrupt Processing
+PMDCFunc PMDSetInterruptMask(PMDAxisInterface axis_intf, PMDuint16 mask)
+{ return SendWord<CMoOp::SetInterruptMask>(axis_intf, mask); }
+PMDCFunc PMDGetInterruptMask(PMDAxisInterface axis_intf, PMDuint16* mask)
+{ return GetWord<CMoOp::GetInterruptMask>(axis_intf, mask); }
+PMDCFunc PMDClearInterrupt(PMDAxisInterface axis_intf)
+{ return Send<CMoOp::ClearInterrupt>(axis_intf); }
+PMDCFunc PMDGetInterruptAxis(PMDAxisInterface axis_intf, PMDuint16* mask)
+{ return GetWord<CMoOp::GetInterruptAxis>(axis_intf, mask); }
+
+// Status Register Control
+PMDCFunc PMDResetEventStatus(PMDAxisInterface axis_intf, PMDuint16 status)
+{ return SendWord<CMoOp::ResetEventStatus>(axis_intf, status); }
+PMDCFunc PMDGetEventStatus(PMDAxisInterface axis_intf, PMDuint16* status)
+{ return GetWord<CMoOp::GetEventStatus>(axis_intf, status); }
+PMDCFunc PMDGetActivityStatus(PMDAxisInterface axis_intf, PMDuint16* status)
+{ return GetWord<CMoOp::GetActivityStatus>(axis_intf, status); }
+PMDCFunc PMDSetSignalSense(PMDAxisInterface axis_intf, PMDuint16 sense)
+{ return SendWord<CMoOp::SetSignalSense>(axis_intf, sense); }
+PMDCFunc PMDGetSignalSense(PMDAxisInterface axis_intf, PMDuint16* sense)
+{ return GetWord<CMoOp::GetSignalSense>(axis_intf, sense); }
+PMDCFunc PMDGetSignalStatus(PMDAxisInterface axis_intf, PMDuint16* status)
+{ return GetWord<CMoOp::GetSignalStatus>(axis_intf, status); }
+
+// Encoder
+PMDCFunc PMDAdjustActualPosition(PMDAxisInterface axis_intf, PMDint32 position)
+{ return SendLong<CMoOp::AdjustActualPosition>(axis_intf, (PMDuint32)position); }
+PMDCFunc PMDSetActualPosition(PMDAxisInterface axis_intf, PMDint32 position)
+{ return SendLong<CMoOp::SetActualPosition>(axis_intf, (PMDuint32)position); }
+PMDCFunc PMDGetActualPosition(PMDAxisInterface axis_intf, PMDint32* position)
+{ return GetLong<CMoOp::GetActualPosition>(axis_intf, position); }
+PMDCFunc PMDSetActualPositionUnits(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetActualPositionUnits>(axis_intf, mode); }
+PMDCFunc PMDGetActualPositionUnits(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetActualPositionUnits>(axis_intf, mode); }
+PMDCFunc PMDSetCaptureSource(PMDAxisInterface axis_intf, PMDuint16 source)
+{ return SendWord<CMoOp::SetCaptureSource>(axis_intf, source); }
+PMDCFunc PMDGetCaptureSource(PMDAxisInterface axis_intf, PMDuint16* source)
+{ return GetWord<CMoOp::GetCaptureSource>(axis_intf, source); }
+PMDCFunc PMDSetEncoderSource(PMDAxisInterface axis_intf, PMDuint16 source)
+{ return SendWord<CMoOp::SetEncoderSource>(axis_intf, source); }
+PMDCFunc PMDGetEncoderSource(PMDAxisInterface axis_intf, PMDuint16* source)
+{ return GetWord<CMoOp::GetEncoderSource>(axis_intf, source); }
+PMDCFunc PMDSetEncoderModulus(PMDAxisInterface axis_intf, PMDuint16 modulus)
+{ return SendWord<CMoOp::SetEncoderModulus>(axis_intf, modulus); }
+PMDCFunc PMDGetEncoderModulus(PMDAxisInterface axis_intf, PMDuint16* modulus)
+{ return GetWord<CMoOp::GetEncoderModulus>(axis_intf, modulus); }
+PMDCFunc PMDSetEncoderToStepRatio(PMDAxisInterface axis_intf, PMDuint16 counts, PMDuint16 steps)
+{ return SendWordWord<CMoOp::SetEncoderToStepRatio>(axis_intf, counts, steps); }
+PMDCFunc PMDGetEncoderToStepRatio(PMDAxisInterface axis_intf, PMDuint16* counts, PMDuint16* steps)
+{ return GetWordWord<CMoOp::GetEncoderToStepRatio>(axis_intf, counts, steps); }
+PMDCFunc PMDGetActualVelocity(PMDAxisInterface axis_intf, PMDint32* velocity)
+{ return GetLong<CMoOp::GetActualVelocity>(axis_intf, velocity); }
+PMDCFunc PMDGetCaptureValue(PMDAxisInterface axis_intf, PMDint32* position)
+{ return GetLong<CMoOp::GetCaptureValue>(axis_intf, position); }
+
+PMDCFunc PMDSetAuxiliaryEncoderSource(PMDAxisInterface axis_intf, PMDuint8 mode, PMDAxis auxillaryAxis)
+{
+    return SendWord<CMoOp::SetAuxiliaryEncoderSource>(axis_intf,
+	(PMDuint16)((mode << 8) | auxillaryAxis));
+}
+
+PMDCFunc PMDGetAuxiliaryEncoderSource(PMDAxisInterface axis_intf, PMDuint8* mode, PMDAxis* auxillaryAxis)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = GetWord<CMoOp::GetAuxiliaryEncoderSource>(axis_intf, &w)))
+    {
+	*mode = (PMDuint8)(w >> 8);
+	*auxillaryAxis = w & nibbleMask;
+    }
+    return result;
+}
+
+// Motor
+PMDCFunc PMDSetMotorType(PMDAxisInterface axis_intf, PMDuint16 type)
+{ return SendWord<CMoOp::SetMotorType>(axis_intf, type); }
+PMDCFunc PMDGetMotorType(PMDAxisInterface axis_intf, PMDuint16* type)
+{ return GetWord<CMoOp::GetMotorType>(axis_intf, type); }
+PMDCFunc PMDSetMotorCommand(PMDAxisInterface axis_intf, PMDint16 motorCommand)
+{ return SendWord<CMoOp::SetMotorCommand>(axis_intf, (PMDuint16)motorCommand); }
+PMDCFunc PMDGetMotorCommand(PMDAxisInterface axis_intf, PMDint16* motorCommand)
+{ return GetWord<CMoOp::GetMotorCommand>(axis_intf, motorCommand); }
+PMDCFunc PMDGetActiveMotorCommand(PMDAxisInterface axis_intf, PMDint16* motorCommand)
+{ return GetWord<CMoOp::GetActiveMotorCommand>(axis_intf, motorCommand); }
+
+// Commutation
+PMDCFunc PMDSetOutputMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetOutputMode>(axis_intf, mode); }
+PMDCFunc PMDGetOutputMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetOutputMode>(axis_intf, mode); }
+PMDCFunc PMDSetPWMFrequency(PMDAxisInterface axis_intf, PMDuint16 frequency)
+{ return SendWord<CMoOp::SetPWMFrequency>(axis_intf, frequency); }
+PMDCFunc PMDGetPWMFrequency(PMDAxisInterface axis_intf, PMDuint16* frequency)
+{ return GetWord<CMoOp::GetPWMFrequency>(axis_intf, frequency); }
+PMDCFunc PMDSetCommutationMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetCommutationMode>(axis_intf, mode); }
+PMDCFunc PMDGetCommutationMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetCommutationMode>(axis_intf, mode); }
+PMDCFunc PMDSetPhaseInitializeMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetPhaseInitializeMode>(axis_intf, mode); }
+PMDCFunc PMDGetPhaseInitializeMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetPhaseInitializeMode>(axis_intf, mode); }
+PMDCFunc PMDSetPhasePrescale(PMDAxisInterface axis_intf, PMDuint16 scale)
+{ return SendWord<CMoOp::SetPhasePrescale>(axis_intf, scale); }
+PMDCFunc PMDGetPhasePrescale(PMDAxisInterface axis_intf, PMDuint16* scale)
+{ return GetWord<CMoOp::GetPhasePrescale>(axis_intf, scale); }
+PMDCFunc PMDSetPhaseCounts(PMDAxisInterface axis_intf, PMDuint16 counts)
+{ return SendWord<CMoOp::SetPhaseCounts>(axis_intf, counts); }
+PMDCFunc PMDGetPhaseCounts(PMDAxisInterface axis_intf, PMDuint16* counts)
+{ return GetWord<CMoOp::GetPhaseCounts>(axis_intf, counts); }
+PMDCFunc PMDSetPhaseInitializeTime(PMDAxisInterface axis_intf, PMDuint16 time)
+{ return SendWord<CMoOp::SetPhaseInitializeTime>(axis_intf, time); }
+PMDCFunc PMDGetPhaseInitializeTime(PMDAxisInterface axis_intf, PMDuint16* time)
+{ return GetWord<CMoOp::GetPhaseInitializeTime>(axis_intf, time); }
+PMDCFunc PMDSetPhaseOffset(PMDAxisInterface axis_intf, PMDuint16 offset)
+{ return SendWord<CMoOp::SetPhaseOffset>(axis_intf, offset); }
+PMDCFunc PMDGetPhaseOffset(PMDAxisInterface axis_intf, PMDuint16* offset)
+{ return GetWord<CMoOp::GetPhaseOffset>(axis_intf, offset); }
+PMDCFunc PMDSetPhaseAngle(PMDAxisInterface axis_intf, PMDuint16 angle)
+{ return SendWord<CMoOp::SetPhaseAngle>(axis_intf, angle); }
+PMDCFunc PMDGetPhaseAngle(PMDAxisInterface axis_intf, PMDuint16* angle)
+{ return GetWord<CMoOp::GetPhaseAngle>(axis_intf, angle); }
+PMDCFunc PMDSetPhaseCorrectionMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetPhaseCorrectionMode>(axis_intf, mode); }
+PMDCFunc PMDGetPhaseCorrectionMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetPhaseCorrectionMode>(axis_intf, mode); }
+PMDCFunc PMDInitializePhase(PMDAxisInterface axis_intf)
+{ return Send<CMoOp::InitializePhase>(axis_intf); }
+PMDCFunc PMDGetPhaseCommand(PMDAxisInterface axis_intf, PMDuint16 phase, PMDint16* command)
+{ return WordGetWord<CMoOp::GetPhaseCommand>(axis_intf, phase, command); }
+
+// External Memory
+PMDCFunc PMDSetBufferStart(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDuint32 address)
+{ return SendWordLong<CMoOp::SetBufferStart>(axis_intf, bufferID, address); }
+PMDCFunc PMDGetBufferStart(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDuint32* address)
+{ return WordGetLong<CMoOp::GetBufferStart>(axis_intf, bufferID, address); }
+PMDCFunc PMDSetBufferLength(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDuint32 length)
+{ return SendWordLong<CMoOp::SetBufferLength>(axis_intf, bufferID, length); }
+PMDCFunc PMDGetBufferLength(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDuint32* length)
+{ return WordGetLong<CMoOp::GetBufferLength>(axis_intf, bufferID, length); }
+PMDCFunc PMDWriteBuffer(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDint32 data)
+{ return SendWordLong<CMoOp::WriteBuffer>(axis_intf, bufferID, (PMDuint32)data); }
+PMDCFunc PMDReadBuffer(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDint32* data)
+{ return WordGetLong<CMoOp::ReadBuffer>(axis_intf, bufferID, data); }
+PMDCFunc PMDSetBufferWriteIndex(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDuint32 index)
+{ return SendWordLong<CMoOp::SetBufferWriteIndex>(axis_intf, bufferID, index); }
+PMDCFunc PMDGetBufferWriteIndex(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDuint32* index)
+{ return WordGetLong<CMoOp::GetBufferWriteIndex>(axis_intf, bufferID, index); }
+PMDCFunc PMDSetBufferReadIndex(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDuint32 index)
+{ return SendWordLong<CMoOp::SetBufferReadIndex>(axis_intf, bufferID, index); }
+PMDCFunc PMDGetBufferReadIndex(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDuint32* index)
+{ return WordGetLong<CMoOp::GetBufferReadIndex>(axis_intf, bufferID, index); }
+
+// Trace Operations
+PMDCFunc PMDSetTraceMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetTraceMode>(axis_intf, mode); }
+PMDCFunc PMDGetTraceMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetTraceMode>(axis_intf, mode); }
+PMDCFunc PMDSetTracePeriod(PMDAxisInterface axis_intf, PMDuint16 tracePeriod)
+{ return SendWord<CMoOp::SetTracePeriod>(axis_intf, tracePeriod); }
+PMDCFunc PMDGetTracePeriod(PMDAxisInterface axis_intf, PMDuint16* tracePeriod)
+{ return GetWord<CMoOp::GetTracePeriod>(axis_intf, tracePeriod); }
+
+PMDCFunc PMDSetTraceVariable(PMDAxisInterface axis_intf, PMDuint16 variableNumber,
+    PMDAxis traceAxis, PMDuint8 variable)
+{
+    return SendWordWord<CMoOp::SetTraceVariable>(axis_intf, variableNumber,
+	(PMDuint16)((variable << 8) | (traceAxis & nibbleMask)));
+}
+
+PMDCFunc PMDGetTraceVariable(PMDAxisInterface axis_intf, PMDuint16 variableNumber,
+    PMDAxis* traceAxis, PMDuint8* variable)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = WordGetWord<CMoOp::GetTraceVariable>(axis_intf,
+	    variableNumber, &w)))
+    {
+	*traceAxis = w & nibbleMask;
+	*variable = (PMDuint8)(w >> 8);
+    }
+    return result;
+}
+
+// Trace start and stop share one layout: state, bit, condition and axis,
+// a nibble each from the top down.
+static inline PMDuint16
+PackTraceTrigger(PMDAxis axis, PMDuint8 condition, PMDuint8 bit, PMDuint8 state)
+{
+    return (PMDuint16)(((state & nibbleMask) << 12) | ((bit & nibbleMask) << 8) |
+	((condition & nibbleMask) << 4) | (axis & nibbleMask));
+}
+
+static inline void
+UnpackTraceTrigger(PMDuint16 w, PMDAxis* axis, PMDuint8* condition,
+    PMDuint8* bit, PMDuint8* state)
+{
+    *axis = w & nibbleMask;
+    *condition = (PMDuint8)((w >> 4) & nibbleMask);
+    *bit = (PMDuint8)((w >> 8) & nibbleMask);
+    *state = (PMDuint8)((w >> 12) & nibbleMask);
+}
+
+PMDCFunc PMDSetTraceStart(PMDAxisInterface axis_intf, PMDAxis triggerAxis,
+    PMDuint8 condition, PMDuint8 bit, PMDuint8 state)
+{
+    return SendWord<CMoOp::SetTraceStart>(axis_intf,
+	PackTraceTrigger(triggerAxis, condition, bit, state));
+}
+
+PMDCFunc PMDGetTraceStart(PMDAxisInterface axis_intf, PMDAxis* triggerAxis,
+    PMDuint8* condition, PMDuint8* bit, PMDuint8* state)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = GetWord<CMoOp::GetTraceStart>(axis_intf, &w)))
+    {
+	UnpackTraceTrigger(w, triggerAxis, condition, bit, state);
+    }
+    return result;
+}
+
+PMDCFunc PMDSetTraceStop(PMDAxisInterface axis_intf, PMDAxis triggerAxis,
+    PMDuint8 condition, PMDuint8 bit, PMDuint8 state)
+{
+    return SendWord<CMoOp::SetTraceStop>(axis_intf,
+	PackTraceTrigger(triggerAxis, condition, bit, state));
+}
+
+PMDCFunc PMDGetTraceStop(PMDAxisInterface axis_intf, PMDAxis* triggerAxis,
+    PMDuint8* condition, PMDuint8* bit, PMDuint8* state)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = GetWord<CMoOp::GetTraceStop>(axis_intf, &w)))
+    {
+	UnpackTraceTrigger(w, triggerAxis, condition, bit, state);
+    }
+    return result;
+}
+
+PMDCFunc PMDGetTraceStatus(PMDAxisInterface axis_intf, PMDuint16* status)
+{ return GetWord<CMoOp::GetTraceStatus>(axis_intf, status); }
+PMDCFunc PMDGetTraceCount(PMDAxisInterface axis_intf, PMDuint32* count)
+{ return GetLong<CMoOp::GetTraceCount>(axis_intf, count); }
+PMDCFunc PMDGetTraceValue(PMDAxisInterface axis_intf, PMDuint8 variable, PMDint32* value)
+{ return WordGetLong<CMoOp::GetTraceValue>(axis_intf, variable, value); }
+
+// Miscellaneous
+PMDCFunc PMDWriteIO(PMDAxisInterface axis_intf, PMDuint16 address, PMDuint16 data)
+{ return SendWordWord<CMoOp::WriteIO>(axis_intf, address, data); }
+PMDCFunc PMDReadIO(PMDAxisInterface axis_intf, PMDuint16 address, PMDuint16* data)
+{ return WordGetWord<CMoOp::ReadIO>(axis_intf, address, data); }
+PMDCFunc PMDReadAnalog(PMDAxisInterface axis_intf, PMDuint16 portID, PMDuint16* value)
+{ return WordGetWord<CMoOp::ReadAnalog>(axis_intf, portID, value); }
+PMDCFunc PMDReset(PMDAxisInterface axis_intf)
+{ return Send<CMoOp::Reset>(axis_intf); }
+PMDCFunc PMDNoOperation(PMDAxisInterface axis_intf)
+{ return Send<CMoOp::NoOperation>(axis_intf); }
+
+PMDCFunc PMDGetVersion(PMDAxisInterface axis_intf, PMDuint16* family,
+    PMDuint16* motorType, PMDuint16* numberAxes, PMDuint16* special,
+    PMDuint16* custom, PMDuint16* major, PMDuint16* minor)
+{
+    PMDuint16 w1, w2;
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = GetWordWord<CMoOp::GetVersion>(axis_intf, &w1, &w2)))
+    {
+	*family = w1 >> 12;
+	*motorType = (w1 >> 8) & nibbleMask;
+	*numberAxes = (w1 >> 4) & nibbleMask;
+	*special = w1 & nibbleMask;
+	*custom = w2 >> 8;
+	*major = (w2 >> 4) & nibbleMask;
+	*minor = w2 & nibbleMask;
+    }
+    return result;
+}
+
+PMDCFunc PMDGetVersion32(PMDAxisInterface axis_intf, PMDuint32* version)
+{ return GetLong<CMoOp::GetVersion>(axis_intf, version); }
+PMDCFunc PMDGetInstructionError(PMDAxisInterface axis_intf, PMDuint16* instructionError)
+{ return GetWord<CMoOp::GetInstructionError>(axis_intf, instructionError); }
+
+PMDCFunc PMDSetSerialPortMode(PMDAxisInterface axis_intf, PMDuint8 baud,
+    PMDuint8 parity, PMDuint8 stopBits, PMDuint8 protocol, PMDuint8 multiDropID)
+{
+    return SendWord<CMoOp::SetSerialPortMode>(axis_intf,
+	(PMDuint16)((multiDropID << 11) | (protocol << 7) | (stopBits << 6) |
+	(parity << 4) | baud));
+}
+
+PMDCFunc PMDGetSerialPortMode(PMDAxisInterface axis_intf, PMDuint8* baud,
+    PMDuint8* parity, PMDuint8* stopBits, PMDuint8* protocol, PMDuint8* multiDropID)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = GetWord<CMoOp::GetSerialPortMode>(axis_intf, &w)))
+    {
+	*baud = (PMDuint8)(w & 0x0F);
+	*parity = (PMDuint8)((w >> 4) & 0x03);
+	*stopBits = (PMDuint8)((w >> 6) & 0x01);
+	*protocol = (PMDuint8)((w >> 7) & 0x03);
+	*multiDropID = (PMDuint8)((w >> 11) & 0x1F);
+    }
+    return result;
+}
+
+PMDCFunc PMDSetCANMode(PMDAxisInterface axis_intf, PMDuint8 nodeID, PMDuint8 transmission_rate)
+{
+    return SendWord<CMoOp::SetCANMode>(axis_intf,
+	(PMDuint16)((transmission_rate << 13) | nodeID));
+}
+
+PMDCFunc PMDGetCANMode(PMDAxisInterface axis_intf, PMDuint8* nodeID, PMDuint8* transmission_rate)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = GetWord<CMoOp::GetCANMode>(axis_intf, &w)))
+    {
+	*nodeID = (PMDuint8)(w & 0x7F);
+	*transmission_rate = (PMDuint8)((w >> 13) & 0x07);
+    }
+    return result;
+}
+
+PMDCFunc PMDSetSPIMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetSPIMode>(axis_intf, mode); }
+PMDCFunc PMDGetSPIMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetSPIMode>(axis_intf, mode); }
+PMDCFunc PMDGetTime(PMDAxisInterface axis_intf, PMDuint32* numberServoCycles)
+{ return GetLong<CMoOp::GetTime>(axis_intf, numberServoCycles); }
+PMDCFunc PMDGetChecksum(PMDAxisInterface axis_intf, PMDuint32* checksum)
+{ return GetLong<CMoOp::GetChecksum>(axis_intf, checksum); }
+PMDCFunc PMDSetStepRange(PMDAxisInterface axis_intf, PMDuint16 range)
+{ return SendWord<CMoOp::SetStepRange>(axis_intf, range); }
+PMDCFunc PMDGetStepRange(PMDAxisInterface axis_intf, PMDuint16* range)
+{ return GetWord<CMoOp::GetStepRange>(axis_intf, range); }
+PMDCFunc PMDSetSynchronizationMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetSynchronizationMode>(axis_intf, mode); }
+PMDCFunc PMDGetSynchronizationMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetSynchronizationMode>(axis_intf, mode); }
+
+// ION and Atlas specific functions
+PMDCFunc PMDGetDriveStatus(PMDAxisInterface axis_intf, PMDuint16* status)
+{ return GetWord<CMoOp::GetDriveStatus>(axis_intf, status); }
+PMDCFunc PMDSetPositionLoop(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint32 value)
+{ return SendWordLong<CMoOp::SetPositionLoop>(axis_intf, parameter, (PMDuint32)value); }
+PMDCFunc PMDGetPositionLoop(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint32* value)
+{ return WordGetLong<CMoOp::GetPositionLoop>(axis_intf, parameter, value); }
+PMDCFunc PMDGetPositionLoopValue(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint32* value)
+{ return WordGetLong<CMoOp::GetPositionLoopValue>(axis_intf, parameter, value); }
+PMDCFunc PMDSetOperatingMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetOperatingMode>(axis_intf, mode); }
+PMDCFunc PMDGetOperatingMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetOperatingMode>(axis_intf, mode); }
+PMDCFunc PMDGetActiveOperatingMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetActiveOperatingMode>(axis_intf, mode); }
+PMDCFunc PMDRestoreOperatingMode(PMDAxisInterface axis_intf)
+{ return Send<CMoOp::RestoreOperatingMode>(axis_intf); }
+PMDCFunc PMDSetCurrentFoldback(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16 value)
+{ return SendWordWord<CMoOp::SetCurrentFoldback>(axis_intf, parameter, value); }
+PMDCFunc PMDGetCurrentFoldback(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16* value)
+{ return WordGetWord<CMoOp::GetCurrentFoldback>(axis_intf, parameter, value); }
+PMDCFunc PMDSetHoldingCurrent(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16 value)
+{ return SendWordWord<CMoOp::SetCurrent>(axis_intf, parameter, value); }
+PMDCFunc PMDGetHoldingCurrent(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16* value)
+{ return WordGetWord<CMoOp::GetCurrent>(axis_intf, parameter, value); }
+PMDCFunc PMDSetCurrentControlMode(PMDAxisInterface axis_intf, PMDuint16 mode)
+{ return SendWord<CMoOp::SetCurrentControlMode>(axis_intf, mode); }
+PMDCFunc PMDGetCurrentControlMode(PMDAxisInterface axis_intf, PMDuint16* mode)
+{ return GetWord<CMoOp::GetCurrentControlMode>(axis_intf, mode); }
+
+PMDCFunc PMDSetAxisOutMask(PMDAxisInterface axis_intf, PMDAxis sourceAxis,
+    PMDuint8 sourceRegister, PMDuint16 selectionMask, PMDuint16 senseMask)
+{
+    return SendWordWordWord<CMoOp::SetAxisOutMask>(axis_intf,
+	(PMDuint16)(((sourceRegister & nibbleMask) << 8) | (sourceAxis & nibbleMask)),
+	selectionMask, senseMask);
+}
+
+PMDCFunc PMDGetAxisOutMask(PMDAxisInterface axis_intf, PMDAxis* sourceAxis,
+    PMDuint8* sourceRegister, PMDuint16* selectionMask, PMDuint16* senseMask)
+{
+    PMDuint16 w;
+    PMDresult result;
+
+    if (PMD_NOERROR == (result = GetWordWordWord<CMoOp::GetAxisOutMask>(axis_intf,
+	    &w, selectionMask, senseMask)))
+    {
+	*sourceAxis = w & nibbleMask;
+	*sourceRegister = (PMDuint8)((w >> 8) & nibbleMask);
+    }
+    return result;
+}
+
+PMDCFunc PMDSetEventAction(PMDAxisInterface axis_intf, PMDuint16 eventid, PMDuint16 action)
+{ return SendWordWord<CMoOp::SetEventAction>(axis_intf, eventid, action); }
+PMDCFunc PMDGetEventAction(PMDAxisInterface axis_intf, PMDuint16 eventid, PMDuint16* action)
+{ return WordGetWord<CMoOp::GetEventAction>(axis_intf, eventid, action); }
+PMDCFunc PMDSetBusVoltageLimits(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16 value)
+{ return SendWordWord<CMoOp::SetDriveFaultParameter>(axis_intf, parameter, value); }
+PMDCFunc PMDGetBusVoltageLimits(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16* value)
+{ return WordGetWord<CMoOp::GetDriveFaultParameter>(axis_intf, parameter, value); }
+PMDCFunc PMDGetBusVoltage(PMDAxisInterface axis_intf, PMDuint16* voltage)
+{ return GetWord<CMoOp::GetBusVoltage>(axis_intf, voltage); }
+PMDCFunc PMDSetOvertemperatureLimit(PMDAxisInterface axis_intf, PMDuint16 limit)
+{ return SendWord<CMoOp::SetOvertemperatureLimit>(axis_intf, limit); }
+PMDCFunc PMDGetOvertemperatureLimit(PMDAxisInterface axis_intf, PMDuint16* limit)
+{ return GetWord<CMoOp::GetOvertemperatureLimit>(axis_intf, limit); }
+PMDCFunc PMDGetTemperature(PMDAxisInterface axis_intf, PMDint16* temperature)
+{ return GetWord<CMoOp::GetTemperature>(axis_intf, temperature); }
+PMDCFunc PMDClearDriveFaultStatus(PMDAxisInterface axis_intf)
+{ return Send<CMoOp::ClearDriveFaultStatus>(axis_intf); }
+PMDCFunc PMDGetDriveFaultStatus(PMDAxisInterface axis_intf, PMDuint16* status)
+{ return GetWord<CMoOp::GetDriveFaultStatus>(axis_intf, status); }
+PMDCFunc PMDSetUpdateMask(PMDAxisInterface axis_intf, PMDuint16 mask)
+{ return SendWord<CMoOp::SetUpdateMask>(axis_intf, mask); }
+PMDCFunc PMDGetUpdateMask(PMDAxisInterface axis_intf, PMDuint16* mask)
+{ return GetWord<CMoOp::GetUpdateMask>(axis_intf, mask); }
+
+// The current loop and FOC commands select a phase or loop in the high
+// byte of the first word and a parameter or node in the low byte.
+static inline PMDuint16
+PackSelector(PMDuint8 high, PMDuint8 low)
+{
+    return (PMDuint16)((high << 8) | low);
+}
+
+PMDCFunc PMDSetCurrentLoop(PMDAxisInterface axis_intf, PMDuint8 phase, PMDuint8 parameter, PMDuint16 value)
+{ return SendWordWord<CMoOp::SetCurrentLoop>(axis_intf, PackSelector(phase, parameter), value); }
+PMDCFunc PMDGetCurrentLoop(PMDAxisInterface axis_intf, PMDuint8 phase, PMDuint8 parameter, PMDuint16* value)
+{ return WordGetWord<CMoOp::GetCurrentLoop>(axis_intf, PackSelector(phase, parameter), value); }
+PMDCFunc PMDGetCurrentLoopValue(PMDAxisInterface axis_intf, PMDuint8 phase, PMDuint8 node, PMDint32* value)
+{ return WordGetLong<CMoOp::GetCurrentLoopValue>(axis_intf, PackSelector(phase, node), value); }
+PMDCFunc PMDSetDefault(PMDAxisInterface axis_intf, PMDuint16 variable, PMDuint32 value)
+{ return SendWordLong<CMoOp::SetDefault>(axis_intf, variable, value); }
+PMDCFunc PMDGetDefault(PMDAxisInterface axis_intf, PMDuint16 variable, PMDuint32* value)
+{ return WordGetLong<CMoOp::GetDefault>(axis_intf, variable, value); }
+PMDCFunc PMDSetFOC(PMDAxisInterface axis_intf, PMDuint8 loop, PMDuint8 parameter, PMDuint16 value)
+{ return SendWordWord<CMoOp::SetFOC>(axis_intf, PackSelector(loop, parameter), value); }
+PMDCFunc PMDGetFOC(PMDAxisInterface axis_intf, PMDuint8 loop, PMDuint8 parameter, PMDuint16* value)
+{ return WordGetWord<CMoOp::GetFOC>(axis_intf, PackSelector(loop, parameter), value); }
+PMDCFunc PMDGetFOCValue(PMDAxisInterface axis_intf, PMDuint8 loop, PMDuint8 node, PMDint32* value)
+{ return WordGetLong<CMoOp::GetFOCValue>(axis_intf, PackSelector(loop, node), value); }
+PMDCFunc PMDSetFaultOutMask(PMDAxisInterface axis_intf, PMDuint16 mask)
+{ return SendWord<CMoOp::SetFaultOutMask>(axis_intf, mask); }
+PMDCFunc PMDGetFaultOutMask(PMDAxisInterface axis_intf, PMDuint16* mask)
+{ return GetWord<CMoOp::GetFaultOutMask>(axis_intf, mask); }
+
+// Atlas, MC5x113 and MC7x113 specific functions
+PMDCFunc PMDDriveNVRAM(PMDAxisInterface axis_intf, PMDuint16 option, PMDuint16 value)
+{ return SendWordWord<CMoOp::DriveNVRAM>(axis_intf, option, value); }
+PMDCFunc PMDReadBuffer16(PMDAxisInterface axis_intf, PMDuint16 bufferID, PMDint16* data)
+{ return WordGetWord<CMoOp::ReadBuffer16>(axis_intf, bufferID, data); }
+PMDCFunc PMDSetCurrent(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16 value)
+{ return SendWordWord<CMoOp::SetCurrent>(axis_intf, parameter, value); }
+PMDCFunc PMDGetCurrent(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16* value)
+{ return WordGetWord<CMoOp::GetCurrent>(axis_intf, parameter, value); }
+PMDCFunc PMDSetDriveFaultParameter(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16 value)
+{ return SendWordWord<CMoOp::SetDriveFaultParameter>(axis_intf, parameter, value); }
+PMDCFunc PMDGetDriveFaultParameter(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16* value)
+{ return WordGetWord<CMoOp::GetDriveFaultParameter>(axis_intf, parameter, value); }
+PMDCFunc PMDSetDrivePWM(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16 value)
+{ return SendWordWord<CMoOp::SetDrivePWM>(axis_intf, parameter, value); }
+PMDCFunc PMDGetDrivePWM(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16* value)
+{ return WordGetWord<CMoOp::GetDrivePWM>(axis_intf, parameter, value); }
+PMDCFunc PMDSetFeedbackParameter(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint32 value)
+{ return SendWordLong<CMoOp::SetFeedbackParameter>(axis_intf, parameter, value); }
+PMDCFunc PMDGetFeedbackParameter(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint32* value)
+{ return WordGetLong<CMoOp::GetFeedbackParameter>(axis_intf, parameter, value); }
+
+// MC5x113 specific functions
+PMDCFunc PMDSetAnalogCalibration(PMDAxisInterface axis_intf, PMDuint16 channel, PMDint16 value)
+{ return SendWordWord<CMoOp::SetAnalogCalibration>(axis_intf, channel, (PMDuint16)value); }
+PMDCFunc PMDGetAnalogCalibration(PMDAxisInterface axis_intf, PMDuint16 channel, PMDint16* value)
+{ return WordGetWord<CMoOp::GetAnalogCalibration>(axis_intf, channel, value); }
+PMDCFunc PMDGetDriveValue(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDuint16* value)
+{ return WordGetWord<CMoOp::GetDriveValue>(axis_intf, parameter, value); }
+PMDCFunc PMDCalibrateAnalog(PMDAxisInterface axis_intf, PMDuint16 option)
+{ return SendWord<CMoOp::CalibrateAnalog>(axis_intf, option); }
+
+// MC7x113 specific functions
+PMDCFunc PMDSetLoop(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint32 value)
+{ return SendWordLong<CMoOp::SetLoop>(axis_intf, parameter, (PMDuint32)value); }
+PMDCFunc PMDGetLoop(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint32* value)
+{ return WordGetLong<CMoOp::GetLoop>(axis_intf, parameter, value); }
+PMDCFunc PMDGetLoopValue(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint32* value)
+{ return WordGetLong<CMoOp::GetLoopValue>(axis_intf, parameter, value); }
+PMDCFunc PMDSetProfileParameter(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint32 value)
+{ return SendWordLong<CMoOp::SetProfileParameter>(axis_intf, parameter, (PMDuint32)value); }
+PMDCFunc PMDGetProfileParameter(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint32* value)
+{ return WordGetLong<CMoOp::GetProfileParameter>(axis_intf, parameter, value); }
+PMDCFunc PMDGetProductInfo(PMDAxisInterface axis_intf, PMDuint16 index, PMDuint32* value)
+{ return WordGetLong<CMoOp::GetProductInfo>(axis_intf, index, value); }
+PMDCFunc PMDExecutionControl(PMDAxisInterface axis_intf, PMDuint16 option, PMDint32 value)
+{ return SendWordLong<CMoOp::ExecutionControl>(axis_intf, option, (PMDuint32)value); }
+PMDCFunc PMDSetCommutationParameter(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint32 value)
+{ return SendWordLong<CMoOp::SetCommutationParameter>(axis_intf, parameter, (PMDuint32)value); }
+PMDCFunc PMDGetCommutationParameter(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint32* value)
+{ return WordGetLong<CMoOp::GetCommutationParameter>(axis_intf, parameter, value); }
+PMDCFunc PMDSetPhaseParameter(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint16 value)
+{ return SendWordWord<CMoOp::SetPhaseParameter>(axis_intf, parameter, (PMDuint16)value); }
+PMDCFunc PMDGetPhaseParameter(PMDAxisInterface axis_intf, PMDuint16 parameter, PMDint16* value)
+{ return WordGetWord<CMoOp::GetPhaseParameter>(axis_intf, parameter, value); }
+PMDCFunc PMDSetDriveCommandMode(PMDAxisInterface axis_intf, PMDint16 mode)
+{ return SendWord<CMoOp::SetDriveCommandMode>(axis_intf, (PMDuint16)mode); }
+PMDCFunc PMDGetDriveCommandMode(PMDAxisInterface axis_intf, PMDint16* mode)
+{ return GetWord<CMoOp::GetDriveCommandMode>(axis_intf, mode); }
+PMDCFunc PMDGetRuntimeError(PMDAxisInterface axis_intf, PMDuint16* error)
+{ return GetWord<CMoOp::GetRuntimeError>(axis_intf, error); }
+PMDCFunc PMDSetCurrentLimit(PMDAxisInterface axis_intf, PMDuint16 limit)
+{ return SendWord<CMoOp::SetMotorLimit>(axis_intf, limit); }
+PMDCFunc PMDGetCurrentLimit(PMDAxisInterface axis_intf, PMDuint16* limit)
+{ return GetWord<CMoOp::GetMotorLimit>(axis_intf, limit); }
+
+// ------------------------------------------------------------------------
+// PMDdevice.h
+// ------------------------------------------------------------------------
+
+PMDCFunc PMDCloseAxisInterface(PMDAxisInterface axis_intf)
+{
+    if (axis_intf->transport.Close == 0L)
+    {
+	return PMD_ERR_InterfaceNotInitialized;
+    }
+    return axis_intf->transport.Close(axis_intf->transport_data);
+}
+
+PMDCFunc PMDReadDPRAM(PMDAxisInterface axis_intf, PMDuint32* data,
+    PMDuint32 offset_in_dwords, PMDuint32 dwords_to_read)
+{
+    if (!axis_intf->transport.bHasDPRAM || axis_intf->transport.ReadDPRAM == 0L)
+    {
+	return PMD_ERR_NoDPRAM;
+    }
+    return axis_intf->transport.ReadDPRAM(axis_intf->transport_data, data,
+	offset_in_dwords, dwords_to_read);
+}
+
+PMDCFunc PMDWriteDPRAM(PMDAxisInterface axis_intf, PMDuint32* data,
+    PMDuint32 offset_in_dwords, PMDuint32 dwords_to_write)
+{
+    if (!axis_intf->transport.bHasDPRAM || axis_intf->transport.WriteDPRAM == 0L)
+    {
+	return PMD_ERR_NoDPRAM;
+    }
+    return axis_intf->transport.WriteDPRAM(axis_intf->transport_data, data,
+	offset_in_dwords, dwords_to_write);
+}
+
+PMDCFunc PMDHardReset(PMDAxisInterface axis_intf)
+{
+    if (axis_intf->transport.HardReset == 0L)
+    {
+	return PMD_ERR_InvalidOperation;
+    }
+    return axis_intf->transport.HardReset(axis_intf->transport_data);
+}
+
+// An Atlas amplifier is reached through the Magellan axis that drives it,
+// so its handle is the same transport with the Atlas bit set in the axis.
+PMDCFunc PMDAtlasAxisOpen(PMDAxisInterface hSourceAxis, PMDAxisInterface hAtlasAxis)
+{
+    memcpy(hAtlasAxis, hSourceAxis, sizeof(PMDAxisHandle));
+    hAtlasAxis->axis = (PMDAxis)((hSourceAxis->axis & nibbleMask) | PMDAtlasAxisMask);
+    return PMD_NOERROR;
+}
+
+// ------------------------------------------------------------------------
+// PMDdiag.h
+// ------------------------------------------------------------------------
+
+const char*
+PMDGetOpcodeText(PMDuint16 opCode)
+{
+    const char* name = CMoOpcodes[(PMDuint8)(opCode & byteMask)].name;
+
+    return name != 0L ? name : "Unknown";
+}
+
+const char*
+PMDGetErrorMessage(PMDresult errorCode)
+{
+    switch (errorCode)
+    {
+    case PMD_NOERROR:				return "No error";
+    case PMD_ERR_Reset:				return "Processor reset";
+    case PMD_ERR_InvalidInstruction:		return "Invalid instruction";
+    case PMD_ERR_InvalidAxis:			return "Invalid axis";
+    case PMD_ERR_InvalidParameter:		return "Invalid data parameter";
+    case PMD_ERR_TraceRunning:			return "Trace currently running";
+    case PMD_ERR_BlockOutOfBounds:		return "Block out of bounds";
+    case PMD_ERR_TraceBufferZero:		return "Zero length trace buffer";
+    case PMD_ERR_BadSerialChecksum:		return "Invalid checksum";
+    case PMD_ERR_InvalidNegativeValue:		return "Invalid negative value for profile mode";
+    case PMD_ERR_InvalidParameterChange:	return "Invalid parameter change for profile mode";
+    case PMD_ERR_LimitEventPending:		return "Invalid move with limit event pending";
+    case PMD_ERR_InvalidMoveIntoLimit:		return "Invalid move into limit";
+    case PMD_ERR_InvalidOperatingModeRestore:	return "Invalid operating mode restore";
+    case PMD_ERR_InvalidOperatingModeForCommand: return "Command not valid in this operating mode";
+    case PMD_ERR_BadState:			return "Command not accepted in current state";
+    case PMD_ERR_HardFault:			return "A hard fault has occured. The processor must be reset";
+    case PMD_ERR_AtlasNotDetected:		return "Atlas command specified but no Atlas detected.";
+    case PMD_ERR_BadSPIChecksum:		return "Bad SPI command checksum";
+    case PMD_ERR_InvalidSPIprotocol:		return "Incorrect SPI command protocol";
+    case PMD_ERR_InvalidTorqueCommand:		return "Invalid torque command";
+    case PMD_ERR_BadFlashChecksum:		return "Bad flash checksum";
+    case PMD_ERR_InvalidFlashModeCommand:	return "Command not valid in flash mode";
+    case PMD_ERR_ReadOnly:			return "Write to read only buffer";
+    case PMD_ERR_InitializationOnlyCommand:	return "Command valid only for initialization";
+    case PMD_ERR_IncorrectDataCount:		return "Incorrect amount of data received by processor";
+    case PMD_ERR_MoveWhileInError:		return "Attempt to move while an event bit is set that caused a stop";
+    case PMD_ERR_WaitTimedOut:			return "ExecutionControl command timed out";
+    case PMD_ERR_InitializationRunning:		return "Attempt to change buffer 1 state while NVRAM init is running";
+    case PMD_ERR_InvalidClock:			return "Invalid external clock detected";
+    case PMD_ERR_InitializationSkipped:		return "Reset was performed with NVRAM initialization inhibited";
+    case PMD_ERR_InvalidInterface:		return "Operation not permitted on command interface";
+
+    case PMD_ERR_InvalidOperation:		return "Invalid operation";
+    case PMD_ERR_NotConnected:			return "Not connected";
+    case PMD_ERR_NotResponding:			return "Device not responding";
+    case PMD_ERR_CommPortRead:			return "Error reading from port";
+    case PMD_ERR_CommPortWrite:			return "Error writing to port";
+    case PMD_ERR_InvalidSerialPort:		return "Invalid port";
+    case PMD_ERR_InterfaceNotInitialized:	return "Interface not initialized";
+    case PMD_ERR_OpeningPort:			return "Error opening port";
+    case PMD_ERR_Driver:			return "Driver error";
+    case PMD_ERR_NoDPRAM:			return "Interface has no dual port RAM";
+    case PMD_ERR_DPRAM:				return "Dual port RAM error";
+    case PMD_ERR_Timeout:			return "Timeout";
+    case PMD_ERR_WaitCancelled:			return "Wait cancelled";
+    case PMD_ERR_CommunicationsError:		return "Communication error";
+    case PMD_ERR_CommTimeoutError:		return "Communication timeout";
+    case PMD_ERR_ChecksumError:			return "Checksum error";
+    case PMD_ERR_CommandError:			return "Command error";
+    }
+    return "Unknown error code";
+}
+
+}   // extern "C"
+
+#endif	// !defined(_WIN32) || defined(CMO_NATIVE_CMOTION)
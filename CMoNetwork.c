@@ -0,0 +1,700 @@
+// TCP and UDP transports for Ethernet attached devices, see CMoNetwork.h.
+
+#if defined(_WIN32)
+#   include <winsock2.h>
+#   include <ws2tcpip.h>
+#   if defined(_MSC_VER)
+#	pragma comment (lib, "ws2_32.lib")
+#   endif
+#   define poll WSAPoll
+#   define CloseSocket(s) closesocket((SOCKET)(s))
+#   define SocketError() WSAGetLastError()
+#   define WouldBlock(e) ((e) == WSAEWOULDBLOCK)
+#   define InProgress(e) ((e) == WSAEWOULDBLOCK)
+#   define Interrupted(e) 0
+#   define SEND_FLAGS 0
+#   define NO_SOCKET ((CMoSocket)INVALID_SOCKET)
+typedef int socklen_t;
+#else
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <netdb.h>
+#   include <poll.h>
+#   include <time.h>
+#   include <unistd.h>
+#   include <netinet/in.h>
+#   include <netinet/tcp.h>
+#   include <sys/socket.h>
+#   define CloseSocket(s) close(s)
+#   define SocketError() errno
+#   define WouldBlock(e) ((e) == EAGAIN || (e) == EWOULDBLOCK)
+#   define InProgress(e) ((e) == EINPROGRESS)
+#   define Interrupted(e) ((e) == EINTR)
+#   define SEND_FLAGS MSG_NOSIGNAL
+#   define NO_SOCKET (-1)
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CMoNetwork.h"
+
+// How long connecting may take.
+#define CMO_NETWORK_CONNECT_MS 2000
+
+// Defaults for a new connection.  A TCP window only has to cover the
+// round trip; UDP is kept smaller so that a lost burst costs less.
+#define CMO_NETWORK_TIMEOUT_MS 100
+#define CMO_NETWORK_TCP_WINDOW 32
+#define CMO_NETWORK_UDP_WINDOW 8
+#define CMO_NETWORK_RETRANSMITS 3
+
+// UDP frames are numbered within a batch by the low 16 bits, so longer
+// batches go out in pieces.
+#define CMO_NETWORK_UDP_BATCH 16384
+
+// Sequence number and a reply, or room for anything larger that shows up.
+#define CMO_NETWORK_DATAGRAM (2 + CMO_FRAME_BYTES + 16)
+
+static PMDuint32
+Now(void)
+{
+#if defined(_WIN32)
+    return (PMDuint32)GetTickCount();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (PMDuint32)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#endif
+}
+
+static int
+SetNonBlocking(CMoSocket s)
+{
+#if defined(_WIN32)
+    u_long on = 1;
+
+    return ioctlsocket((SOCKET)s, FIONBIO, &on) == 0;
+#else
+    int flags = fcntl(s, F_GETFL);
+
+    return flags != -1 && fcntl(s, F_SETFL, flags | O_NONBLOCK) != -1;
+#endif
+}
+
+static int
+Connect(CMoSocket s, const struct sockaddr* address, int length, int protocol)
+{
+    struct pollfd pfd;
+    socklen_t size;
+    int on = 1, error = 0;
+
+    if (!SetNonBlocking(s))
+    {
+	return 0;
+    }
+    if (protocol == CMoNetworkTCP)
+    {
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+    }
+    if (connect(s, address, length) == 0)
+    {
+	return 1;
+    }
+    if (!InProgress(SocketError()))
+    {
+	return 0;
+    }
+    pfd.fd = s;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, CMO_NETWORK_CONNECT_MS) != 1)
+    {
+	return 0;
+    }
+    size = sizeof(error);
+    return getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&error, &size) == 0 &&
+	error == 0;
+}
+
+PMDresult
+CMoNetwork_Open(PMDAxisHandle* handle, int protocol, const char* host, PMDuint16 port)
+{
+    struct addrinfo hints, *found, *ai;
+    CMoSocket s = NO_SOCKET;
+    CMoNetworkData* net;
+    char service[8];
+#if defined(_WIN32)
+    static int started = 0;
+    WSADATA wsa;
+
+    if (!started && WSAStartup(MAKEWORD(2, 2), &wsa) == 0)
+    {
+	started = 1;
+    }
+#endif
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = protocol == CMoNetworkUDP ? SOCK_DGRAM : SOCK_STREAM;
+    sprintf(service, "%u", (unsigned)port);
+    if (getaddrinfo(host, service, &hints, &found) != 0)
+    {
+	return PMD_ERR_OpeningPort;
+    }
+    for (ai = found; ai != NULL; ai = ai->ai_next)
+    {
+	s = (CMoSocket)socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+	if (s == NO_SOCKET)
+	{
+	    continue;
+	}
+	if (Connect(s, ai->ai_addr, (int)ai->ai_addrlen, protocol))
+	{
+	    break;
+	}
+	CloseSocket(s);
+	s = NO_SOCKET;
+    }
+    if (s == NO_SOCKET || ai->ai_addrlen > sizeof(net->address) ||
+	(net = (CMoNetworkData*)calloc(1, sizeof(CMoNetworkData))) == NULL)
+    {
+	if (s != NO_SOCKET)
+	{
+	    CloseSocket(s);
+	}
+	freeaddrinfo(found);
+	return PMD_ERR_OpeningPort;
+    }
+    memcpy(net->address, ai->ai_addr, ai->ai_addrlen);
+    net->addressLength = (int)ai->ai_addrlen;
+    net->family = ai->ai_family;
+    freeaddrinfo(found);
+
+    net->protocol = protocol;
+    net->socket = s;
+    net->timeout = CMO_NETWORK_TIMEOUT_MS;
+    net->window = protocol == CMoNetworkUDP
+	? CMO_NETWORK_UDP_WINDOW : CMO_NETWORK_TCP_WINDOW;
+    net->retransmits = CMO_NETWORK_RETRANSMITS;
+    net->retry.attempts = 1;
+
+    // Only now that there is something to replace it with.
+    if (handle->transport.Close != NULL && handle->transport_data != NULL)
+    {
+	handle->transport.Close(handle->transport_data);
+    }
+    memset(&handle->transport, 0, sizeof(handle->transport));
+    handle->transport.SendCommand = CMoNetwork_SendCommand;
+    handle->transport.Close = CMoNetwork_Close;
+    handle->transport_data = net;
+    return PMD_ERR_OK;
+}
+
+PMDresult
+CMoNetwork_Close(void* transport_data)
+{
+    CMoNetworkData* net = (CMoNetworkData*)transport_data;
+
+    if (net != NULL)
+    {
+	if (net->socket != NO_SOCKET)
+	{
+	    CloseSocket(net->socket);
+	}
+	free(net);
+    }
+    return PMD_ERR_OK;
+}
+
+CMoNetworkData*
+CMoNetwork_Clone(const CMoNetworkData* net)
+{
+    CMoNetworkData* clone;
+    CMoSocket s;
+
+    s = (CMoSocket)socket(net->family,
+	net->protocol == CMoNetworkUDP ? SOCK_DGRAM : SOCK_STREAM,
+	net->protocol == CMoNetworkUDP ? IPPROTO_UDP : IPPROTO_TCP);
+    if (s == NO_SOCKET)
+    {
+	return NULL;
+    }
+    if (!Connect(s, (const struct sockaddr*)net->address, net->addressLength,
+	    net->protocol) ||
+	(clone = (CMoNetworkData*)malloc(sizeof(CMoNetworkData))) == NULL)
+    {
+	CloseSocket(s);
+	return NULL;
+    }
+    *clone = *net;
+    clone->socket = s;
+    clone->sequence = (PMDuint16)(net->sequence + 0x8000);
+    clone->bReconnect = 0;
+    memset(&clone->stats, 0, sizeof(clone->stats));
+    return clone;
+}
+
+// ------------------------------------------------------------------------
+// Packets
+// ------------------------------------------------------------------------
+
+// The point-to-point layout PMDSerial_Send builds, with address 0.
+static int
+Encode(const CMoFrame* frame, PMDuint8* buffer)
+{
+    int c = 0, i;
+    PMDuint8 sum;
+
+    buffer[c++] = 0;
+    buffer[c++] = 0;
+    for (i = 0; i < frame->xCt; i++)
+    {
+	buffer[c++] = (PMDuint8)(frame->xDat[i] >> 8);
+	buffer[c++] = (PMDuint8)(frame->xDat[i] & 0xFF);
+    }
+    for (sum = 0, i = 0; i < c; i++)
+    {
+	sum += buffer[i];
+    }
+    buffer[1] = (PMDuint8)-sum;
+    return c;
+}
+
+// Bytes in the reply to frame, or 0 when fewer than that are there yet.
+// The data words only follow a zero status.
+static int
+ReplyLength(const CMoFrame* frame, const PMDuint8* rx, int have)
+{
+    int length;
+
+    if (have < 2)
+    {
+	return 0;
+    }
+    length = rx[0] ? 2 : 2 + 2 * frame->rCt;
+    return have < length ? 0 : length;
+}
+
+// Hand frame its reply; false when the checksum is wrong.
+static int
+Decode(CMoFrame* frame, const PMDuint8* rx, int length)
+{
+    PMDuint8 sum;
+    int i;
+
+    for (sum = 0, i = 0; i < length; i++)
+    {
+	sum += rx[i];
+    }
+    if (sum)
+    {
+	return 0;
+    }
+    frame->result = rx[0];
+    for (i = 0; i < frame->rCt && !rx[0]; i++)
+    {
+	frame->rDat[i] = (PMDuint16)((rx[2 + 2*i] << 8) | rx[3 + 2*i]);
+    }
+    return 1;
+}
+
+static PMDuint8
+Opcode(const CMoFrame* frame)
+{
+    return (PMDuint8)(frame->xDat[0] & 0xFF);
+}
+
+static void
+InFlight(CMoNetworkData* net, int count)
+{
+    if ((PMDuint32)count > net->stats.maxInFlight)
+    {
+	net->stats.maxInFlight = count;
+    }
+}
+
+// ------------------------------------------------------------------------
+// TCP
+// ------------------------------------------------------------------------
+
+// Start over on a new connection, leaving any late replies on the old one.
+static PMDresult
+Reconnect(CMoNetworkData* net)
+{
+    CMoSocket s;
+
+    if (net->socket != NO_SOCKET)
+    {
+	CloseSocket(net->socket);
+	net->socket = NO_SOCKET;
+    }
+    s = (CMoSocket)socket(net->family, SOCK_STREAM, IPPROTO_TCP);
+    if (s == NO_SOCKET)
+    {
+	return PMD_ERR_NotConnected;
+    }
+    if (!Connect(s, (const struct sockaddr*)net->address, net->addressLength,
+	    CMoNetworkTCP))
+    {
+	CloseSocket(s);
+	return PMD_ERR_NotConnected;
+    }
+    net->socket = s;
+    net->bReconnect = 0;
+    net->stats.reconnects++;
+    return PMD_ERR_OK;
+}
+
+// Write what the window allows in one send and read replies as they come,
+// in order, until every frame has one.
+static PMDresult
+SendStream(CMoNetworkData* net, CMoFrame* frames, int count)
+{
+    PMDuint8 rx[4 * CMO_FRAME_BYTES];
+    PMDuint8* tx;
+    int* offset;
+    int have = 0, pos, length, n, sent = 0, answered = 0, limit, written = 0;
+    struct pollfd pfd;
+    PMDresult result = PMD_ERR_OK;
+
+    tx = (PMDuint8*)malloc((size_t)count * CMO_FRAME_BYTES);
+    offset = (int*)malloc(((size_t)count + 1) * sizeof(int));
+    if (tx == NULL || offset == NULL)
+    {
+	free(tx);
+	free(offset);
+	return PMD_ERR_CommunicationsError;
+    }
+    for (offset[0] = 0, n = 0; n < count; n++)
+    {
+	offset[n + 1] = offset[n] + Encode(&frames[n], tx + offset[n]);
+    }
+    if (net->bReconnect && (result = Reconnect(net)) != PMD_ERR_OK)
+    {
+	answered = count;
+	for (n = 0; n < count; n++)
+	{
+	    frames[n].result = result;
+	}
+    }
+
+    while (answered < count && result == PMD_ERR_OK)
+    {
+	limit = answered + (int)net->window;
+	if (limit > count)
+	{
+	    limit = count;
+	}
+	pfd.fd = net->socket;
+	pfd.events = POLLIN | (written < offset[limit] ? POLLOUT : 0);
+	pfd.revents = 0;
+	n = poll(&pfd, 1, net->timeout);
+	if (n < 0)
+	{
+	    if (!Interrupted(SocketError()))
+	    {
+		result = PMD_ERR_CommunicationsError;
+	    }
+	    continue;
+	}
+	if (n == 0)
+	{
+	    result = PMD_ERR_CommTimeoutError;
+	    continue;
+	}
+
+	if ((pfd.revents & POLLOUT) && written < offset[limit])
+	{
+	    n = send(net->socket, (const char*)tx + written,
+		offset[limit] - written, SEND_FLAGS);
+	    if (n < 0 && !WouldBlock(SocketError()))
+	    {
+		result = PMD_ERR_NotConnected;
+		continue;
+	    }
+	    if (n > 0)
+	    {
+		written += n;
+		net->stats.bytesOut += n;
+		while (sent < limit && offset[sent + 1] <= written)
+		{
+		    sent++;
+		    net->stats.packets++;
+		}
+		InFlight(net, sent - answered);
+	    }
+	}
+
+	if (pfd.revents & (POLLIN | POLLERR | POLLHUP))
+	{
+	    n = recv(net->socket, (char*)rx + have, sizeof(rx) - have, 0);
+	    if (n == 0 || (n < 0 && !WouldBlock(SocketError())))
+	    {
+		result = PMD_ERR_NotConnected;
+		continue;
+	    }
+	    if (n > 0)
+	    {
+		have += n;
+		net->stats.bytesIn += n;
+	    }
+	    for (pos = 0; answered < count; pos += length, answered++)
+	    {
+		if ((length = ReplyLength(&frames[answered], rx + pos, have - pos)) == 0)
+		{
+		    break;
+		}
+		if (!Decode(&frames[answered], rx + pos, length))
+		{
+		    // Can't trust where the next reply starts.
+		    result = PMD_ERR_ChecksumError;
+		    break;
+		}
+	    }
+	    memmove(rx, rx + pos, have - pos);
+	    have -= pos;
+	}
+    }
+
+    // Whatever didn't come back gets the reason it didn't.
+    for (n = answered; n < count; n++)
+    {
+	frames[n].result = result;
+    }
+    if (result == PMD_ERR_CommTimeoutError)
+    {
+	net->stats.timeouts += count - answered;
+    }
+    if (result != PMD_ERR_OK)
+    {
+	net->bReconnect = 1;
+    }
+    free(tx);
+    free(offset);
+    return result;
+}
+
+// ------------------------------------------------------------------------
+// UDP
+// ------------------------------------------------------------------------
+
+typedef struct Flight {
+    PMDuint8 packet[2 + CMO_FRAME_BYTES];
+    int length;
+    PMDuint32 due;
+    PMDuint32 tries;
+    int done;
+} Flight;
+
+static void
+Transmit(CMoNetworkData* net, Flight* flight, PMDuint32 now)
+{
+    // A datagram that doesn't go out is as good as lost on the way, and
+    // gets retransmitted the same.
+    if (send(net->socket, (const char*)flight->packet, flight->length, SEND_FLAGS) > 0)
+    {
+	net->stats.bytesOut += flight->length;
+    }
+    flight->due = now + net->timeout;
+}
+
+static void
+Receive(CMoNetworkData* net, CMoFrame* frames, Flight* flights, int sent,
+    PMDuint16 base, int* inFlight, int* answered)
+{
+    PMDuint8 datagram[CMO_NETWORK_DATAGRAM];
+    int n, length, index;
+
+    while ((n = recv(net->socket, (char*)datagram, sizeof(datagram), 0)) > 0)
+    {
+	net->stats.bytesIn += n;
+	if (n < 4)
+	{
+	    continue;
+	}
+	index = (PMDuint16)(((datagram[0] << 8) | datagram[1]) - base);
+	if (index >= sent || flights[index].done)
+	{
+	    net->stats.duplicates++;
+	    continue;
+	}
+
+	// A damaged reply is left for the retransmit to replace.
+	length = ReplyLength(&frames[index], datagram + 2, n - 2);
+	if (length != n - 2 || !Decode(&frames[index], datagram + 2, length))
+	{
+	    continue;
+	}
+	flights[index].done = 1;
+	(*inFlight)--;
+	(*answered)++;
+    }
+}
+
+static PMDresult
+SendDatagrams(CMoNetworkData* net, CMoFrame* frames, int count)
+{
+    Flight* flights;
+    PMDuint16 base = net->sequence;
+    PMDuint32 now, wait;
+    int n, sent = 0, oldest = 0, inFlight = 0, answered = 0, alone = 0;
+    struct pollfd pfd;
+
+    if ((flights = (Flight*)calloc(count, sizeof(Flight))) == NULL)
+    {
+	return PMD_ERR_CommunicationsError;
+    }
+    for (n = 0; n < count; n++)
+    {
+	PMDuint16 sequence = (PMDuint16)(base + n);
+
+	flights[n].packet[0] = (PMDuint8)(sequence >> 8);
+	flights[n].packet[1] = (PMDuint8)(sequence & 0xFF);
+	flights[n].length = 2 + Encode(&frames[n], flights[n].packet + 2);
+    }
+    net->sequence = (PMDuint16)(base + count);
+
+    while (answered < count)
+    {
+	// Reads share the window; anything else goes on its own.
+	now = Now();
+	if (inFlight == 0)
+	{
+	    alone = 0;
+	}
+	while (sent < count && inFlight < (int)net->window && !alone &&
+	    (inFlight == 0 || CMoOpcodes_IsRead(Opcode(&frames[sent]))))
+	{
+	    alone = !CMoOpcodes_IsRead(Opcode(&frames[sent]));
+	    Transmit(net, &flights[sent++], now);
+	    net->stats.packets++;
+	    InFlight(net, ++inFlight);
+	}
+
+	// Until a reply comes in or the oldest packet is due again.
+	wait = net->timeout;
+	for (n = oldest; n < sent; n++)
+	{
+	    if (!flights[n].done)
+	    {
+		PMDint32 left = (PMDint32)(flights[n].due - now);
+		if (left < (PMDint32)wait)
+		{
+		    wait = left > 0 ? left : 0;
+		}
+	    }
+	}
+	pfd.fd = net->socket;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, wait) > 0)
+	{
+	    Receive(net, frames, flights, sent, base, &inFlight, &answered);
+	}
+
+	now = Now();
+	for (n = oldest; n < sent; n++)
+	{
+	    Flight* flight = &flights[n];
+
+	    if (flight->done || (PMDint32)(flight->due - now) > 0)
+	    {
+		continue;
+	    }
+	    if (flight->tries < net->retransmits &&
+		CMoOpcodes_CanRepeat(Opcode(&frames[n])))
+	    {
+		flight->tries++;
+		net->stats.retransmits++;
+		Transmit(net, flight, now);
+		continue;
+	    }
+	    if (!CMoOpcodes_CanRepeat(Opcode(&frames[n])))
+	    {
+		net->stats.refused++;
+	    }
+	    frames[n].result = PMD_ERR_CommTimeoutError;
+	    net->stats.timeouts++;
+	    flight->done = 1;
+	    inFlight--;
+	    answered++;
+	}
+	while (oldest < sent && flights[oldest].done)
+	{
+	    oldest++;
+	}
+    }
+    free(flights);
+    return PMD_ERR_OK;
+}
+
+// ------------------------------------------------------------------------
+// PMDIOTransport
+// ------------------------------------------------------------------------
+
+PMDresult
+CMoNetwork_SendFrames(void* transport_data, CMoFrame* frames, int count)
+{
+    CMoNetworkData* net = (CMoNetworkData*)transport_data;
+    PMDresult first = PMD_ERR_OK;
+    int n, piece;
+
+    for (n = 0; n < count; n++)
+    {
+	if (frames[n].xCt > CMO_FRAME_WORDS || frames[n].rCt > CMO_FRAME_WORDS)
+	{
+	    for (n = 0; n < count; n++)
+	    {
+		frames[n].result = PMD_ERR_CommandError;
+	    }
+	    return PMD_ERR_CommandError;
+	}
+    }
+    if (count <= 0)
+    {
+	return PMD_ERR_OK;
+    }
+    net->stats.batches++;
+    if (net->protocol == CMoNetworkTCP)
+    {
+	SendStream(net, frames, count);
+    }
+    else
+    {
+	for (n = 0; n < count; n += piece)
+	{
+	    piece = count - n < CMO_NETWORK_UDP_BATCH
+		? count - n : CMO_NETWORK_UDP_BATCH;
+	    SendDatagrams(net, frames + n, piece);
+	}
+    }
+
+    for (n = 0; n < count && first == PMD_ERR_OK; n++)
+    {
+	first = frames[n].result;
+    }
+    return first;
+}
+
+PMDresult
+CMoNetwork_SendCommand(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat)
+{
+    CMoFrame frame;
+    PMDresult result;
+
+    if (xCt > CMO_FRAME_WORDS || rCt > CMO_FRAME_WORDS)
+    {
+	return PMD_ERR_CommandError;
+    }
+    frame.xCt = xCt;
+    frame.rCt = rCt;
+    memcpy(frame.xDat, xDat, xCt * sizeof(PMDuint16));
+    frame.result = PMD_ERR_OK;
+    if ((result = CMoNetwork_SendFrames(transport_data, &frame, 1)) == PMD_ERR_OK)
+    {
+	memcpy(rDat, frame.rDat, rCt * sizeof(PMDuint16));
+    }
+    return result;
+}
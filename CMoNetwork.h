@@ -0,0 +1,99 @@
+#ifndef INC_CMoNetwork_h__
+#define INC_CMoNetwork_h__
+
+// TCP and UDP transports carrying the point-to-point serial packets.
+//
+// This is not the framing of PMD's own Ethernet products, which speak the
+// PMD Resource Protocol through C-Motion.dll (pmd::device, CMoDevice.hpp);
+// neither transport here can talk to one of those.  Both carry the serial
+// packets unchanged: address, checksum, then big endian words out;
+// status, checksum and the reply words back.  Over TCP that is a byte
+// stream just like the serial line, with Nagle turned off, which a serial
+// device server passing bytes through in raw mode also carries to a
+// drive's serial port.  Over UDP each datagram is a two byte sequence
+// number followed by one packet, and the reply carries the same number;
+// only the emulator in bench/CMoNetworkBench.cpp answers that.
+//
+// Up to -window packets are kept in flight at once.  Over TCP everything
+// the window allows goes out in a single send and arrives in order.  A
+// TCP reply has nothing but its place in the stream to say which packet
+// it answers, so after a timeout or a bad reply the next batch starts on
+// a new connection rather than risk taking a late reply for its own.
+//
+// Datagrams can overtake one another, so over UDP only reads share the
+// window.  Anything that isn't a read (CMoOpcodes.hpp) goes out alone,
+// once everything before it is answered, and nothing follows it until it
+// is, so a setting and the Update after it can't run the wrong way round.
+// A packet that isn't answered within -timeout is sent again, at most
+// -retransmits times, but only if its opcode may reach the chip twice.  A
+// once-only packet that goes unanswered may have run already, so it fails
+// with a timeout instead and is counted as refused.
+
+#include <stddef.h>
+#include "CMoTransport.h"
+#include "c-motion/PMDW32Ser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {CMoNetworkTCP, CMoNetworkUDP};
+
+// A SOCKET is pointer sized on Windows.
+#if defined(_WIN32)
+typedef size_t CMoSocket;
+#else
+typedef int CMoSocket;
+#endif
+
+// PMD's Ethernet products listen here.  NetworkConnect and pmd::device's
+// Connect tcp default to it.
+#define CMO_NETWORK_PORT 40100
+
+typedef struct CMoNetworkStats {
+    PMDuint32 batches;
+    PMDuint32 packets;		// sent, first time round
+    PMDuint32 retransmits;
+    PMDuint32 refused;		// UDP only, unanswered and once only
+    PMDuint32 duplicates;	// replies for packets already answered
+    PMDuint32 timeouts;		// packets that never got a reply
+    PMDuint32 reconnects;	// TCP only, after a timeout or a bad reply
+    PMDuint32 maxInFlight;
+    PMDuint32 bytesOut;
+    PMDuint32 bytesIn;
+} CMoNetworkStats;
+
+typedef struct CMoNetworkData {
+    int protocol;
+    CMoSocket socket;
+    PMDuint32 timeout;		// ms to wait for a reply
+    PMDuint32 window;		// packets in flight at most
+    PMDuint32 retransmits;	// UDP only
+    PMDSerialRetry retry;	// after a failed call, see CMoRetry.hpp
+    PMDuint16 sequence;		// UDP only, the next one to use
+    int bReconnect;		// TCP only, replies may be out of step
+    PMDuint8 address[128];	// where to connect again, a sockaddr
+    int addressLength;
+    int family;
+    CMoNetworkStats stats;
+} CMoNetworkData;
+
+// Connect handle to host:port over protocol, replacing whatever transport
+// it had.  handle->transport.Close frees the CMoNetworkData.
+PMDresult CMoNetwork_Open(PMDAxisHandle* handle, int protocol, const char* host, PMDuint16 port);
+
+PMDresult CMoNetwork_SendCommand(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat);
+PMDresult CMoNetwork_SendFrames(void* transport_data, CMoFrame* frames, int count);
+PMDresult CMoNetwork_Close(void* transport_data);
+
+// A second connection to the same device with the same settings, for the
+// stops of CMoStop.hpp, so they don't wait behind whatever the first one
+// has in flight.  UDP sequence numbers start half way round from the
+// first connection's.  NULL if it can't be had; CMoNetwork_Close frees it.
+CMoNetworkData* CMoNetwork_Clone(const CMoNetworkData* net);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// #ifndef INC_CMoNetwork_h__
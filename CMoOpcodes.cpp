@@ -0,0 +1,21 @@
+/*
+ * CMoOpcodes.cpp --
+ *
+ *	The parts of the opcode table the C transports need.  See
+ *	CMoOpcodes.hpp.
+ */
+
+#include "CMoOpcodes.hpp"
+#include "CMoTransport.h"
+
+int
+CMoOpcodes_IsRead(PMDuint8 opcode)
+{
+    return CMoOpcodes[opcode].repeat == CMoRepeatRead;
+}
+
+int
+CMoOpcodes_CanRepeat(PMDuint8 opcode)
+{
+    return CMoOpcodes[opcode].repeat != CMoRepeatOnce;
+}
@@ -0,0 +1,327 @@
+/*
+ * CMoOpcodes.hpp --
+ *
+ *	The Magellan instruction set as a table of descriptors.
+ *
+ * Every C-Motion call is one packet: a command word holding the axis and
+ * the opcode, a fixed number of argument words and a fixed number of reply
+ * words.  The table below records those counts once, so the native C-Motion
+ * layer (CMoNative.cpp) can check each wrapper against it at compile time
+ * and the transports can size a reply from the opcode alone.  The counts
+ * were taken from the Programmer's Command Reference and agree with what
+ * C-Motion.dll 5.x puts on the wire.
+ *
+ * Each opcode also says what happens if the chip gets it twice, which is
+ * what decides whether a packet that may or may not have arrived can be
+ * sent again (CMoRetry.hpp).
+ */
+#ifndef INC_CMoOpcodes_hpp__
+#define INC_CMoOpcodes_hpp__
+
+#include "c-motion/PMDtypes.h"
+
+// X(opcode, name, argument words, reply words)
+//
+// A few opcodes are reachable under a second C-Motion name; those are
+// listed once under the name the reference manual uses:
+//   SetMotorLimit/GetMotorLimit           also Set/GetCurrentLimit
+//   SetCurrent/GetCurrent                 also Set/GetHoldingCurrent
+//   SetDriveFaultParameter/GetDrive...    also Set/GetBusVoltageLimits
+//   GetVersion                            also GetVersion32
+//
+#define CMO_OPCODES(X) \
+    X(0x00, NoOperation, 0, 0) \
+    X(0x01, GetProductInfo, 1, 2) \
+    X(0x02, SetMotorType, 1, 0) \
+    X(0x03, GetMotorType, 0, 1) \
+    X(0x06, SetMotorLimit, 1, 0) \
+    X(0x07, GetMotorLimit, 0, 1) \
+    X(0x08, SetAuxiliaryEncoderSource, 1, 0) \
+    X(0x09, GetAuxiliaryEncoderSource, 0, 1) \
+    X(0x0A, SetSPIMode, 1, 0) \
+    X(0x0B, GetSPIMode, 0, 1) \
+    X(0x0C, SetPWMFrequency, 1, 0) \
+    X(0x0D, GetPWMFrequency, 0, 1) \
+    X(0x0E, GetDriveStatus, 0, 1) \
+    X(0x0F, SetMotorBias, 1, 0) \
+    X(0x10, SetPosition, 2, 0) \
+    X(0x11, SetVelocity, 2, 0) \
+    X(0x12, SetCANMode, 1, 0) \
+    X(0x13, SetJerk, 2, 0) \
+    X(0x14, SetGearRatio, 2, 0) \
+    X(0x15, GetCANMode, 0, 1) \
+    X(0x16, SetProfileParameter, 3, 0) \
+    X(0x17, GetProfileParameter, 1, 2) \
+    X(0x1A, Update, 0, 0) \
+    X(0x1B, SetOvertemperatureLimit, 1, 0) \
+    X(0x1C, GetOvertemperatureLimit, 0, 1) \
+    X(0x1D, GetCommandedPosition, 0, 2) \
+    X(0x1E, GetCommandedVelocity, 0, 2) \
+    X(0x21, SetFeedbackParameter, 3, 0) \
+    X(0x22, GetFeedbackParameter, 1, 2) \
+    X(0x23, SetDrivePWM, 2, 0) \
+    X(0x24, GetDrivePWM, 1, 1) \
+    X(0x28, GetTraceValue, 1, 2) \
+    X(0x29, SetAnalogCalibration, 2, 0) \
+    X(0x2A, GetAnalogCalibration, 1, 1) \
+    X(0x2C, GetPhaseAngle, 0, 1) \
+    X(0x2D, GetMotorBias, 0, 1) \
+    X(0x2E, RestoreOperatingMode, 0, 0) \
+    X(0x2F, SetInterruptMask, 1, 0) \
+    X(0x30, DriveNVRAM, 2, 0) \
+    X(0x31, GetEventStatus, 0, 1) \
+    X(0x32, SetBreakpointUpdateMask, 2, 0) \
+    X(0x33, GetBreakpointUpdateMask, 1, 1) \
+    X(0x34, ResetEventStatus, 1, 0) \
+    X(0x35, ExecutionControl, 3, 0) \
+    X(0x36, GetCaptureValue, 0, 2) \
+    X(0x37, GetActualPosition, 0, 2) \
+    X(0x38, GetLoopValue, 1, 2) \
+    X(0x39, Reset, 0, 0) \
+    X(0x3A, GetActiveMotorCommand, 0, 1) \
+    X(0x3B, SetSampleTime, 2, 0) \
+    X(0x3C, GetSampleTime, 0, 2) \
+    X(0x3D, GetRuntimeError, 0, 1) \
+    X(0x3E, GetTime, 0, 2) \
+    X(0x40, GetBusVoltage, 0, 1) \
+    X(0x41, SetCurrentFoldback, 2, 0) \
+    X(0x42, GetCurrentFoldback, 1, 1) \
+    X(0x43, SetCurrentControlMode, 1, 0) \
+    X(0x44, GetCurrentControlMode, 0, 1) \
+    X(0x45, SetAxisOutMask, 3, 0) \
+    X(0x46, GetAxisOutMask, 0, 3) \
+    X(0x47, ClearPositionError, 0, 0) \
+    X(0x48, SetEventAction, 2, 0) \
+    X(0x49, GetEventAction, 1, 1) \
+    X(0x4A, GetPosition, 0, 2) \
+    X(0x4B, GetVelocity, 0, 2) \
+    X(0x4C, GetAcceleration, 0, 2) \
+    X(0x4D, SetActualPosition, 2, 0) \
+    X(0x53, GetTemperature, 0, 1) \
+    X(0x55, GetPositionLoopValue, 1, 2) \
+    X(0x56, GetInterruptMask, 0, 1) \
+    X(0x57, GetActiveOperatingMode, 0, 1) \
+    X(0x58, GetJerk, 0, 2) \
+    X(0x59, GetGearRatio, 0, 2) \
+    X(0x5A, GetFOCValue, 1, 2) \
+    X(0x5B, MultiUpdate, 1, 0) \
+    X(0x5E, SetCurrent, 2, 0) \
+    X(0x5F, GetCurrent, 1, 1) \
+    X(0x60, GetDriveFaultParameter, 1, 1) \
+    X(0x62, SetDriveFaultParameter, 2, 0) \
+    X(0x63, SetCommutationParameter, 3, 0) \
+    X(0x64, GetCommutationParameter, 1, 2) \
+    X(0x65, SetOperatingMode, 1, 0) \
+    X(0x66, GetOperatingMode, 0, 1) \
+    X(0x67, SetPositionLoop, 3, 0) \
+    X(0x68, GetPositionLoop, 1, 2) \
+    X(0x69, GetMotorCommand, 0, 1) \
+    X(0x6A, SetStartVelocity, 2, 0) \
+    X(0x6B, GetStartVelocity, 0, 2) \
+    X(0x6C, ClearDriveFaultStatus, 0, 0) \
+    X(0x6D, GetDriveFaultStatus, 0, 1) \
+    X(0x6E, GetOutputMode, 0, 1) \
+    X(0x6F, CalibrateAnalog, 1, 0) \
+    X(0x70, GetDriveValue, 1, 1) \
+    X(0x71, GetCurrentLoopValue, 1, 2) \
+    X(0x72, SetPhaseInitializeTime, 1, 0) \
+    X(0x73, SetCurrentLoop, 2, 0) \
+    X(0x74, GetCurrentLoop, 1, 1) \
+    X(0x75, SetPhaseCounts, 1, 0) \
+    X(0x76, SetPhaseOffset, 1, 0) \
+    X(0x77, SetMotorCommand, 1, 0) \
+    X(0x78, SetLoop, 3, 0) \
+    X(0x79, GetLoop, 1, 2) \
+    X(0x7A, InitializePhase, 0, 0) \
+    X(0x7B, GetPhaseOffset, 0, 1) \
+    X(0x7C, GetPhaseInitializeTime, 0, 1) \
+    X(0x7D, GetPhaseCounts, 0, 1) \
+    X(0x7E, SetDriveCommandMode, 1, 0) \
+    X(0x7F, GetDriveCommandMode, 0, 1) \
+    X(0x82, WriteIO, 2, 0) \
+    X(0x83, ReadIO, 1, 1) \
+    X(0x84, SetPhaseAngle, 1, 0) \
+    X(0x85, SetPhaseParameter, 2, 0) \
+    X(0x86, GetPhaseParameter, 1, 1) \
+    X(0x89, SetDefault, 3, 0) \
+    X(0x8A, GetDefault, 1, 2) \
+    X(0x8B, SetSerialPortMode, 1, 0) \
+    X(0x8C, GetSerialPortMode, 0, 1) \
+    X(0x8D, SetEncoderModulus, 1, 0) \
+    X(0x8E, GetEncoderModulus, 0, 1) \
+    X(0x8F, GetVersion, 0, 2) \
+    X(0x90, SetAcceleration, 2, 0) \
+    X(0x91, SetDeceleration, 2, 0) \
+    X(0x92, GetDeceleration, 0, 2) \
+    X(0x97, SetPositionErrorLimit, 2, 0) \
+    X(0x98, GetPositionErrorLimit, 0, 2) \
+    X(0x99, GetPositionError, 0, 2) \
+    X(0xA0, SetProfileMode, 1, 0) \
+    X(0xA1, GetProfileMode, 0, 1) \
+    X(0xA2, SetSignalSense, 1, 0) \
+    X(0xA3, GetSignalSense, 0, 1) \
+    X(0xA4, GetSignalStatus, 0, 1) \
+    X(0xA5, GetInstructionError, 0, 1) \
+    X(0xA6, GetActivityStatus, 0, 1) \
+    X(0xA7, GetCommandedAcceleration, 0, 2) \
+    X(0xA8, SetTrackingWindow, 1, 0) \
+    X(0xA9, GetTrackingWindow, 0, 1) \
+    X(0xAA, SetSettleTime, 1, 0) \
+    X(0xAB, GetSettleTime, 0, 1) \
+    X(0xAC, ClearInterrupt, 0, 0) \
+    X(0xAD, GetActualVelocity, 0, 2) \
+    X(0xAE, SetGearMaster, 1, 0) \
+    X(0xAF, GetGearMaster, 0, 1) \
+    X(0xB0, SetTraceMode, 1, 0) \
+    X(0xB1, GetTraceMode, 0, 1) \
+    X(0xB2, SetTraceStart, 1, 0) \
+    X(0xB3, GetTraceStart, 0, 1) \
+    X(0xB4, SetTraceStop, 1, 0) \
+    X(0xB5, GetTraceStop, 0, 1) \
+    X(0xB6, SetTraceVariable, 2, 0) \
+    X(0xB7, GetTraceVariable, 1, 1) \
+    X(0xB8, SetTracePeriod, 1, 0) \
+    X(0xB9, GetTracePeriod, 0, 1) \
+    X(0xBA, GetTraceStatus, 0, 1) \
+    X(0xBB, GetTraceCount, 0, 2) \
+    X(0xBC, SetSettleWindow, 1, 0) \
+    X(0xBD, GetSettleWindow, 0, 1) \
+    X(0xBE, SetActualPositionUnits, 1, 0) \
+    X(0xBF, GetActualPositionUnits, 0, 1) \
+    X(0xC0, SetBufferStart, 3, 0) \
+    X(0xC1, GetBufferStart, 1, 2) \
+    X(0xC2, SetBufferLength, 3, 0) \
+    X(0xC3, GetBufferLength, 1, 2) \
+    X(0xC4, SetBufferWriteIndex, 3, 0) \
+    X(0xC5, GetBufferWriteIndex, 1, 2) \
+    X(0xC6, SetBufferReadIndex, 3, 0) \
+    X(0xC7, GetBufferReadIndex, 1, 2) \
+    X(0xC8, WriteBuffer, 3, 0) \
+    X(0xC9, ReadBuffer, 1, 2) \
+    X(0xCD, ReadBuffer16, 1, 1) \
+    X(0xCE, GetStepRange, 0, 1) \
+    X(0xCF, SetStepRange, 1, 0) \
+    X(0xD0, SetStopMode, 1, 0) \
+    X(0xD1, GetStopMode, 0, 1) \
+    X(0xD4, SetBreakpoint, 2, 0) \
+    X(0xD5, GetBreakpoint, 1, 1) \
+    X(0xD6, SetBreakpointValue, 3, 0) \
+    X(0xD7, GetBreakpointValue, 1, 2) \
+    X(0xD8, SetCaptureSource, 1, 0) \
+    X(0xD9, GetCaptureSource, 0, 1) \
+    X(0xDA, SetEncoderSource, 1, 0) \
+    X(0xDB, GetEncoderSource, 0, 1) \
+    X(0xDE, SetEncoderToStepRatio, 2, 0) \
+    X(0xDF, GetEncoderToStepRatio, 0, 2) \
+    X(0xE0, SetOutputMode, 1, 0) \
+    X(0xE1, GetInterruptAxis, 0, 1) \
+    X(0xE2, SetCommutationMode, 1, 0) \
+    X(0xE3, GetCommutationMode, 0, 1) \
+    X(0xE4, SetPhaseInitializeMode, 1, 0) \
+    X(0xE5, GetPhaseInitializeMode, 0, 1) \
+    X(0xE6, SetPhasePrescale, 1, 0) \
+    X(0xE7, GetPhasePrescale, 0, 1) \
+    X(0xE8, SetPhaseCorrectionMode, 1, 0) \
+    X(0xE9, GetPhaseCorrectionMode, 0, 1) \
+    X(0xEA, GetPhaseCommand, 1, 1) \
+    X(0xEB, SetMotionCompleteMode, 1, 0) \
+    X(0xEC, GetMotionCompleteMode, 0, 1) \
+    X(0xEF, ReadAnalog, 1, 1) \
+    X(0xF2, SetSynchronizationMode, 1, 0) \
+    X(0xF3, GetSynchronizationMode, 0, 1) \
+    X(0xF5, AdjustActualPosition, 2, 0) \
+    X(0xF6, SetFOC, 2, 0) \
+    X(0xF7, GetFOC, 1, 1) \
+    X(0xF8, GetChecksum, 0, 2) \
+    X(0xF9, SetUpdateMask, 1, 0) \
+    X(0xFA, GetUpdateMask, 0, 1) \
+    X(0xFB, SetFaultOutMask, 1, 0) \
+    X(0xFC, GetFaultOutMask, 0, 1)
+
+// Opcodes that are neither queries nor settings: each one adds to,
+// advances, clears or starts something, so a second copy does more than
+// the first.  That takes in the reads that clear what they return:
+// GetCaptureValue re-arms the capture, and GetInstructionError and
+// GetRuntimeError clear the error, so a second copy, or one nobody asked
+// for, loses it.  Everything else named Get* (plus the few reads below)
+// has no effect at all, and the rest write an absolute value.
+#define CMO_ONCE_OPCODES(X) \
+    X(DriveNVRAM) X(ResetEventStatus) X(ExecutionControl) X(Reset) \
+    X(ClearDriveFaultStatus) X(CalibrateAnalog) X(InitializePhase) \
+    X(ClearInterrupt) X(WriteBuffer) X(ReadBuffer) X(ReadBuffer16) \
+    X(AdjustActualPosition) X(GetCaptureValue) X(GetInstructionError) \
+    X(GetRuntimeError)
+
+enum CMoRepeat
+{
+    CMoRepeatOnce,	// must not be applied twice, and unknown opcodes
+    CMoRepeatSet,	// twice is the same as once
+    CMoRepeatRead	// no effect on the chip
+};
+
+namespace CMoOp
+{
+#define CMO_OPCODE_ENUM(op, name, x, r) name = op,
+    enum : PMDuint8
+    {
+	CMO_OPCODES(CMO_OPCODE_ENUM)
+    };
+#undef CMO_OPCODE_ENUM
+}
+
+struct CMoOpcode
+{
+    PMDuint8 xWords = 0;    // argument words, not counting the command word
+    PMDuint8 rWords = 0;    // reply words when the status is good
+    PMDuint8 repeat = CMoRepeatOnce;
+    const char* name = 0L;  // 0L for an opcode the table doesn't know
+};
+
+// The descriptors indexed directly by opcode.  Built at compile time so a
+// lookup is a single load and can be folded into constant expressions.
+class CMoOpcodeTable
+{
+public:
+    constexpr CMoOpcodeTable()
+    {
+#define CMO_OPCODE_ENTRY(op, label, x, r) \
+	entry[op].xWords = x; entry[op].rWords = r; entry[op].name = #label; \
+	entry[op].repeat = IsRead(#label) ? CMoRepeatRead : CMoRepeatSet;
+	CMO_OPCODES(CMO_OPCODE_ENTRY)
+#undef CMO_OPCODE_ENTRY
+#define CMO_ONCE_ENTRY(label) entry[CMoOp::label].repeat = CMoRepeatOnce;
+	CMO_ONCE_OPCODES(CMO_ONCE_ENTRY)
+#undef CMO_ONCE_ENTRY
+    }
+
+    constexpr const CMoOpcode& operator[](PMDuint8 op) const
+    {
+	return entry[op];
+    }
+
+private:
+    static constexpr bool Is(const char* name, const char* prefix)
+    {
+	return *prefix == 0 || (*name == *prefix && Is(name + 1, prefix + 1));
+    }
+
+    static constexpr bool IsRead(const char* name)
+    {
+	return Is(name, "Get") || Is(name, "NoOperation") ||
+	    Is(name, "ReadIO") || Is(name, "ReadAnalog");
+    }
+
+    CMoOpcode entry[256];
+};
+
+constexpr CMoOpcodeTable CMoOpcodes;
+
+// True when 'op' is known and takes exactly x argument and r reply words.
+constexpr bool
+CMoOpcodeShape(PMDuint8 op, int x, int r)
+{
+    return CMoOpcodes[op].name != 0L &&
+	CMoOpcodes[op].xWords == x && CMoOpcodes[op].rWords == r;
+}
+
+#endif	// #ifndef INC_CMoOpcodes_hpp__
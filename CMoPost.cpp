@@ -0,0 +1,179 @@
+/*
+ * CMoPost.cpp --
+ *
+ *	Calls answered by a Tcl event.  See CMoPost.hpp.
+ */
+
+#include "CMoPost.hpp"
+#include "CMoPrefetch.hpp"
+#include "CMoRetry.hpp"
+#include "CMoReconnect.hpp"
+#include "CMoReplyStamp.h"
+
+CMoPost::CMoPost(Tcl_Interp* _interp, CMoProgram::AxisLookup _lookup,
+	ClientData _lookupData, Tcl_Obj* _axisName, CMoAxis::Method _method,
+	Tcl_Obj* _words, Tcl_Obj* _command)
+    : interp(_interp), thread(Tcl_GetCurrentThread()), lookup(_lookup),
+    lookupData(_lookupData), axisName(_axisName), method(_method),
+    words(_words), command(_command)
+{
+    Tcl_Preserve(interp);
+    Tcl_IncrRefCount(axisName);
+    Tcl_IncrRefCount(words);
+    if (command != 0L) Tcl_IncrRefCount(command);
+}
+
+CMoPost::~CMoPost()
+{
+    Tcl_DecrRefCount(axisName);
+    Tcl_DecrRefCount(words);
+    if (command != 0L) Tcl_DecrRefCount(command);
+    Tcl_Release(interp);
+}
+
+int
+CMoPost::Start(Tcl_Interp* interp, CMoProgram::AxisLookup lookup,
+	ClientData lookupData, Tcl_Obj* axisName, CMoAxis::Method method,
+	Tcl_Obj* words, Tcl_Obj* command, int priority)
+{
+    CMoPost* post;
+    CMoAxis* axis;
+    PMDAxisHandle* handle;
+    int code;
+
+    if ((axis = lookup(lookupData, interp, axisName)) == 0L)
+    {
+	return TCL_ERROR;
+    }
+    post = new CMoPost(interp, lookup, lookupData, axisName, method, words,
+	command);
+
+    // The method checks its arguments now, so a bad call is an error
+    // here and not in the callback.
+    post->capture.Record();
+    axis->BeginCapture(&post->capture);
+    code = axis->Invoke(interp, method, words);
+    axis->EndCapture();
+    if (code != TCL_OK)
+    {
+	delete post;
+	return TCL_ERROR;
+    }
+    Tcl_ResetResult(interp);
+
+    post->request.tx = 0L;
+    post->request.txLen = 0;
+    post->request.frames = post->capture.frames.empty() ? 0L
+	: &post->capture.frames[0];
+    post->request.count = static_cast<int>(post->capture.frames.size());
+    post->request.priority = priority;
+    post->request.stamp = 0;
+    post->request.done = Done;
+    post->request.clientData = post;
+
+    handle = axis->Handle();
+    if (!CMoReactor::Submit(handle, &post->request))
+    {
+	if (post->request.count > 0)
+	{
+	    CMoTransport_SendFrames(handle, post->request.frames,
+		post->request.count);
+	}
+	post->Queue();
+    }
+    return TCL_OK;
+}
+
+// On the reactor thread.
+void
+CMoPost::Done(CMoReactor::Request* request)
+{
+    static_cast<CMoPost*>(request->clientData)->Queue();
+}
+
+// Hand the post back to the thread that made it.
+void
+CMoPost::Queue()
+{
+    Event* event = (Event*)ckalloc(sizeof(Event));
+
+    event->header.proc = EventProc;
+    event->post = this;
+    Tcl_ThreadQueueEvent(thread, &event->header, TCL_QUEUE_TAIL);
+    Tcl_ThreadAlert(thread);
+}
+
+int
+CMoPost::EventProc(Tcl_Event* evPtr, int flags)
+{
+    CMoPost* post = ((Event*)evPtr)->post;
+
+    if (!(flags & TCL_FILE_EVENTS))
+    {
+	return 0;
+    }
+    post->Finish();
+    delete post;
+    return 1;
+}
+
+void
+CMoPost::Finish()
+{
+    CMoAxis* axis;
+    Tcl_Obj *script, *result;
+    Tcl_InterpState state;
+    int code;
+
+    if (Tcl_InterpDeleted(interp))
+    {
+	return;
+    }
+
+    // Whatever the interp was in the middle of keeps its result.
+    state = Tcl_SaveInterpState(interp, TCL_OK);
+    if (request.stamp != 0)
+    {
+	CMoReplyStamp_Set(request.stamp);
+    }
+
+    // Let the method decode its own replies, if the axis is still there.
+    if ((axis = lookup(lookupData, interp, axisName)) != 0L)
+    {
+	CMoRetry::Frames(axis->Handle(), request.frames, request.count);
+	CMoReconnect::Record(axis->Handle(), request.frames, request.count);
+	CMoPrefetch::Sent(axis->Handle(), request.frames, request.count);
+	capture.Replay(request.frames, request.count);
+	axis->BeginCapture(&capture);
+	code = axis->Invoke(interp, method, words);
+	axis->EndCapture();
+    }
+    else
+    {
+	code = TCL_ERROR;
+    }
+    result = Tcl_GetObjResult(interp);
+    Tcl_IncrRefCount(result);
+    Tcl_ResetResult(interp);
+
+    if (command != 0L)
+    {
+	script = Tcl_DuplicateObj(command);
+	Tcl_IncrRefCount(script);
+	Tcl_ListObjAppendElement(0L, script,
+	    Tcl_NewStringObj(code == TCL_OK ? "ok" : "error", -1));
+	Tcl_ListObjAppendElement(0L, script, result);
+	if (Tcl_EvalObjEx(interp, script, TCL_EVAL_GLOBAL) == TCL_ERROR)
+	{
+	    Tcl_BackgroundError(interp);
+	}
+	Tcl_DecrRefCount(script);
+    }
+    else if (code != TCL_OK)
+    {
+	Tcl_SetObjResult(interp, result);
+	Tcl_BackgroundError(interp);
+    }
+    Tcl_DecrRefCount(result);
+    Tcl_RestoreInterpState(interp, state);
+}
@@ -0,0 +1,61 @@
+/*
+ * CMoPost.hpp --
+ *
+ *	One call made by [cmotion::post ?-command script? axis method ?arg ...?].
+ *
+ * The call is checked and recorded the way a batch entry is, its packets
+ * go to the reactor (CMoReactor.hpp) and the script carries on.  When the
+ * replies are in, a Tcl event brings them back to the thread that posted
+ * the call, the method decodes them as usual, and the -command script is
+ * called with two more words: "ok" and the result, or "error" and the
+ * message.  Without -command an error goes to [interp bgerror].  The
+ * packets are queued in the given priority class (CMoPriority.h).
+ *
+ * Posting leaves the axis' port as it is.  Only an axis attached with
+ * [cmotion::reactor attach axis] goes through the reactor; any other is
+ * sent to at once and only the answer is deferred.
+ */
+#ifndef INC_CMoPost_hpp__
+#define INC_CMoPost_hpp__
+
+#include "CMoProgram.hpp"
+#include "CMoReactor.hpp"
+
+class CMoPost
+{
+public:
+    static int Start(Tcl_Interp* interp, CMoProgram::AxisLookup lookup,
+	    ClientData lookupData, Tcl_Obj* axisName, CMoAxis::Method method,
+	    Tcl_Obj* words, Tcl_Obj* command, int priority);
+
+private:
+    struct Event
+    {
+	Tcl_Event header;
+	CMoPost* post;
+    };
+
+    CMoPost(Tcl_Interp* interp, CMoProgram::AxisLookup lookup,
+	    ClientData lookupData, Tcl_Obj* axisName, CMoAxis::Method method,
+	    Tcl_Obj* words, Tcl_Obj* command);
+    ~CMoPost();
+
+    void Queue();
+    void Finish();
+
+    static void Done(CMoReactor::Request* request);
+    static int EventProc(Tcl_Event* evPtr, int flags);
+
+    Tcl_Interp* interp;
+    Tcl_ThreadId thread;
+    CMoProgram::AxisLookup lookup;
+    ClientData lookupData;
+    Tcl_Obj* axisName;
+    CMoAxis::Method method;
+    Tcl_Obj* words;
+    Tcl_Obj* command;		// 0L without -command
+    CMoCapture capture;
+    CMoReactor::Request request;
+};
+
+#endif	// #ifndef INC_CMoPost_hpp__
@@ -0,0 +1,438 @@
+/*
+ * CMoPrefetch.cpp --
+ *
+ *	Learned read-ahead for co-read registers.  See CMoPrefetch.hpp.
+ */
+
+#include "CMoPrefetch.hpp"
+#include "CMoCapture.hpp"
+#include "CMoReplyStamp.h"
+#include "tcl.h"
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+
+typedef std::chrono::steady_clock Clock;
+
+// Bounds on what an axis learns: distinct reads, and followers of each.
+#define MAX_PATTERNS 64
+#define MAX_FOLLOWERS 8
+
+// Counts are halved when a read has been seen this often, so a script
+// that changes its habits is followed.
+#define DECAY_SEEN 256
+
+// A packet as it goes out, unused words zero.
+struct Key
+{
+    PMDuint8 xCt;
+    PMDuint8 rCt;
+    PMDuint16 xDat[CMO_FRAME_WORDS];
+
+    Key() { memset(this, 0, sizeof(*this)); }
+    Key(PMDuint8 x, const PMDuint16* dat, PMDuint8 r)
+    {
+	memset(this, 0, sizeof(*this));
+	xCt = x;
+	rCt = r;
+	memcpy(xDat, dat, x * sizeof(PMDuint16));
+    }
+    bool operator<(const Key& other) const
+    {
+	return memcmp(this, &other, sizeof(*this)) < 0;
+    }
+};
+
+struct Pattern
+{
+    PMDuint32 seen;
+    std::map<Key, PMDuint32> next;
+};
+
+struct Cached
+{
+    CMoFrame frame;
+    Clock::time_point at;
+    unsigned long long stamp;	// CMoReplyStamp_Now when it came in
+};
+
+struct Prefetcher
+{
+    void* transportData;	// what was learned was learned here
+    CMoPrefetch::Config config;
+    std::map<Key, Pattern> patterns;
+    std::map<Key, Cached> cache;
+    bool havePrevious;
+    Key previous;
+    Clock::time_point previousAt;
+    CMoPrefetch::Stats stats;
+};
+
+// Axes are only ever sent to by the thread that owns them; the lock is
+// for the map, and for stats read from elsewhere.
+static std::map<PMDAxisHandle*, Prefetcher*> prefetchers;
+static std::atomic<int> enabled(0);
+static Tcl_Mutex mutex;
+
+static inline unsigned long
+Bytes(const CMoFrame& frame)
+{
+    return 2 * (frame.xCt + frame.rCt);
+}
+
+static inline bool
+Same(const Key& key, const CMoFrame& frame)
+{
+    return key.xCt == frame.xCt && key.rCt == frame.rCt &&
+	memcmp(key.xDat, frame.xDat, frame.xCt * sizeof(PMDuint16)) == 0;
+}
+
+static void
+Waste(Prefetcher* p, std::map<Key, Cached>::iterator it)
+{
+    p->stats.wasted++;
+    p->stats.wastedBytes += Bytes(it->second.frame);
+    p->cache.erase(it);
+}
+
+static void
+Flush(Prefetcher* p)
+{
+    while (!p->cache.empty())
+    {
+	Waste(p, p->cache.begin());
+    }
+}
+
+static void
+Expire(Prefetcher* p, Clock::time_point now)
+{
+    std::map<Key, Cached>::iterator it = p->cache.begin();
+    Clock::duration ttl = std::chrono::milliseconds(p->config.ttlMs);
+
+    while (it != p->cache.end())
+    {
+	if (now - it->second.at > ttl)
+	{
+	    Waste(p, it++);
+	}
+	else
+	{
+	    ++it;
+	}
+    }
+}
+
+// Another transport took the axis: nothing learned on the old one holds.
+static void
+Forget(Prefetcher* p, void* transportData)
+{
+    Flush(p);
+    p->patterns.clear();
+    p->havePrevious = false;
+    p->transportData = transportData;
+}
+
+static void
+Learn(Prefetcher* p, const Key& key, Clock::time_point now)
+{
+    std::map<Key, Pattern>::iterator it;
+    std::map<Key, PMDuint32>::iterator next;
+
+    if (p->havePrevious &&
+	now - p->previousAt <= std::chrono::milliseconds(p->config.ttlMs) &&
+	(it = p->patterns.find(p->previous)) != p->patterns.end())
+    {
+	Pattern& pattern = it->second;
+
+	if ((next = pattern.next.find(key)) != pattern.next.end())
+	{
+	    next->second++;
+	}
+	else if (pattern.next.size() < MAX_FOLLOWERS)
+	{
+	    pattern.next[key] = 1;
+	}
+    }
+
+    if ((it = p->patterns.find(key)) == p->patterns.end())
+    {
+	if (p->patterns.size() < MAX_PATTERNS)
+	{
+	    it = p->patterns.insert(std::make_pair(key, Pattern())).first;
+	    it->second.seen = 0;
+	}
+    }
+    if (it != p->patterns.end() && ++it->second.seen >= DECAY_SEEN)
+    {
+	Pattern& pattern = it->second;
+
+	pattern.seen /= 2;
+	for (next = pattern.next.begin(); next != pattern.next.end(); )
+	{
+	    if ((next->second /= 2) == 0)
+	    {
+		pattern.next.erase(next++);
+	    }
+	    else
+	    {
+		++next;
+	    }
+	}
+    }
+    p->havePrevious = true;
+    p->previous = key;
+    p->previousAt = now;
+}
+
+// The read most likely to come after key, if one is likely enough and
+// sending it ahead changes nothing on the chip.
+static bool
+Predict(const Prefetcher* p, const Key& key, Key* follower)
+{
+    std::map<Key, Pattern>::const_iterator it = p->patterns.find(key);
+    std::map<Key, PMDuint32>::const_iterator next, best;
+
+    if (it == p->patterns.end() || it->second.next.empty())
+    {
+	return false;
+    }
+    best = it->second.next.begin();
+    for (next = best; next != it->second.next.end(); ++next)
+    {
+	if (next->second > best->second)
+	{
+	    best = next;
+	}
+    }
+    if (best->second < CMO_PREFETCH_MIN_SEEN || 2 * best->second < it->second.seen ||
+	!CMoOpcodes_IsRead((PMDuint8)(best->first.xDat[0] & 0xFF)))
+    {
+	return false;
+    }
+    *follower = best->first;
+    return true;
+}
+
+static Prefetcher*
+Find(PMDAxisHandle* handle)
+{
+    std::map<PMDAxisHandle*, Prefetcher*>::iterator it = prefetchers.find(handle);
+
+    return it == prefetchers.end() ? 0L : it->second;
+}
+
+bool
+CMoPrefetch::Enable(PMDAxisHandle* handle, const Config& config)
+{
+    Prefetcher* p;
+
+    if (!CMoTransport_IsPipelined(handle))
+    {
+	return false;
+    }
+    Tcl_MutexLock(&mutex);
+    if ((p = Find(handle)) == 0L)
+    {
+	p = new Prefetcher();
+	p->transportData = handle->transport_data;
+	p->havePrevious = false;
+	memset(&p->stats, 0, sizeof(p->stats));
+	prefetchers[handle] = p;
+	enabled++;
+    }
+    p->config = config;
+    Tcl_MutexUnlock(&mutex);
+    return true;
+}
+
+void
+CMoPrefetch::Release(PMDAxisHandle* handle)
+{
+    Prefetcher* p;
+
+    Tcl_MutexLock(&mutex);
+    if ((p = Find(handle)) != 0L)
+    {
+	prefetchers.erase(handle);
+	enabled--;
+    }
+    Tcl_MutexUnlock(&mutex);
+    delete p;
+}
+
+bool
+CMoPrefetch::GetConfig(PMDAxisHandle* handle, Config* config)
+{
+    Prefetcher* p;
+
+    Tcl_MutexLock(&mutex);
+    if ((p = Find(handle)) != 0L)
+    {
+	*config = p->config;
+    }
+    Tcl_MutexUnlock(&mutex);
+    return p != 0L;
+}
+
+bool
+CMoPrefetch::GetStats(PMDAxisHandle* handle, Stats* stats)
+{
+    std::map<Key, Pattern>::const_iterator it;
+    Prefetcher* p;
+    Key follower;
+
+    Tcl_MutexLock(&mutex);
+    if ((p = Find(handle)) != 0L)
+    {
+	*stats = p->stats;
+	stats->patterns = 0;
+	for (it = p->patterns.begin(); it != p->patterns.end(); ++it)
+	{
+	    if (Predict(p, it->first, &follower)) stats->patterns++;
+	}
+    }
+    Tcl_MutexUnlock(&mutex);
+    return p != 0L;
+}
+
+bool
+CMoPrefetch::Answer(PMDAxisHandle* handle, PMDuint8 xCt, PMDuint16* xDat,
+	PMDuint8 rCt, PMDuint16* rDat, PMDresult* result)
+{
+    std::map<Key, Cached>::iterator cached;
+    CMoFrame frames[1 + CMO_PREFETCH_MAX_DEPTH];
+    Clock::time_point now;
+    unsigned long long stamp;
+    Prefetcher* p;
+    Key key, follower;
+    PMDuint32 step;
+    int n, i;
+
+    // A batch, a post or a program recording its packets, or replaying
+    // replies it already has.
+    if (enabled == 0 || handle->transport.SendCommand == CMoCapture::SendCommand)
+    {
+	return false;
+    }
+
+    Tcl_MutexLock(&mutex);
+    if ((p = Find(handle)) == 0L)
+    {
+	Tcl_MutexUnlock(&mutex);
+	return false;
+    }
+    if (p->transportData != handle->transport_data)
+    {
+	Forget(p, handle->transport_data);
+    }
+    now = Clock::now();
+    Expire(p, now);
+    if (!CMoOpcodes_IsRead((PMDuint8)(xDat[0] & 0xFF)) ||
+	xCt > CMO_FRAME_WORDS || rCt > CMO_FRAME_WORDS)
+    {
+	Flush(p);
+	p->havePrevious = false;
+	Tcl_MutexUnlock(&mutex);
+	return false;
+    }
+
+    key = Key(xCt, xDat, rCt);
+    p->stats.reads++;
+    Learn(p, key, now);
+    if ((cached = p->cache.find(key)) != p->cache.end())
+    {
+	memcpy(rDat, cached->second.frame.rDat, rCt * sizeof(PMDuint16));
+	*result = cached->second.frame.result;
+	CMoReplyStamp_Set(cached->second.stamp);
+	p->cache.erase(cached);
+	p->stats.hits++;
+	Tcl_MutexUnlock(&mutex);
+	return true;
+    }
+
+    // The read, then what has followed it, and what has followed that.
+    memset(&frames[0], 0, sizeof(frames[0]));
+    frames[0].xCt = xCt;
+    frames[0].rCt = rCt;
+    memcpy(frames[0].xDat, xDat, xCt * sizeof(PMDuint16));
+    for (n = 1, step = 0; step < p->config.depth && Predict(p, key, &follower);
+	step++, key = follower)
+    {
+	for (i = 0; i < n && !Same(follower, frames[i]); i++)
+	    ;
+	if (i < n)
+	{
+	    break;
+	}
+	if (p->cache.find(follower) == p->cache.end())
+	{
+	    memset(&frames[n], 0, sizeof(frames[n]));
+	    frames[n].xCt = follower.xCt;
+	    frames[n].rCt = follower.rCt;
+	    memcpy(frames[n].xDat, follower.xDat, sizeof(follower.xDat));
+	    n++;
+	}
+    }
+    Tcl_MutexUnlock(&mutex);
+    if (n == 1)
+    {
+	return false;
+    }
+
+    CMoTransport_SendFrames(handle, frames, n);
+
+    Tcl_MutexLock(&mutex);
+    if ((p = Find(handle)) != 0L)
+    {
+	p->stats.batches++;
+	p->stats.prefetched += n - 1;
+	now = Clock::now();
+	stamp = CMoReplyStamp_Now();
+	for (i = 1; i < n; i++)
+	{
+	    if (frames[i].result != PMD_NOERROR)
+	    {
+		p->stats.wasted++;
+		p->stats.wastedBytes += Bytes(frames[i]);
+		continue;
+	    }
+	    key = Key(frames[i].xCt, frames[i].xDat, frames[i].rCt);
+	    p->cache[key].frame = frames[i];
+	    p->cache[key].at = now;
+	    p->cache[key].stamp = stamp;
+	}
+    }
+    Tcl_MutexUnlock(&mutex);
+
+    memcpy(rDat, frames[0].rDat, rCt * sizeof(PMDuint16));
+    *result = frames[0].result;
+    return true;
+}
+
+void
+CMoPrefetch::Sent(PMDAxisHandle* handle, const CMoFrame* frames, int count)
+{
+    Prefetcher* p;
+    int n;
+
+    if (enabled == 0)
+    {
+	return;
+    }
+    Tcl_MutexLock(&mutex);
+    if ((p = Find(handle)) != 0L)
+    {
+	for (n = 0; n < count; n++)
+	{
+	    if (!CMoOpcodes_IsRead((PMDuint8)(frames[n].xDat[0] & 0xFF)))
+	    {
+		Flush(p);
+		p->havePrevious = false;
+		break;
+	    }
+	}
+    }
+    Tcl_MutexUnlock(&mutex);
+}
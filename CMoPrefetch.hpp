@@ -0,0 +1,77 @@
+/*
+ * CMoPrefetch.hpp --
+ *
+ *	Reading ahead the registers a script reads together, behind
+ *	[$axis PrefetchConfigure -enable 1].
+ *
+ * Scripts tend to read in the same order every time: GetPositionError
+ * right after GetActualPosition, GetActivityStatus right after
+ * GetEventStatus.  With the prefetcher on, the axis keeps, for every read
+ * (CMoOpcodes.hpp) it sends, which read came next within -ttl ms and how
+ * often.  Once a read has been followed by the same one at least
+ * CMO_PREFETCH_MIN_SEEN times, and in at least half of its last
+ * occurrences, that follower goes out in the same pipelined batch
+ * (CMoTransport.h) as the read, and its follower after it, up to -depth
+ * of them.  Their replies wait in a cache for -ttl ms; the next read of
+ * the same packet takes one from there, once, instead of going on the
+ * wire.  Anything else the axis sends that isn't a read empties the
+ * cache, so a setting is never followed by a reply from before it.  A
+ * read that clears or re-arms what it returns (GetCaptureValue,
+ * GetInstructionError, ReadBuffer and the like) doesn't count as one, and
+ * is never learned, sent ahead or answered from the cache: sent ahead and
+ * not used, it would lose what it read.
+ *
+ * [$axis PrefetchStats] says how many prefetched replies were used (hits)
+ * and how many expired or were thrown away unused (wasted), with the
+ * command and reply bytes those cost, to tune -depth and -ttl by or turn
+ * it off again.  Only a transport that pipelines (a point-to-point serial
+ * port, a CAN bus or a network connection) takes it, and only calls made
+ * through the native C-Motion layer (CMoNative.cpp) are seen.
+ */
+#ifndef INC_CMoPrefetch_hpp__
+#define INC_CMoPrefetch_hpp__
+
+#include "CMoTransport.h"
+
+#define CMO_PREFETCH_MIN_SEEN 4
+#define CMO_PREFETCH_MAX_DEPTH 4
+
+class CMoPrefetch
+{
+public:
+    struct Config
+    {
+	PMDuint32 ttlMs;
+	PMDuint32 depth;	// followers sent with a read, 1 to CMO_PREFETCH_MAX_DEPTH
+    };
+
+    struct Stats
+    {
+	unsigned long reads;
+	unsigned long batches;	// reads sent with followers
+	unsigned long prefetched;
+	unsigned long hits;
+	unsigned long wasted;
+	unsigned long wastedBytes;
+	unsigned long patterns;	// reads with a follower learned
+    };
+
+    // Start, or change, prefetching for the axis behind handle; false for
+    // a transport that doesn't pipeline.  Release forgets what it learned.
+    static bool Enable(PMDAxisHandle* handle, const Config& config);
+    static void Release(PMDAxisHandle* handle);
+
+    // False when prefetching is off for the axis.
+    static bool GetConfig(PMDAxisHandle* handle, Config* config);
+    static bool GetStats(PMDAxisHandle* handle, Stats* stats);
+
+    // For the packet about to go out: true with the reply in rDat and
+    // *result when it was prefetched, or went out here with its followers.
+    static bool Answer(PMDAxisHandle* handle, PMDuint8 xCt, PMDuint16* xDat,
+	    PMDuint8 rCt, PMDuint16* rDat, PMDresult* result);
+
+    // Frames sent some other way, a batch, a post or a program.
+    static void Sent(PMDAxisHandle* handle, const CMoFrame* frames, int count);
+};
+
+#endif	// #ifndef INC_CMoPrefetch_hpp__
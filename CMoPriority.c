@@ -0,0 +1,85 @@
+// Priority classes and queue waits, see CMoPriority.h.
+
+#include <stddef.h>
+#include "CMoPriority.h"
+
+#if defined(_MSC_VER)
+#   define CMO_THREAD_LOCAL __declspec(thread)
+#else
+#   define CMO_THREAD_LOCAL __thread
+#endif
+
+const char* const CMoPriority_Names[CMO_PRIORITIES + 1] = {
+    "control", "interactive", "background", NULL
+};
+
+// Thread local rather than Tcl_GetThreadData: the transports are also
+// run by threads Tcl doesn't know about.
+static CMO_THREAD_LOCAL int current = CMoInteractive;
+
+int
+CMoPriority_Get(void)
+{
+    return current;
+}
+
+int
+CMoPriority_Set(int priority)
+{
+    int previous = current;
+
+    if (priority >= 0 && priority < CMO_PRIORITIES)
+    {
+	current = priority;
+    }
+    return previous;
+}
+
+int
+CMoPriority_Aged(int priority, PMDuint32 waitedUs)
+{
+    int aged = priority - (int)(waitedUs / (CMO_PRIORITY_AGE_MS * 1000));
+    int best = priority == CMoControl ? CMoControl : CMoInteractive;
+
+    return aged < best ? best : aged;
+}
+
+void
+CMoWaitStats_Note(CMoWaitStats* stats, PMDuint32 us)
+{
+    int i = 0;
+
+    while (i < CMO_WAIT_BUCKETS - 1 && (us >> i) != 0)
+    {
+	i++;
+    }
+    stats->buckets[i]++;
+    stats->count++;
+    stats->totalUs += us;
+    if (us > stats->maxUs)
+    {
+	stats->maxUs = us;
+    }
+}
+
+PMDuint32
+CMoWaitStats_Percentile(const CMoWaitStats* stats, int percent)
+{
+    double want = (double)stats->count * percent / 100.0;
+    PMDuint32 seen = 0;
+    int i;
+
+    for (i = 0; i < CMO_WAIT_BUCKETS - 1; i++)
+    {
+	seen += stats->buckets[i];
+	if (seen >= want && seen > 0)
+	{
+	    break;
+	}
+    }
+    if (i == CMO_WAIT_BUCKETS - 1 || ((PMDuint32)1 << i) > stats->maxUs)
+    {
+	return stats->maxUs;
+    }
+    return (PMDuint32)1 << i;
+}
@@ -0,0 +1,64 @@
+#ifndef INC_CMoPriority_h__
+#define INC_CMoPriority_h__
+
+// Priority classes for the traffic that shares a port.
+//
+// A jog or a stop from the operator shouldn't have to wait behind a
+// program upload or the polling of a dozen waits.  Every request carries
+// the class of the thread that made it, and the reactor (CMoReactor.hpp)
+// and a CAN bus (CMoCan.h) send the next frame from the best class that
+// has one, so a request gets in at the next frame boundary even in the
+// middle of a long batch of a worse class.  A class that has requests
+// waiting but hasn't had the line moves up a class every
+// CMO_PRIORITY_AGE_MS, as far as interactive but never level with
+// control, and starts again from its own class each time it gets it.
+// Between two that stand level the one that has waited longer goes, so
+// background traffic still goes out under a steady stream of interactive
+// requests, and control always goes first.
+//
+// Each queue keeps, per class, how long requests waited from being queued
+// until their first frame went out.
+
+#include "c-motion/PMDtypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {CMoControl, CMoInteractive, CMoBackground, CMO_PRIORITIES};
+
+#define CMO_PRIORITY_AGE_MS 100
+
+// Waits of less than 2^i us go in bucket i, the last one takes the rest.
+#define CMO_WAIT_BUCKETS 24
+
+typedef struct CMoWaitStats {
+    PMDuint32 count;
+    PMDuint32 maxUs;
+    double totalUs;
+    PMDuint32 buckets[CMO_WAIT_BUCKETS];
+} CMoWaitStats;
+
+// control, interactive and background, then NULL for Tcl_GetIndexFromObj.
+extern const char* const CMoPriority_Names[CMO_PRIORITIES + 1];
+
+// The class of the calling thread's requests, interactive to begin with.
+// Set returns the one it had.
+int CMoPriority_Get(void);
+int CMoPriority_Set(int priority);
+
+// Where a class stands after being passed over for waitedUs; no better
+// than CMoInteractive unless it is CMoControl.
+int CMoPriority_Aged(int priority, PMDuint32 waitedUs);
+
+void CMoWaitStats_Note(CMoWaitStats* stats, PMDuint32 us);
+
+// The upper end of the bucket the given percentile falls in, no more than
+// the longest wait.
+PMDuint32 CMoWaitStats_Percentile(const CMoWaitStats* stats, int percent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// #ifndef INC_CMoPriority_h__
@@ -0,0 +1,341 @@
+/*
+ * CMoProgram.cpp --
+ *
+ *	Prepared command programs.  See CMoProgram.hpp.
+ */
+
+#include "CMoProgram.hpp"
+#include "CMoPrefetch.hpp"
+#include "CMoRetry.hpp"
+#include "CMoReconnect.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+
+// The recorder is axis 1; the real axis goes into word 0 at run time.
+static void
+SetAxis(CMoFrame& frame, PMDAxis axis)
+{
+    frame.xDat[0] = static_cast<PMDuint16>((axis << 8) | (frame.xDat[0] & byteMask));
+}
+
+// "%3" is slot 3.  Anything else is a plain argument.
+static int
+SlotIndex(Tcl_Obj* obj)
+{
+    const char* s = Tcl_GetString(obj);
+    const char* p;
+
+    if (s[0] != '%' || s[1] == '\0')
+    {
+	return 0;
+    }
+    for (p = s + 1; *p; p++)
+    {
+	if (*p < '0' || *p > '9') return 0;
+    }
+    return atoi(s + 1);
+}
+
+CMoProgram::CMoProgram(AxisLookup _lookup, ClientData _lookupData)
+    : token(0L), lookup(_lookup), lookupData(_lookupData), recorder(&capture),
+    slots(0), keyLength(0)
+{
+}
+
+CMoProgram::~CMoProgram()
+{
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+	Tcl_DecrRefCount(steps[i].words);
+    }
+}
+
+int
+CMoProgram::AddStep(Tcl_Interp* interp, CMoAxis::Method method, Tcl_Obj* words)
+{
+    Step step;
+    Tcl_Obj** objv;
+    int objc, i, slot;
+
+    if (TCL_OK != Tcl_ListObjGetElements(interp, words, &objc, &objv))
+    {
+	return TCL_ERROR;
+    }
+
+    step.method = method;
+    step.words = words;
+    step.patched = false;
+    step.first = step.count = 0;
+    step.offset = step.length = 0;
+
+    for (i = 1; i < objc; i++)
+    {
+	if ((slot = SlotIndex(objv[i])) > 0)
+	{
+	    step.patched = true;
+	    if (slot > slots) slots = slot;
+	}
+    }
+
+    // Without slots the arguments never change, so check and encode the
+    // call right now.  That is also where a bad argument gets reported.
+    if (!step.patched)
+    {
+	capture.Record();
+	if (TCL_OK != recorder.Invoke(interp, method, words))
+	{
+	    return TCL_ERROR;
+	}
+	Tcl_ResetResult(interp);
+	step.first = frames.size();
+	step.count = capture.frames.size();
+	frames.insert(frames.end(), capture.frames.begin(), capture.frames.end());
+    }
+
+    Tcl_IncrRefCount(words);
+    steps.push_back(step);
+    keyLength = 0;
+    return TCL_OK;
+}
+
+Tcl_Obj*
+CMoProgram::Substitute(const Step& step, int objc, Tcl_Obj* const objv[])
+{
+    Tcl_Obj** words;
+    Tcl_Obj* result;
+    int count, i, slot;
+
+    Tcl_ListObjGetElements(0L, step.words, &count, &words);
+    result = Tcl_NewListObj(0, 0L);
+    for (i = 0; i < count; i++)
+    {
+	slot = (i > 0 ? SlotIndex(words[i]) : 0);
+	Tcl_ListObjAppendElement(0L, result, slot > 0 && slot <= objc ?
+	    objv[slot - 1] : words[i]);
+    }
+    return result;
+}
+
+void
+CMoProgram::EncodeSteps(PMDAxisHandle* handle)
+{
+    PMDuint8 buffer[CMO_FRAME_BYTES];
+    CMoFrame frame;
+    int length;
+
+    encoded.clear();
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+	Step& step = steps[i];
+
+	if (step.patched) continue;
+	step.offset = encoded.size();
+	for (size_t j = step.first; j < step.first + step.count; j++)
+	{
+	    frame = frames[j];
+	    SetAxis(frame, handle->axis);
+	    length = CMoTransport_EncodeFrame(handle, &frame, buffer);
+	    encoded.insert(encoded.end(), buffer, buffer + length);
+	}
+	step.length = encoded.size() - step.offset;
+    }
+}
+
+int
+CMoProgram::Run(Tcl_Interp* interp, CMoAxis* axis, int objc, Tcl_Obj* const objv[])
+{
+    PMDAxisHandle* handle = axis->Handle();
+    std::vector<Tcl_Obj*> words(steps.size(), static_cast<Tcl_Obj*>(0L));
+    std::vector<size_t> first(steps.size() + 1);
+    PMDuint8 buffer[CMO_FRAME_BYTES];
+    CMoFrame probe;
+    Tcl_Obj* results = 0L;
+    int length, code = TCL_OK;
+    size_t i, j;
+
+    if (objc < slots)
+    {
+	std::ostringstream msg;
+	msg << "program needs " << slots << " values";
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(msg.str().c_str(), -1));
+	return TCL_ERROR;
+    }
+
+    // Gather the frames.  Only the steps with slots are encoded again.
+    runFrames.clear();
+    for (i = 0; i < steps.size(); i++)
+    {
+	Step& step = steps[i];
+
+	first[i] = runFrames.size();
+	if (step.patched)
+	{
+	    words[i] = Substitute(step, objc, objv);
+	    Tcl_IncrRefCount(words[i]);
+	    capture.Record();
+	    if (TCL_OK != recorder.Invoke(interp, step.method, words[i]))
+	    {
+		code = TCL_ERROR;
+		goto done;
+	    }
+	    Tcl_ResetResult(interp);
+	    runFrames.insert(runFrames.end(), capture.frames.begin(),
+		capture.frames.end());
+	}
+	else
+	{
+	    words[i] = step.words;
+	    Tcl_IncrRefCount(words[i]);
+	    runFrames.insert(runFrames.end(), frames.begin() + step.first,
+		frames.begin() + step.first + step.count);
+	}
+    }
+    first[i] = runFrames.size();
+    for (j = 0; j < runFrames.size(); j++)
+    {
+	SetAxis(runFrames[j], handle->axis);
+    }
+
+    if (!runFrames.empty())
+    {
+	// A NoOperation for this axis tells us if the transport is a byte
+	// stream at all, and if what we encoded last time still applies.
+	memset(&probe, 0, sizeof(probe));
+	probe.xCt = 1;
+	SetAxis(probe, handle->axis);
+
+	if ((length = CMoTransport_EncodeFrame(handle, &probe, buffer)) > 0)
+	{
+	    if (length != keyLength || memcmp(key, buffer, length) != 0)
+	    {
+		EncodeSteps(handle);
+		memcpy(key, buffer, length);
+		keyLength = length;
+	    }
+
+	    tx.clear();
+	    for (i = 0; i < steps.size(); i++)
+	    {
+		Step& step = steps[i];
+
+		if (!step.patched)
+		{
+		    tx.insert(tx.end(), encoded.begin() + step.offset,
+			encoded.begin() + step.offset + step.length);
+		    continue;
+		}
+		for (j = first[i]; j < first[i+1]; j++)
+		{
+		    length = CMoTransport_EncodeFrame(handle, &runFrames[j], buffer);
+		    tx.insert(tx.end(), buffer, buffer + length);
+		}
+	    }
+	    CMoTransport_SendEncoded(handle, &tx[0], static_cast<int>(tx.size()),
+		&runFrames[0], static_cast<int>(runFrames.size()));
+	}
+	else
+	{
+	    CMoTransport_SendFrames(handle, &runFrames[0],
+		static_cast<int>(runFrames.size()));
+	}
+	CMoRetry::Frames(handle, &runFrames[0],
+	    static_cast<int>(runFrames.size()));
+	CMoReconnect::Record(handle, &runFrames[0],
+	    static_cast<int>(runFrames.size()));
+	CMoPrefetch::Sent(handle, &runFrames[0],
+	    static_cast<int>(runFrames.size()));
+    }
+
+    // Hand each step its replies so it decodes them, or reports the
+    // error the chip gave, just like a direct call would.
+    results = Tcl_NewListObj(0, 0L);
+    for (i = 0; i < steps.size(); i++)
+    {
+	capture.Replay(runFrames.empty() ? 0L : &runFrames[first[i]],
+	    first[i+1] - first[i]);
+	if (TCL_OK != recorder.Invoke(interp, steps[i].method, words[i]))
+	{
+	    Tcl_DecrRefCount(results);
+	    code = TCL_ERROR;
+	    goto done;
+	}
+	Tcl_ListObjAppendElement(0L, results, Tcl_GetObjResult(interp));
+	Tcl_ResetResult(interp);
+    }
+    Tcl_SetObjResult(interp, results);
+
+done:
+    capture.Record();
+    for (i = 0; i < words.size(); i++)
+    {
+	if (words[i] != 0L) Tcl_DecrRefCount(words[i]);
+    }
+    return code;
+}
+
+Tcl_Obj*
+CMoProgram::Info()
+{
+    Tcl_Obj* info = Tcl_NewListObj(0, 0L);
+
+    Tcl_ListObjAppendElement(0L, info, Tcl_NewStringObj("steps", -1));
+    Tcl_ListObjAppendElement(0L, info, Tcl_NewIntObj(static_cast<int>(steps.size())));
+    Tcl_ListObjAppendElement(0L, info, Tcl_NewStringObj("slots", -1));
+    Tcl_ListObjAppendElement(0L, info, Tcl_NewIntObj(slots));
+    Tcl_ListObjAppendElement(0L, info, Tcl_NewStringObj("frames", -1));
+    Tcl_ListObjAppendElement(0L, info, Tcl_NewIntObj(static_cast<int>(frames.size())));
+    return info;
+}
+
+int
+CMoProgram::Command(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* const objv[])
+{
+    CMoProgram* program = static_cast<CMoProgram*>(clientData);
+    static const char* options[] = {"run", "info", "destroy", 0L};
+    enum options {OPT_RUN, OPT_INFO, OPT_DESTROY};
+    CMoAxis* axis;
+    int index;
+
+    if (objc < 2)
+    {
+	Tcl_WrongNumArgs(interp, 1, objv, "option ?arg ...?");
+	return TCL_ERROR;
+    }
+
+    if (TCL_OK != Tcl_GetIndexFromObj(interp, objv[1], options, "option", 0,
+	    &index))
+    {
+	return TCL_ERROR;
+    }
+
+    switch ((enum options) index)
+    {
+    case OPT_RUN:
+	if (objc < 3)
+	{
+	    Tcl_WrongNumArgs(interp, 2, objv, "axis ?value ...?");
+	    return TCL_ERROR;
+	}
+	if ((axis = program->lookup(program->lookupData, interp, objv[2])) == 0L)
+	{
+	    return TCL_ERROR;
+	}
+	return program->Run(interp, axis, objc - 3, objv + 3);
+
+    case OPT_INFO:
+	Tcl_SetObjResult(interp, program->Info());
+	return TCL_OK;
+
+    case OPT_DESTROY:
+	Tcl_DeleteCommandFromToken(interp, program->token);
+	return TCL_OK;
+    }
+    return TCL_OK;
+}
+
+void
+CMoProgram::Deleted(ClientData clientData)
+{
+    delete static_cast<CMoProgram*>(clientData);
+}
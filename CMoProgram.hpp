@@ -0,0 +1,68 @@
+/*
+ * CMoProgram.hpp --
+ *
+ *	Prepared command programs made by [cmotion::prepare].
+ *
+ * A program is a short script of pmd::cmotion method calls, such as
+ * {SetVelocity 100; SetAcceleration 5; Update}.  Each call is checked and
+ * encoded once when the program is prepared, so running it again is a copy
+ * of the already encoded packets and one write to the port.  An argument
+ * written as %1, %2, ... is a slot that gets its value from the arguments
+ * to [$program run $axis ?value ...?]; only the calls with slots are
+ * encoded again on each run.
+ */
+#ifndef INC_CMoProgram_hpp__
+#define INC_CMoProgram_hpp__
+
+#include "CMoAxis.hpp"
+#include <vector>
+
+class CMoProgram
+{
+public:
+    typedef CMoAxis* (*AxisLookup)(ClientData clientData, Tcl_Interp* interp, Tcl_Obj* name);
+
+    CMoProgram(AxisLookup lookup, ClientData lookupData);
+    ~CMoProgram();
+
+    int AddStep(Tcl_Interp* interp, CMoAxis::Method method, Tcl_Obj* words);
+    int Run(Tcl_Interp* interp, CMoAxis* axis, int objc, Tcl_Obj* const objv[]);
+    Tcl_Obj* Info();
+
+    Tcl_Command token;
+    static Tcl_ObjCmdProc Command;
+    static Tcl_CmdDeleteProc Deleted;
+
+private:
+    struct Step
+    {
+	CMoAxis::Method method;
+	Tcl_Obj* words;		// method name and arguments, %N marks a slot
+	bool patched;		// has slots, so it is encoded on every run
+	size_t first, count;	// recorded frames, when not patched
+	size_t offset, length;	// encoded bytes, when not patched
+    };
+
+    Tcl_Obj* Substitute(const Step& step, int objc, Tcl_Obj* const objv[]);
+    void EncodeSteps(PMDAxisHandle* handle);
+
+    AxisLookup lookup;
+    ClientData lookupData;
+    CMoCapture capture;
+    CMoAxis recorder;
+    std::vector<Step> steps;
+    std::vector<CMoFrame> frames;
+    int slots;
+
+    // Encoded bytes of the unpatched steps and what they were encoded
+    // for.  The encoding only depends on the axis and the port address.
+    std::vector<PMDuint8> encoded;
+    PMDuint8 key[CMO_FRAME_BYTES];
+    int keyLength;
+
+    // scratch reused between runs
+    std::vector<CMoFrame> runFrames;
+    std::vector<PMDuint8> tx;
+};
+
+#endif	// #ifndef INC_CMoProgram_hpp__
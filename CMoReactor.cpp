@@ -0,0 +1,1561 @@
+/*
+ * CMoReactor.cpp --
+ *
+ *	The epoll reactor.  See CMoReactor.hpp.
+ */
+
+#include "CMoReactor.hpp"
+#include "CMoReplyStamp.h"
+#include "c-motion/PMDW32Ser.h"
+#include <string.h>
+#include <errno.h>
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <chrono>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+typedef std::chrono::steady_clock Clock;
+
+// Frames written ahead of their replies on one port.  A bigger request
+// goes out this many at a time, so that the other classes can get in.
+#define REACTOR_WINDOW 16
+
+// After a garbled reply or a timeout the line has to stay quiet this
+// long before the receive queue is flushed and the next packet goes out.
+#define REACTOR_QUIET_MS 5
+
+// Requests per port preallocated by Arm unless told otherwise, and the
+// stack the reactor thread touches so that it is already mapped.
+#define REACTOR_DEPTH 64
+#define REACTOR_STACK (64 * 1024)
+
+namespace {
+
+// pthreads rather than <thread> and <mutex>: the extension gets loaded
+// into tclsh builds that ship an older libstdc++.
+class Guard
+{
+public:
+    Guard(pthread_mutex_t* _mutex) : mutex(_mutex) { pthread_mutex_lock(mutex); }
+    ~Guard() { pthread_mutex_unlock(mutex); }
+private:
+    pthread_mutex_t* mutex;
+};
+
+// A queue that stops allocating once it is big enough, unlike
+// std::deque.  push_back says whether it had to grow.
+template <class T> class Ring
+{
+public:
+    Ring() : head(0), count(0) {}
+
+    bool empty() const { return count == 0; }
+    T& front() { return slots[head]; }
+    T& back() { return slots[(head + count - 1) % slots.size()]; }
+
+    void pop_front()
+    {
+	head = (head + 1) % slots.size();
+	count--;
+    }
+
+    void pop_back()
+    {
+	count--;
+    }
+
+    size_t size() const { return count; }
+    T& operator[](size_t i) { return slots[(head + i) % slots.size()]; }
+
+    bool push_back(const T& x)
+    {
+	bool grew = false;
+
+	if (count == slots.size())
+	{
+	    Reserve(count ? 2 * count : 8);
+	    grew = true;
+	}
+	slots[(head + count) % slots.size()] = x;
+	count++;
+	return !grew;
+    }
+
+    void Reserve(size_t n)
+    {
+	std::vector<T> bigger;
+	size_t i;
+
+	if (n <= slots.size())
+	{
+	    return;
+	}
+	bigger.resize(n);
+	for (i = 0; i < count; i++)
+	{
+	    bigger[i] = slots[(head + i) % slots.size()];
+	}
+	slots.swap(bigger);
+	head = 0;
+    }
+
+private:
+    std::vector<T> slots;
+    size_t head, count;
+};
+
+static long long
+Micros(Clock::time_point t)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+	t.time_since_epoch()).count();
+}
+
+// Same for a vector; false if it had to grow.
+template <class T> bool
+Append(std::vector<T>& v, const T& x)
+{
+    bool fits = v.size() < v.capacity();
+    v.push_back(x);
+    return fits;
+}
+
+// Frames begin to end of a request, written in one go.
+struct Slice
+{
+    CMoReactor::Request* request;
+    int begin, end;
+};
+
+struct Port
+{
+    PMDAxisHandle handle;	// a copy, for encoding and the timeout
+    PMDSerialIOData* sio;
+    int fd;
+
+    Ring<CMoReactor::Request*> queue[CMO_PRIORITIES];	// not all written yet
+    Ring<Slice> active;		// written, replies due
+    long long served[CMO_PRIORITIES];	// us, when each last had the line
+    int inflight;
+    int pending;		// submitted and not yet called back
+
+    std::vector<PMDuint8> tx;
+    size_t txPos;
+    PMDuint8 rx[256];
+    size_t rxLen;
+
+    Clock::time_point deadline;	// for the oldest reply outstanding
+    Clock::time_point sent;	// when the last byte went out
+    bool timing;		// a lone frame in flight, for PMDSerial_RttSample
+    bool draining;		// throwing away bytes until the line is quiet
+    bool resync;		// drain once the replies in flight are in
+    bool detaching;
+    bool ready;			// on the reactor's ready list
+    bool polling;		// EPOLLOUT armed
+    bool lost;			// hung up, waiting to be detached
+};
+
+class Reactor
+{
+public:
+    Reactor();
+
+    bool Attach(PMDAxisHandle* handle);
+    bool Detach(PMDAxisHandle* handle);
+    bool IsAttached(PMDAxisHandle* handle);
+    bool Submit(void* transport_data, CMoReactor::Request* request);
+    bool Preempt(void* transport_data, CMoReactor::Request* request);
+    PMDresult Transact(void* transport_data, CMoReactor::Request* request);
+    void GetStats(CMoReactor::Stats* stats);
+    int Arm(const CMoReactor::Realtime* config, const char** what);
+    void Disarm();
+    bool GetRealtime(CMoReactor::Realtime* config);
+
+private:
+    static void* Thread(void* clientData);
+    void Run();
+    int NextTimeout(Clock::time_point now);
+    void Wake();
+    void Pump(Port* port);
+    int Next(Port* port, Clock::time_point now);
+    CMoReactor::Request* Shared(Port* port, CMoReactor::Request* request);
+    void Encode(Port* port, CMoReactor::Request* request, int count);
+    void Cancel(CMoReactor::Request* request, int from, PMDresult result);
+    void Write(Port* port);
+    void Receive(Port* port, Clock::time_point now);
+    void Parse(Port* port);
+    void Fail(Port* port, PMDresult result);
+    void Lose(Port* port);
+    void Drain(Port* port, Clock::time_point now);
+    void Poll(Port* port, bool out);
+    void Complete(CMoReactor::Request* request);
+    Clock::time_point ReplyDeadline(Port* port, Clock::time_point now);
+    void Preallocate(Port* port);
+    void Allocated() { if (armed) stats.allocations++; }
+
+    static void Wakeup(CMoReactor::Request* request);
+
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    std::map<void*, Port*> ports;	// by transport_data
+    std::map<int, Port*> byFd;
+    std::vector<Port*> ready;
+    std::vector<CMoReactor::Request*> completed;
+    int epfd, wakefd;
+    bool wakePending;
+    CMoReactor::Stats stats;
+
+    pthread_t thread;
+    CMoReactor::Realtime realtime;
+    bool armed;
+    bool prefault;		// the thread should touch its stack
+    size_t reserve;		// what the thread's own lists should hold
+};
+
+Reactor::Reactor()
+    : wakePending(false), armed(false), prefault(false), reserve(0)
+{
+    struct epoll_event ev;
+
+    pthread_mutex_init(&lock, 0L);
+    pthread_cond_init(&finished, 0L);
+    memset(&stats, 0, sizeof(stats));
+    memset(&realtime, 0, sizeof(realtime));
+    realtime.depth = REACTOR_DEPTH;
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ev.events = EPOLLIN;
+    ev.data.fd = wakefd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev);
+    pthread_create(&thread, 0L, Thread, this);
+    pthread_detach(thread);
+}
+
+void*
+Reactor::Thread(void* clientData)
+{
+    static_cast<Reactor*>(clientData)->Run();
+    return 0L;
+}
+
+// The single reactor, started the first time a port is attached.
+Reactor*
+Instance(bool create)
+{
+    static pthread_mutex_t once = PTHREAD_MUTEX_INITIALIZER;
+    static Reactor* reactor = 0L;
+    Guard guard(&once);
+
+    if (reactor == 0L && create)
+    {
+	reactor = new Reactor();
+    }
+    return reactor;
+}
+
+bool
+Reactor::Attach(PMDAxisHandle* handle)
+{
+    PMDSerialIOData* sio = (PMDSerialIOData*)handle->transport_data;
+    struct epoll_event ev;
+    Port* port;
+    int flags;
+
+    if (handle->transport.SendCommand != PMDSerial_Send ||
+	sio == 0L || sio->hPort == INVALID_HANDLE_VALUE ||
+	sio->protocol != Protocol_PointToPoint)
+    {
+	return false;
+    }
+
+    Guard guard(&lock);
+
+    flags = fcntl(sio->hPort, F_GETFL);
+    if (flags == -1 || fcntl(sio->hPort, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+	return false;
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = sio->hPort;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sio->hPort, &ev) != 0)
+    {
+	fcntl(sio->hPort, F_SETFL, flags);
+	return false;
+    }
+
+    port = new Port();
+    port->sio = sio;
+    port->fd = sio->hPort;
+    port->inflight = 0;
+    port->pending = 0;
+    port->txPos = 0;
+    port->rxLen = 0;
+    port->draining = port->resync = port->detaching = port->timing = false;
+    port->ready = port->polling = port->lost = false;
+    memset(port->served, 0, sizeof(port->served));
+    if (sio->bFlush)
+    {
+	tcflush(port->fd, TCIOFLUSH);
+	sio->bFlush = 0;
+    }
+
+    handle->transport.SendCommand = CMoReactor_SendCommand;
+    port->handle = *handle;
+    ports[sio] = port;
+    byFd[port->fd] = port;
+    stats.ports++;
+    if (armed)
+    {
+	Preallocate(port);
+    }
+    return true;
+}
+
+bool
+Reactor::Detach(PMDAxisHandle* handle)
+{
+    std::map<void*, Port*>::iterator it;
+    Port* port;
+    int flags;
+
+    Guard guard(&lock);
+
+    if ((it = ports.find(handle->transport_data)) == ports.end())
+    {
+	return false;
+    }
+    port = it->second;
+    port->detaching = true;
+    while (port->pending > 0 || port->draining)
+    {
+	pthread_cond_wait(&finished, &lock);
+    }
+
+    epoll_ctl(epfd, EPOLL_CTL_DEL, port->fd, 0L);
+    flags = fcntl(port->fd, F_GETFL);
+    fcntl(port->fd, F_SETFL, flags & ~O_NONBLOCK);
+    if (port->resync)
+    {
+	port->sio->bFlush = 1;
+    }
+    handle->transport.SendCommand = PMDSerial_Send;
+
+    ports.erase(it);
+    byFd.erase(port->fd);
+    for (size_t i = 0; i < ready.size(); i++)
+    {
+	if (ready[i] == port) ready[i] = 0L;
+    }
+    delete port;
+    stats.ports--;
+    return true;
+}
+
+bool
+Reactor::IsAttached(PMDAxisHandle* handle)
+{
+    Guard guard(&lock);
+    return ports.find(handle->transport_data) != ports.end();
+}
+
+bool
+Reactor::Submit(void* transport_data, CMoReactor::Request* request)
+{
+    std::map<void*, Port*>::iterator it;
+    CMoReactor::Request* leader, **link;
+    Port* port;
+
+    request->result = PMD_ERR_OK;
+    request->stamp = 0;
+    request->sent = request->txSent = 0;
+    request->answered = 0;
+    request->awaited = request->count;
+    request->finished = false;
+    request->queued = Micros(Clock::now());
+    request->joined = 0L;
+    if (request->priority < 0 || request->priority >= CMO_PRIORITIES)
+    {
+	request->priority = CMoInteractive;
+    }
+
+    Guard guard(&lock);
+
+    if ((it = ports.find(transport_data)) == ports.end())
+    {
+	return false;
+    }
+    port = it->second;
+    port->pending++;
+    request->port = port;
+    if ((leader = Shared(port, request)) != 0L)
+    {
+	// Answered in the order they came.
+	for (link = &leader->joined; *link != 0L; link = &(*link)->joined)
+	    ;
+	*link = request;
+	stats.coalesced++;
+	return true;
+    }
+    if (!port->queue[request->priority].push_back(request)) Allocated();
+    if (!port->ready)
+    {
+	port->ready = true;
+	if (!Append(ready, port)) Allocated();
+	Wake();
+    }
+    return true;
+}
+
+bool
+Reactor::Preempt(void* transport_data, CMoReactor::Request* request)
+{
+    std::map<void*, Port*>::iterator it;
+    CMoReactor::Request* last;
+    Slice* slice, stop;
+    Port* port;
+    size_t end, len;
+    int i, c, first;
+
+    request->result = PMD_ERR_OK;
+    request->stamp = 0;
+    request->sent = request->txSent = 0;
+    request->answered = 0;
+    request->awaited = request->count;
+    request->finished = false;
+    request->priority = CMoControl;
+    request->queued = Micros(Clock::now());
+    request->joined = 0L;
+
+    Guard guard(&lock);
+
+    if ((it = ports.find(transport_data)) == ports.end())
+    {
+	return false;
+    }
+    port = it->second;
+    port->pending++;
+    request->port = port;
+    Wake();
+    if (port->lost)
+    {
+	Cancel(request, 0, PMD_ERR_NotConnected);
+	return true;
+    }
+
+    // Nothing that was waiting may go out after it, of any class.
+    for (c = 0; c < CMO_PRIORITIES; c++)
+    {
+	while (!port->queue[c].empty())
+	{
+	    last = port->queue[c].front();
+	    port->queue[c].pop_front();
+	    Cancel(last, last->sent, PMD_ERR_WaitCancelled);
+	}
+    }
+
+    // Nor the rest of the transmit buffer, from the first packet that
+    // hasn't started on its way.  The slices in it are the last ones
+    // Pump made active, and every packet is 2 + 2*xCt bytes.
+    end = port->tx.size();
+    while (port->txPos < end && !port->active.empty())
+    {
+	slice = &port->active.back();
+	last = slice->request;
+	first = slice->begin > last->answered ? slice->begin : last->answered;
+	for (i = slice->end; i > first; i--)
+	{
+	    len = 2 + 2 * last->frames[i - 1].xCt;
+	    if (end - port->txPos < len)
+	    {
+		break;
+	    }
+	    end -= len;
+	}
+	port->inflight -= slice->end - i;
+	if (i > first)
+	{
+	    slice->end = i;
+	    Cancel(last, i, PMD_ERR_WaitCancelled);
+	    break;
+	}
+	port->active.pop_back();
+	Cancel(last, i, PMD_ERR_WaitCancelled);
+    }
+    port->tx.resize(end);
+    if (port->txPos == port->tx.size())
+    {
+	port->tx.clear();
+	port->txPos = 0;
+    }
+
+    // Its reply can't wait for the line to go quiet.
+    if (port->draining)
+    {
+	tcflush(port->fd, TCIFLUSH);
+	port->draining = false;
+    }
+
+    stop.request = request;
+    stop.begin = 0;
+    stop.end = request->count;
+    Encode(port, request, request->count);
+    if (!port->active.push_back(stop)) Allocated();
+    port->inflight += request->count;
+    stats.requests++;
+    stats.frames += request->count;
+    port->deadline = ReplyDeadline(port, Clock::now());
+    Write(port);
+    return true;
+}
+
+void
+Reactor::Wakeup(CMoReactor::Request* request)
+{
+    Reactor* reactor = static_cast<Reactor*>(request->clientData);
+    Guard guard(&reactor->lock);
+
+    request->finished = true;
+    pthread_cond_broadcast(&reactor->finished);
+}
+
+PMDresult
+Reactor::Transact(void* transport_data, CMoReactor::Request* request)
+{
+    request->done = Wakeup;
+    request->clientData = this;
+    if (!Submit(transport_data, request))
+    {
+	return PMD_ERR_NotConnected;
+    }
+
+    Guard guard(&lock);
+    while (!request->finished)
+    {
+	pthread_cond_wait(&finished, &lock);
+    }
+    return request->result;
+}
+
+void
+Reactor::GetStats(CMoReactor::Stats* _stats)
+{
+    Guard guard(&lock);
+    *_stats = stats;
+}
+
+int
+Reactor::Arm(const CMoReactor::Realtime* config, const char** what)
+{
+    std::map<void*, Port*>::iterator it;
+    struct sched_param param;
+    cpu_set_t cpus;
+    int i, err;
+
+    Guard guard(&lock);
+
+    CPU_ZERO(&cpus);
+    for (i = 0; i < CPU_SETSIZE; i++)
+    {
+	if (config->cpus == 0 || (i < 64 && ((config->cpus >> i) & 1)))
+	{
+	    CPU_SET(i, &cpus);
+	}
+    }
+    if ((err = pthread_setaffinity_np(thread, sizeof(cpus), &cpus)) != 0)
+    {
+	*what = "can't set the CPU affinity";
+	return err;
+    }
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = config->priority;
+    if ((err = pthread_setschedparam(thread,
+	    config->priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param)) != 0)
+    {
+	*what = "can't set the scheduling priority";
+	return err;
+    }
+    if (config->lock && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+	*what = "can't lock memory";
+	return errno;
+    }
+    if (!config->lock && realtime.lock)
+    {
+	munlockall();
+    }
+
+    realtime = *config;
+    if (realtime.depth <= 0)
+    {
+	realtime.depth = REACTOR_DEPTH;
+    }
+    for (it = ports.begin(); it != ports.end(); ++it)
+    {
+	Preallocate(it->second);
+    }
+    armed = true;
+    prefault = true;
+    stats.allocations = 0;
+    Wake();
+    return 0;
+}
+
+void
+Reactor::Disarm()
+{
+    struct sched_param param;
+    cpu_set_t cpus;
+    int i;
+
+    Guard guard(&lock);
+
+    CPU_ZERO(&cpus);
+    for (i = 0; i < CPU_SETSIZE; i++)
+    {
+	CPU_SET(i, &cpus);
+    }
+    pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+    memset(&param, 0, sizeof(param));
+    pthread_setschedparam(thread, SCHED_OTHER, &param);
+    if (realtime.lock)
+    {
+	munlockall();
+    }
+    memset(&realtime, 0, sizeof(realtime));
+    realtime.depth = REACTOR_DEPTH;
+    armed = false;
+}
+
+bool
+Reactor::GetRealtime(CMoReactor::Realtime* config)
+{
+    Guard guard(&lock);
+
+    *config = realtime;
+    return armed;
+}
+
+// Called with the lock held.  One write to the eventfd covers any
+// number of submits until the reactor gets around to them.
+void
+Reactor::Wake()
+{
+    uint64_t one = 1;
+
+    if (!wakePending)
+    {
+	wakePending = true;
+	if (write(wakefd, &one, sizeof(one)) < 0)
+	{
+	    // EAGAIN only if the counter is already huge; it's awake.
+	}
+    }
+}
+
+void
+Reactor::Poll(Port* port, bool out)
+{
+    struct epoll_event ev;
+
+    if (port->polling == out)
+    {
+	return;
+    }
+    ev.events = EPOLLIN | (out ? EPOLLOUT : 0);
+    ev.data.fd = port->fd;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, port->fd, &ev);
+    port->polling = out;
+}
+
+// Fill the window from the queues and start writing.  The frames go a
+// slice at a time, each from the request Next picks; one that doesn't fit
+// stays at the head of its queue for the next time there is room.
+void
+Reactor::Pump(Port* port)
+{
+    CMoReactor::Request* request;
+    Clock::time_point now;
+    Slice slice;
+    int c, n;
+
+    if (port->lost)
+    {
+	for (c = 0; c < CMO_PRIORITIES; c++)
+	{
+	    while (!port->queue[c].empty())
+	    {
+		request = port->queue[c].front();
+		port->queue[c].pop_front();
+		Cancel(request, request->sent, PMD_ERR_NotConnected);
+	    }
+	}
+	return;
+    }
+    if (port->draining || port->txPos < port->tx.size())
+    {
+	return;
+    }
+    if (port->resync)
+    {
+	if (!port->active.empty())
+	{
+	    return;
+	}
+	Drain(port, Clock::now());
+	return;
+    }
+
+    port->tx.clear();
+    port->txPos = 0;
+    now = Clock::now();
+    while (port->inflight < REACTOR_WINDOW && (c = Next(port, now)) >= 0)
+    {
+	request = port->queue[c].front();
+	if (request->count == 0)
+	{
+	    port->queue[c].pop_front();
+	    Complete(request);
+	    continue;
+	}
+	if (request->sent == 0)
+	{
+	    CMoWaitStats_Note(&stats.waits[c],
+		static_cast<PMDuint32>(Micros(now) - request->queued));
+	    stats.requests++;
+	}
+	port->served[c] = Micros(now);
+
+	n = REACTOR_WINDOW - port->inflight;
+	if (n > request->count - request->sent)
+	{
+	    n = request->count - request->sent;
+	}
+	slice.request = request;
+	slice.begin = request->sent;
+	slice.end = request->sent + n;
+	Encode(port, request, n);
+	if (!port->active.push_back(slice)) Allocated();
+	port->inflight += n;
+	stats.frames += n;
+	if (request->sent == request->count)
+	{
+	    port->queue[c].pop_front();
+	}
+    }
+
+    if (!port->tx.empty())
+    {
+	port->deadline = ReplyDeadline(port, Clock::now());
+	Write(port);
+    }
+}
+
+// The queue whose head goes next: the best class, counting how long each
+// has been passed over (CMoPriority_Aged), the one passed over longer
+// when two stand level, or -1 if all are empty.
+int
+Reactor::Next(Port* port, Clock::time_point now)
+{
+    long long since, bestSince = 0;
+    int c, aged, best = -1, bestAged = CMO_PRIORITIES;
+
+    for (c = 0; c < CMO_PRIORITIES; c++)
+    {
+	if (port->queue[c].empty())
+	{
+	    continue;
+	}
+	since = port->queue[c].front()->queued;
+	if (port->served[c] > since)
+	{
+	    since = port->served[c];
+	}
+	aged = CMoPriority_Aged(c, static_cast<PMDuint32>(Micros(now) - since));
+	if (aged < bestAged || (aged == bestAged && since < bestSince))
+	{
+	    best = c;
+	    bestAged = aged;
+	    bestSince = since;
+	}
+    }
+    return best;
+}
+
+static bool
+Same(CMoReactor::Request* request, const CMoFrame* frame)
+{
+    const CMoFrame* other = &request->frames[0];
+
+    return request->count == 1 && request->awaited == 1 &&
+	request->answered == 0 && other->xCt == frame->xCt &&
+	other->rCt == frame->rCt &&
+	memcmp(other->xDat, frame->xDat, frame->xCt * sizeof(PMDuint16)) == 0;
+}
+
+// The request whose reply a lone read can have: one on its way whose
+// reply isn't in yet, or one queued in a class no worse than its own.
+CMoReactor::Request*
+Reactor::Shared(Port* port, CMoReactor::Request* request)
+{
+    const CMoFrame* frame = &request->frames[0];
+    size_t i;
+    int c;
+
+    if (request->count != 1 || frame->xCt == 0 ||
+	!CMoOpcodes_IsRead(static_cast<PMDuint8>(frame->xDat[0] & 0xFF)))
+    {
+	return 0L;
+    }
+    for (i = 0; i < port->active.size(); i++)
+    {
+	if (Same(port->active[i].request, frame))
+	{
+	    return port->active[i].request;
+	}
+    }
+    for (c = 0; c <= request->priority; c++)
+    {
+	for (i = 0; i < port->queue[c].size(); i++)
+	{
+	    if (Same(port->queue[c][i], frame))
+	    {
+		return port->queue[c][i];
+	    }
+	}
+    }
+    return 0L;
+}
+
+// Add the next count packets of request to the transmit buffer.
+void
+Reactor::Encode(Port* port, CMoReactor::Request* request, int count)
+{
+    size_t base, len = 0;
+    int i, end = request->sent + count;
+
+    if (request->tx != 0L)
+    {
+	for (i = request->sent; i < end; i++)
+	{
+	    len += 2 + 2 * request->frames[i].xCt;
+	}
+	if (port->tx.size() + len > port->tx.capacity())
+	{
+	    Allocated();
+	}
+	port->tx.insert(port->tx.end(), request->tx + request->txSent,
+	    request->tx + request->txSent + len);
+	request->txSent += static_cast<int>(len);
+	request->sent = end;
+	return;
+    }
+    if (port->tx.size() + count * CMO_FRAME_BYTES > port->tx.capacity())
+    {
+	Allocated();
+    }
+    for (i = request->sent; i < end; i++)
+    {
+	base = port->tx.size();
+	port->tx.resize(base + CMO_FRAME_BYTES);
+	len = CMoTransport_EncodeFrame(&port->handle, &request->frames[i],
+	    &port->tx[base]);
+	port->tx.resize(base + len);
+    }
+    request->sent = end;
+}
+
+// Frames from on won't go out.  The request is done once the ones before
+// them are answered, and those already are unless it is still active.
+void
+Reactor::Cancel(CMoReactor::Request* request, int from, PMDresult result)
+{
+    int i;
+
+    for (i = from; i < request->count; i++)
+    {
+	request->frames[i].result = result;
+    }
+    if (from < request->count && request->result == PMD_ERR_OK)
+    {
+	request->result = result;
+    }
+    request->awaited = from;
+    if (request->answered == from)
+    {
+	Complete(request);
+    }
+}
+
+void
+Reactor::Write(Port* port)
+{
+    ssize_t n;
+
+    while (port->txPos < port->tx.size())
+    {
+	n = write(port->fd, &port->tx[port->txPos], port->tx.size() - port->txPos);
+	if (n < 0)
+	{
+	    if (errno == EINTR) continue;
+	    if (errno == EAGAIN)
+	    {
+		Poll(port, true);
+		return;
+	    }
+	    port->tx.clear();
+	    port->txPos = 0;
+	    if (PMDSerial_IsLost(port->sio))
+	    {
+		Lose(port);
+		return;
+	    }
+	    Fail(port, PMD_ERR_CommPortWrite);
+	    return;
+	}
+	port->txPos += n;
+	stats.bytesOut += n;
+	PMDSerial_CountBytes(port->sio, (PMDuint32)n, 0);
+    }
+    Poll(port, false);
+
+    // The reply clock starts once the last byte is out.  Only a frame
+    // that has the line to itself gives a round trip worth learning from.
+    port->sent = Clock::now();
+    port->timing = port->inflight == 1;
+    port->deadline = ReplyDeadline(port, port->sent);
+}
+
+// The deadline for the reply at the head of the window, as adaptive as
+// the port is set up to be (see PMDSerial_ReplyTimeoutUs).
+Clock::time_point
+Reactor::ReplyDeadline(Port* port, Clock::time_point now)
+{
+    CMoReactor::Request* request;
+    CMoFrame* frame;
+
+    if (port->active.empty())
+    {
+	return now + std::chrono::milliseconds(port->sio->timeout);
+    }
+    request = port->active.front().request;
+    frame = &request->frames[request->answered];
+    return now + std::chrono::microseconds(
+	PMDSerial_ReplyTimeoutUs(port->sio, frame->xCt, frame->rCt));
+}
+
+void
+Reactor::Receive(Port* port, Clock::time_point now)
+{
+    PMDuint8 junk[256];
+    ssize_t n;
+
+    for (;;)
+    {
+	if (port->draining)
+	{
+	    n = read(port->fd, junk, sizeof(junk));
+	}
+	else
+	{
+	    n = read(port->fd, port->rx + port->rxLen, sizeof(port->rx) - port->rxLen);
+	}
+	if (n < 0 && errno == EINTR) continue;
+	if (n <= 0) break;
+
+	stats.bytesIn += n;
+	PMDSerial_CountBytes(port->sio, 0, (PMDuint32)n);
+	if (port->draining)
+	{
+	    port->deadline = now + std::chrono::milliseconds(REACTOR_QUIET_MS);
+	    continue;
+	}
+	if (port->active.empty())
+	{
+	    // Nobody asked for these.
+	    Drain(port, now);
+	    continue;
+	}
+	port->rxLen += n;
+	port->deadline = ReplyDeadline(port, now);
+	Parse(port);
+    }
+}
+
+// Match the bytes received against the replies outstanding, in order.
+// Each is a status byte and a checksum byte, followed by the data words
+// only when the status is zero.
+void
+Reactor::Parse(Port* port)
+{
+    CMoReactor::Request* request;
+    CMoFrame* frame;
+    size_t pos = 0, len, i;
+    PMDuint8 sum;
+
+    while (!port->active.empty())
+    {
+	request = port->active.front().request;
+	frame = &request->frames[request->answered];
+
+	if (port->rxLen - pos < 2)
+	{
+	    break;
+	}
+	len = port->rx[pos] ? 2 : 2 + 2 * frame->rCt;
+	if (port->rxLen - pos < len)
+	{
+	    break;
+	}
+	for (sum = 0, i = 0; i < len; i++)
+	{
+	    sum += port->rx[pos + i];
+	}
+	if (sum)
+	{
+	    // Can't trust where the next reply starts.
+	    port->rxLen = 0;
+	    Fail(port, PMD_ERR_ChecksumError);
+	    return;
+	}
+
+	frame->result = static_cast<PMDresult>(port->rx[pos]);
+	if (port->timing && frame->result == PMD_ERR_OK)
+	{
+	    PMDSerial_RttSample(port->sio, frame->xCt, frame->rCt,
+		static_cast<PMDuint32>(std::chrono::duration_cast<
+		    std::chrono::microseconds>(Clock::now() - port->sent).count()));
+	}
+	port->timing = false;
+	for (i = 0; i < frame->rCt && !port->rx[pos]; i++)
+	{
+	    frame->rDat[i] = (PMDuint16)((port->rx[pos + 2 + 2*i] << 8) |
+		port->rx[pos + 3 + 2*i]);
+	}
+	if (frame->result == PMD_ERR_HardFault ||
+	    frame->result == PMD_ERR_BadSerialChecksum ||
+	    frame->result == PMD_ERR_InvalidInstruction ||
+	    frame->result == PMD_ERR_InvalidAxis)
+	{
+	    port->resync = true;
+	}
+	if (request->result == PMD_ERR_OK)
+	{
+	    request->result = frame->result;
+	}
+	pos += len;
+	port->inflight--;
+
+	if (++request->answered == port->active.front().end)
+	{
+	    port->active.pop_front();
+	}
+	if (request->answered == request->awaited)
+	{
+	    Complete(request);
+	}
+    }
+
+    port->rxLen -= pos;
+    memmove(port->rx, port->rx + pos, port->rxLen);
+    if (port->active.empty() && port->rxLen > 0)
+    {
+	port->rxLen = 0;
+	port->resync = true;
+    }
+    if (port->active.empty() || port->inflight < REACTOR_WINDOW)
+    {
+	Pump(port);
+    }
+}
+
+// Everything in flight gets the error and the line is drained.  So do
+// the frames still queued of a request that is partly sent.
+void
+Reactor::Fail(Port* port, PMDresult result)
+{
+    CMoReactor::Request* request;
+    Slice slice;
+    int c;
+
+    // Whatever wasn't written yet is part of what failed.
+    port->tx.clear();
+    port->txPos = 0;
+    Poll(port, false);
+
+    while (!port->active.empty())
+    {
+	slice = port->active.front();
+	port->active.pop_front();
+	request = slice.request;
+	for (; request->answered < slice.end; request->answered++)
+	{
+	    request->frames[request->answered].result = result;
+	}
+	if (request->result == PMD_ERR_OK)
+	{
+	    request->result = result;
+	}
+	if (request->answered == request->awaited)
+	{
+	    Complete(request);
+	}
+    }
+    for (c = 0; c < CMO_PRIORITIES; c++)
+    {
+	if (!port->queue[c].empty() && port->queue[c].front()->sent > 0)
+	{
+	    request = port->queue[c].front();
+	    port->queue[c].pop_front();
+	    Cancel(request, request->sent, result);
+	}
+    }
+    port->inflight = 0;
+    port->timing = false;
+    if (port->lost)
+    {
+	return;
+    }
+    if (result == PMD_ERR_CommTimeoutError)
+    {
+	stats.timeouts++;
+    }
+    Drain(port, Clock::now());
+}
+
+// The device behind the port went away.  Stop watching it, since a hung
+// up descriptor is always readable, and fail everything on it until it is
+// detached and opened again (CMoReconnect.hpp).
+void
+Reactor::Lose(Port* port)
+{
+    if (port->lost)
+    {
+	return;
+    }
+    port->lost = true;
+    port->draining = false;
+    port->resync = false;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, port->fd, 0L);
+    Fail(port, PMD_ERR_NotConnected);
+    Pump(port);
+}
+
+void
+Reactor::Drain(Port* port, Clock::time_point now)
+{
+    port->draining = true;
+    port->resync = false;
+    port->rxLen = 0;
+    port->deadline = now + std::chrono::milliseconds(REACTOR_QUIET_MS);
+    stats.resyncs++;
+}
+
+// Called with the lock held.  The reads that joined request get its
+// reply too.
+void
+Reactor::Complete(CMoReactor::Request* request)
+{
+    CMoReactor::Request* joined;
+
+    request->stamp = CMoReplyStamp_Now();
+    if (!Append(completed, request)) Allocated();
+    for (joined = request->joined; joined != 0L; joined = joined->joined)
+    {
+	joined->frames[0] = request->frames[0];
+	joined->result = request->result;
+	joined->stamp = request->stamp;
+	if (!Append(completed, joined)) Allocated();
+    }
+    request->joined = 0L;
+}
+
+// Called with the lock held.  Room for realtime.depth requests on this
+// port, and on the lists every port's requests pass through.
+void
+Reactor::Preallocate(Port* port)
+{
+    int c;
+
+    for (c = 0; c < CMO_PRIORITIES; c++)
+    {
+	port->queue[c].Reserve(realtime.depth);
+    }
+    port->active.Reserve(realtime.depth);
+    port->tx.reserve(REACTOR_WINDOW * CMO_FRAME_BYTES);
+
+    reserve = realtime.depth * ports.size();
+    completed.reserve(reserve);
+    ready.reserve(reserve);
+}
+
+// Touch the stack the reactor thread runs on, so that none of it has to
+// be faulted in once the memory is locked.
+static void
+Prefault()
+{
+    volatile char stack[REACTOR_STACK];
+    size_t i;
+
+    for (i = 0; i < sizeof(stack); i += 1024)
+    {
+	stack[i] = 0;
+    }
+}
+
+int
+Reactor::NextTimeout(Clock::time_point now)
+{
+    std::map<int, Port*>::iterator it;
+    Clock::time_point next = Clock::time_point::max();
+    long long ms;
+
+    for (it = byFd.begin(); it != byFd.end(); ++it)
+    {
+	Port* port = it->second;
+	if ((port->draining || !port->active.empty()) && port->deadline < next)
+	{
+	    next = port->deadline;
+	}
+    }
+    if (next == Clock::time_point::max())
+    {
+	return -1;
+    }
+    if (next <= now)
+    {
+	return 0;
+    }
+    ms = std::chrono::duration_cast<std::chrono::microseconds>(next - now).count();
+    return static_cast<int>((ms + 999) / 1000);
+}
+
+void
+Reactor::Run()
+{
+    struct epoll_event events[64];
+    std::vector<CMoReactor::Request*> done;
+    std::vector<Port*> called;
+    std::vector<Port*> pump;
+    std::map<int, Port*>::iterator it;
+    Clock::time_point now;
+    uint64_t count;
+    int n, i, timeout;
+    bool notify, grew;
+
+    for (;;)
+    {
+	pthread_mutex_lock(&lock);
+	if (done.capacity() < reserve)
+	{
+	    done.reserve(reserve);
+	    called.reserve(reserve);
+	    pump.reserve(reserve);
+	}
+	if (prefault)
+	{
+	    Prefault();
+	    prefault = false;
+	}
+	timeout = NextTimeout(Clock::now());
+	pthread_mutex_unlock(&lock);
+
+	n = epoll_wait(epfd, events, 64, timeout);
+
+	pthread_mutex_lock(&lock);
+	now = Clock::now();
+	stats.wakeups++;
+	notify = false;
+
+	for (i = 0; i < n; i++)
+	{
+	    if (events[i].data.fd == wakefd)
+	    {
+		if (read(wakefd, &count, sizeof(count)) < 0)
+		{
+		    // already drained
+		}
+		wakePending = false;
+		continue;
+	    }
+	    if ((it = byFd.find(events[i].data.fd)) == byFd.end())
+	    {
+		continue;
+	    }
+	    if (events[i].events & EPOLLOUT)
+	    {
+		Write(it->second);
+	    }
+	    if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+	    {
+		Receive(it->second, now);
+	    }
+	    if (events[i].events & (EPOLLERR | EPOLLHUP))
+	    {
+		Lose(it->second);
+	    }
+	}
+
+	pump.swap(ready);
+	for (i = 0; i < static_cast<int>(pump.size()); i++)
+	{
+	    if (pump[i] == 0L) continue;
+	    pump[i]->ready = false;
+	    Pump(pump[i]);
+	}
+	pump.clear();
+
+	// Replies that never came, and lines that have gone quiet.
+	for (it = byFd.begin(); it != byFd.end(); ++it)
+	{
+	    Port* port = it->second;
+	    if (port->deadline > now)
+	    {
+		continue;
+	    }
+	    if (port->draining)
+	    {
+		tcflush(port->fd, TCIFLUSH);
+		port->draining = false;
+		notify = port->detaching;
+		Pump(port);
+	    }
+	    else if (!port->active.empty())
+	    {
+		CMoReactor::Request* request = port->active.front().request;
+		CMoFrame* frame = &request->frames[request->answered];
+		PMDSerial_RttTimeout(port->sio, frame->xCt, frame->rCt);
+		Fail(port, PMD_ERR_CommTimeoutError);
+	    }
+	}
+
+	done.swap(completed);
+	if (notify || !done.empty())
+	{
+	    // Detach may be waiting for a port to empty.
+	    pthread_cond_broadcast(&finished);
+	}
+	pthread_mutex_unlock(&lock);
+
+	// The request may be gone as soon as its routine returns, and a
+	// port can't be detached until all of its routines have.
+	grew = false;
+	for (i = 0; i < static_cast<int>(done.size()); i++)
+	{
+	    grew |= !Append(called, static_cast<Port*>(done[i]->port));
+	    done[i]->done(done[i]);
+	}
+	done.clear();
+	if (!called.empty())
+	{
+	    pthread_mutex_lock(&lock);
+	    if (grew) Allocated();
+	    for (i = 0; i < static_cast<int>(called.size()); i++)
+	    {
+		called[i]->pending--;
+	    }
+	    pthread_cond_broadcast(&finished);
+	    pthread_mutex_unlock(&lock);
+	    called.clear();
+	}
+    }
+}
+
+} // namespace
+
+bool
+CMoReactor::Attach(PMDAxisHandle* handle)
+{
+    return Instance(true)->Attach(handle);
+}
+
+bool
+CMoReactor::Detach(PMDAxisHandle* handle)
+{
+    Reactor* reactor = Instance(false);
+    return reactor != 0L && reactor->Detach(handle);
+}
+
+bool
+CMoReactor::IsAttached(PMDAxisHandle* handle)
+{
+    Reactor* reactor = Instance(false);
+    return reactor != 0L && reactor->IsAttached(handle);
+}
+
+bool
+CMoReactor::Submit(PMDAxisHandle* handle, Request* request)
+{
+    Reactor* reactor = Instance(false);
+    return reactor != 0L && reactor->Submit(handle->transport_data, request);
+}
+
+bool
+CMoReactor::Preempt(void* transport_data, Request* request)
+{
+    Reactor* reactor = Instance(false);
+    return reactor != 0L && reactor->Preempt(transport_data, request);
+}
+
+PMDresult
+CMoReactor::Transact(void* transport_data, Request* request)
+{
+    Reactor* reactor = Instance(false);
+    return reactor != 0L ? reactor->Transact(transport_data, request)
+	: PMD_ERR_NotConnected;
+}
+
+void
+CMoReactor::GetStats(Stats* stats)
+{
+    Reactor* reactor = Instance(false);
+
+    if (reactor != 0L)
+    {
+	reactor->GetStats(stats);
+    }
+    else
+    {
+	memset(stats, 0, sizeof(*stats));
+    }
+}
+
+int
+CMoReactor::Arm(const Realtime* config, const char** what)
+{
+    return Instance(true)->Arm(config, what);
+}
+
+void
+CMoReactor::Disarm()
+{
+    Reactor* reactor = Instance(false);
+
+    if (reactor != 0L)
+    {
+	reactor->Disarm();
+    }
+}
+
+bool
+CMoReactor::GetRealtime(Realtime* config)
+{
+    Reactor* reactor = Instance(false);
+
+    if (reactor != 0L)
+    {
+	return reactor->GetRealtime(config);
+    }
+    memset(config, 0, sizeof(*config));
+    config->depth = REACTOR_DEPTH;
+    return false;
+}
+
+#else	// !__linux__
+
+// No epoll; every port is run by whoever calls it.
+
+bool CMoReactor::Attach(PMDAxisHandle* handle) { return false; }
+bool CMoReactor::Detach(PMDAxisHandle* handle) { return false; }
+bool CMoReactor::IsAttached(PMDAxisHandle* handle) { return false; }
+bool CMoReactor::Submit(PMDAxisHandle* handle, Request* request) { return false; }
+bool CMoReactor::Preempt(void* transport_data, Request* request) { return false; }
+
+PMDresult
+CMoReactor::Transact(void* transport_data, Request* request)
+{
+    return PMD_ERR_NotConnected;
+}
+
+void
+CMoReactor::GetStats(Stats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+int
+CMoReactor::Arm(const Realtime* config, const char** what)
+{
+    *what = "no reactor here";
+    return ENOSYS;
+}
+
+void CMoReactor::Disarm() {}
+
+bool
+CMoReactor::GetRealtime(Realtime* config)
+{
+    memset(config, 0, sizeof(*config));
+    return false;
+}
+
+#endif	// __linux__
+
+// The SendCommand of an attached axis.  The C-Motion calls end up here
+// one packet at a time.
+PMDresult
+CMoReactor_SendCommand(void* transport_data, PMDuint8 xCt, PMDuint16* xDat,
+	PMDuint8 rCt, PMDuint16* rDat)
+{
+    CMoReactor::Request request;
+    CMoFrame frame;
+    PMDresult result;
+
+    if (xCt > CMO_FRAME_WORDS || rCt > CMO_FRAME_WORDS)
+    {
+	return PMD_ERR_InvalidParameter;
+    }
+    memset(&frame, 0, sizeof(frame));
+    frame.xCt = xCt;
+    frame.rCt = rCt;
+    memcpy(frame.xDat, xDat, xCt * sizeof(PMDuint16));
+
+    request.tx = 0L;
+    request.txLen = 0;
+    request.frames = &frame;
+    request.count = 1;
+    request.priority = CMoPriority_Get();
+    request.stamp = 0;
+    result = CMoReactor::Transact(transport_data, &request);
+    if (request.stamp != 0)
+    {
+	CMoReplyStamp_Set(request.stamp);
+    }
+    if (result == PMD_ERR_OK)
+    {
+	memcpy(rDat, frame.rDat, rCt * sizeof(PMDuint16));
+    }
+    return result;
+}
+
+// CMoTransport_SendEncoded for an attached axis.
+PMDresult
+CMoReactor_SendEncoded(PMDAxisHandle* handle, const PMDuint8* tx, int txLen,
+	CMoFrame* frames, int count)
+{
+    CMoReactor::Request request;
+    PMDresult result;
+
+    request.tx = tx;
+    request.txLen = txLen;
+    request.frames = frames;
+    request.count = count;
+    request.priority = CMoPriority_Get();
+    request.stamp = 0;
+    result = CMoReactor::Transact(handle->transport_data, &request);
+    if (request.stamp != 0)
+    {
+	CMoReplyStamp_Set(request.stamp);
+    }
+    return result;
+}
@@ -0,0 +1,129 @@
+/*
+ * CMoReactor.hpp --
+ *
+ *	One thread that runs the serial ports of many axes at once.
+ *
+ * An attached port is switched to non-blocking, registered with epoll
+ * and given a small state machine: write the queued packets, read the
+ * replies back in order, hand each finished request to its completion
+ * routine.  The reactor thread never waits on any one port, so a single
+ * core keeps every link busy no matter how many there are.
+ *
+ * Attaching swaps the axis' SendCommand for CMoReactor_SendCommand, so
+ * the ordinary CMoAxis methods, batches and programs keep working; they
+ * queue a request and wait for it.  [cmotion::post] queues one and gets
+ * the answer back later as a Tcl event (see CMoPost.hpp).
+ *
+ * Each port has a queue per priority class (CMoPriority.h).  A request is
+ * written a window's worth of frames at a time, and each time there is
+ * room the next frames come from the best class waiting, so a request of
+ * a better class gets past a long batch at the next frame boundary.
+ *
+ * A read that is the same single command as one already queued in as
+ * good a class, or already on its way, isn't sent again: it is answered
+ * with that one's reply, and stamped with when that came in.  A dozen
+ * callers polling GetActualPosition on the same axis then cost a frame
+ * or two each time rather than a dozen.
+ *
+ * Only point-to-point serial ports can be attached, and only on Linux.
+ * Everywhere else Attach says no and callers use the port directly.
+ */
+#ifndef INC_CMoReactor_hpp__
+#define INC_CMoReactor_hpp__
+
+#include "CMoTransport.h"
+
+class CMoReactor
+{
+public:
+    struct Request;
+    typedef void (*Completion)(Request* request);
+
+    struct Request
+    {
+	// Packets already encoded for the port, or 0L to have the reactor
+	// encode the frames itself.
+	const PMDuint8* tx;
+	int txLen;
+	CMoFrame* frames;
+	int count;
+	int priority;		// CMoControl, CMoInteractive or CMoBackground
+
+	// Runs on the reactor thread once every frame has its result.
+	// It must not block, nor attach or detach ports.
+	Completion done;
+	void* clientData;
+
+	// first error among the frames, like CMoTransport_SendEncoded
+	PMDresult result;
+	// when it was done (CMoReplyStamp_Now), or the request it shared
+	// a reply with was
+	unsigned long long stamp;
+
+	// The reactor's bookkeeping.  Frames that Preempt kept from going
+	// out aren't awaited.
+	int sent;		// frames written, or on their way
+	int txSent;		// bytes of tx written, likewise
+	int answered;
+	int awaited;
+	bool finished;
+	long long queued;	// us, when it was submitted
+	void* port;
+	Request* joined;	// reads that share this one's reply
+    };
+
+    struct Stats
+    {
+	unsigned long ports;
+	unsigned long requests;
+	unsigned long frames;
+	unsigned long timeouts;
+	unsigned long resyncs;
+	unsigned long bytesOut;
+	unsigned long bytesIn;
+	unsigned long wakeups;
+	unsigned long allocations;	// on the hot path since Arm
+	unsigned long coalesced;	// requests given another's reply
+	CMoWaitStats waits[CMO_PRIORITIES];	// from Submit to the first frame
+    };
+
+    // How the reactor thread runs, see [cmotion::realtime].
+    struct Realtime
+    {
+	bool lock;		// mlockall the process
+	int priority;		// SCHED_FIFO priority, 0 for SCHED_OTHER
+	unsigned long long cpus;	// affinity mask of CPUs 0-63, 0 for any
+	int depth;		// requests preallocated per port
+    };
+
+    // Start or stop running the port behind handle.  Detach waits for
+    // the requests already queued and returns whether it was attached.
+    static bool Attach(PMDAxisHandle* handle);
+    static bool Detach(PMDAxisHandle* handle);
+    static bool IsAttached(PMDAxisHandle* handle);
+
+    // Queue a request; false if the port isn't attached.
+    static bool Submit(PMDAxisHandle* handle, Request* request);
+
+    // Send a request ahead of everything else on the port, for the stops
+    // of CMoStop.hpp.  Requests still queued, and frames not yet written
+    // short of one already started, fail with PMD_ERR_WaitCancelled; it
+    // goes out right behind the packets already on the line.  False if
+    // the port isn't attached.
+    static bool Preempt(void* transport_data, Request* request);
+
+    // Queue a request and wait for it.
+    static PMDresult Transact(void* transport_data, Request* request);
+
+    static void GetStats(Stats* stats);
+
+    // Apply config to the reactor thread and preallocate every queue and
+    // buffer it uses, so that from then on it neither page faults nor
+    // allocates.  Returns 0 or an errno, with what naming the step that
+    // failed.  Disarm goes back to an ordinary thread.
+    static int Arm(const Realtime* config, const char** what);
+    static void Disarm();
+    static bool GetRealtime(Realtime* config);
+};
+
+#endif	// #ifndef INC_CMoReactor_hpp__
@@ -0,0 +1,486 @@
+/*
+ * CMoReconnect.cpp --
+ *
+ *	Bringing a serial port back with the drive's settings restored.  See
+ *	CMoReconnect.hpp.
+ */
+
+#include "tcl.h"
+#include "c-motion/c-motion.h"
+#include "CMoReconnect.hpp"
+#include "CMoOpcodes.hpp"
+#include "CMoReactor.hpp"
+#include "c-motion/PMDW32Ser.h"
+#include <string.h>
+#include <list>
+#include <map>
+#include <vector>
+
+// Between tries at opening the port again.
+#define RECONNECT_FIRST_MS 10
+#define RECONNECT_MAX_MS 1000
+
+// The rate a drive comes up at after a power cycle.
+#define DRIVE_DEFAULT_BAUD 57600
+
+// How long the drive gets to switch its UART, as for SerialConfigure.
+#define DRIVE_SETTLE_MS 10
+
+// The rates SetSerialPortMode can select, indexed by PMDSerialBaud.
+static const PMDuint32 serialRates[] =
+{
+    1200, 2400, 9600, 19200, 57600, 115200, 230400, 460800
+};
+#define NUM_SERIAL_RATES (sizeof(serialRates) / sizeof(serialRates[0]))
+
+class Link
+{
+public:
+    Link(PMDAxisHandle* handle);
+    ~Link();
+
+    void Add(PMDuint8 xCt, const PMDuint16* xDat);
+    int Size();
+    bool Recover(PMDresult result);
+
+    PMDuint32 waitMs;
+
+private:
+    static Tcl_ThreadCreateType Thread(ClientData clientData);
+    void Run();
+    bool Restore();
+    bool Find(PMDAxisHandle* probe, PMDSerialIOData* scratch);
+    PMDuint32 Replay(PMDAxisHandle* handle);
+
+    PMDAxisHandle* handle;	// the axis' own
+    PMDSerialIOData* sio;
+
+    // The last value of each setting, oldest first.
+    std::list<CMoFrame> journal;
+    std::map<PMDuint32, std::list<CMoFrame>::iterator> index;
+
+    Tcl_Mutex mutex;
+    Tcl_Condition changed;
+    Tcl_ThreadId thread;
+    bool joinable;
+    bool running;		// the thread is bringing the port back
+    bool stopping;
+    Tcl_Time lostAt;
+};
+
+static bool
+Answers(PMDAxisHandle* handle)
+{
+    PMDuint16 family, motorType, numberAxes, special, custom, major, minor;
+    PMDresult result = ::PMDGetVersion(handle, &family, &motorType,
+	&numberAxes, &special, &custom, &major, &minor);
+
+    // A drive that has just come up says so to its first packet.
+    return result == PMD_NOERROR || result == PMD_ERR_Reset;
+}
+
+static Link*
+LinkOf(PMDAxisHandle* handle)
+{
+    if (handle->transport.SendCommand != PMDSerial_Send &&
+	handle->transport.SendCommand != CMoReactor_SendCommand)
+    {
+	return 0L;
+    }
+    return static_cast<Link*>(((PMDSerialIOData*)handle->transport_data)->reconnect.link);
+}
+
+Link::Link(PMDAxisHandle* _handle)
+    : waitMs(0), handle(_handle), sio((PMDSerialIOData*)_handle->transport_data),
+    mutex(0L), changed(0L), joinable(false), running(false), stopping(false)
+{
+}
+
+Link::~Link()
+{
+    int code;
+
+    Tcl_MutexLock(&mutex);
+    stopping = true;
+    Tcl_ConditionNotify(&changed);
+    Tcl_MutexUnlock(&mutex);
+    if (joinable)
+    {
+	Tcl_JoinThread(thread, &code);
+    }
+    Tcl_ConditionFinalize(&changed);
+    Tcl_MutexFinalize(&mutex);
+}
+
+void
+Link::Add(PMDuint8 xCt, const PMDuint16* xDat)
+{
+    std::map<PMDuint32, std::list<CMoFrame>::iterator>::iterator it;
+    int kind = CMoJournal[(PMDuint8)(xDat[0] & 0xFF)];
+    PMDuint32 key;
+    CMoFrame frame;
+
+    if (kind == CMoNotJournalled || xCt > CMO_FRAME_WORDS)
+    {
+	return;
+    }
+    key = (PMDuint32)xDat[0] << 16 | (kind == CMoJournalKeyed && xCt > 1 ? xDat[1] : 0);
+    memset(&frame, 0, sizeof(frame));
+    frame.xCt = xCt;
+    memcpy(frame.xDat, xDat, xCt * sizeof(PMDuint16));
+
+    Tcl_MutexLock(&mutex);
+    if ((it = index.find(key)) != index.end())
+    {
+	journal.erase(it->second);
+    }
+    index[key] = journal.insert(journal.end(), frame);
+    Tcl_MutexUnlock(&mutex);
+}
+
+int
+Link::Size()
+{
+    int size;
+
+    Tcl_MutexLock(&mutex);
+    size = static_cast<int>(journal.size());
+    Tcl_MutexUnlock(&mutex);
+    return size;
+}
+
+// Send the journal to the drive behind handle as one batch.  Returns how
+// many settings it took.
+PMDuint32
+Link::Replay(PMDAxisHandle* target)
+{
+    std::vector<CMoFrame> frames;
+    PMDuint32 took = 0;
+    size_t i;
+
+    Tcl_MutexLock(&mutex);
+    frames.assign(journal.begin(), journal.end());
+    Tcl_MutexUnlock(&mutex);
+
+    if (frames.empty())
+    {
+	return 0;
+    }
+    CMoTransport_SendFrames(target, &frames[0], static_cast<int>(frames.size()));
+    for (i = 0; i < frames.size(); i++)
+    {
+	if (frames[i].result == PMD_NOERROR) took++;
+    }
+    return took;
+}
+
+bool
+Link::Recover(PMDresult result)
+{
+    Tcl_Time now, deadline, wait;
+    bool back;
+
+    // The port is fine, the drive has forgotten everything.
+    if (result == PMD_ERR_Reset)
+    {
+	sio->reconnect.resets++;
+	sio->reconnect.replayed += Replay(handle);
+	return true;
+    }
+
+    Tcl_MutexLock(&mutex);
+    if (!running)
+    {
+	// Another call may have seen the loss first and brought it back.
+	if (!PMDSerial_IsLost(sio))
+	{
+	    Tcl_MutexUnlock(&mutex);
+	    return true;
+	}
+	if (joinable)
+	{
+	    // The last one has finished, or is about to.
+	    Tcl_ThreadId last = thread;
+	    joinable = false;
+	    Tcl_MutexUnlock(&mutex);
+	    Tcl_JoinThread(last, 0L);
+	    Tcl_MutexLock(&mutex);
+	}
+	if (!running && !stopping)
+	{
+	    running = true;
+	    sio->reconnect.losses++;
+	    Tcl_GetTime(&lostAt);
+	    if (Tcl_CreateThread(&thread, Thread, this,
+		    TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) == TCL_OK)
+	    {
+		joinable = true;
+	    }
+	    else
+	    {
+		running = false;
+	    }
+	}
+    }
+
+    Tcl_GetTime(&deadline);
+    deadline.sec += waitMs / 1000;
+    deadline.usec += (waitMs % 1000) * 1000;
+    if (deadline.usec >= 1000000)
+    {
+	deadline.sec++;
+	deadline.usec -= 1000000;
+    }
+    while (running && !stopping)
+    {
+	Tcl_GetTime(&now);
+	wait.sec = deadline.sec - now.sec;
+	wait.usec = deadline.usec - now.usec;
+	if (wait.usec < 0)
+	{
+	    wait.sec--;
+	    wait.usec += 1000000;
+	}
+	if (wait.sec < 0)
+	{
+	    break;
+	}
+	Tcl_ConditionWait(&changed, &mutex, &wait);
+    }
+    back = !running && !PMDSerial_IsLost(sio);
+    Tcl_MutexUnlock(&mutex);
+    return back;
+}
+
+Tcl_ThreadCreateType
+Link::Thread(ClientData clientData)
+{
+    static_cast<Link*>(clientData)->Run();
+    TCL_THREAD_CREATE_RETURN;
+}
+
+void
+Link::Run()
+{
+    Tcl_Time wait, now;
+    int backoff = RECONNECT_FIRST_MS;
+    bool back = false;
+
+    Tcl_MutexLock(&mutex);
+    while (!stopping)
+    {
+	Tcl_MutexUnlock(&mutex);
+	back = Restore();
+	Tcl_MutexLock(&mutex);
+	if (back || stopping)
+	{
+	    break;
+	}
+	wait.sec = backoff / 1000;
+	wait.usec = (backoff % 1000) * 1000;
+	Tcl_ConditionWait(&changed, &mutex, &wait);
+	backoff = backoff * 2 < RECONNECT_MAX_MS ? backoff * 2 : RECONNECT_MAX_MS;
+    }
+    if (back)
+    {
+	Tcl_GetTime(&now);
+	sio->reconnect.lastMs = (now.sec - lostAt.sec) * 1000 +
+	    (now.usec - lostAt.usec) / 1000;
+    }
+    running = false;
+    Tcl_ConditionNotify(&changed);
+    Tcl_MutexUnlock(&mutex);
+}
+
+// Open the port again and set the drive up on a copy of the transport
+// data, so a call that comes in meanwhile fails on the dead port rather
+// than getting in the way, then hand the new port to the axis.
+bool
+Link::Restore()
+{
+    PMDSerialIOData scratch;
+    PMDAxisHandle probe, owner;
+    PMDuint32 took;
+    bool attached;
+
+    memcpy(&scratch, sio, sizeof(scratch));
+    scratch.hPort = INVALID_HANDLE_VALUE;
+    scratch.retry.attempts = 1;
+    scratch.reconnect.link = 0L;
+    probe = *handle;
+    probe.transport.SendCommand = PMDSerial_Send;
+    probe.transport_data = &scratch;
+
+    if (PMDSerial_Reopen(&scratch) != PMD_ERR_OK)
+    {
+	return false;
+    }
+    sio->reconnect.reopened++;
+    if (!Find(&probe, &scratch))
+    {
+	PMDSerial_ClosePort(&scratch);
+	return false;
+    }
+    took = Replay(&probe);
+
+    // The reactor watches the old descriptor, and the axis may be in the
+    // middle of a capture, so work on a handle of our own.
+    owner = *handle;
+    owner.transport.SendCommand = CMoReactor_SendCommand;
+    owner.transport_data = sio;
+    attached = CMoReactor::Detach(&owner);
+
+    Tcl_MutexLock(&mutex);
+    PMDSerial_ClosePort(sio);
+    sio->hPort = scratch.hPort;
+    sio->baud = scratch.baud;
+    sio->bFlush = 1;
+    sio->reconnect.replayed += took;
+    Tcl_MutexUnlock(&mutex);
+
+    if (attached && !CMoReactor::Attach(&owner))
+    {
+	handle->transport.SendCommand = PMDSerial_Send;
+    }
+    return true;
+}
+
+// Is the drive there at the rate the port had?  A drive that was power
+// cycled comes up at its default rate, and is moved back up from there.
+bool
+Link::Find(PMDAxisHandle* probe, PMDSerialIOData* scratch)
+{
+    PMDuint8 rate, parity, stopBits, protocol, multiDropID;
+    PMDuint32 baud = scratch->baud;
+    PMDresult result;
+    int code;
+
+    if (Answers(probe))
+    {
+	return true;
+    }
+    if (baud == DRIVE_DEFAULT_BAUD ||
+	!PMDSerial_SetConfig(scratch, DRIVE_DEFAULT_BAUD, scratch->parity))
+    {
+	return false;
+    }
+    if (!Answers(probe))
+    {
+	PMDSerial_SetConfig(scratch, baud, scratch->parity);
+	return false;
+    }
+    for (code = 0; code < (int) NUM_SERIAL_RATES; code++)
+    {
+	if (serialRates[code] == baud) break;
+    }
+    if (code == (int) NUM_SERIAL_RATES ||
+	::PMDGetSerialPortMode(probe, &rate, &parity, &stopBits, &protocol,
+	    &multiDropID) != PMD_NOERROR)
+    {
+	return true;
+    }
+    result = ::PMDSetSerialPortMode(probe, (PMDuint8) code, parity, stopBits,
+	protocol, multiDropID);
+    if (result != PMD_NOERROR && result < PMD_ERR_InvalidOperation)
+    {
+	return true;
+    }
+    Tcl_Sleep(DRIVE_SETTLE_MS);
+    PMDSerial_SetConfig(scratch, baud, scratch->parity);
+    if (Answers(probe))
+    {
+	return true;
+    }
+
+    // Stay at the default rate rather than lose the drive.
+    PMDSerial_SetConfig(scratch, DRIVE_DEFAULT_BAUD, scratch->parity);
+    return Answers(probe);
+}
+
+void
+CMoReconnect::Enable(PMDAxisHandle* handle, PMDuint32 waitMs)
+{
+    PMDSerialIOData* sio;
+    Link* link;
+
+    if (waitMs == 0)
+    {
+	Release(handle);
+	return;
+    }
+    if (handle->transport.SendCommand != PMDSerial_Send &&
+	handle->transport.SendCommand != CMoReactor_SendCommand)
+    {
+	return;
+    }
+    sio = (PMDSerialIOData*)handle->transport_data;
+    if ((link = LinkOf(handle)) == 0L)
+    {
+	link = new Link(handle);
+	sio->reconnect.link = link;
+    }
+    link->waitMs = waitMs;
+    sio->reconnect.waitMs = waitMs;
+}
+
+void
+CMoReconnect::Release(PMDAxisHandle* handle)
+{
+    PMDSerialIOData* sio;
+    Link* link;
+
+    if ((link = LinkOf(handle)) == 0L)
+    {
+	return;
+    }
+    sio = (PMDSerialIOData*)handle->transport_data;
+    sio->reconnect.link = 0L;
+    sio->reconnect.waitMs = 0;
+    delete link;
+}
+
+bool
+CMoReconnect::Recover(PMDAxisHandle* handle, PMDresult result)
+{
+    Link* link = LinkOf(handle);
+
+    return link != 0L && link->Recover(result);
+}
+
+void
+CMoReconnect::Record(PMDAxisHandle* handle, PMDuint8 xCt, const PMDuint16* xDat)
+{
+    Link* link = LinkOf(handle);
+
+    if (link != 0L)
+    {
+	link->Add(xCt, xDat);
+    }
+}
+
+void
+CMoReconnect::Record(PMDAxisHandle* handle, const CMoFrame* frames, int count)
+{
+    Link* link = LinkOf(handle);
+    int n;
+
+    if (link == 0L)
+    {
+	return;
+    }
+    for (n = 0; n < count; n++)
+    {
+	if (frames[n].result == PMD_NOERROR)
+	{
+	    link->Add(frames[n].xCt, frames[n].xDat);
+	}
+    }
+}
+
+int
+CMoReconnect::Journalled(PMDAxisHandle* handle)
+{
+    Link* link = LinkOf(handle);
+
+    return link != 0L ? link->Size() : 0;
+}
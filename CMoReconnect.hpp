@@ -0,0 +1,116 @@
+/*
+ * CMoReconnect.hpp --
+ *
+ *	Bringing a serial port back after the device behind it went away or
+ *	the drive reset, with the drive's settings restored.
+ *
+ * With [SerialConfigure -reconnect ms] on, every setting the chip takes
+ * goes into a journal kept for the port, only the last value of each
+ * parameter.  When the port hangs up (a USB adapter re-enumerating shows
+ * up as PMD_ERR_NotConnected) a thread opens it again, backing off from
+ * 10 ms to a second between tries, finds the drive, sends it the whole
+ * journal as one pipelined batch and only then hands the port back.  A
+ * drive that browned out answers the next packet with PMD_ERR_Reset and
+ * gets the journal straight away on the same port.
+ *
+ * A call that runs into the loss waits up to the -reconnect time for the
+ * port to return and then goes again, as CMoRetry.hpp allows for its
+ * opcode.  Settings that describe the moment rather than the setup
+ * (SetActualPosition, SetMotorCommand, the buffer indexes, ...) are left
+ * out, and so are SetStopMode, the breakpoints and Update: a restored axis
+ * holds still until told to move, and nothing it has done already is set
+ * up to happen again.
+ */
+#ifndef INC_CMoReconnect_hpp__
+#define INC_CMoReconnect_hpp__
+
+#include "CMoTransport.h"
+#include "CMoOpcodes.hpp"
+
+// Settings that describe the moment rather than the setup, left out of
+// the journal.  SetStopMode is a command despite its name: replayed, it
+// would stop the axis at the next Update.  A breakpoint is left out as
+// well, since one that has gone off would be armed again with its action.
+#define CMO_MOMENTARY_OPCODES(X) \
+    X(SetActualPosition) X(SetMotorCommand) X(SetSerialPortMode) \
+    X(SetBufferWriteIndex) X(SetBufferReadIndex) X(SetTraceStart) \
+    X(SetTraceStop) X(SetPhaseAngle) X(SetStopMode) X(SetBreakpoint) \
+    X(SetBreakpointValue)
+
+// Settings whose first word says which parameter the rest is for, so
+// each value of that word is a separate entry.
+#define CMO_KEYED_OPCODES(X) \
+    X(SetProfileParameter) X(SetFeedbackParameter) X(SetDrivePWM) \
+    X(SetAnalogCalibration) X(SetBreakpointUpdateMask) X(SetCurrentFoldback) \
+    X(SetEventAction) X(SetCurrent) X(SetDriveFaultParameter) \
+    X(SetCommutationParameter) X(SetPositionLoop) X(SetCurrentLoop) \
+    X(SetLoop) X(SetPhaseParameter) X(SetDefault) X(SetTraceVariable) \
+    X(SetBufferStart) X(SetBufferLength) X(SetFOC)
+
+// What the journal keeps of an opcode: nothing, its last value, or its
+// last value for each value of its first word.
+enum { CMoNotJournalled, CMoJournalled, CMoJournalKeyed };
+
+// The journal kind indexed by opcode, built at compile time as CMoOpcodes
+// is: every setting the table knows, less the momentary ones.
+class CMoJournalTable
+{
+public:
+    constexpr CMoJournalTable() : kind()
+    {
+	for (int op = 0; op < 256; op++)
+	{
+	    kind[op] = CMoOpcodes[op].name != 0L &&
+		CMoOpcodes[op].repeat == CMoRepeatSet &&
+		IsSet(CMoOpcodes[op].name) ? CMoJournalled : CMoNotJournalled;
+	}
+#define CMO_JOURNAL_ENTRY(label) kind[CMoOp::label] = CMoNotJournalled;
+	CMO_MOMENTARY_OPCODES(CMO_JOURNAL_ENTRY)
+#undef CMO_JOURNAL_ENTRY
+#define CMO_JOURNAL_ENTRY(label) kind[CMoOp::label] = CMoJournalKeyed;
+	CMO_KEYED_OPCODES(CMO_JOURNAL_ENTRY)
+#undef CMO_JOURNAL_ENTRY
+    }
+
+    constexpr int operator[](PMDuint8 op) const
+    {
+	return kind[op];
+    }
+
+private:
+    static constexpr bool IsSet(const char* name)
+    {
+	return name[0] == 'S' && name[1] == 'e' && name[2] == 't';
+    }
+
+    PMDuint8 kind[256];
+};
+
+constexpr CMoJournalTable CMoJournal;
+
+class CMoReconnect
+{
+public:
+    // Start journalling the port behind handle, and bringing it back when
+    // it goes, with calls waiting up to waitMs for it.  0 turns it off.
+    static void Enable(PMDAxisHandle* handle, PMDuint32 waitMs);
+    static void Release(PMDAxisHandle* handle);
+
+    static inline bool Lost(PMDresult result)
+    {
+	return result == PMD_ERR_NotConnected || result == PMD_ERR_Reset;
+    }
+
+    // Bring the port back after result (one that Lost says yes to) and
+    // restore the drive.  True once it is back and the call can go again.
+    static bool Recover(PMDAxisHandle* handle, PMDresult result);
+
+    // Journal a packet the chip took, or the frames among these that it did.
+    static void Record(PMDAxisHandle* handle, PMDuint8 xCt, const PMDuint16* xDat);
+    static void Record(PMDAxisHandle* handle, const CMoFrame* frames, int count);
+
+    // Settings in the journal, 0 when it's off.
+    static int Journalled(PMDAxisHandle* handle);
+};
+
+#endif	// #ifndef INC_CMoReconnect_hpp__
@@ -0,0 +1,42 @@
+// Reply stamps, see CMoReplyStamp.h.
+
+#include "CMoReplyStamp.h"
+#if defined(_WIN32)
+#   include <windows.h>
+#else
+#   include <time.h>
+#endif
+
+#if defined(_MSC_VER)
+#   define CMO_THREAD_LOCAL __declspec(thread)
+#else
+#   define CMO_THREAD_LOCAL __thread
+#endif
+
+// Thread local for the same reason as the priority class (CMoPriority.c).
+static CMO_THREAD_LOCAL unsigned long long replied;
+
+unsigned long long
+CMoReplyStamp_Now(void)
+{
+#if defined(_WIN32)
+    return (unsigned long long)GetTickCount64() * 1000;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+unsigned long long
+CMoReplyStamp_Get(void)
+{
+    return replied;
+}
+
+void
+CMoReplyStamp_Set(unsigned long long us)
+{
+    replied = us;
+}
@@ -0,0 +1,32 @@
+#ifndef INC_CMoReplyStamp_h__
+#define INC_CMoReplyStamp_h__
+
+// When the reply to the calling thread's last command came in.
+//
+// Every call through the native C-Motion layer (CMoNative.cpp) clears it
+// before it goes out and stamps it when the reply is in, whatever the
+// transport, so [cmotion::age] is about the command just made and says -1
+// after one that failed.  Identical reads queued at once on the reactor
+// or a CAN bus share one reply (CMoReactor.hpp, CMoCan.h), and a
+// prefetched read (CMoPrefetch.hpp) is answered from one already in; both
+// keep the stamp of the reply they used, which may be older than the
+// command.  A -command script of [cmotion::post] sees the stamp of the
+// post's reply.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Monotonic microseconds, the clock the replies are stamped with.
+unsigned long long CMoReplyStamp_Now(void);
+
+// When the reply to the calling thread's last command came in, 0 before
+// the first or after one that failed.
+unsigned long long CMoReplyStamp_Get(void);
+void CMoReplyStamp_Set(unsigned long long us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// #ifndef INC_CMoReplyStamp_h__
@@ -0,0 +1,221 @@
+/*
+ * CMoRetry.cpp --
+ *
+ *	Sending a packet again after a transient transport error.  See
+ *	CMoRetry.hpp.
+ */
+
+#include "CMoRetry.hpp"
+#include "CMoCan.h"
+#include "CMoNetwork.h"
+#include "CMoOpcodes.hpp"
+#include "CMoReconnect.hpp"
+#include "c-motion/PMDW32Ser.h"
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// The policy of the port behind handle, or 0L for a transport without one.
+static PMDSerialRetry*
+Policy(PMDAxisHandle* handle)
+{
+    if (handle->transport.SendCommand == PMDSerial_Send ||
+	handle->transport.SendCommand == CMoReactor_SendCommand)
+    {
+	return &((PMDSerialIOData*)handle->transport_data)->retry;
+    }
+    if (handle->transport.SendCommand == CMoNetwork_SendCommand)
+    {
+	return &((CMoNetworkData*)handle->transport_data)->retry;
+    }
+    if (handle->transport.SendCommand == CMoCan_SendCommand)
+    {
+	return &((CMoCanData*)handle->transport_data)->retry;
+    }
+    return 0L;
+}
+
+// The owner thread, the reactor and background waits can all be retrying
+// on one port at once, so its counters only ever go up atomically.
+static inline void
+Count(PMDuint32* counter)
+{
+#if defined(_MSC_VER)
+    InterlockedIncrement((volatile LONG*)counter);
+#else
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+// How long, in ms, the port behind handle waits for a reply.
+static PMDuint32
+Timeout(PMDAxisHandle* handle)
+{
+    if (handle->transport.SendCommand == CMoNetwork_SendCommand)
+    {
+	return ((CMoNetworkData*)handle->transport_data)->timeout;
+    }
+    if (handle->transport.SendCommand == CMoCan_SendCommand)
+    {
+	return ((CMoCanData*)handle->transport_data)->timeout;
+    }
+    return ((PMDSerialIOData*)handle->transport_data)->timeout;
+}
+
+static bool
+Allowed(PMDuint16 command, PMDresult result)
+{
+    return result == PMD_ERR_BadSerialChecksum ||
+	CMoOpcodes[(PMDuint8)(command & 0xFF)].repeat != CMoRepeatOnce;
+}
+
+// No longer than the port waits for a reply.
+static void
+Backoff(PMDAxisHandle* handle, PMDSerialRetry* policy, PMDuint32 retry)
+{
+    PMDuint32 limit = Timeout(handle) * 1000;
+    PMDuint32 usec = policy->backoffUs << (retry < 16 ? retry : 16);
+
+    if (usec == 0)
+    {
+	return;
+    }
+    if (usec > limit || usec < policy->backoffUs)
+    {
+	usec = limit;
+    }
+#if defined(_WIN32)
+    Sleep((usec + 999) / 1000);
+#else
+    struct timespec ts;
+    ts.tv_sec = usec / 1000000;
+    ts.tv_nsec = (usec % 1000000) * 1000L;
+    nanosleep(&ts, 0L);
+#endif
+}
+
+PMDresult
+CMoRetry::Again(PMDAxisHandle* handle, PMDresult result,
+    PMDuint8 xCt, PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat)
+{
+    PMDSerialRetry* policy = Policy(handle);
+    PMDuint32 attempt, attempts;
+
+    if (policy == 0L)
+    {
+	return result;
+    }
+
+    // A call that lost the port goes once more when it is back, whatever
+    // the policy says about noise.
+    attempts = policy->attempts;
+    if (CMoReconnect::Lost(result) && attempts < 2)
+    {
+	attempts = 2;
+    }
+    if (attempts <= 1)
+    {
+	return result;
+    }
+
+    // The first retry goes straight out, which is one frame time when
+    // the noise has passed; later ones back off.
+    for (attempt = 1; ; attempt++)
+    {
+	if (CMoReconnect::Lost(result))
+	{
+	    if (!CMoReconnect::Recover(handle, result))
+	    {
+		return result;
+	    }
+	}
+	else if (attempt >= attempts)
+	{
+	    break;
+	}
+	else if (attempt > 1)
+	{
+	    Backoff(handle, policy, attempt - 2);
+	}
+	// A port that came back with no attempts left has used them up.
+	if (attempt >= attempts)
+	{
+	    break;
+	}
+	if (!Allowed(xDat[0], result))
+	{
+	    Count(&policy->refused);
+	    return result;
+	}
+	Count(&policy->retries);
+	result = handle->transport.SendCommand(handle->transport_data,
+	    xCt, xDat, rCt, rDat);
+	if (!Transient(result) && !CMoReconnect::Lost(result))
+	{
+	    Count(&policy->recovered);
+	    return result;
+	}
+    }
+    Count(&policy->exhausted);
+    return result;
+}
+
+void
+CMoRetry::Frames(PMDAxisHandle* handle, CMoFrame* frames, int count)
+{
+    PMDSerialRetry* policy = Policy(handle);
+    int n;
+
+    if (policy == 0L)
+    {
+	return;
+    }
+    for (n = 0; n < count; n++)
+    {
+	CMoFrame* frame = &frames[n];
+
+	if (!Transient(frame->result) && !CMoReconnect::Lost(frame->result))
+	{
+	    continue;
+	}
+	if (CMoOpcodes[(PMDuint8)(frame->xDat[0] & 0xFF)].repeat != CMoRepeatRead)
+	{
+	    Count(&policy->refused);
+	    continue;
+	}
+	frame->result = Again(handle, frame->result, frame->xCt,
+	    frame->xDat, frame->rCt, frame->rDat);
+    }
+}
+
+bool
+CMoRetry::Resume(PMDAxisHandle* handle, PMDresult result, PMDuint32 attempt)
+{
+    PMDSerialRetry* policy = Policy(handle);
+
+    if (policy == 0L)
+    {
+	return false;
+    }
+    if (CMoReconnect::Lost(result))
+    {
+	return CMoReconnect::Recover(handle, result);
+    }
+    if (!Transient(result))
+    {
+	return false;
+    }
+    if (attempt >= policy->attempts)
+    {
+	Count(&policy->exhausted);
+	return false;
+    }
+    if (attempt > 1)
+    {
+	Backoff(handle, policy, attempt - 2);
+    }
+    Count(&policy->retries);
+    return true;
+}
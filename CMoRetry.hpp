@@ -0,0 +1,52 @@
+/*
+ * CMoRetry.hpp --
+ *
+ *	Sending a packet again after a transient transport error.
+ *
+ * A corrupted reply (PMD_ERR_ChecksumError), a missing one
+ * (PMD_ERR_CommTimeoutError) or a packet the drive refused for its
+ * checksum (PMD_ERR_BadSerialChecksum) is usually line noise, and the
+ * next try gets through.  Each serial port, network connection and CAN
+ * node carries a policy for that (PMDSerialRetry, set with -attempts and
+ * -backoff of SerialConfigure, NetworkConfigure or CanConfigure): how many
+ * times in all a packet may go out and how long to wait between tries.
+ *
+ * Whether a packet may go again depends on the opcode (CMoOpcodes.hpp).
+ * The drive never executes a packet it reports a bad checksum for, so
+ * anything can be resent then.  After a corrupted or missing reply it may
+ * or may not have, so only reads and absolute settings go again; an
+ * AdjustActualPosition or a WriteBuffer comes back to the script as the
+ * error it was rather than risk being applied twice.
+ */
+#ifndef INC_CMoRetry_hpp__
+#define INC_CMoRetry_hpp__
+
+#include "CMoTransport.h"
+
+class CMoRetry
+{
+public:
+    static inline bool Transient(PMDresult result)
+    {
+	return result == PMD_ERR_ChecksumError ||
+	    result == PMD_ERR_CommTimeoutError ||
+	    result == PMD_ERR_BadSerialChecksum;
+    }
+
+    // Try a packet that failed with a transient result again, as the
+    // port's policy allows.  Returns the last result.
+    static PMDresult Again(PMDAxisHandle* handle, PMDresult result,
+	    PMDuint8 xCt, PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat);
+
+    // The same for frames sent together in a batch.  By now the frames
+    // after a failed one have gone out, so only reads are sent again;
+    // anything else would end up out of order.
+    static void Frames(PMDAxisHandle* handle, CMoFrame* frames, int count);
+
+    // For a transfer that can pick up where it failed, because it says
+    // where each piece goes (CMoMemory.hpp): whether it may go on after
+    // result on this, its attempt-th go, with the port back if it was lost.
+    static bool Resume(PMDAxisHandle* handle, PMDresult result, PMDuint32 attempt);
+};
+
+#endif	// #ifndef INC_CMoRetry_hpp__
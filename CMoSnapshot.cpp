@@ -0,0 +1,358 @@
+/*
+ * CMoSnapshot.cpp --
+ *
+ *	Seqlocked per-axis state.  See CMoSnapshot.hpp.
+ */
+
+#include "CMoSnapshot.hpp"
+#include "CMoOpcodes.hpp"
+#include "CMoTelemetry.h"
+#include "tcl.h"
+#include <errno.h>
+#if !defined(_WIN32)
+#include <signal.h>
+#endif
+
+const PMDuint8 CMoSnapshot::Opcodes[CMO_SNAPSHOT_PACKETS] = {
+    CMoOp::GetActualPosition, CMoOp::GetActualVelocity,
+    CMoOp::GetEventStatus, CMoOp::GetActivityStatus
+};
+
+CMoSnapshot::Slot CMoSnapshot::table[CMO_SNAPSHOT_SLOTS];
+
+// Taking and giving back slots; writing to one is up to its owner.
+static bool taken[CMO_SNAPSHOT_SLOTS];
+static Tcl_Mutex mutex;
+
+// The shared memory copy, under the same lock.  Writers look at exporting
+// without it and only go for the lock when there is a copy to keep.
+static CMoTelemetry* segment;
+static std::string segmentName;
+static std::atomic<bool> exporting(false);
+
+static_assert(CMO_TELEMETRY_AXES == CMO_SNAPSHOT_SLOTS,
+    "the shared memory segment has a slot for each in the table");
+
+void
+CMoSnapshot::Begin(Slot& slot)
+{
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1,
+	std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void
+CMoSnapshot::End(Slot& slot)
+{
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1,
+	std::memory_order_release);
+}
+
+#if !defined(_WIN32)
+
+// The same seqlock as the table's, in the segment.
+static void
+Store(CMoTelemetry* t, int slot, bool live, const CMoSnapshot::State& state)
+{
+    uint32_t sequence = t->sequence[slot].value;
+
+    __atomic_store_n(&t->sequence[slot].value, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&t->live[slot], live ? 1 : 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->position[slot], state.position, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->velocity[slot], state.velocity, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->eventStatus[slot], state.eventStatus, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->activityStatus[slot], state.activityStatus,
+	__ATOMIC_RELAXED);
+    __atomic_store_n(&t->result[slot], (uint16_t)state.result, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->stamp[slot], (uint64_t)state.stamp, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->polls[slot], state.polls, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->failures[slot], state.failures, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->sequence[slot].value, sequence + 2, __ATOMIC_RELEASE);
+}
+
+// A segment of ours left by a process that has gone, taken away; EEXIST
+// for one that isn't ours or whose writer is still running.
+static int
+Reclaim(const char* name)
+{
+    const CMoTelemetry* t;
+    pid_t pid;
+
+    if ((t = CMoTelemetry_Open(name)) == 0L)
+    {
+	return EEXIST;
+    }
+    pid = (pid_t)t->pid;
+    CMoTelemetry_Close(t);
+    if (kill(pid, 0) == 0 || errno != ESRCH)
+    {
+	return EEXIST;
+    }
+    return shm_unlink(name) == 0 ? 0 : errno;
+}
+
+static CMoTelemetry*
+Create(const char* name, int* error)
+{
+    void* p;
+    int fd;
+
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST)
+    {
+	if ((*error = Reclaim(name)) != 0)
+	{
+	    return 0L;
+	}
+	fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0)
+    {
+	*error = errno;
+	return 0L;
+    }
+    if (ftruncate(fd, sizeof(CMoTelemetry)) != 0 ||
+	(p = mmap(0L, sizeof(CMoTelemetry), PROT_READ | PROT_WRITE, MAP_SHARED,
+	    fd, 0)) == MAP_FAILED)
+    {
+	*error = errno;
+	close(fd);
+	shm_unlink(name);
+	return 0L;
+    }
+    close(fd);
+    return (CMoTelemetry*)p;
+}
+
+static void
+ExitProc(ClientData clientData)
+{
+    CMoSnapshot::Export("");
+}
+
+#endif	// #if !defined(_WIN32)
+
+int
+CMoSnapshot::Acquire()
+{
+    int i;
+
+    Tcl_MutexLock(&mutex);
+    for (i = 0; i < CMO_SNAPSHOT_SLOTS && taken[i]; i++)
+	;
+    if (i < CMO_SNAPSHOT_SLOTS)
+    {
+	taken[i] = true;
+    }
+    Tcl_MutexUnlock(&mutex);
+    if (i == CMO_SNAPSHOT_SLOTS)
+    {
+	return -1;
+    }
+
+    Slot& slot = table[i];
+    Begin(slot);
+    slot.live.store(true, std::memory_order_relaxed);
+    slot.position.store(0, std::memory_order_relaxed);
+    slot.velocity.store(0, std::memory_order_relaxed);
+    slot.eventStatus.store(0, std::memory_order_relaxed);
+    slot.activityStatus.store(0, std::memory_order_relaxed);
+    slot.result.store(PMD_NOERROR, std::memory_order_relaxed);
+    slot.stamp.store(0, std::memory_order_relaxed);
+    slot.polls.store(0, std::memory_order_relaxed);
+    slot.failures.store(0, std::memory_order_relaxed);
+    End(slot);
+    Mirror(i);
+    return i;
+}
+
+void
+CMoSnapshot::Release(int slot)
+{
+    if (slot < 0 || slot >= CMO_SNAPSHOT_SLOTS)
+    {
+	return;
+    }
+    Begin(table[slot]);
+    table[slot].live.store(false, std::memory_order_relaxed);
+    End(table[slot]);
+    Mirror(slot);
+
+    Tcl_MutexLock(&mutex);
+    taken[slot] = false;
+    Tcl_MutexUnlock(&mutex);
+}
+
+void
+CMoSnapshot::Publish(int slot, const State& state)
+{
+    Slot& s = table[slot];
+
+    Begin(s);
+    s.position.store(state.position, std::memory_order_relaxed);
+    s.velocity.store(state.velocity, std::memory_order_relaxed);
+    s.eventStatus.store(state.eventStatus, std::memory_order_relaxed);
+    s.activityStatus.store(state.activityStatus, std::memory_order_relaxed);
+    s.result.store((PMDuint16)state.result, std::memory_order_relaxed);
+    s.stamp.store(state.stamp, std::memory_order_relaxed);
+    s.polls.store(s.polls.load(std::memory_order_relaxed) + 1,
+	std::memory_order_relaxed);
+    End(s);
+    Mirror(slot);
+}
+
+void
+CMoSnapshot::Fail(int slot, PMDresult result)
+{
+    Slot& s = table[slot];
+
+    Begin(s);
+    s.result.store((PMDuint16)result, std::memory_order_relaxed);
+    s.polls.store(s.polls.load(std::memory_order_relaxed) + 1,
+	std::memory_order_relaxed);
+    s.failures.store(s.failures.load(std::memory_order_relaxed) + 1,
+	std::memory_order_relaxed);
+    End(s);
+    Mirror(slot);
+}
+
+bool
+CMoSnapshot::Read(int slot, State* state)
+{
+    PMDuint32 before;
+    bool live;
+
+    if (slot < 0 || slot >= CMO_SNAPSHOT_SLOTS)
+    {
+	return false;
+    }
+    const Slot& s = table[slot];
+    do
+    {
+	while ((before = s.sequence.load(std::memory_order_acquire)) & 1)
+	    ;
+	live = s.live.load(std::memory_order_relaxed);
+	state->position = s.position.load(std::memory_order_relaxed);
+	state->velocity = s.velocity.load(std::memory_order_relaxed);
+	state->eventStatus = s.eventStatus.load(std::memory_order_relaxed);
+	state->activityStatus = s.activityStatus.load(std::memory_order_relaxed);
+	state->result = (PMDresult)s.result.load(std::memory_order_relaxed);
+	state->stamp = s.stamp.load(std::memory_order_relaxed);
+	state->polls = s.polls.load(std::memory_order_relaxed);
+	state->failures = s.failures.load(std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    while (s.sequence.load(std::memory_order_relaxed) != before);
+    return live;
+}
+
+void
+CMoSnapshot::Mirror(int slot)
+{
+#if !defined(_WIN32)
+    State state;
+    bool live;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!exporting.load(std::memory_order_relaxed))
+    {
+	return;
+    }
+    Tcl_MutexLock(&mutex);
+    if (segment != 0L)
+    {
+	live = Read(slot, &state);
+	Store(segment, slot, live, state);
+    }
+    Tcl_MutexUnlock(&mutex);
+#endif
+}
+
+int
+CMoSnapshot::Export(const char* name)
+{
+#if defined(_WIN32)
+    return *name == '\0' ? 0 : ENOSYS;
+#else
+    static bool exitHandler = false;
+    CMoTelemetry *t = 0L, *old;
+    std::string oldName;
+    State state;
+    bool live;
+    int error, i;
+
+    Tcl_MutexLock(&mutex);
+    if (segmentName == name)
+    {
+	Tcl_MutexUnlock(&mutex);
+	return 0;
+    }
+    Tcl_MutexUnlock(&mutex);
+
+    if (*name != '\0')
+    {
+	if ((t = Create(name, &error)) == 0L)
+	{
+	    return error;
+	}
+	t->version = CMO_TELEMETRY_VERSION;
+	t->size = sizeof(CMoTelemetry);
+	t->axes = CMO_TELEMETRY_AXES;
+	t->pid = (uint32_t)getpid();
+	exporting.store(true);
+    }
+
+    // Every slot as it is now, then the magic that lets readers in; from
+    // here on each write to the table is copied as it happens.
+    Tcl_MutexLock(&mutex);
+    old = segment;
+    oldName = segmentName;
+    segment = t;
+    segmentName = name;
+    if (t != 0L)
+    {
+	for (i = 0; i < CMO_SNAPSHOT_SLOTS; i++)
+	{
+	    live = Read(i, &state);
+	    Store(t, i, live, state);
+	}
+	__atomic_store_n(&t->magic, CMO_TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+	if (!exitHandler)
+	{
+	    Tcl_CreateExitHandler(ExitProc, 0L);
+	    exitHandler = true;
+	}
+    }
+    else
+    {
+	exporting.store(false);
+    }
+    Tcl_MutexUnlock(&mutex);
+
+    // Readers still mapping the old one see nothing published in it.
+    if (old != 0L)
+    {
+	for (i = 0; i < CMO_SNAPSHOT_SLOTS; i++)
+	{
+	    Read(i, &state);
+	    Store(old, i, false, state);
+	}
+	__atomic_store_n(&old->magic, 0, __ATOMIC_RELEASE);
+	munmap(old, sizeof(CMoTelemetry));
+	shm_unlink(oldName.c_str());
+    }
+    return 0;
+#endif
+}
+
+std::string
+CMoSnapshot::Exported()
+{
+    std::string name;
+
+    Tcl_MutexLock(&mutex);
+    name = segmentName;
+    Tcl_MutexUnlock(&mutex);
+    return name;
+}
@@ -0,0 +1,97 @@
+/*
+ * CMoSnapshot.hpp --
+ *
+ *	The latest state of each published axis, readable from any thread
+ *	without a packet or a lock.
+ *
+ * An axis given [$axis Publish -interval ms] is polled by the worker that
+ * does the waits (CMoWait.hpp): its actual position and velocity and its
+ * event and activity status go out as one pipelined batch every interval,
+ * booked on the wire like any other periodic poll (CMoLoad.hpp), and the
+ * answers are written into the axis' slot in a table shared by the whole
+ * process.  Any thread, in any interpreter, reads a slot with Read or
+ * [cmotion::snapshot slot] as often as it likes at no cost to the bus.
+ *
+ * Each slot is a seqlock on a cache line of its own.  The one writer makes
+ * the sequence odd, stores the state and makes it even again; a reader
+ * copies the state between two loads of the sequence and goes again if
+ * they differ or were odd.  Readers never write to the slot, so any number
+ * of them share the line without taking it from each other or from the
+ * writer, and a reader is only ever held up by a write in progress, a
+ * few stores long.
+ *
+ * [cmotion::telemetry /name] keeps a copy of the table in a POSIX shared
+ * memory segment as well, laid out as CMoTelemetry.h describes, for an
+ * HMI or a logger in another process to read the same way.
+ */
+#ifndef INC_CMoSnapshot_hpp__
+#define INC_CMoSnapshot_hpp__
+
+#include "CMoTransport.h"
+#include <atomic>
+#include <string>
+
+#define CMO_SNAPSHOT_SLOTS 64
+#define CMO_SNAPSHOT_PACKETS 4
+
+class CMoSnapshot
+{
+public:
+    struct State
+    {
+	PMDint32 position;		// actual
+	PMDint32 velocity;		// actual
+	PMDuint16 eventStatus;
+	PMDuint16 activityStatus;
+	PMDresult result;		// of the last poll
+	unsigned long long stamp;	// CMoReplyStamp_Now of the last good one
+	PMDuint32 polls;
+	PMDuint32 failures;
+    };
+
+    // What a poll reads: GetActualPosition, GetActualVelocity,
+    // GetEventStatus and GetActivityStatus.
+    static const PMDuint8 Opcodes[CMO_SNAPSHOT_PACKETS];
+
+    // A free slot, or -1 when they are all taken.  Release empties it.
+    static int Acquire();
+    static void Release(int slot);
+
+    // Only the slot's owner writes to it, a poll at a time.  Publish takes
+    // everything up to the stamp; Fail keeps the last good state and
+    // notes the error.
+    static void Publish(int slot, const State& state);
+    static void Fail(int slot, PMDresult result);
+
+    // False for a slot nothing is published in.
+    static bool Read(int slot, State* state);
+
+    // Copy every slot to the shared memory segment name from now on, in
+    // place of any before it; "" stops.  0, or an errno.  Exported is the
+    // name, or "".
+    static int Export(const char* name);
+    static std::string Exported();
+
+private:
+    struct alignas(64) Slot
+    {
+	std::atomic<PMDuint32> sequence;
+	std::atomic<bool> live;
+	std::atomic<PMDint32> position;
+	std::atomic<PMDint32> velocity;
+	std::atomic<PMDuint16> eventStatus;
+	std::atomic<PMDuint16> activityStatus;
+	std::atomic<PMDuint16> result;
+	std::atomic<unsigned long long> stamp;
+	std::atomic<PMDuint32> polls;
+	std::atomic<PMDuint32> failures;
+    };
+
+    static void Begin(Slot& slot);
+    static void End(Slot& slot);
+    static void Mirror(int slot);
+
+    static Slot table[CMO_SNAPSHOT_SLOTS];
+};
+
+#endif	// #ifndef INC_CMoSnapshot_hpp__
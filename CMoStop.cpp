@@ -0,0 +1,389 @@
+/*
+ * CMoStop.cpp --
+ *
+ *	Emergency stops sent past every queue.  See CMoStop.hpp.
+ */
+
+#include "c-motion/c-motion.h"
+#include "CMoStop.hpp"
+#include "CMoCan.h"
+#include "CMoNetwork.h"
+#include "CMoOpcodes.hpp"
+#include "CMoReactor.hpp"
+#include "c-motion/PMDW32Ser.h"
+#include <string.h>
+#include <chrono>
+#include <list>
+#include <map>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+typedef PMDresult (*SendProc)(void*, PMDuint8, PMDuint16*, PMDuint8, PMDuint16*);
+
+struct Armed
+{
+    PMDAxisHandle* handle;
+    Tcl_ThreadId thread;	// that owns the port
+    SendProc send;
+    void* transportData;
+    CMoNetworkData* clone;	// network only
+
+    CMoFrame frames[CMoStop::NUM_KINDS][2];
+    int count[CMoStop::NUM_KINDS];
+    PMDuint8 tx[CMoStop::NUM_KINDS][2 * CMO_FRAME_BYTES];	// serial only
+    int txLen[CMoStop::NUM_KINDS];
+
+    CMoStop::Stats stats;
+
+    // The stop under way.
+    CMoFrame sent[2];
+    CMoReactor::Request request;
+    bool preempted;		// handed to the reactor
+    bool waiting;		// for it to answer
+    bool stranger;		// sent directly, but not by the owner
+    PMDresult result;
+    Clock::time_point answered;
+};
+
+// Every armed axis.  A trigger works on them with the lock let go, so
+// Arm and Disarm wait for it to finish.
+static std::list<Armed*> armed;
+static Tcl_Mutex mutex;
+static Tcl_Condition idle;
+static bool busy;
+
+// The reactor hands back the serial stops on its own thread.
+static Tcl_Mutex answerMutex;
+static Tcl_Condition answeredCondition;
+
+static void
+Frame(CMoFrame* frame, PMDAxisHandle* handle, PMDuint8 opcode, PMDuint16 argument)
+{
+    memset(frame, 0, sizeof(*frame));
+    frame->xCt = 2;
+    frame->xDat[0] = (PMDuint16)((handle->axis << 8) | opcode);
+    frame->xDat[1] = argument;
+}
+
+static bool
+IsSerial(SendProc send)
+{
+    return send == PMDSerial_Send || send == CMoReactor_SendCommand;
+}
+
+static const char* ownerOnly =
+    "its serial port isn't attached to the reactor, so only the thread "
+    "that owns it can stop it";
+
+// Why only the owner of the port can stop the axis, or 0L when anyone can.
+static const char*
+Why(PMDAxisHandle* handle)
+{
+    if (handle->transport.SendCommand == PMDSerial_Send)
+    {
+	return ownerOnly;
+    }
+    return 0L;
+}
+
+bool
+CMoStop::Arm(PMDAxisHandle* handle, const char** why)
+{
+    Armed* entry;
+    int kind, i, len;
+
+    Disarm(handle);
+    *why = 0L;
+    if (handle->transport.SendCommand == 0L)
+    {
+	*why = "the axis has no port";
+	return false;
+    }
+    entry = new Armed();
+    entry->handle = handle;
+    entry->thread = Tcl_GetCurrentThread();
+    entry->send = handle->transport.SendCommand;
+    entry->transportData = handle->transport_data;
+
+    Frame(&entry->frames[Abrupt][0], handle, CMoOp::SetStopMode, PMDStopModeAbrupt);
+    Frame(&entry->frames[Abrupt][1], handle, CMoOp::Update, 0);
+    entry->frames[Abrupt][1].xCt = 1;
+    entry->count[Abrupt] = 2;
+    Frame(&entry->frames[MotorOff][0], handle, CMoOp::SetOperatingMode,
+	PMDOperatingModeAxisEnabled);
+    entry->count[MotorOff] = 1;
+
+    if (IsSerial(entry->send))
+    {
+	for (kind = 0; kind < NUM_KINDS; kind++)
+	{
+	    for (i = 0; i < entry->count[kind]; i++)
+	    {
+		len = CMoTransport_EncodeFrame(handle, &entry->frames[kind][i],
+		    entry->tx[kind] + entry->txLen[kind]);
+		if (len == 0)
+		{
+		    // Not a port the reactor takes.
+		    entry->txLen[kind] = 0;
+		    break;
+		}
+		entry->txLen[kind] += len;
+	    }
+	}
+    }
+    else if (entry->send == CMoNetwork_SendCommand)
+    {
+	entry->clone = CMoNetwork_Clone((CMoNetworkData*)entry->transportData);
+    }
+
+    Tcl_MutexLock(&mutex);
+    while (busy)
+    {
+	Tcl_ConditionWait(&idle, &mutex, 0L);
+    }
+    armed.push_back(entry);
+    Tcl_MutexUnlock(&mutex);
+
+    *why = Why(handle);
+    return *why == 0L;
+}
+
+void
+CMoStop::Disarm(PMDAxisHandle* handle)
+{
+    std::list<Armed*>::iterator it;
+    Armed* entry = 0L;
+
+    Tcl_MutexLock(&mutex);
+    while (busy)
+    {
+	Tcl_ConditionWait(&idle, &mutex, 0L);
+    }
+    for (it = armed.begin(); it != armed.end(); ++it)
+    {
+	if ((*it)->handle == handle)
+	{
+	    entry = *it;
+	    armed.erase(it);
+	    break;
+	}
+    }
+    Tcl_MutexUnlock(&mutex);
+
+    if (entry != 0L)
+    {
+	if (entry->clone != 0L)
+	{
+	    CMoNetwork_Close(entry->clone);
+	}
+	delete entry;
+    }
+}
+
+static void
+Answered(CMoReactor::Request* request)
+{
+    Armed* entry = static_cast<Armed*>(request->clientData);
+
+    Tcl_MutexLock(&answerMutex);
+    entry->answered = Clock::now();
+    entry->result = request->result;
+    entry->waiting = false;
+    Tcl_ConditionNotify(&answeredCondition);
+    Tcl_MutexUnlock(&answerMutex);
+}
+
+// The way every port can be used: by its owner, one packet at a time.
+// Any other thread sends nothing.
+static void
+Direct(Armed* entry, int count)
+{
+    SendProc send = IsSerial(entry->send) ? PMDSerial_Send : entry->send;
+    PMDuint16 rDat[CMO_FRAME_WORDS];
+    int i;
+
+    entry->result = PMD_ERR_OK;
+    entry->stranger = entry->thread != Tcl_GetCurrentThread();
+    if (entry->stranger)
+    {
+	entry->result = PMD_ERR_InvalidOperation;
+    }
+    for (i = 0; i < count && entry->result == PMD_ERR_OK; i++)
+    {
+	entry->result = send(entry->transportData, entry->sent[i].xCt,
+	    entry->sent[i].xDat, entry->sent[i].rCt, rDat);
+    }
+    entry->answered = Clock::now();
+}
+
+int
+CMoStop::Trigger(Kind kind, int* axes, PMDresult* error, const char** why)
+{
+    std::vector<Armed*> entries;
+    std::vector<Armed*> direct;
+    std::map<void*, std::vector<Armed*> > buses;
+    std::map<void*, std::vector<Armed*> >::iterator bus;
+    std::vector<CMoCanJob> jobs;
+    CMoReactor::Request* request;
+    Clock::time_point began;
+    Armed* entry;
+    size_t i, j;
+    int failed = 0;
+    PMDuint32 us;
+
+    Tcl_MutexLock(&mutex);
+    while (busy)
+    {
+	Tcl_ConditionWait(&idle, &mutex, 0L);
+    }
+    busy = true;
+    entries.assign(armed.begin(), armed.end());
+    Tcl_MutexUnlock(&mutex);
+
+    began = Clock::now();
+
+    // The serial stops first, since the reactor sends them while the
+    // others are on their way.
+    for (i = 0; i < entries.size(); i++)
+    {
+	entry = entries[i];
+	memcpy(entry->sent, entry->frames[kind], sizeof(entry->sent));
+	entry->preempted = entry->waiting = entry->stranger = false;
+	if (!IsSerial(entry->send) || entry->txLen[kind] == 0)
+	{
+	    continue;
+	}
+	request = &entry->request;
+	request->tx = entry->tx[kind];
+	request->txLen = entry->txLen[kind];
+	request->frames = entry->sent;
+	request->count = entry->count[kind];
+	request->priority = CMoControl;
+	request->done = Answered;
+	request->clientData = entry;
+	entry->waiting = true;
+	entry->preempted = CMoReactor::Preempt(entry->transportData, request);
+	if (!entry->preempted)
+	{
+	    entry->waiting = false;
+	}
+    }
+
+    for (i = 0; i < entries.size(); i++)
+    {
+	entry = entries[i];
+	if (entry->preempted)
+	{
+	    continue;
+	}
+	if (entry->send == CMoCan_SendCommand)
+	{
+	    buses[CMoCan_Bus(entry->transportData)].push_back(entry);
+	}
+	else if (entry->clone != 0L)
+	{
+	    entry->result = CMoNetwork_SendFrames(entry->clone, entry->sent,
+		entry->count[kind]);
+	    entry->answered = Clock::now();
+	}
+	else
+	{
+	    direct.push_back(entry);
+	}
+    }
+
+    // Each bus all at once.
+    for (bus = buses.begin(); bus != buses.end(); ++bus)
+    {
+	jobs.resize(bus->second.size());
+	for (i = 0; i < jobs.size(); i++)
+	{
+	    jobs[i].transport_data = bus->second[i]->transportData;
+	    jobs[i].frames = bus->second[i]->sent;
+	    jobs[i].count = bus->second[i]->count[kind];
+	}
+	CMoCan_SendUrgent(&jobs[0], (int)jobs.size());
+	for (i = 0; i < jobs.size(); i++)
+	{
+	    entry = bus->second[i];
+	    entry->result = PMD_ERR_OK;
+	    for (j = 0; j < (size_t)jobs[i].count && entry->result == PMD_ERR_OK; j++)
+	    {
+		entry->result = entry->sent[j].result;
+	    }
+	    entry->answered = Clock::now();
+	}
+    }
+
+    for (i = 0; i < direct.size(); i++)
+    {
+	Direct(direct[i], direct[i]->count[kind]);
+    }
+
+    // The reactor times out a stop that gets no answer itself.
+    Tcl_MutexLock(&answerMutex);
+    for (i = 0; i < entries.size(); i++)
+    {
+	while (entries[i]->waiting)
+	{
+	    Tcl_ConditionWait(&answeredCondition, &answerMutex, 0L);
+	}
+    }
+    Tcl_MutexUnlock(&answerMutex);
+
+    *error = PMD_ERR_OK;
+    *why = 0L;
+    for (i = 0; i < entries.size(); i++)
+    {
+	entry = entries[i];
+	entry->stats.stops++;
+	if (entry->result != PMD_ERR_OK)
+	{
+	    entry->stats.failures++;
+	    if (failed++ == 0)
+	    {
+		*error = entry->result;
+		*why = entry->stranger ? ownerOnly : 0L;
+	    }
+	    continue;
+	}
+	us = (PMDuint32)std::chrono::duration_cast<std::chrono::microseconds>(
+	    entry->answered - began).count();
+	entry->stats.lastUs = us;
+	if (us > entry->stats.worstUs)
+	{
+	    entry->stats.worstUs = us;
+	}
+    }
+    *axes = (int)entries.size();
+
+    Tcl_MutexLock(&mutex);
+    busy = false;
+    Tcl_ConditionNotify(&idle);
+    Tcl_MutexUnlock(&mutex);
+    return failed;
+}
+
+bool
+CMoStop::GetStats(PMDAxisHandle* handle, Stats* stats)
+{
+    std::list<Armed*>::iterator it;
+    bool found = false;
+
+    Tcl_MutexLock(&mutex);
+    while (busy)
+    {
+	Tcl_ConditionWait(&idle, &mutex, 0L);
+    }
+    for (it = armed.begin(); it != armed.end() && !found; ++it)
+    {
+	if ((*it)->handle == handle)
+	{
+	    *stats = (*it)->stats;
+	    stats->why = Why(handle);
+	    found = true;
+	}
+    }
+    Tcl_MutexUnlock(&mutex);
+    return found;
+}
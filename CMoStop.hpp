@@ -0,0 +1,72 @@
+/*
+ * CMoStop.hpp --
+ *
+ *	The emergency stop behind [cmotion::estop].
+ *
+ * A stop sent like any other command waits its turn behind whatever the
+ * port already has: a batch, a program, a queue of posted commands.  Here
+ * every axis has its stop packets encoded as soon as it is connected, and
+ * the trigger sends them all at once, each port the quickest way it has:
+ *
+ *   serial	through the reactor (CMoReactor.hpp), ahead of everything
+ *		queued and of what it hadn't written yet, both of which
+ *		are thrown away
+ *   CAN	ahead of every job on the bus, cutting short the other
+ *		jobs for the same node (CMoCan.h)
+ *   network	on a second connection kept open for the purpose
+ *		(CMoNetwork.h), so nothing in flight is in the way
+ *
+ * What was thrown away fails with "Wait cancelled".  Bytes the serial
+ * driver already has still go first; the reactor's window keeps that to
+ * a few packets.
+ *
+ * A serial port that isn't attached to the reactor has no way past its
+ * queue.  Only the thread that owns it can send to it, so only a trigger
+ * from that thread stops it, after whatever that thread was doing.  Arm
+ * says so, [$axis StopStats] shows it as preempt 0, and a trigger from any
+ * other thread fails for that axis with the reason rather than a bare
+ * error code.  Attach the port ([cmotion::reactor attach axis]) for a stop
+ * that any thread can send at once.
+ *
+ * The stop is SetStopMode abrupt and Update, or SetOperatingMode with just
+ * the axis enabled, which turns the motor output off as well.  Each axis
+ * keeps how long its stops took from the trigger to the drive's answer,
+ * last and worst, for [$axis StopStats].
+ */
+#ifndef INC_CMoStop_hpp__
+#define INC_CMoStop_hpp__
+
+#include "tcl.h"
+#include "CMoTransport.h"
+
+class CMoStop
+{
+public:
+    enum Kind {Abrupt, MotorOff, NUM_KINDS};
+
+    struct Stats
+    {
+	unsigned long stops;
+	unsigned long failures;
+	PMDuint32 lastUs;	// trigger to answer
+	PMDuint32 worstUs;
+	const char* why;	// 0L when any thread can stop it at once
+    };
+
+    // Encode the stops for the axis behind handle as it is connected now.
+    // Disarm before it goes away or changes ports, Arm again after.  The
+    // axis is armed either way, but Arm returns false, with the reason in
+    // *why, when only the thread that owns its port can stop it.
+    static bool Arm(PMDAxisHandle* handle, const char** why);
+    static void Disarm(PMDAxisHandle* handle);
+
+    // Stop every armed axis and wait for them all to answer.  Returns how
+    // many didn't, with the first error in *error, and how many there are
+    // in *axes.  *why is the reason when the first failure was an axis
+    // this thread can't stop, 0L otherwise.
+    static int Trigger(Kind kind, int* axes, PMDresult* error, const char** why);
+
+    static bool GetStats(PMDAxisHandle* handle, Stats* stats);
+};
+
+#endif	// #ifndef INC_CMoStop_hpp__
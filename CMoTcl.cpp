@@ -30,6 +30,16 @@
 #include "cpptcl/ItclAdaptor.hpp"
 #include "cpptcl/TclHash.hpp"
 #include "CMoAxis.hpp"
+#include "CMoDevice.hpp"
+#include "CMoProgram.hpp"
+#include "CMoBatch.hpp"
+#include "CMoPost.hpp"
+#include "CMoReactor.hpp"
+#include "CMoReplyStamp.h"
+#include "CMoSnapshot.hpp"
+#include "CMoStop.hpp"
+#include "c-motion/PMDdiag.h"
+#include <map>
 #include <string>
 #include <sstream>
 
@@ -37,6 +47,10 @@ class ItclCMoAdaptor
     : private Itcl::IAdaptor<ItclCMoAdaptor>
 {
     Tcl::Hash<CMoAxis *, TCL_ONE_WORD_KEYS> CMoHash;
+    Tcl::Hash<CMoDevice *, TCL_ONE_WORD_KEYS> DevHash;
+    std::map<std::string, CMoAxis::Method> APIMethods;
+    unsigned long programs;
+    CMoBatch *batch;		// open [cmotion::batch], if any
     Tcl_Encoding iso8859_1;
  
     virtual void DoCleanup ()
@@ -47,15 +61,17 @@ class ItclCMoAdaptor
 
 public:
     ItclCMoAdaptor(Tcl_Interp *interp)
-	: Itcl::IAdaptor<ItclCMoAdaptor>(interp)
+	: Itcl::IAdaptor<ItclCMoAdaptor>(interp), programs(0), batch(0L)
     {
 
 	// Let [Incr Tcl] know we have some methods in here.
 	NewItclCmd("CMo-construct", &ItclCMoAdaptor::ConstructCmd);
 	NewItclCmd("CMo-destruct",  &ItclCMoAdaptor::DestructCmd);
 
+    // Also remember the method by name so [cmotion::prepare] can find it.
 #define NewItclAPICmd(a) \
-     NewItclCmd(STRINGIFY(JOIN(CMo-,a)), &ItclCMoAdaptor::PMD##a##Cmd)
+     NewItclCmd("CMo-" #a, &ItclCMoAdaptor::PMD##a##Cmd); \
+     APIMethods[#a] = &CMoAxis::PMD##a
 
 	// **** Begin API connections ****
 
@@ -305,6 +321,80 @@ public:
 	NewItclAPICmd(SetCurrentLimit);
 	NewItclAPICmd(GetCurrentLimit);
 
+	// **** End API connections ****
+
+#define NewItclExtCmd(a) \
+     NewItclCmd("CMo-" #a, &ItclCMoAdaptor::a##Cmd)
+
+	// Host side extensions that aren't a single C-Motion call.
+
+	// Version of the C-Motion layer linked in
+	NewItclCmd("CMo-GetCMotionVersion", &ItclCMoAdaptor::GetCMotionVersionCmd);
+
+	// Move queue
+	NewItclExtCmd(QueueMove);
+	NewItclExtCmd(QueueStart);
+	NewItclExtCmd(QueueStop);
+	NewItclExtCmd(QueueService);
+	NewItclExtCmd(QueueStatus);
+
+	// Host side serial port
+	NewItclExtCmd(SerialConfigure);
+	NewItclExtCmd(SerialStats);
+
+	// Host side network connection
+	NewItclExtCmd(NetworkConnect);
+	NewItclExtCmd(NetworkConfigure);
+	NewItclExtCmd(NetworkStats);
+	NewItclExtCmd(CanConnect);
+	NewItclExtCmd(CanConfigure);
+	NewItclExtCmd(CanStats);
+	NewItclExtCmd(ReadMemory);
+	NewItclExtCmd(WriteMemory);
+	NewItclExtCmd(WaitForEvent);
+	NewItclExtCmd(Publish);
+
+	// Emergency stops
+	NewItclExtCmd(StopStats);
+
+	// Bus load
+	NewItclExtCmd(BusLoad);
+
+	// Read-ahead
+	NewItclExtCmd(PrefetchConfigure);
+	NewItclExtCmd(PrefetchStats);
+
+#define NewItclDevCmd(a) \
+     NewItclCmd("CMoDev-" #a, &ItclCMoAdaptor::Dev##a##Cmd)
+
+	// pmd::device, for the user code on a C-Motion Engine
+	NewItclCmd("CMoDev-construct", &ItclCMoAdaptor::DevConstructCmd);
+	NewItclCmd("CMoDev-destruct",  &ItclCMoAdaptor::DevDestructCmd);
+	NewItclDevCmd(Connect);
+	NewItclDevCmd(Disconnect);
+	NewItclDevCmd(StoreUserCode);
+	NewItclDevCmd(GetUserCodeFileName);
+	NewItclDevCmd(GetUserCodeFileVersion);
+	NewItclDevCmd(GetUserCodeFileDate);
+	NewItclDevCmd(TaskStart);
+	NewItclDevCmd(TaskStop);
+	NewItclDevCmd(TaskGetState);
+	NewItclDevCmd(ReadMemory);
+	NewItclDevCmd(WriteMemory);
+	NewItclDevCmd(WaitForEvent);
+
+	// Commands in the ::cmotion namespace
+	NewTclCmd("::cmotion::prepare", &ItclCMoAdaptor::PrepareCmd);
+	NewTclCmd("::cmotion::batch", &ItclCMoAdaptor::BatchCmd);
+	NewTclCmd("::cmotion::post", &ItclCMoAdaptor::PostCmd);
+	NewTclCmd("::cmotion::priority", &ItclCMoAdaptor::PriorityCmd);
+	NewTclCmd("::cmotion::age", &ItclCMoAdaptor::AgeCmd);
+	NewTclCmd("::cmotion::snapshot", &ItclCMoAdaptor::SnapshotCmd);
+	NewTclCmd("::cmotion::telemetry", &ItclCMoAdaptor::TelemetryCmd);
+	NewTclCmd("::cmotion::reactor", &ItclCMoAdaptor::ReactorCmd);
+	NewTclCmd("::cmotion::realtime", &ItclCMoAdaptor::RealtimeCmd);
+	NewTclCmd("::cmotion::estop", &ItclCMoAdaptor::EstopCmd);
+
 	iso8859_1 = Tcl_GetEncoding(interp, "iso8859-1");
     }
 
@@ -367,14 +457,578 @@ private:
 	    // constructor returned with an error!  Thus, no CMoAPI
 	    // instance exists in the hash table even though an Itcl object
 	    // context exists.  Only delete what we know is there.
+	    if (batch != 0L) batch->Forget(CMoPtr);
 	    delete CMoPtr;
 	}
 	return TCL_OK;
     }
 
+    // Find the CMoAxis behind a pmd::cmotion object name.
+    static CMoAxis* FindAxis(ClientData clientData, Tcl_Interp* interp, Tcl_Obj* name)
+    {
+	ItclCMoAdaptor* adaptor = static_cast<ItclCMoAdaptor*>(clientData);
+	ItclObject* ItclObj = 0L;
+	CMoAxis* CMoPtr;
+
+	if (Itcl_FindObject(interp, Tcl_GetString(name), &ItclObj) != TCL_OK) {
+	    return 0L;
+	}
+	if (ItclObj == 0L || adaptor->CMoHash.Find(ItclObj, &CMoPtr) != TCL_OK) {
+	    Tcl_ResetResult(interp);
+	    Tcl_AppendResult(interp, "\"", Tcl_GetString(name),
+		"\" is not a pmd::cmotion object", 0L);
+	    return 0L;
+	}
+	return CMoPtr;
+    }
+
+    // Split a script into commands and add each one to the program.  The
+    // words are substituted here, in the caller's scope, so the program
+    // only holds constants and %N slots.
+    int CompileProgram (CMoProgram *program, Tcl_Obj *scriptObj)
+    {
+	std::map<std::string, CMoAxis::Method>::iterator method;
+	Tcl_Parse parse;
+	Tcl_Token *token;
+	Tcl_Obj *words, *word;
+	const char *script;
+	int length, i, code = TCL_OK;
+
+	script = Tcl_GetStringFromObj(scriptObj, &length);
+	while (length > 0 && code == TCL_OK) {
+	    if (Tcl_ParseCommand(interp, script, length, 0, &parse) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    words = Tcl_NewListObj(0, 0L);
+	    Tcl_IncrRefCount(words);
+
+	    for (i = 0, token = parse.tokenPtr; i < parse.numWords && code == TCL_OK;
+		    i++, token += token->numComponents + 1) {
+		if (token->type == TCL_TOKEN_SIMPLE_WORD) {
+		    word = Tcl_NewStringObj(token[1].start, token[1].size);
+		} else if (token->type == TCL_TOKEN_EXPAND_WORD) {
+		    Tcl_SetObjResult(interp,
+			Tcl_NewStringObj("{*} can't be used in a program", -1));
+		    code = TCL_ERROR;
+		    break;
+		} else if ((code = Tcl_EvalTokensStandard(interp, token + 1,
+			token->numComponents)) == TCL_OK) {
+		    word = Tcl_GetObjResult(interp);
+		} else {
+		    break;
+		}
+		Tcl_ListObjAppendElement(0L, words, word);
+	    }
+
+	    if (code == TCL_OK && parse.numWords > 0) {
+		Tcl_ListObjIndex(0L, words, 0, &word);
+		method = APIMethods.find(Tcl_GetString(word));
+		if (method == APIMethods.end()) {
+		    Tcl_ResetResult(interp);
+		    Tcl_AppendResult(interp, "unknown method \"",
+			Tcl_GetString(word), "\"", 0L);
+		    code = TCL_ERROR;
+		} else {
+		    code = program->AddStep(interp, method->second, words);
+		}
+	    }
+
+	    Tcl_DecrRefCount(words);
+	    length -= static_cast<int>(parse.commandStart + parse.commandSize - script);
+	    script = parse.commandStart + parse.commandSize;
+	    Tcl_FreeParse(&parse);
+	}
+	return code;
+    }
+
+    // cmotion::prepare script
+    int PrepareCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	CMoProgram *program;
+	std::ostringstream name;
+
+	if (objc != 2) {
+	    Tcl_WrongNumArgs(interp, 1, objv, "script");
+	    return TCL_ERROR;
+	}
+
+	program = new CMoProgram(FindAxis, this);
+	if (CompileProgram(program, objv[1]) != TCL_OK) {
+	    delete program;
+	    return TCL_ERROR;
+	}
+
+	name << "::cmotion::program" << ++programs;
+	program->token = Tcl_CreateObjCommand(interp, name.str().c_str(),
+		CMoProgram::Command, program, CMoProgram::Deleted);
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(name.str().c_str(), -1));
+	return TCL_OK;
+    }
+
+    // cmotion::batch script
+    int BatchCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	CMoBatch *current;
+	Tcl_Obj *result;
+	int code;
+
+	if (objc != 2) {
+	    Tcl_WrongNumArgs(interp, 1, objv, "script");
+	    return TCL_ERROR;
+	}
+
+	// An inner batch just adds to the one already open.
+	if (batch != 0L) {
+	    return Tcl_EvalObjEx(interp, objv[1], 0);
+	}
+
+	batch = new CMoBatch();
+	code = Tcl_EvalObjEx(interp, objv[1], 0);
+	current = batch;
+	batch = 0L;
+
+	// Nothing is sent when the script fails.
+	if (code == TCL_ERROR) {
+	    delete current;
+	    return code;
+	}
+
+	result = Tcl_GetObjResult(interp);
+	Tcl_IncrRefCount(result);
+	if (current->Commit(interp) != TCL_OK) {
+	    code = TCL_ERROR;
+	} else if (code != TCL_OK) {
+	    // keep [return], [break] and friends working from inside
+	    Tcl_SetObjResult(interp, result);
+	}
+	Tcl_DecrRefCount(result);
+	delete current;
+	return code;
+    }
+
+    // cmotion::post ?-command script? ?-priority class? axis method ?arg ...?
+    int PostCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	static const char *options[] = {"-command", "-priority", 0L};
+	enum options {OPT_COMMAND, OPT_PRIORITY};
+	std::map<std::string, CMoAxis::Method>::iterator method;
+	Tcl_Obj *command = 0L;
+	int first = 1, index, priority = CMoPriority_Get();
+
+	while (objc > first + 1 && Tcl_GetString(objv[first])[0] == '-') {
+	    if (Tcl_GetIndexFromObj(interp, objv[first], options, "option", 0,
+		    &index) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if ((enum options) index == OPT_COMMAND) {
+		command = objv[first + 1];
+	    } else if (Tcl_GetIndexFromObj(interp, objv[first + 1],
+		    CMoPriority_Names, "class", 0, &priority) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    first += 2;
+	}
+	if (objc < first + 2) {
+	    Tcl_WrongNumArgs(interp, 1, objv,
+		"?-command script? ?-priority class? axis method ?arg ...?");
+	    return TCL_ERROR;
+	}
+	method = APIMethods.find(Tcl_GetString(objv[first + 1]));
+	if (method == APIMethods.end()) {
+	    Tcl_AppendResult(interp, "unknown method \"",
+		Tcl_GetString(objv[first + 1]), "\"", 0L);
+	    return TCL_ERROR;
+	}
+	return CMoPost::Start(interp, FindAxis, this, objv[first], method->second,
+		Tcl_NewListObj(objc - first - 1, objv + first + 1), command,
+		priority);
+    }
+
+    // cmotion::priority ?class? ?script?
+    //
+    // The class this thread's commands are queued in (CMoPriority.h).  With
+    // a script, only while it runs; without one, from now on, returning
+    // the class it had.
+    int PriorityCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	int priority, previous, code;
+
+	if (objc > 3) {
+	    Tcl_WrongNumArgs(interp, 1, objv, "?class? ?script?");
+	    return TCL_ERROR;
+	}
+	if (objc == 1) {
+	    Tcl_SetObjResult(interp,
+		Tcl_NewStringObj(CMoPriority_Names[CMoPriority_Get()], -1));
+	    return TCL_OK;
+	}
+	if (Tcl_GetIndexFromObj(interp, objv[1], CMoPriority_Names, "class", 0,
+		&priority) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	previous = CMoPriority_Set(priority);
+	if (objc == 2) {
+	    Tcl_SetObjResult(interp,
+		Tcl_NewStringObj(CMoPriority_Names[previous], -1));
+	    return TCL_OK;
+	}
+	code = Tcl_EvalObjEx(interp, objv[2], 0);
+	CMoPriority_Set(previous);
+	return code;
+    }
+
+    // cmotion::age
+    //
+    // Microseconds since the reply to this thread's last command came in
+    // (CMoReplyStamp.h), or in a -command script of [cmotion::post], the
+    // reply to the post; -1 before there is one or after a command that
+    // failed.  A read that shared another caller's reply or was prefetched
+    // may be older than the command.
+    int AgeCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	unsigned long long stamp = CMoReplyStamp_Get();
+
+	if (objc != 1) {
+	    Tcl_WrongNumArgs(interp, 1, objv, "");
+	    return TCL_ERROR;
+	}
+	Tcl_SetObjResult(interp, Tcl_NewWideIntObj(stamp == 0 ? -1 :
+		static_cast<Tcl_WideInt>(CMoReplyStamp_Now() - stamp)));
+	return TCL_OK;
+    }
+
+    // cmotion::snapshot ?slot?
+    //
+    // The state an axis published with [$axis Publish] (CMoSnapshot.hpp),
+    // from any thread or interpreter and without going near the bus:
+    // position, velocity, eventStatus and activityStatus from the last
+    // good poll, ageUs since it, the result of the last poll, and how many
+    // polls and failures there were.  Without a slot, a dict of all of
+    // them by slot.
+    static Tcl_Obj *SnapshotObj (const CMoSnapshot::State &state)
+    {
+	Tcl_Obj *result = Tcl_NewDictObj();
+
+#define SnapshotPut(f) \
+	Tcl_DictObjPut(0L, result, Tcl_NewStringObj(#f, -1), \
+	    Tcl_NewLongObj(state.f))
+	SnapshotPut(position);
+	SnapshotPut(velocity);
+	SnapshotPut(eventStatus);
+	SnapshotPut(activityStatus);
+#undef SnapshotPut
+	Tcl_DictObjPut(0L, result, Tcl_NewStringObj("ageUs", -1),
+	    Tcl_NewWideIntObj(state.stamp == 0 ? -1 :
+		static_cast<Tcl_WideInt>(CMoReplyStamp_Now() - state.stamp)));
+	Tcl_DictObjPut(0L, result, Tcl_NewStringObj("result", -1),
+	    Tcl_NewStringObj(state.result == PMD_NOERROR ? "ok"
+		: ::PMDGetErrorMessage(state.result), -1));
+	Tcl_DictObjPut(0L, result, Tcl_NewStringObj("polls", -1),
+	    Tcl_NewLongObj(state.polls));
+	Tcl_DictObjPut(0L, result, Tcl_NewStringObj("failures", -1),
+	    Tcl_NewLongObj(state.failures));
+	return result;
+    }
+
+    int SnapshotCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	CMoSnapshot::State state;
+	Tcl_Obj *result;
+	int slot;
+
+	if (objc > 2) {
+	    Tcl_WrongNumArgs(interp, 1, objv, "?slot?");
+	    return TCL_ERROR;
+	}
+	if (objc == 2) {
+	    if (Tcl_GetIntFromObj(interp, objv[1], &slot) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (!CMoSnapshot::Read(slot, &state)) {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "nothing is published in slot %d", slot));
+		return TCL_ERROR;
+	    }
+	    Tcl_SetObjResult(interp, SnapshotObj(state));
+	    return TCL_OK;
+	}
+	result = Tcl_NewDictObj();
+	for (slot = 0; slot < CMO_SNAPSHOT_SLOTS; slot++) {
+	    if (CMoSnapshot::Read(slot, &state)) {
+		Tcl_DictObjPut(0L, result, Tcl_NewIntObj(slot),
+		    SnapshotObj(state));
+	    }
+	}
+	Tcl_SetObjResult(interp, result);
+	return TCL_OK;
+    }
+
+    // cmotion::telemetry ?name?
+    //
+    // Keeps the snapshot table in the POSIX shared memory segment name
+    // too, for other processes (CMoTelemetry.h); "" stops.  Without a
+    // name, the one in use, or "".
+    int TelemetryCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	const char *name;
+	int error;
+
+	if (objc > 2) {
+	    Tcl_WrongNumArgs(interp, 1, objv, "?name?");
+	    return TCL_ERROR;
+	}
+	if (objc == 2) {
+	    name = Tcl_GetString(objv[1]);
+	    if ((error = CMoSnapshot::Export(name)) != 0) {
+		Tcl_SetErrno(error);
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "can't export to \"%s\": %s", name, Tcl_PosixError(interp)));
+		return TCL_ERROR;
+	    }
+	}
+	Tcl_SetObjResult(interp,
+	    Tcl_NewStringObj(CMoSnapshot::Exported().c_str(), -1));
+	return TCL_OK;
+    }
+
+    // cmotion::reactor attach|detach axis
+    // cmotion::reactor stats
+    int ReactorCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	static const char *options[] = {"attach", "detach", "stats", 0L};
+	enum options {OPT_ATTACH, OPT_DETACH, OPT_STATS};
+	CMoReactor::Stats stats;
+	CMoAxis *CMoPtr;
+	Tcl_Obj *result;
+	int index;
+
+	if (objc < 2) {
+	    Tcl_WrongNumArgs(interp, 1, objv, "option ?axis?");
+	    return TCL_ERROR;
+	}
+	if (Tcl_GetIndexFromObj(interp, objv[1], options, "option", 0, &index) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+
+	if ((enum options) index == OPT_STATS) {
+	    if (objc != 2) {
+		Tcl_WrongNumArgs(interp, 2, objv, "");
+		return TCL_ERROR;
+	    }
+	    CMoReactor::GetStats(&stats);
+	    result = Tcl_NewDictObj();
+#define StatsPut(f) \
+	    Tcl_DictObjPut(0L, result, Tcl_NewStringObj(#f, -1), \
+		Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(stats.f)))
+	    StatsPut(ports);
+	    StatsPut(requests);
+	    StatsPut(frames);
+	    StatsPut(timeouts);
+	    StatsPut(resyncs);
+	    StatsPut(bytesOut);
+	    StatsPut(bytesIn);
+	    StatsPut(wakeups);
+	    StatsPut(allocations);
+	    StatsPut(coalesced);
+#undef StatsPut
+	    Tcl_DictObjPut(0L, result, Tcl_NewStringObj("waits", -1),
+		CMoWaitStats_NewObj(stats.waits));
+	    Tcl_SetObjResult(interp, result);
+	    return TCL_OK;
+	}
+
+	if (objc != 3) {
+	    Tcl_WrongNumArgs(interp, 2, objv, "axis");
+	    return TCL_ERROR;
+	}
+	if ((CMoPtr = FindAxis(this, interp, objv[2])) == 0L) {
+	    return TCL_ERROR;
+	}
+	if ((enum options) index == OPT_DETACH) {
+	    CMoReactor::Detach(CMoPtr->Handle());
+	} else if (!CMoReactor::IsAttached(CMoPtr->Handle()) &&
+		!CMoReactor::Attach(CMoPtr->Handle())) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"can't attach: not a point-to-point serial port, or no reactor here", -1));
+	    return TCL_ERROR;
+	}
+	return TCL_OK;
+    }
+
+    // cmotion::realtime ?-lock bool? ?-priority n? ?-cpus list? ?-depth n?
+    // cmotion::realtime off
+    //
+    // Options given are applied to the reactor thread on top of the ones
+    // already in force, and arm it: its queues and buffers are sized for
+    // -depth requests per port, and any allocation it still has to make
+    // is counted in -allocations.  Without options, the settings.
+    int RealtimeCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	static const char *options[] = {"-lock", "-priority", "-cpus", "-depth", 0L};
+	enum options {OPT_LOCK, OPT_PRIORITY, OPT_CPUS, OPT_DEPTH};
+	CMoReactor::Realtime config;
+	CMoReactor::Stats stats;
+	Tcl_Obj *result, *cpus, **elems;
+	const char *what;
+	int i, j, index, flag, value, count, err;
+	bool armed;
+
+	armed = CMoReactor::GetRealtime(&config);
+
+	if (objc == 2 && strcmp(Tcl_GetString(objv[1]), "off") == 0) {
+	    CMoReactor::Disarm();
+	    return TCL_OK;
+	}
+
+	if (objc == 1) {
+	    CMoReactor::GetStats(&stats);
+	    cpus = Tcl_NewListObj(0, 0L);
+	    for (i = 0; i < 64; i++) {
+		if ((config.cpus >> i) & 1) {
+		    Tcl_ListObjAppendElement(0L, cpus, Tcl_NewIntObj(i));
+		}
+	    }
+	    result = Tcl_NewListObj(0, 0L);
+	    Tcl_ListObjAppendElement(0L, result, Tcl_NewStringObj("-lock", -1));
+	    Tcl_ListObjAppendElement(0L, result, Tcl_NewBooleanObj(config.lock));
+	    Tcl_ListObjAppendElement(0L, result, Tcl_NewStringObj("-priority", -1));
+	    Tcl_ListObjAppendElement(0L, result, Tcl_NewIntObj(config.priority));
+	    Tcl_ListObjAppendElement(0L, result, Tcl_NewStringObj("-cpus", -1));
+	    Tcl_ListObjAppendElement(0L, result, cpus);
+	    Tcl_ListObjAppendElement(0L, result, Tcl_NewStringObj("-depth", -1));
+	    Tcl_ListObjAppendElement(0L, result, Tcl_NewIntObj(config.depth));
+	    Tcl_ListObjAppendElement(0L, result, Tcl_NewStringObj("-armed", -1));
+	    Tcl_ListObjAppendElement(0L, result, Tcl_NewBooleanObj(armed));
+	    Tcl_ListObjAppendElement(0L, result, Tcl_NewStringObj("-allocations", -1));
+	    Tcl_ListObjAppendElement(0L, result,
+		Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(stats.allocations)));
+	    Tcl_SetObjResult(interp, result);
+	    return TCL_OK;
+	}
+
+	if (objc % 2 == 0) {
+	    Tcl_WrongNumArgs(interp, 1, objv,
+		"?-lock bool? ?-priority n? ?-cpus list? ?-depth n? | off");
+	    return TCL_ERROR;
+	}
+
+	for (i = 1; i < objc; i += 2) {
+	    if (Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, &index) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    switch ((enum options) index) {
+	    case OPT_LOCK:
+		if (Tcl_GetBooleanFromObj(interp, objv[i+1], &flag) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		config.lock = flag != 0;
+		break;
+
+	    case OPT_PRIORITY:
+		if (Tcl_GetIntFromObj(interp, objv[i+1], &value) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		if (value < 0 || value > 99) {
+		    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+			"invalid priority, must be 0 to 99", -1));
+		    return TCL_ERROR;
+		}
+		config.priority = value;
+		break;
+
+	    case OPT_CPUS:
+		if (Tcl_ListObjGetElements(interp, objv[i+1], &count, &elems) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		config.cpus = 0;
+		for (j = 0; j < count; j++) {
+		    if (Tcl_GetIntFromObj(interp, elems[j], &value) != TCL_OK) {
+			return TCL_ERROR;
+		    }
+		    if (value < 0 || value > 63) {
+			Tcl_SetObjResult(interp, Tcl_NewStringObj(
+			    "invalid CPU, must be 0 to 63", -1));
+			return TCL_ERROR;
+		    }
+		    config.cpus |= 1ULL << value;
+		}
+		break;
+
+	    case OPT_DEPTH:
+		if (Tcl_GetIntFromObj(interp, objv[i+1], &value) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		if (value <= 0) {
+		    Tcl_SetObjResult(interp, Tcl_NewStringObj("invalid depth", -1));
+		    return TCL_ERROR;
+		}
+		config.depth = value;
+		break;
+	    }
+	}
+
+	if ((err = CMoReactor::Arm(&config, &what)) != 0) {
+	    Tcl_SetErrno(err);
+	    Tcl_AppendResult(interp, what, ": ", Tcl_PosixError(interp), 0L);
+	    return TCL_ERROR;
+	}
+	return TCL_OK;
+    }
+
+    // cmotion::estop ?-motoroff?
+    //
+    // Stops every axis in the process at once, ahead of anything else
+    // their ports have to send (see CMoStop.hpp), and returns how many
+    // there are once they have all answered.
+    int EstopCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	static const char *options[] = {"-motoroff", 0L};
+	CMoStop::Kind kind = CMoStop::Abrupt;
+	PMDresult error;
+	const char *why;
+	int index, axes, failed;
+
+	if (objc > 2) {
+	    Tcl_WrongNumArgs(interp, 1, objv, "?-motoroff?");
+	    return TCL_ERROR;
+	}
+	if (objc == 2) {
+	    if (Tcl_GetIndexFromObj(interp, objv[1], options, "option", 0, &index) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    kind = CMoStop::MotorOff;
+	}
+
+	failed = CMoStop::Trigger(kind, &axes, &error, &why);
+	if (failed > 0) {
+	    std::ostringstream msg;
+	    msg << failed << " of " << axes << " axes did not take the stop: "
+		<< (why != 0L ? why : ::PMDGetErrorMessage(error));
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(msg.str().c_str(), -1));
+	    return TCL_ERROR;
+	}
+	Tcl_SetObjResult(interp, Tcl_NewIntObj(axes));
+	return TCL_OK;
+    }
+
     // Boiler-plate to connect to the CMoAxis class.
 #define NewAPICmd(a) \
 	int a##Cmd (int objc, struct Tcl_Obj * const objv[]) \
+    { \
+	ItclObject* ItclObj; \
+	CMoAxis* CMoPtr; \
+	if (GetItclObj(&ItclObj, objv[0]) != TCL_OK) return TCL_ERROR; \
+	if (CMoHash.Find(ItclObj, &CMoPtr) != TCL_OK) { \
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj("CMoAPI instance lost!", -1)); \
+	    return TCL_ERROR; \
+	} \
+	if (batch != 0L) return batch->Call(interp, CMoPtr, &CMoAxis::a, objc, objv); \
+	return CMoPtr->a(interp,objc,objv); \
+    }
+
+    // Same, for the host side extensions that never go into a batch.
+#define NewExtCmd(a) \
+	int a##Cmd (int objc, struct Tcl_Obj * const objv[]) \
     { \
 	ItclObject* ItclObj; \
 	CMoAxis* CMoPtr; \
@@ -632,6 +1286,108 @@ private:
     NewAPICmd(PMDSetCurrentLimit);
     NewAPICmd(PMDGetCurrentLimit);
 
+    // Doesn't need the instance, just reports what Cmotcl_Init checked.
+    int GetCMotionVersionCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	PMDuint32 Maj, Min;
+	std::ostringstream ver;
+
+	PMDGetCMotionVersion(&Maj, &Min);
+	ver << Maj << "." << Min;
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(ver.str().c_str(), -1));
+	return TCL_OK;
+    }
+
+    // Move queue
+    NewExtCmd(QueueMove);
+    NewExtCmd(QueueStart);
+    NewExtCmd(QueueStop);
+    NewExtCmd(QueueService);
+    NewExtCmd(QueueStatus);
+
+    // Host side serial port
+    NewExtCmd(SerialConfigure);
+    NewExtCmd(SerialStats);
+
+    // Host side network connection
+    NewExtCmd(NetworkConnect);
+    NewExtCmd(NetworkConfigure);
+    NewExtCmd(NetworkStats);
+    NewExtCmd(CanConnect);
+    NewExtCmd(CanConfigure);
+    NewExtCmd(CanStats);
+    NewExtCmd(ReadMemory);
+    NewExtCmd(WriteMemory);
+    NewExtCmd(WaitForEvent);
+    NewExtCmd(Publish);
+
+    // Emergency stops
+    NewExtCmd(StopStats);
+
+    // Bus load
+    NewExtCmd(BusLoad);
+
+    // Read-ahead
+    NewExtCmd(PrefetchConfigure);
+    NewExtCmd(PrefetchStats);
+
+    // The pmd::device constructor and destructor.
+    int DevConstructCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	ItclObject *ItclObj;
+
+	if (objc != 1) {
+	    Tcl_WrongNumArgs(interp, 1, objv, "");
+	    return TCL_ERROR;
+	}
+	if (GetItclObj(&ItclObj, objv[0]) != TCL_OK) return TCL_ERROR;
+	DevHash.Add(ItclObj, new CMoDevice());
+	return TCL_OK;
+    }
+
+    int DevDestructCmd (int objc, struct Tcl_Obj * const objv[])
+    {
+	ItclObject *ItclObj;
+	CMoDevice *DevPtr;
+
+	if (objc != 1) {
+	    Tcl_WrongNumArgs(interp, 1, objv, "");
+	    return TCL_ERROR;
+	}
+	if (GetItclObj(&ItclObj, objv[0]) != TCL_OK) return TCL_ERROR;
+	if (DevHash.Extract(ItclObj, &DevPtr) == TCL_OK) {
+	    delete DevPtr;
+	}
+	return TCL_OK;
+    }
+
+    // Boiler-plate to connect to the CMoDevice class.
+#define NewDevCmd(a) \
+	int Dev##a##Cmd (int objc, struct Tcl_Obj * const objv[]) \
+    { \
+	ItclObject* ItclObj; \
+	CMoDevice* DevPtr; \
+	if (GetItclObj(&ItclObj, objv[0]) != TCL_OK) return TCL_ERROR; \
+	if (DevHash.Find(ItclObj, &DevPtr) != TCL_OK) { \
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj("CMoDevice instance lost!", -1)); \
+	    return TCL_ERROR; \
+	} \
+	return DevPtr->a(interp,objc,objv); \
+    }
+
+    NewDevCmd(Connect);
+    NewDevCmd(Disconnect);
+    NewDevCmd(StoreUserCode);
+    NewDevCmd(GetUserCodeFileName);
+    NewDevCmd(GetUserCodeFileVersion);
+    NewDevCmd(GetUserCodeFileDate);
+    NewDevCmd(TaskStart);
+    NewDevCmd(TaskStop);
+    NewDevCmd(TaskGetState);
+    NewDevCmd(ReadMemory);
+    NewDevCmd(WriteMemory);
+    NewDevCmd(WaitForEvent);
+
 
 /*
 
@@ -746,7 +1502,7 @@ EXTERN int Cmotcl_Init (Tcl_Interp *interp)
     }
 #endif
 #ifdef USE_ITCL_STUBS
-    if (Itcl_InitStubs(interp, "3.1", 0) == 0L) {
+    if (Itcl_InitStubs(interp, ITCL_VERSION, 0) == 0L) {
 	return TCL_ERROR;
     }
 #endif
@@ -0,0 +1,160 @@
+#ifndef INC_CMoTelemetry_h__
+#define INC_CMoTelemetry_h__
+
+// The snapshot table (CMoSnapshot.hpp) as a POSIX shared memory segment,
+// for an HMI or a logger in another process.
+//
+// [cmotion::telemetry /name] creates the segment and from then on every
+// poll of a published axis ([$axis Publish -interval ms]) is written to
+// it as well; [cmotion::telemetry ""] takes it away again.  This header
+// is all a reader needs: CMoTelemetry_Open maps the segment read only, and
+// CMoTelemetry_Read copies one axis' state out of the mapping, with no
+// system call and no lock, as often as it likes.  Link with -lrt where
+// shm_open needs it.
+//
+// The segment is one CMoTelemetry: a header, then each field as an array
+// indexed by slot, every array starting on a cache line.  Each slot has a
+// sequence number of its own, on a line of its own, that the writer makes
+// odd while it updates the slot and even again after; a reader copies the
+// slot between two loads of it and goes again if they differ or were odd.
+// Anything that changes this layout changes CMO_TELEMETRY_VERSION, and a
+// reader refuses a segment whose magic, version or size it doesn't know.
+//
+// stamp is CLOCK_MONOTONIC in microseconds, the same clock every process
+// on the machine sees, when the state was read from the drive.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CMO_TELEMETRY_MAGIC	0x546F4D43	// "CMoT"
+#define CMO_TELEMETRY_VERSION	1
+#define CMO_TELEMETRY_AXES	64
+
+typedef struct CMoTelemetry {
+    // Header
+    uint32_t magic;		// written last, once the rest is in place
+    uint32_t version;
+    uint32_t size;		// sizeof(CMoTelemetry)
+    uint32_t axes;		// CMO_TELEMETRY_AXES
+    uint32_t pid;		// of the writer, to tell one left by a process that died
+    uint8_t reserved[44];
+
+    struct {
+	uint32_t value;
+	uint8_t pad[60];
+    } sequence[CMO_TELEMETRY_AXES];
+
+    // The state, one array per field.
+    uint32_t live[CMO_TELEMETRY_AXES];		// something is published
+    int32_t position[CMO_TELEMETRY_AXES];		// actual
+    int32_t velocity[CMO_TELEMETRY_AXES];		// actual
+    uint16_t eventStatus[CMO_TELEMETRY_AXES];
+    uint16_t activityStatus[CMO_TELEMETRY_AXES];
+    uint16_t result[CMO_TELEMETRY_AXES];		// of the last poll, a PMDresult
+    uint16_t reserved2[CMO_TELEMETRY_AXES];
+    uint64_t stamp[CMO_TELEMETRY_AXES];		// of the last good poll, 0 before
+    uint32_t polls[CMO_TELEMETRY_AXES];
+    uint32_t failures[CMO_TELEMETRY_AXES];
+} CMoTelemetry;
+
+typedef struct CMoTelemetryState {
+    int32_t position;
+    int32_t velocity;
+    uint16_t eventStatus;
+    uint16_t activityStatus;
+    uint16_t result;
+    uint64_t stamp;
+    uint32_t polls;
+    uint32_t failures;
+} CMoTelemetryState;
+
+#if !defined(_WIN32)
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Whether slot has something published, with its state in *state.
+static inline int
+CMoTelemetry_Read(const CMoTelemetry* t, int slot, CMoTelemetryState* state)
+{
+    uint32_t before, live;
+
+    if (slot < 0 || slot >= CMO_TELEMETRY_AXES)
+    {
+	return 0;
+    }
+    do
+    {
+	while ((before = __atomic_load_n(&t->sequence[slot].value,
+		__ATOMIC_ACQUIRE)) & 1)
+	    ;
+	live = __atomic_load_n(&t->live[slot], __ATOMIC_RELAXED);
+	state->position = __atomic_load_n(&t->position[slot], __ATOMIC_RELAXED);
+	state->velocity = __atomic_load_n(&t->velocity[slot], __ATOMIC_RELAXED);
+	state->eventStatus = __atomic_load_n(&t->eventStatus[slot], __ATOMIC_RELAXED);
+	state->activityStatus = __atomic_load_n(&t->activityStatus[slot], __ATOMIC_RELAXED);
+	state->result = __atomic_load_n(&t->result[slot], __ATOMIC_RELAXED);
+	state->stamp = __atomic_load_n(&t->stamp[slot], __ATOMIC_RELAXED);
+	state->polls = __atomic_load_n(&t->polls[slot], __ATOMIC_RELAXED);
+	state->failures = __atomic_load_n(&t->failures[slot], __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+    }
+    while (__atomic_load_n(&t->sequence[slot].value, __ATOMIC_RELAXED) != before);
+    return live != 0;
+}
+
+// The segment named as given to [cmotion::telemetry], or NULL when there
+// is none or it isn't one this header knows.
+static inline const CMoTelemetry*
+CMoTelemetry_Open(const char* name)
+{
+    const CMoTelemetry* t;
+    struct stat st;
+    void* p;
+    int fd;
+
+    if ((fd = shm_open(name, O_RDONLY, 0)) < 0)
+    {
+	return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CMoTelemetry))
+    {
+	close(fd);
+	return NULL;
+    }
+    p = mmap(NULL, sizeof(CMoTelemetry), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+	return NULL;
+    }
+    t = (const CMoTelemetry*)p;
+    if (__atomic_load_n(&t->magic, __ATOMIC_ACQUIRE) != CMO_TELEMETRY_MAGIC ||
+	t->version != CMO_TELEMETRY_VERSION || t->size != sizeof(CMoTelemetry) ||
+	t->axes != CMO_TELEMETRY_AXES)
+    {
+	munmap(p, sizeof(CMoTelemetry));
+	return NULL;
+    }
+    return t;
+}
+
+static inline void
+CMoTelemetry_Close(const CMoTelemetry* t)
+{
+    munmap((void*)t, sizeof(CMoTelemetry));
+}
+
+#endif	// #if !defined(_WIN32)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// #ifndef INC_CMoTelemetry_h__
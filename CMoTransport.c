@@ -1,7 +1,11 @@
 // future home of the transport hook into Tcl's channel system.
 // See the PMDIOTransport typedef in PMDdevice.h
 
+#include <stdlib.h>
 #include "CMoTransport.h"
+#include "CMoCan.h"
+#include "CMoNetwork.h"
+#include "c-motion/PMDW32Ser.h"
 #include "tcl.h"
 
 // notice here that reads follow writes.  The chip never talks on its own out-of-band
@@ -17,12 +21,11 @@ TclTransport_SendCommand(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PM
 PMDresult
 TclTransport_Close(void* transport_data)
 {
-    int result;
     Tcl_Channel chan = *(Tcl_Channel*)transport_data;
 
     if (chan != NULL)
     {
-	result = Tcl_Close(0L, chan);
+	Tcl_Close(0L, chan);
 	chan = NULL;
     }
 
@@ -59,3 +62,254 @@ TclTransport_HardReset(void* transport_data)
     return PMD_ERR_InvalidOperation;
 }
 
+
+// ------------------------------------------------------------------------
+// Pipelined frames
+// ------------------------------------------------------------------------
+
+// Only the point-to-point serial protocol is a plain byte stream we can
+// pipeline.  Multi-drop replies carry an extra address byte.  The reactor
+// only takes such ports.
+static int
+IsPipelinedSerial(PMDAxisHandle* handle)
+{
+    return (handle->transport.SendCommand == PMDSerial_Send ||
+	    handle->transport.SendCommand == CMoReactor_SendCommand) &&
+	((PMDSerialIOData*)handle->transport_data)->protocol == Protocol_PointToPoint;
+}
+
+// Same layout PMDSerial_Send builds: address, checksum, then big endian words.
+int
+CMoTransport_EncodeFrame(PMDAxisHandle* handle, const CMoFrame* frame, PMDuint8* buffer)
+{
+    PMDSerialIOData* SIOtransport_data;
+    int c = 0, i;
+    PMDuint8 sum;
+
+    if (!IsPipelinedSerial(handle) || frame->xCt > CMO_FRAME_WORDS)
+    {
+	return 0;
+    }
+    SIOtransport_data = (PMDSerialIOData*)handle->transport_data;
+
+    buffer[c++] = (PMDuint8)SIOtransport_data->multiDropAddress;
+    buffer[c++] = 0;
+    for (i = 0; i < frame->xCt; i++)
+    {
+	buffer[c++] = (PMDuint8)(frame->xDat[i] >> 8);
+	buffer[c++] = (PMDuint8)(frame->xDat[i] & 0xFF);
+    }
+    for (sum = 0, i = 0; i < c; i++)
+    {
+	sum += buffer[i];
+    }
+    buffer[1] = (PMDuint8)-sum;
+    return c;
+}
+
+// Replies come back in order.  Each is a status byte and a checksum byte,
+// followed by the data words only when the status is zero.
+PMDresult
+CMoTransport_SendEncoded(PMDAxisHandle* handle, const PMDuint8* tx, int txLen, CMoFrame* frames, int count)
+{
+    void* transport_data = handle->transport_data;
+    PMDuint8* rx;
+    PMDuint32 expected = 0, got = 0, bytes;
+    PMDuint32 pos = 0, len, i;
+    PMDresult result, first = PMD_ERR_OK;
+    PMDuint8 sum;
+    PMDresult cause = PMD_ERR_OK;
+    int n, resync = 0;
+
+    if (handle->transport.SendCommand == CMoReactor_SendCommand)
+    {
+	return CMoReactor_SendEncoded(handle, tx, txLen, frames, count);
+    }
+
+    for (n = 0; n < count; n++)
+    {
+	expected += 2 + 2 * frames[n].rCt;
+    }
+    if ((rx = (PMDuint8*)malloc(expected)) == NULL)
+    {
+	return PMD_ERR_CommunicationsError;
+    }
+
+    // Same policy as PMDSerial_Send: only flush when the line is in doubt.
+    if (((PMDSerialIOData*)transport_data)->bFlush)
+    {
+	PMDSerial_FlushRecv(transport_data);
+    }
+    if ((result = PMDSerial_Write(transport_data, tx, txLen)) != PMD_ERR_OK)
+    {
+	free(rx);
+	return result;
+    }
+
+    // Ask for everything.  A short read only happens when one of the
+    // frames came back with an error and no data, or on a real timeout.
+    while (got < expected)
+    {
+	if ((result = PMDSerial_Read(transport_data, rx + got, expected - got, &bytes)) != PMD_ERR_OK)
+	{
+	    break;
+	}
+	if (bytes == 0)
+	{
+	    result = PMD_ERR_CommTimeoutError;
+	    break;
+	}
+	got += bytes;
+    }
+
+    for (n = 0; n < count; n++)
+    {
+	CMoFrame* frame = &frames[n];
+
+	if (pos + 2 > got)
+	{
+	    break;
+	}
+	len = rx[pos] ? 2 : 2 + 2 * frame->rCt;
+	if (pos + len > got)
+	{
+	    break;
+	}
+	for (sum = 0, i = 0; i < len; i++)
+	{
+	    sum += rx[pos + i];
+	}
+	if (sum)
+	{
+	    // Can't trust where the next reply starts.
+	    resync = 1;
+	    cause = PMD_ERR_ChecksumError;
+	    break;
+	}
+
+	frame->result = rx[pos];
+	for (i = 0; i < frame->rCt && !rx[pos]; i++)
+	{
+	    frame->rDat[i] = (PMDuint16)((rx[pos + 2 + 2*i] << 8) | rx[pos + 3 + 2*i]);
+	}
+	if (frame->result == PMD_ERR_HardFault ||
+	    frame->result == PMD_ERR_BadSerialChecksum ||
+	    frame->result == PMD_ERR_InvalidInstruction ||
+	    frame->result == PMD_ERR_InvalidAxis)
+	{
+	    resync = 1;
+	    if (cause == PMD_ERR_OK) cause = frame->result;
+	}
+	if (first == PMD_ERR_OK)
+	{
+	    first = frame->result;
+	}
+	pos += len;
+    }
+
+    // Whatever didn't come back gets the reason it didn't.
+    for (; n < count; n++)
+    {
+	frames[n].result = (resync ? PMD_ERR_ChecksumError :
+	    (result != PMD_ERR_OK ? result : PMD_ERR_CommTimeoutError));
+	if (first == PMD_ERR_OK)
+	{
+	    first = frames[n].result;
+	}
+	resync = 1;
+	if (cause == PMD_ERR_OK) cause = PMD_ERR_CommTimeoutError;
+    }
+
+    free(rx);
+    if (resync)
+    {
+	PMDSerial_Resync(transport_data, cause);
+    }
+    return first;
+}
+
+PMDresult
+CMoTransport_SendFrames(PMDAxisHandle* handle, CMoFrame* frames, int count)
+{
+    PMDuint8* tx;
+    PMDresult result, first = PMD_ERR_OK;
+    int n, c = 0, len;
+
+    if (handle->transport.SendCommand == CMoNetwork_SendCommand)
+    {
+	return CMoNetwork_SendFrames(handle->transport_data, frames, count);
+    }
+    if (handle->transport.SendCommand == CMoCan_SendCommand)
+    {
+	return CMoCan_SendFrames(handle->transport_data, frames, count);
+    }
+    if (IsPipelinedSerial(handle) &&
+	(tx = (PMDuint8*)malloc(count * CMO_FRAME_BYTES)) != NULL)
+    {
+	for (n = 0; n < count; n++)
+	{
+	    if ((len = CMoTransport_EncodeFrame(handle, &frames[n], tx + c)) == 0)
+	    {
+		break;
+	    }
+	    c += len;
+	}
+	if (n == count)
+	{
+	    result = CMoTransport_SendEncoded(handle, tx, c, frames, count);
+	    free(tx);
+	    return result;
+	}
+	free(tx);
+    }
+
+    for (n = 0; n < count; n++)
+    {
+	frames[n].result = handle->transport.SendCommand(handle->transport_data,
+	    frames[n].xCt, frames[n].xDat, frames[n].rCt, frames[n].rDat);
+	if (first == PMD_ERR_OK)
+	{
+	    first = frames[n].result;
+	}
+    }
+    return first;
+}
+
+int
+CMoTransport_IsPipelined(PMDAxisHandle* handle)
+{
+    return handle->transport.SendCommand == CMoNetwork_SendCommand ||
+	handle->transport.SendCommand == CMoCan_SendCommand ||
+	IsPipelinedSerial(handle);
+}
+
+// ------------------------------------------------------------------------
+// Queue waits
+// ------------------------------------------------------------------------
+
+struct Tcl_Obj*
+CMoWaitStats_NewObj(const CMoWaitStats stats[CMO_PRIORITIES])
+{
+    Tcl_Obj *result = Tcl_NewDictObj(), *perClass;
+    const CMoWaitStats* s;
+    int c;
+
+    for (c = 0; c < CMO_PRIORITIES; c++)
+    {
+	s = &stats[c];
+	perClass = Tcl_NewDictObj();
+	Tcl_DictObjPut(NULL, perClass, Tcl_NewStringObj("count", -1),
+	    Tcl_NewWideIntObj(s->count));
+	Tcl_DictObjPut(NULL, perClass, Tcl_NewStringObj("meanUs", -1),
+	    Tcl_NewWideIntObj(s->count ? (Tcl_WideInt)(s->totalUs / s->count) : 0));
+	Tcl_DictObjPut(NULL, perClass, Tcl_NewStringObj("p50Us", -1),
+	    Tcl_NewWideIntObj(CMoWaitStats_Percentile(s, 50)));
+	Tcl_DictObjPut(NULL, perClass, Tcl_NewStringObj("p99Us", -1),
+	    Tcl_NewWideIntObj(CMoWaitStats_Percentile(s, 99)));
+	Tcl_DictObjPut(NULL, perClass, Tcl_NewStringObj("maxUs", -1),
+	    Tcl_NewWideIntObj(s->maxUs));
+	Tcl_DictObjPut(NULL, result, Tcl_NewStringObj(CMoPriority_Names[c], -1),
+	    perClass);
+    }
+    return result;
+}
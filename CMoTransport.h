@@ -1,4 +1,21 @@
+#ifndef INC_CMoTransport_h__
+#define INC_CMoTransport_h__
+
+
 #include "c-motion/PMDtypes.h"
+#include "c-motion/PMDdevice.h"
+#include "CMoPriority.h"
+
+// The reactor, reconnect, wait and CAN threads share state under
+// Tcl_Mutex and Tcl_Condition, which compile to nothing in a Tcl built
+// without threads.  The Makefile and CMoTcl.vcxproj define it.
+#if !defined(TCL_THREADS)
+#error "CMoTcl needs TCL_THREADS defined"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 PMDresult TclTransport_SendCommand(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat);
 PMDresult TclTransport_Close(void* transport_data);
@@ -8,3 +25,51 @@ PMDuint16 TclTransport_HasInterrupt(void* transport_data);
 PMDuint16 TclTransport_HasError(void* transport_data);
 PMDresult TclTransport_HardReset(void* transport_data);
 
+// One command packet and its reply, in the same words that
+// PMDIOTransport.SendCommand is given.  xDat[0] is the axis and opcode.
+#define CMO_FRAME_WORDS 8
+
+typedef struct CMoFrame {
+    PMDuint8 xCt;
+    PMDuint8 rCt;
+    PMDuint16 xDat[CMO_FRAME_WORDS];
+    PMDuint16 rDat[CMO_FRAME_WORDS];
+    PMDresult result;
+} CMoFrame;
+
+// Largest number of bytes CMoTransport_EncodeFrame will write.
+#define CMO_FRAME_BYTES (2 + 2 * CMO_FRAME_WORDS)
+
+// Pipelined I/O.  A byte stream transport gets all the packets in one
+// write and the replies are matched up in order afterwards.  A network
+// transport keeps a window of them in flight (CMoNetwork.h), and a CAN
+// bus sends them alongside those for its other nodes (CMoCan.h).
+// Anything else falls back to one SendCommand per frame.
+int CMoTransport_EncodeFrame(PMDAxisHandle* handle, const CMoFrame* frame, PMDuint8* buffer);
+PMDresult CMoTransport_SendEncoded(PMDAxisHandle* handle, const PMDuint8* tx, int txLen, CMoFrame* frames, int count);
+PMDresult CMoTransport_SendFrames(PMDAxisHandle* handle, CMoFrame* frames, int count);
+
+// Whether SendFrames gets the frames out together rather than one by one.
+int CMoTransport_IsPipelined(PMDAxisHandle* handle);
+
+// An axis attached to the reactor (CMoReactor.hpp) has this for its
+// SendCommand, and its encoded packets go out through the reactor too.
+PMDresult CMoReactor_SendCommand(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat);
+PMDresult CMoReactor_SendEncoded(PMDAxisHandle* handle, const PMDuint8* tx, int txLen, CMoFrame* frames, int count);
+
+// Whether opcode has no effect on the chip (CMoOpcodes.hpp), so that
+// identical commands can share one reply.
+int CMoOpcodes_IsRead(PMDuint8 opcode);
+
+// Whether opcode may reach the chip twice, so that a packet that may or
+// may not have arrived can be sent again.
+int CMoOpcodes_CanRepeat(PMDuint8 opcode);
+
+// The queue waits of each class as a dict of dicts, for the stats commands.
+struct Tcl_Obj* CMoWaitStats_NewObj(const CMoWaitStats stats[CMO_PRIORITIES]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// #ifndef INC_CMoTransport_h__
@@ -0,0 +1,796 @@
+/*
+ * CMoWait.cpp --
+ *
+ *	Waiting for event status bits off the interpreter thread.  See
+ *	CMoWait.hpp.
+ */
+
+#include "c-motion/c-motion.h"
+#include "CMoWait.hpp"
+#include "CMoCan.h"
+#include "CMoDeviceApi.h"
+#include "CMoOpcodes.hpp"
+#include "CMoReactor.hpp"
+#include "CMoRetry.hpp"
+#include "CMoReconnect.hpp"
+#include "CMoReplyStamp.h"
+#include "CMoSnapshot.hpp"
+#include "c-motion/PMDdiag.h"
+#include "c-motion/PMDW32Ser.h"
+#include <string.h>
+#include <list>
+
+typedef PMDresult (*SendProc)(void*, PMDuint8, PMDuint16*, PMDuint8, PMDuint16*);
+
+struct Wait
+{
+    PMDAxisHandle* handle;	// 0L for a wait on a device's events
+    void* device;		// the DLL's device handle, or 0L
+    PMDAxis axis;
+    int slot;			// published into, -1 for a wait on events
+    PMDuint16 mask;
+    PMDuint32 intervalMs;
+    bool forever;
+    Tcl_Time deadline;
+    Tcl_Time next;		// when to poll again
+
+    // The port as it was when the wait began, for the worker thread.
+    bool threaded;
+    SendProc send;
+    void* transportData;
+    CMoLoad::Booking booking;
+
+    Tcl_Interp* interp;
+    Tcl_ThreadId thread;
+    Tcl_Obj* command;
+    Tcl_TimerToken timer;	// polling from the interp's own thread
+
+    bool finished;
+    bool cancelled;		// the device is closing, set under the mutex
+    bool blocking;		// the caller sleeps on changed, not a callback
+    CMoWait::Outcome outcome;
+    PMDuint16 status;
+    PMDresult result;
+};
+
+struct WaitEvent
+{
+    Tcl_Event header;
+    Wait* wait;
+};
+
+// Every wait from Start until its callback has run.  Only the thread that
+// started a wait takes it out again; the worker reads the list and fills
+// in the outcome.
+static std::list<Wait*> waits;
+static Tcl_Mutex mutex;
+static Tcl_Condition changed;
+static Wait* polling;		// the worker has a packet out for this one
+static bool workerStarted;
+static std::list<void*> listening;	// devices with a thread on their events
+
+// The longest a device's thread waits for an event before it looks at its
+// deadlines and at Cancel again.
+#define DEVICE_SLICE_MS 100
+
+static void
+Later(Tcl_Time* time, PMDuint32 ms)
+{
+    time->sec += ms / 1000;
+    time->usec += (ms % 1000) * 1000;
+    if (time->usec >= 1000000)
+    {
+	time->sec++;
+	time->usec -= 1000000;
+    }
+}
+
+static inline bool
+Before(const Tcl_Time& a, const Tcl_Time& b)
+{
+    return a.sec < b.sec || (a.sec == b.sec && a.usec < b.usec);
+}
+
+// Whether there is no point waiting any longer, and why.  The port being
+// gone is worth waiting through as a transient error is: the reactor lets
+// go of it for a while when the rate changes, and CMoReconnect.hpp may be
+// bringing it back.
+static bool
+Decide(Wait* wait, PMDresult result, PMDuint16 status)
+{
+    Tcl_Time now;
+
+    wait->result = result;
+    if (result == PMD_NOERROR)
+    {
+	wait->status = status;
+	if (status & wait->mask)
+	{
+	    wait->outcome = CMoWait::Happened;
+	    return true;
+	}
+    }
+    else if (!CMoRetry::Transient(result) && !CMoReconnect::Lost(result))
+    {
+	wait->outcome = CMoWait::Failed;
+	return true;
+    }
+
+    Tcl_GetTime(&now);
+    if (!wait->forever && !Before(now, wait->deadline))
+    {
+	wait->outcome = CMoWait::TimedOut;
+	return true;
+    }
+    wait->next = now;
+    Later(&wait->next, wait->intervalMs);
+    if (!wait->forever && Before(wait->deadline, wait->next))
+    {
+	wait->next = wait->deadline;
+    }
+    return false;
+}
+
+// One poll of a published axis, all of it in one batch.
+static void
+Sample(Wait* wait)
+{
+    PMDAxisHandle port;
+    CMoFrame frames[CMO_SNAPSHOT_PACKETS];
+    CMoSnapshot::State state;
+    PMDuint8 op;
+    int n;
+
+    memset(&port, 0, sizeof(port));
+    port.axis = wait->axis;
+    port.transport.SendCommand = wait->send;
+    port.transport_data = wait->transportData;
+    memset(frames, 0, sizeof(frames));
+    for (n = 0; n < CMO_SNAPSHOT_PACKETS; n++)
+    {
+	op = CMoSnapshot::Opcodes[n];
+	frames[n].xCt = 1;
+	frames[n].xDat[0] = (PMDuint16)((wait->axis << 8) | op);
+	frames[n].rCt = CMoOpcodes[op].rWords;
+    }
+    CMoTransport_SendFrames(&port, frames, CMO_SNAPSHOT_PACKETS);
+    for (n = 0; n < CMO_SNAPSHOT_PACKETS; n++)
+    {
+	if (frames[n].result != PMD_NOERROR)
+	{
+	    CMoSnapshot::Fail(wait->slot, frames[n].result);
+	    return;
+	}
+    }
+    state.position = (PMDint32)((PMDuint32)frames[0].rDat[0] << 16 | frames[0].rDat[1]);
+    state.velocity = (PMDint32)((PMDuint32)frames[1].rDat[0] << 16 | frames[1].rDat[1]);
+    state.eventStatus = frames[2].rDat[0];
+    state.activityStatus = frames[3].rDat[0];
+    state.result = PMD_NOERROR;
+    state.stamp = CMoReplyStamp_Now();
+    CMoSnapshot::Publish(wait->slot, state);
+}
+
+static void
+Finish(Wait* wait)
+{
+    Tcl_Interp* interp = wait->interp;
+    Tcl_InterpState state;
+    Tcl_Obj* script;
+
+    // Publishing has no one to tell.
+    if (wait->command == 0L)
+    {
+	delete wait;
+	return;
+    }
+    if (!Tcl_InterpDeleted(interp))
+    {
+	state = Tcl_SaveInterpState(interp, TCL_OK);
+	script = Tcl_DuplicateObj(wait->command);
+	Tcl_IncrRefCount(script);
+	switch (wait->outcome)
+	{
+	case CMoWait::Happened:
+	case CMoWait::TimedOut:
+	    Tcl_ListObjAppendElement(0L, script, Tcl_NewStringObj(
+		wait->outcome == CMoWait::Happened ? "ok" : "timeout", -1));
+	    Tcl_ListObjAppendElement(0L, script, Tcl_NewLongObj(wait->status));
+	    break;
+
+	case CMoWait::Failed:
+	    Tcl_ListObjAppendElement(0L, script, Tcl_NewStringObj("error", -1));
+	    Tcl_ListObjAppendElement(0L, script,
+		Tcl_NewStringObj(::PMDGetErrorMessage(wait->result), -1));
+	    break;
+
+	case CMoWait::Cancelled:
+	    Tcl_ListObjAppendElement(0L, script, Tcl_NewStringObj("error", -1));
+	    Tcl_ListObjAppendElement(0L, script,
+		Tcl_NewStringObj("wait cancelled", -1));
+	    break;
+	}
+	if (Tcl_EvalObjEx(interp, script, TCL_EVAL_GLOBAL) == TCL_ERROR)
+	{
+	    Tcl_BackgroundError(interp);
+	}
+	Tcl_DecrRefCount(script);
+	Tcl_RestoreInterpState(interp, state);
+    }
+    Tcl_DecrRefCount(wait->command);
+    Tcl_Release(interp);
+    delete wait;
+}
+
+static int
+EventProc(Tcl_Event* evPtr, int flags)
+{
+    Wait* wait = ((WaitEvent*)evPtr)->wait;
+
+    if (!(flags & TCL_FILE_EVENTS))
+    {
+	return 0;
+    }
+    Tcl_MutexLock(&mutex);
+    waits.remove(wait);
+    Tcl_MutexUnlock(&mutex);
+    Finish(wait);
+    return 1;
+}
+
+// Hand a finished wait back to the thread that started it.
+static void
+Queue(Wait* wait)
+{
+    WaitEvent* event = (WaitEvent*)ckalloc(sizeof(WaitEvent));
+
+    event->header.proc = EventProc;
+    event->wait = wait;
+    Tcl_ThreadQueueEvent(wait->thread, &event->header, TCL_QUEUE_TAIL);
+    Tcl_ThreadAlert(wait->thread);
+}
+
+// Polls every threaded wait when it is due and sleeps until the next one
+// is, or until Start adds one.
+static Tcl_ThreadCreateType
+Worker(ClientData clientData)
+{
+    std::list<Wait*>::iterator it;
+    Wait* due;
+    Tcl_Time now, sleep;
+    PMDuint16 xDat[1], rDat[1];
+    PMDresult result;
+
+    // Polling gives way to whatever else is going to the same port.
+    CMoPriority_Set(CMoBackground);
+
+    Tcl_MutexLock(&mutex);
+    for (;;)
+    {
+	due = 0L;
+	for (it = waits.begin(); it != waits.end(); ++it)
+	{
+	    if ((*it)->threaded && !(*it)->finished &&
+		(due == 0L || Before((*it)->next, due->next)))
+	    {
+		due = *it;
+	    }
+	}
+	if (due == 0L)
+	{
+	    Tcl_ConditionWait(&changed, &mutex, 0L);
+	    continue;
+	}
+	Tcl_GetTime(&now);
+	if (Before(now, due->next))
+	{
+	    sleep.sec = due->next.sec - now.sec;
+	    sleep.usec = due->next.usec - now.usec;
+	    if (sleep.usec < 0)
+	    {
+		sleep.sec--;
+		sleep.usec += 1000000;
+	    }
+	    Tcl_ConditionWait(&changed, &mutex, &sleep);
+	    continue;
+	}
+
+	polling = due;
+	if (due->slot >= 0)
+	{
+	    Tcl_MutexUnlock(&mutex);
+	    Sample(due);
+	    Tcl_MutexLock(&mutex);
+	    polling = 0L;
+	    Tcl_ConditionNotify(&changed);
+	    Tcl_GetTime(&due->next);
+	    Later(&due->next, due->intervalMs);
+	    continue;
+	}
+	xDat[0] = (PMDuint16)((due->axis << 8) | CMoOp::GetEventStatus);
+	Tcl_MutexUnlock(&mutex);
+	result = due->send(due->transportData, 1, xDat, 1, rDat);
+	Tcl_MutexLock(&mutex);
+	polling = 0L;
+	Tcl_ConditionNotify(&changed);
+
+	// Cancel may have finished it meanwhile.
+	if (!due->finished && Decide(due, result, rDat[0]))
+	{
+	    due->finished = true;
+	    CMoLoad::Release(&due->booking);
+	    Queue(due);
+	}
+    }
+    TCL_THREAD_CREATE_RETURN;
+}
+
+static void
+TimerProc(ClientData clientData)
+{
+    Wait* wait = (Wait*)clientData;
+    Tcl_Time now;
+    PMDuint16 status = 0;
+    PMDresult result;
+    long ms;
+
+    wait->timer = 0L;
+    if (wait->slot >= 0)
+    {
+	Sample(wait);
+	wait->timer = Tcl_CreateTimerHandler(wait->intervalMs, TimerProc, wait);
+	return;
+    }
+    result = ::PMDGetEventStatus(wait->handle, &status);
+    if (Decide(wait, result, status))
+    {
+	Tcl_MutexLock(&mutex);
+	wait->finished = true;
+	waits.remove(wait);
+	Tcl_MutexUnlock(&mutex);
+	CMoLoad::Release(&wait->booking);
+	Finish(wait);
+	return;
+    }
+    Tcl_GetTime(&now);
+    ms = (wait->next.sec - now.sec) * 1000 + (wait->next.usec - now.usec) / 1000;
+    wait->timer = Tcl_CreateTimerHandler(ms > 0 ? (int)ms : 0, TimerProc, wait);
+}
+
+// Hand a wait to the worker, or to a timer on this thread when the port
+// can't be shared.
+static void
+Add(Wait* wait, PMDAxisHandle* handle)
+{
+    wait->handle = handle;
+    wait->axis = handle->axis;
+    wait->thread = Tcl_GetCurrentThread();
+    wait->finished = false;
+    wait->timer = 0L;
+
+    // A serial port can only be shared with the worker through the reactor.
+    if (handle->transport.SendCommand == PMDSerial_Send)
+    {
+	CMoReactor::Attach(handle);
+    }
+    wait->send = handle->transport.SendCommand;
+    wait->transportData = handle->transport_data;
+
+    Tcl_MutexLock(&mutex);
+    if (!workerStarted)
+    {
+	Tcl_ThreadId thread;
+
+	workerStarted = Tcl_CreateThread(&thread, Worker, 0L,
+	    TCL_THREAD_STACK_DEFAULT, TCL_THREAD_NOFLAGS) == TCL_OK;
+    }
+    wait->threaded = workerStarted &&
+	(wait->send == CMoReactor_SendCommand || wait->send == CMoCan_SendCommand);
+    waits.push_back(wait);
+    if (wait->threaded)
+    {
+	Tcl_ConditionNotify(&changed);
+    }
+    Tcl_MutexUnlock(&mutex);
+
+    if (!wait->threaded)
+    {
+	wait->timer = Tcl_CreateTimerHandler(0, TimerProc, wait);
+    }
+}
+
+void
+CMoWait::Start(Tcl_Interp* interp, PMDAxisHandle* handle, PMDuint16 mask,
+	PMDuint32 timeoutMs, PMDuint32 intervalMs,
+	const CMoLoad::Booking& booking, Tcl_Obj* command)
+{
+    Wait* wait = new Wait();
+
+    wait->slot = -1;
+    wait->mask = mask;
+    wait->intervalMs = intervalMs;
+    wait->forever = timeoutMs == 0;
+    Tcl_GetTime(&wait->deadline);
+    wait->next = wait->deadline;
+    Later(&wait->deadline, timeoutMs);
+    wait->interp = interp;
+    wait->command = command;
+    wait->status = 0;
+    wait->result = PMD_NOERROR;
+    wait->booking = booking;
+    Tcl_Preserve(interp);
+    Tcl_IncrRefCount(command);
+    Add(wait, handle);
+}
+
+int
+CMoWait::Publish(PMDAxisHandle* handle, PMDuint32 intervalMs,
+	const CMoLoad::Booking& booking)
+{
+    Wait* wait;
+    int slot;
+
+    Unpublish(handle);
+    if ((slot = CMoSnapshot::Acquire()) < 0)
+    {
+	return -1;
+    }
+    wait = new Wait();
+    wait->slot = slot;
+    wait->mask = 0;
+    wait->intervalMs = intervalMs;
+    wait->forever = true;
+    Tcl_GetTime(&wait->next);
+    wait->interp = 0L;
+    wait->command = 0L;
+    wait->status = 0;
+    wait->result = PMD_NOERROR;
+    wait->booking = booking;
+    Add(wait, handle);
+    return slot;
+}
+
+int
+CMoWait::Published(PMDAxisHandle* handle, PMDuint32* intervalMs)
+{
+    std::list<Wait*>::iterator it;
+    int slot = -1;
+
+    Tcl_MutexLock(&mutex);
+    for (it = waits.begin(); it != waits.end(); ++it)
+    {
+	if ((*it)->handle == handle && (*it)->slot >= 0 && !(*it)->finished)
+	{
+	    slot = (*it)->slot;
+	    *intervalMs = (*it)->intervalMs;
+	    break;
+	}
+    }
+    Tcl_MutexUnlock(&mutex);
+    return slot;
+}
+
+CMoWait::Outcome
+CMoWait::Block(PMDAxisHandle* handle, PMDuint16 mask, PMDuint32 timeoutMs,
+	PMDuint32 intervalMs, const CMoLoad::Booking& booking,
+	PMDuint16* status, PMDresult* error)
+{
+    Wait wait;
+    Tcl_Time now;
+    PMDuint16 got = 0;
+    long ms;
+
+    wait.mask = mask;
+    wait.intervalMs = intervalMs;
+    wait.forever = timeoutMs == 0;
+    Tcl_GetTime(&wait.deadline);
+    Later(&wait.deadline, timeoutMs);
+    wait.status = 0;
+    wait.booking = booking;
+
+    while (!Decide(&wait, ::PMDGetEventStatus(handle, &got), got))
+    {
+	Tcl_GetTime(&now);
+	ms = (wait.next.sec - now.sec) * 1000 + (wait.next.usec - now.usec) / 1000;
+	if (ms > 0)
+	{
+	    Tcl_Sleep((int)ms);
+	}
+    }
+    CMoLoad::Release(&wait.booking);
+    *status = wait.status;
+    *error = wait.result;
+    return wait.outcome;
+}
+
+// ------------------------------------------------------------------------
+// Waits on a device's own events.
+// ------------------------------------------------------------------------
+
+// Done with under the mutex, by the device's thread.
+static void
+Done(Wait* wait, CMoWait::Outcome outcome)
+{
+    wait->finished = true;
+    wait->outcome = outcome;
+    if (wait->blocking)
+    {
+	Tcl_ConditionNotify(&changed);
+    }
+    else
+    {
+	Queue(wait);
+    }
+}
+
+// Takes each event the device raises to the waits on it, until there are
+// none left.  One of these for each device with a wait, so no wait takes
+// an event another one is waiting for.
+static Tcl_ThreadCreateType
+Listener(ClientData clientData)
+{
+    void* device = clientData;
+    std::list<Wait*>::iterator it;
+    Wait* wait;
+    Tcl_Time now;
+    PMDEvent event;
+    PMDresult result;
+    PMDuint32 slice;
+    long ms;
+
+    Tcl_MutexLock(&mutex);
+    for (;;)
+    {
+	Tcl_GetTime(&now);
+	slice = 0;
+	for (it = waits.begin(); it != waits.end(); ++it)
+	{
+	    wait = *it;
+	    if (wait->device != device || wait->finished)
+	    {
+		continue;
+	    }
+	    if (wait->cancelled)
+	    {
+		Done(wait, CMoWait::Cancelled);
+		continue;
+	    }
+	    ms = DEVICE_SLICE_MS;
+	    if (!wait->forever)
+	    {
+		ms = (wait->deadline.sec - now.sec) * 1000 +
+		    (wait->deadline.usec - now.usec) / 1000;
+		if (ms <= 0)
+		{
+		    Done(wait, CMoWait::TimedOut);
+		    continue;
+		}
+	    }
+	    if (slice == 0 || (PMDuint32)ms < slice)
+	    {
+		slice = ms < DEVICE_SLICE_MS ? (PMDuint32)ms : DEVICE_SLICE_MS;
+	    }
+	}
+	if (slice == 0)
+	{
+	    break;
+	}
+	Tcl_MutexUnlock(&mutex);
+	memset(&event, 0, sizeof(event));
+	result = PMDWaitForEvent(device, &event, slice);
+	Tcl_MutexLock(&mutex);
+
+	if (result == PMD_ERR_Timeout || result == PMD_ERR_CommTimeoutError)
+	{
+	    continue;
+	}
+	for (it = waits.begin(); it != waits.end(); ++it)
+	{
+	    wait = *it;
+	    if (wait->device != device || wait->finished)
+	    {
+		continue;
+	    }
+	    wait->result = result;
+	    if (result != PMD_NOERROR)
+	    {
+		Done(wait, CMoWait::Failed);
+	    }
+	    else if (event.axis == wait->axis && (event.eventmask & wait->mask))
+	    {
+		wait->status = event.eventmask;
+		Done(wait, CMoWait::Happened);
+	    }
+	}
+    }
+    listening.remove(device);
+    Tcl_ConditionNotify(&changed);
+    Tcl_MutexUnlock(&mutex);
+    TCL_THREAD_CREATE_RETURN;
+}
+
+static Wait*
+NewDeviceWait(void* device, PMDAxis axis, PMDuint16 mask, PMDuint32 timeoutMs)
+{
+    Wait* wait = new Wait();
+
+    wait->handle = 0L;
+    wait->device = device;
+    wait->axis = axis;
+    wait->slot = -1;
+    wait->mask = mask;
+    wait->forever = timeoutMs == 0;
+    Tcl_GetTime(&wait->deadline);
+    Later(&wait->deadline, timeoutMs);
+    wait->threaded = false;
+    wait->thread = Tcl_GetCurrentThread();
+    wait->timer = 0L;
+    wait->finished = false;
+    wait->cancelled = false;
+    wait->status = 0;
+    wait->result = PMD_NOERROR;
+    return wait;
+}
+
+// Put a wait on the device's list, with a thread to listen if there isn't
+// one yet.  Called with the mutex held.
+static bool
+Listen(Wait* wait)
+{
+    std::list<void*>::iterator it;
+    Tcl_ThreadId thread;
+
+    for (it = listening.begin(); it != listening.end(); ++it)
+    {
+	if (*it == wait->device)
+	{
+	    waits.push_back(wait);
+	    return true;
+	}
+    }
+    if (Tcl_CreateThread(&thread, Listener, wait->device,
+	    TCL_THREAD_STACK_DEFAULT, TCL_THREAD_NOFLAGS) != TCL_OK)
+    {
+	return false;
+    }
+    listening.push_back(wait->device);
+    waits.push_back(wait);
+    return true;
+}
+
+void
+CMoWait::StartDevice(Tcl_Interp* interp, void* device, PMDAxis axis,
+	PMDuint16 mask, PMDuint32 timeoutMs, Tcl_Obj* command)
+{
+    Wait* wait = NewDeviceWait(device, axis, mask, timeoutMs);
+
+    wait->blocking = false;
+    wait->interp = interp;
+    wait->command = command;
+    Tcl_Preserve(interp);
+    Tcl_IncrRefCount(command);
+    Tcl_MutexLock(&mutex);
+    if (!Listen(wait))
+    {
+	wait->finished = true;
+	wait->outcome = Failed;
+	wait->result = PMD_ERR_InvalidOperation;
+	waits.push_back(wait);
+	Queue(wait);
+    }
+    Tcl_MutexUnlock(&mutex);
+}
+
+CMoWait::Outcome
+CMoWait::BlockDevice(void* device, PMDAxis axis, PMDuint16 mask,
+	PMDuint32 timeoutMs, PMDuint16* status, PMDresult* error)
+{
+    Wait* wait = NewDeviceWait(device, axis, mask, timeoutMs);
+    Outcome outcome;
+
+    wait->blocking = true;
+    wait->interp = 0L;
+    wait->command = 0L;
+    Tcl_MutexLock(&mutex);
+    if (!Listen(wait))
+    {
+	Tcl_MutexUnlock(&mutex);
+	delete wait;
+	*status = 0;
+	*error = PMD_ERR_InvalidOperation;
+	return Failed;
+    }
+    while (!wait->finished)
+    {
+	Tcl_ConditionWait(&changed, &mutex, 0L);
+    }
+    waits.remove(wait);
+    Tcl_MutexUnlock(&mutex);
+    outcome = wait->outcome;
+    *status = wait->status;
+    *error = wait->result;
+    delete wait;
+    return outcome;
+}
+
+void
+CMoWait::CancelDevice(void* device)
+{
+    std::list<Wait*>::iterator it;
+    std::list<void*>::iterator d;
+    bool busy = true;
+
+    Tcl_MutexLock(&mutex);
+    for (it = waits.begin(); it != waits.end(); ++it)
+    {
+	if ((*it)->device == device)
+	{
+	    (*it)->cancelled = true;
+	}
+    }
+    while (busy)
+    {
+	busy = false;
+	for (d = listening.begin(); d != listening.end(); ++d)
+	{
+	    busy = busy || *d == device;
+	}
+	if (busy)
+	{
+	    Tcl_ConditionWait(&changed, &mutex, 0L);
+	}
+    }
+    Tcl_MutexUnlock(&mutex);
+}
+
+// ------------------------------------------------------------------------
+
+// Take the axis' waits, or just its publishing, from the worker and the
+// timers.  The slot is empty by the time this returns.
+static void
+Stop(PMDAxisHandle* handle, bool publishing)
+{
+    std::list<Wait*>::iterator it;
+    Wait* wait;
+
+    Tcl_MutexLock(&mutex);
+    for (it = waits.begin(); it != waits.end(); ++it)
+    {
+	wait = *it;
+	if (wait->handle != handle || wait->finished ||
+	    (publishing && wait->slot < 0))
+	{
+	    continue;
+	}
+	while (polling == wait)
+	{
+	    Tcl_ConditionWait(&changed, &mutex, 0L);
+	}
+	wait->finished = true;
+	wait->outcome = CMoWait::Cancelled;
+	CMoLoad::Release(&wait->booking);
+	if (wait->slot >= 0)
+	{
+	    CMoSnapshot::Release(wait->slot);
+	}
+	if (wait->timer != 0L)
+	{
+	    Tcl_DeleteTimerHandler(wait->timer);
+	    wait->timer = 0L;
+	}
+	Queue(wait);
+    }
+    Tcl_MutexUnlock(&mutex);
+}
+
+void
+CMoWait::Unpublish(PMDAxisHandle* handle)
+{
+    Stop(handle, true);
+}
+
+void
+CMoWait::Cancel(PMDAxisHandle* handle)
+{
+    Stop(handle, false);
+}
@@ -0,0 +1,86 @@
+/*
+ * CMoWait.hpp --
+ *
+ *	Waiting for event status bits, behind [WaitForEvent].
+ *
+ * A script that waits for a motion to finish would otherwise loop on
+ * GetEventStatus with [after] in between, waking the interpreter every
+ * few ms and noticing the event up to a whole period late.  Here one
+ * worker thread does the polling for every wait in the process, each at
+ * its own -interval, sleeping on a condition in between.  When the status
+ * has one of the bits asked for, or the -timeout runs out, a Tcl event
+ * takes the answer back to the thread that asked and the -command script
+ * runs there.  Without -command the caller sleeps until then.
+ *
+ * The worker can only share a port that can take packets from two threads
+ * at once: a serial port attached to the reactor (CMoReactor.hpp; a wait
+ * attaches it as [cmotion::post] does) or a CAN bus.  Any other port is
+ * polled from a Tcl timer on the thread that owns it instead, which still
+ * leaves the interpreter free in between.
+ *
+ * The same worker keeps the snapshot table (CMoSnapshot.hpp) up to date
+ * for the axes that publish their state there.
+ *
+ * Polling is the fallback.  A device opened through C-Motion.dll
+ * (CMoDevice.hpp) raises its axes' events itself, and [$device
+ * WaitForEvent axis mask] waits for them with the DLL's PMDWaitForEvent
+ * and sends nothing in the meantime.  One thread for each such device
+ * takes every event it raises and hands it to all the waits on it.
+ */
+#ifndef INC_CMoWait_hpp__
+#define INC_CMoWait_hpp__
+
+#include "tcl.h"
+#include "CMoTransport.h"
+#include "CMoLoad.hpp"
+
+class CMoWait
+{
+public:
+    enum Outcome {Happened, TimedOut, Failed, Cancelled};
+
+    // Wait for any of the bits in mask, calling command back with
+    // "ok status", "timeout status" or "error message" appended.  The
+    // polls' booking on the wire (CMoLoad.hpp) is let go once the wait
+    // is over.
+    static void Start(Tcl_Interp* interp, PMDAxisHandle* handle,
+	    PMDuint16 mask, PMDuint32 timeoutMs, PMDuint32 intervalMs,
+	    const CMoLoad::Booking& booking, Tcl_Obj* command);
+
+    // The same, waiting here.  status is the last event status read, or
+    // the error when the outcome is Failed.
+    static Outcome Block(PMDAxisHandle* handle, PMDuint16 mask,
+	    PMDuint32 timeoutMs, PMDuint32 intervalMs,
+	    const CMoLoad::Booking& booking, PMDuint16* status,
+	    PMDresult* error);
+
+    // Poll the axis into a slot of its own in the snapshot table
+    // (CMoSnapshot.hpp) every intervalMs, until Unpublish or Cancel.
+    // Returns the slot, or -1 when none is free.  An axis has one at most;
+    // publishing it again moves it to a new one.
+    static int Publish(PMDAxisHandle* handle, PMDuint32 intervalMs,
+	    const CMoLoad::Booking& booking);
+    static void Unpublish(PMDAxisHandle* handle);
+
+    // The slot the axis is published in, and how often, or -1.
+    static int Published(PMDAxisHandle* handle, PMDuint32* intervalMs);
+
+    // The axis is going away or changing ports: its waits call back with
+    // an error and its publishing stops.  Returns once nothing is polling
+    // it any more.
+    static void Cancel(PMDAxisHandle* handle);
+
+    // Wait for an event with any of the bits in mask from an axis of a
+    // device, through the DLL's device handle, in the background or here.
+    // The status is the bits of the event that ended the wait.
+    static void StartDevice(Tcl_Interp* interp, void* device, PMDAxis axis,
+	    PMDuint16 mask, PMDuint32 timeoutMs, Tcl_Obj* command);
+    static Outcome BlockDevice(void* device, PMDAxis axis, PMDuint16 mask,
+	    PMDuint32 timeoutMs, PMDuint16* status, PMDresult* error);
+
+    // The device is closing: its waits call back with an error.  Returns
+    // once nothing is waiting in the DLL on it any more.
+    static void CancelDevice(void* device);
+};
+
+#endif	// #ifndef INC_CMoWait_hpp__
@@ -0,0 +1,422 @@
+/*
+ * CMoCanBench.cpp --
+ *
+ *	Commands per second, bus utilisation and host CPU per command over
+ *	the SocketCAN transport against the number of nodes on the bus.
+ *
+ * An emulated bus of drives answers each command with the status and the
+ * reply words CMoOpcodes.hpp gives it.  Every frame holds the wire for
+ * its length in bits at the chosen bit rate, commands and replies alike,
+ * and each node takes the service time to work a command out, one at a
+ * time.  With vcan0 up (ip link add vcan0 type vcan; ip link set vcan0 up)
+ * it runs over the real SocketCAN stack; without it the transport is
+ * attached to one end of a SOCK_SEQPACKET socketpair instead, which
+ * carries the same struct can_frame but has no kernel filters.
+ *
+ * For 1, 2, 4, ... nodes it times GetPosition from one thread per node,
+ * each calling on its own, then the same commands as one CMoCan_SendJobs
+ * call, and checks every reply.
+ *
+ *	make bench TCL_PREFIX=/usr/local
+ *	bench/CMoCanBench ?kbitPerSec? ?serviceUs? ?frames? ?interface?
+ */
+
+#include "CMoCan.h"
+#include "CMoOpcodes.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <queue>
+#include <vector>
+
+static double
+Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double
+CpuTime(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ------------------------------------------------------------------------
+// The emulated bus.
+// ------------------------------------------------------------------------
+
+struct Reply
+{
+    double due;
+    unsigned long order;	// replies due together go in arrival order
+    bool onWire;		// due is when it's sent, not when it's worked out
+    struct can_frame frame;
+    bool operator<(const Reply& other) const
+    {
+	return due != other.due ? due > other.due : order > other.order;
+    }
+};
+
+struct Emulator
+{
+    int socket;
+    double bitTime, service;
+    double wireFree;		// when the bus is next idle
+    double wireBusy;		// seconds the bus has carried frames
+    double nodeFree[CMO_CAN_NODES];
+    std::priority_queue<Reply> replies;
+    unsigned long arrivals;
+    clockid_t cpu;
+    volatile bool ready, stop;
+};
+
+// Time on the wire: a standard frame is 47 bits and the data, and bit
+// stuffing adds about a fifth.
+static double
+FrameTime(Emulator* emu, int dlc)
+{
+    return (47 + 8 * dlc) * 1.2 * emu->bitTime;
+}
+
+static double
+Wire(Emulator* emu, double from, int dlc)
+{
+    double length = FrameTime(emu, dlc);
+
+    if (emu->wireFree < from) emu->wireFree = from;
+    emu->wireFree += length;
+    emu->wireBusy += length;
+    return emu->wireFree;
+}
+
+static void
+Command(Emulator* emu, const struct can_frame* in, double now)
+{
+    int node = (in->can_id & CAN_SFF_MASK) - CMO_CAN_COMMAND_ID;
+    const CMoOpcode& d = CMoOpcodes[in->data[1]];
+    Reply reply;
+    double start;
+    int i;
+
+    if (node < 0 || node >= CMO_CAN_NODES || in->can_dlc < 2) return;
+
+    // Heard once it has crossed the wire, worked out in turn, then sent.
+    start = Wire(emu, now, in->can_dlc);
+    if (emu->nodeFree[node] > start) start = emu->nodeFree[node];
+    emu->nodeFree[node] = start + emu->service;
+
+    memset(&reply.frame, 0, sizeof(reply.frame));
+    reply.frame.can_id = CMO_CAN_REPLY_ID + node;
+    reply.frame.data[0] = d.name == 0L || in->can_dlc != 2 + 2 * d.xWords ? 2 : 0;
+    reply.frame.can_dlc = 2;
+    for (i = 0; reply.frame.data[0] == 0 && i < d.rWords; i++)
+    {
+	reply.frame.data[2 + 2*i] = 0x12;
+	reply.frame.data[3 + 2*i] = static_cast<PMDuint8>(0x34 + i);
+	reply.frame.can_dlc += 2;
+    }
+    reply.due = emu->nodeFree[node];
+    reply.onWire = false;
+    reply.order = emu->arrivals++;
+    emu->replies.push(reply);
+}
+
+static void*
+EmulatorThread(void* clientData)
+{
+    Emulator* emu = static_cast<Emulator*>(clientData);
+    struct can_frame in[64];
+    struct mmsghdr msgs[64];
+    struct iovec iov[64];
+    struct pollfd pfd;
+    struct timespec wait;
+    double now, left;
+    int got, i;
+
+    pthread_getcpuclockid(pthread_self(), &emu->cpu);
+    emu->ready = true;
+    while (!emu->stop)
+    {
+	// Rounded up: waking early would only mean another trip round.
+	left = emu->replies.empty() ? 0.05 : emu->replies.top().due - Now();
+	if (left < 0) left = 0;
+	wait.tv_sec = static_cast<time_t>(left);
+	wait.tv_nsec = static_cast<long>((left - wait.tv_sec) * 1e9) + 1;
+	pfd.fd = emu->socket;
+	pfd.events = POLLIN;
+	if (ppoll(&pfd, 1, &wait, 0L) > 0)
+	{
+	    memset(msgs, 0, sizeof(msgs));
+	    for (i = 0; i < 64; i++)
+	    {
+		iov[i].iov_base = &in[i];
+		iov[i].iov_len = sizeof(in[i]);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	    }
+	    got = recvmmsg(emu->socket, msgs, 64, MSG_DONTWAIT, 0L);
+	    now = Now();
+	    for (i = 0; i < got; i++)
+	    {
+		Command(emu, &in[i], now);
+	    }
+	}
+	now = Now();
+	while (!emu->replies.empty() && emu->replies.top().due <= now)
+	{
+	    Reply reply = emu->replies.top();
+
+	    emu->replies.pop();
+	    if (!reply.onWire)
+	    {
+		// The node has its answer; now it waits for the wire.
+		reply.due = Wire(emu, reply.due, reply.frame.can_dlc);
+		reply.onWire = true;
+		emu->replies.push(reply);
+	    }
+	    else if (send(emu->socket, &reply.frame, sizeof(reply.frame), 0) < 0) {}
+	}
+    }
+    return 0L;
+}
+
+// The emulator's end of the bus: vcan0 if it's there, otherwise one end
+// of a socketpair whose other end goes to the transport in *host.
+static bool
+OpenBus(Emulator* emu, const char* interface, int* host)
+{
+    struct sockaddr_can address;
+    struct can_filter filter;
+    struct ifreq ifr;
+    int pair[2];
+
+    *host = -1;
+    emu->socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (emu->socket >= 0 && strlen(interface) < IFNAMSIZ)
+    {
+	memset(&ifr, 0, sizeof(ifr));
+	strcpy(ifr.ifr_name, interface);
+	memset(&address, 0, sizeof(address));
+	address.can_family = AF_CAN;
+	if (ioctl(emu->socket, SIOCGIFINDEX, &ifr) == 0)
+	{
+	    address.can_ifindex = ifr.ifr_ifindex;
+	    filter.can_id = CMO_CAN_COMMAND_ID;
+	    filter.can_mask = CAN_SFF_MASK & ~(CMO_CAN_NODES - 1);
+	    setsockopt(emu->socket, SOL_CAN_RAW, CAN_RAW_FILTER,
+		&filter, sizeof(filter));
+	    if (bind(emu->socket, (struct sockaddr*)&address, sizeof(address)) == 0)
+	    {
+		return true;
+	    }
+	}
+    }
+    if (emu->socket >= 0) close(emu->socket);
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair) != 0)
+    {
+	return false;
+    }
+    emu->socket = pair[0];
+    *host = pair[1];
+    return false;
+}
+
+// ------------------------------------------------------------------------
+// The host side.
+// ------------------------------------------------------------------------
+
+struct Node
+{
+    PMDAxisHandle handle;
+    std::vector<CMoFrame> frames;
+    int wrong;
+    pthread_t thread;
+};
+
+static void
+Fill(std::vector<CMoFrame>& frames)
+{
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+	memset(&frames[i], 0, sizeof(frames[i]));
+	frames[i].xCt = 1;
+	frames[i].rCt = 2;
+	frames[i].xDat[0] = static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::GetPosition);
+    }
+}
+
+// Replies that aren't the emulator's GetPosition answer.
+static int
+Wrong(const std::vector<CMoFrame>& frames)
+{
+    int wrong = 0;
+
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+	if (frames[i].result != PMD_ERR_OK ||
+	    frames[i].rDat[0] != 0x1234 || frames[i].rDat[1] != 0x1235)
+	{
+	    wrong++;
+	}
+    }
+    return wrong;
+}
+
+static void*
+Caller(void* clientData)
+{
+    Node* node = static_cast<Node*>(clientData);
+    PMDuint16 xDat[1], rDat[2];
+    size_t i;
+
+    for (i = 0; i < node->frames.size(); i++)
+    {
+	xDat[0] = static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::GetPosition);
+	node->frames[i].result = node->handle.transport.SendCommand(
+	    node->handle.transport_data, 1, xDat, 2, rDat);
+	node->frames[i].rDat[0] = rDat[0];
+	node->frames[i].rDat[1] = rDat[1];
+    }
+    return 0L;
+}
+
+static void
+Report(const char* how, Emulator* emu, std::vector<Node>& nodes, int count,
+    double start, double cpu, double emuCpu, const CMoCanStats& before)
+{
+    CMoCanStats stats;
+    double elapsed = Now() - start;
+    int wrong = 0;
+
+    CMoCan_GetStats(nodes[0].handle.transport_data, &stats);
+    cpu = CpuTime(CLOCK_PROCESS_CPUTIME_ID) - cpu - (CpuTime(emu->cpu) - emuCpu);
+    for (size_t n = 0; n < nodes.size(); n++)
+    {
+	wrong += Wrong(nodes[n].frames);
+    }
+    printf("%6d %8s %12.0f %8.0f%% %10.2f %10.2f %8.1f %8lu %6d\n",
+	static_cast<int>(nodes.size()), how, count / elapsed,
+	100 * emu->wireBusy / elapsed,
+	static_cast<double>(stats.sendCalls - before.sendCalls) / count,
+	static_cast<double>(stats.recvCalls - before.recvCalls) / count,
+	1e6 * cpu / count, (unsigned long) stats.maxOutstanding, wrong);
+    fflush(stdout);
+}
+
+static void
+Run(Emulator* emu, const char* interface, int host, int nodeCount, int count)
+{
+    std::vector<Node> nodes(nodeCount);
+    std::vector<CMoCanJob> jobs(nodeCount);
+    CMoCanStats before;
+    double start, cpu, emuCpu;
+    int n, per = count / nodeCount;
+    PMDresult result;
+
+    // The bus takes the socket it is opened on and closes it at the end.
+    if (host >= 0) host = dup(host);
+    for (n = 0; n < nodeCount; n++)
+    {
+	memset(&nodes[n].handle, 0, sizeof(nodes[n].handle));
+	nodes[n].handle.axis = PMDAxis1;
+	result = host < 0
+	    ? CMoCan_Open(&nodes[n].handle, interface, static_cast<PMDuint8>(n))
+	    : CMoCan_Attach(&nodes[n].handle, host, interface, static_cast<PMDuint8>(n));
+	if (result != PMD_ERR_OK)
+	{
+	    printf("can't open %s\n", interface);
+	    exit(1);
+	}
+	nodes[n].frames.resize(per);
+    }
+
+    // One thread per node, each on its own.
+    CMoCan_GetStats(nodes[0].handle.transport_data, &before);
+    emu->wireBusy = 0;
+    start = Now();
+    cpu = CpuTime(CLOCK_PROCESS_CPUTIME_ID);
+    emuCpu = CpuTime(emu->cpu);
+    for (n = 0; n < nodeCount; n++)
+    {
+	Fill(nodes[n].frames);
+	pthread_create(&nodes[n].thread, 0L, Caller, &nodes[n]);
+    }
+    for (n = 0; n < nodeCount; n++)
+    {
+	pthread_join(nodes[n].thread, 0L);
+    }
+    Report("threads", emu, nodes, per * nodeCount, start, cpu, emuCpu, before);
+
+    // All of them as one call.
+    CMoCan_GetStats(nodes[0].handle.transport_data, &before);
+    for (n = 0; n < nodeCount; n++)
+    {
+	Fill(nodes[n].frames);
+	jobs[n].transport_data = nodes[n].handle.transport_data;
+	jobs[n].frames = &nodes[n].frames[0];
+	jobs[n].count = per;
+    }
+    emu->wireBusy = 0;
+    start = Now();
+    cpu = CpuTime(CLOCK_PROCESS_CPUTIME_ID);
+    emuCpu = CpuTime(emu->cpu);
+    CMoCan_SendJobs(&jobs[0], nodeCount);
+    Report("jobs", emu, nodes, per * nodeCount, start, cpu, emuCpu, before);
+
+    for (n = 0; n < nodeCount; n++)
+    {
+	nodes[n].handle.transport.Close(nodes[n].handle.transport_data);
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    double kbit = argc > 1 ? atof(argv[1]) : 1000;
+    double serviceUs = argc > 2 ? atof(argv[2]) : 50;
+    int count = argc > 3 ? atoi(argv[3]) : 4000;
+    const char* interface = argc > 4 ? argv[4] : "vcan0";
+    pthread_t thread;
+    Emulator emu;
+    int host, nodeCount;
+    bool real;
+
+    memset(emu.nodeFree, 0, sizeof(emu.nodeFree));
+    emu.bitTime = 1e-3 / kbit;
+    emu.service = serviceUs * 1e-6;
+    emu.wireFree = 0;
+    emu.wireBusy = 0;
+    emu.arrivals = 0;
+    emu.ready = false;
+    emu.stop = false;
+    real = OpenBus(&emu, interface, &host);
+    pthread_create(&thread, 0L, EmulatorThread, &emu);
+    while (!emu.ready) usleep(1000);
+
+    printf("GetPosition, %.0f kbit/s, %.0f us per command in each node, over %s\n",
+	kbit, serviceUs, real ? interface : "a socketpair (no kernel filters)");
+    printf("%6s %8s %12s %9s %10s %10s %8s %8s %6s\n", "nodes", "callers",
+	"commands/s", "bus", "sends/cmd", "recvs/cmd", "cpu us", "at once",
+	"wrong");
+    for (nodeCount = 1; nodeCount <= 32; nodeCount *= 2)
+    {
+	Run(&emu, interface, host, nodeCount, count);
+    }
+
+    emu.stop = true;
+    pthread_join(thread, 0L);
+    return 0;
+}
@@ -0,0 +1,460 @@
+/*
+ * CMoNetworkBench.cpp --
+ *
+ *	Commands per second over the TCP and UDP transports against the
+ *	in-flight window.
+ *
+ * An emulated Ethernet drive listens on loopback for both.  It answers
+ * each packet the way CMoReactorBench's drives do, but only once the
+ * chosen round trip time has passed and never faster than one packet per
+ * service time, which is what stops a real device being a free pipe.
+ * Over UDP it keeps its replies by sequence number and answers a repeat
+ * from there, and it can lose a share of the datagrams each way.
+ *
+ * For each protocol it times GetPosition one call at a time, then batches
+ * of them with the window at 1, 2, 4, ... and checks every reply.
+ *
+ *	make bench TCL_PREFIX=/usr/local
+ *	bench/CMoNetworkBench ?rttUs? ?serviceUs? ?loss%? ?frames?
+ */
+
+#include "CMoNetwork.h"
+#include "CMoOpcodes.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <map>
+#include <queue>
+#include <vector>
+
+static double
+Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ------------------------------------------------------------------------
+// The emulated drive.
+// ------------------------------------------------------------------------
+
+struct Connection;
+
+struct Reply
+{
+    double due;
+    Connection* conn;		// TCP, or 0L for UDP
+    int fd;			// the UDP socket
+    struct sockaddr_storage to;
+    socklen_t toLen;
+    PMDuint8 bytes[2 + CMO_FRAME_BYTES];
+    int length;
+    unsigned long order;	// replies due together go in arrival order
+    bool operator<(const Reply& other) const
+    {
+	return due != other.due ? due > other.due : order > other.order;
+    }
+};
+
+// Outlives its socket while replies for it are queued, so that a reply
+// can't go out on a later connection that was given the same fd.
+struct Connection
+{
+    int fd;
+    PMDuint8 rx[4096];
+    int have;
+    int pending;
+    bool closed;
+};
+
+struct Emulator
+{
+    int epfd, timer, listener, udp;
+    PMDuint16 port;
+    double rtt, service, loss;
+    double busyUntil;		// when the drive can take the next packet
+    std::priority_queue<Reply> replies;
+    std::map<PMDuint16, std::vector<PMDuint8> > answered;
+    unsigned long repeats, arrivals;
+    volatile bool stop;
+};
+
+static bool
+Lose(Emulator* emu)
+{
+    return emu->loss > 0 && rand() < emu->loss * RAND_MAX;
+}
+
+static void
+Arm(Emulator* emu)
+{
+    struct itimerspec its;
+    double due;
+
+    memset(&its, 0, sizeof(its));
+    if (!emu->replies.empty())
+    {
+	due = emu->replies.top().due;
+	its.it_value.tv_sec = static_cast<time_t>(due);
+	// Rounded up: firing early would only mean another trip round.
+	its.it_value.tv_nsec = static_cast<long>((due - its.it_value.tv_sec) * 1e9) + 1;
+	if (its.it_value.tv_nsec >= 1000000000L)
+	{
+	    its.it_value.tv_sec++;
+	    its.it_value.tv_nsec -= 1000000000L;
+	}
+    }
+    timerfd_settime(emu->timer, TFD_TIMER_ABSTIME, &its, 0L);
+}
+
+// Length of the packet at the front of rx, or 0 if it isn't all there.
+static int
+PacketLength(const PMDuint8* rx, int have)
+{
+    int length;
+
+    if (have < 4) return 0;
+    length = 4 + 2 * CMoOpcodes[rx[3]].xWords;
+    return have < length ? 0 : length;
+}
+
+// The drive's answer to one packet: status 0 and the reply words
+// CMoOpcodes.hpp gives it, or an error status and no data.
+static int
+Answer(const PMDuint8* packet, int length, PMDuint8* reply)
+{
+    const CMoOpcode& d = CMoOpcodes[packet[3]];
+    PMDuint8 sum;
+    int c = 0, i;
+
+    for (sum = 0, i = 0; i < length; i++) sum += packet[i];
+    reply[c++] = (sum != 0 || d.name == 0L) ? (sum ? 9 : 2) : 0;
+    reply[c++] = 0;
+    if (reply[0] == 0)
+    {
+	for (i = 0; i < d.rWords; i++)
+	{
+	    reply[c++] = 0x12;
+	    reply[c++] = static_cast<PMDuint8>(0x34 + i);
+	}
+    }
+    for (sum = 0, i = 0; i < c; i++) sum += reply[i];
+    reply[1] = static_cast<PMDuint8>(-sum);
+    return c;
+}
+
+static void
+Schedule(Emulator* emu, Reply& reply, double now)
+{
+    if (emu->busyUntil < now) emu->busyUntil = now;
+    emu->busyUntil += emu->service;
+    reply.due = emu->busyUntil > now + emu->rtt ? emu->busyUntil : now + emu->rtt;
+    reply.order = emu->arrivals++;
+    emu->replies.push(reply);
+}
+
+static void
+StreamIn(Emulator* emu, Connection* conn, double now)
+{
+    Reply reply;
+    int got, length;
+
+    got = read(conn->fd, conn->rx + conn->have, sizeof(conn->rx) - conn->have);
+    if (got <= 0)
+    {
+	epoll_ctl(emu->epfd, EPOLL_CTL_DEL, conn->fd, 0L);
+	close(conn->fd);
+	conn->closed = true;
+	if (conn->pending == 0) delete conn;
+	return;
+    }
+    conn->have += got;
+    while ((length = PacketLength(conn->rx, conn->have)) > 0)
+    {
+	reply.conn = conn;
+	reply.toLen = 0;
+	conn->pending++;
+	reply.length = Answer(conn->rx, length, reply.bytes);
+	Schedule(emu, reply, now);
+	memmove(conn->rx, conn->rx + length, conn->have - length);
+	conn->have -= length;
+    }
+}
+
+static void
+DatagramIn(Emulator* emu, double now)
+{
+    PMDuint8 datagram[64];
+    Reply reply;
+    PMDuint16 sequence;
+    int got;
+
+    reply.toLen = sizeof(reply.to);
+    while ((got = recvfrom(emu->udp, datagram, sizeof(datagram), MSG_DONTWAIT,
+	    (struct sockaddr*)&reply.to, &reply.toLen)) > 0)
+    {
+	if (got < 6 || Lose(emu)) continue;
+	sequence = static_cast<PMDuint16>((datagram[0] << 8) | datagram[1]);
+	reply.conn = 0L;
+	reply.fd = emu->udp;
+	reply.bytes[0] = datagram[0];
+	reply.bytes[1] = datagram[1];
+
+	// Seen it: the reply it already got, not a second run.
+	std::map<PMDuint16, std::vector<PMDuint8> >::iterator seen =
+	    emu->answered.find(sequence);
+	if (seen != emu->answered.end())
+	{
+	    emu->repeats++;
+	    memcpy(reply.bytes + 2, &seen->second[0], seen->second.size());
+	    reply.length = 2 + static_cast<int>(seen->second.size());
+	}
+	else
+	{
+	    reply.length = 2 + Answer(datagram + 2, got - 2, reply.bytes + 2);
+	    emu->answered[sequence].assign(reply.bytes + 2, reply.bytes + reply.length);
+	    emu->answered.erase(static_cast<PMDuint16>(sequence - 32768));
+	}
+	Schedule(emu, reply, now);
+	reply.toLen = sizeof(reply.to);
+    }
+}
+
+static void*
+EmulatorThread(void* clientData)
+{
+    Emulator* emu = static_cast<Emulator*>(clientData);
+    struct epoll_event events[64], ev;
+    uint64_t expirations;
+    Connection* conn;
+    double now;
+    int n, i, fd, on = 1;
+
+    while (!emu->stop)
+    {
+	n = epoll_wait(emu->epfd, events, 64, 50);
+	now = Now();
+	for (i = 0; i < n; i++)
+	{
+	    void* what = events[i].data.ptr;
+
+	    if (what == &emu->timer)
+	    {
+		if (read(emu->timer, &expirations, sizeof(expirations)) < 0) {}
+	    }
+	    else if (what == &emu->listener)
+	    {
+		if ((fd = accept(emu->listener, 0L, 0L)) < 0) continue;
+		// As a drive would, or Nagle holds the last reply of a
+		// window back for the host's delayed ACK.
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		conn = new Connection();
+		conn->fd = fd;
+		conn->have = 0;
+		conn->pending = 0;
+		conn->closed = false;
+		ev.events = EPOLLIN;
+		ev.data.ptr = conn;
+		epoll_ctl(emu->epfd, EPOLL_CTL_ADD, fd, &ev);
+	    }
+	    else if (what == &emu->udp)
+	    {
+		DatagramIn(emu, now);
+	    }
+	    else
+	    {
+		StreamIn(emu, static_cast<Connection*>(what), now);
+	    }
+	}
+	now = Now();
+	while (!emu->replies.empty() && emu->replies.top().due <= now)
+	{
+	    const Reply& reply = emu->replies.top();
+	    if (reply.conn != 0L)
+	    {
+		conn = reply.conn;
+		if (!conn->closed)
+		{
+		    if (send(conn->fd, reply.bytes, reply.length, MSG_NOSIGNAL) < 0) {}
+		}
+		else if (conn->pending == 1)
+		{
+		    delete conn;
+		    conn = 0L;
+		}
+		if (conn != 0L) conn->pending--;
+	    }
+	    else if (!Lose(emu))
+	    {
+		if (sendto(reply.fd, reply.bytes, reply.length, 0,
+		    (const struct sockaddr*)&reply.to, reply.toLen) < 0) {}
+	    }
+	    emu->replies.pop();
+	}
+	Arm(emu);
+    }
+    return 0L;
+}
+
+static void
+Listen(Emulator* emu)
+{
+    struct sockaddr_in addr;
+    struct epoll_event ev;
+    socklen_t length = sizeof(addr);
+    int on = 1;
+
+    emu->epfd = epoll_create1(0);
+    emu->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    emu->listener = socket(AF_INET, SOCK_STREAM, 0);
+    emu->udp = socket(AF_INET, SOCK_DGRAM, 0);
+    setsockopt(emu->listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    // Any free port will do, the same number for both.
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(emu->listener, (struct sockaddr*)&addr, sizeof(addr));
+    getsockname(emu->listener, (struct sockaddr*)&addr, &length);
+    bind(emu->udp, (struct sockaddr*)&addr, sizeof(addr));
+    listen(emu->listener, 8);
+    emu->port = ntohs(addr.sin_port);
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &emu->timer;
+    epoll_ctl(emu->epfd, EPOLL_CTL_ADD, emu->timer, &ev);
+    ev.data.ptr = &emu->listener;
+    epoll_ctl(emu->epfd, EPOLL_CTL_ADD, emu->listener, &ev);
+    ev.data.ptr = &emu->udp;
+    epoll_ctl(emu->epfd, EPOLL_CTL_ADD, emu->udp, &ev);
+}
+
+// ------------------------------------------------------------------------
+// The host side.
+// ------------------------------------------------------------------------
+
+static void
+Fill(std::vector<CMoFrame>& frames)
+{
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+	memset(&frames[i], 0, sizeof(frames[i]));
+	frames[i].xCt = 1;
+	frames[i].rCt = 2;
+	frames[i].xDat[0] = static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::GetPosition);
+    }
+}
+
+// Replies that aren't the emulator's GetPosition answer.
+static int
+Wrong(const std::vector<CMoFrame>& frames)
+{
+    int wrong = 0;
+
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+	if (frames[i].result != PMD_ERR_OK ||
+	    frames[i].rDat[0] != 0x1234 || frames[i].rDat[1] != 0x1235)
+	{
+	    wrong++;
+	}
+    }
+    return wrong;
+}
+
+static double
+OneAtATime(PMDAxisHandle* handle, int count)
+{
+    PMDuint16 xDat[1], rDat[2];
+    double start = Now();
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+	xDat[0] = static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::GetPosition);
+	handle->transport.SendCommand(handle->transport_data, 1, xDat, 2, rDat);
+    }
+    return count / (Now() - start);
+}
+
+static void
+Run(int protocol, PMDuint16 port, int count)
+{
+    std::vector<CMoFrame> frames(count);
+    CMoNetworkData* net;
+    PMDAxisHandle handle;
+    double start, rate;
+    int window;
+
+    memset(&handle, 0, sizeof(handle));
+    handle.axis = PMDAxis1;
+    if (CMoNetwork_Open(&handle, protocol, "127.0.0.1", port) != PMD_ERR_OK)
+    {
+	printf("can't connect\n");
+	return;
+    }
+    net = static_cast<CMoNetworkData*>(handle.transport_data);
+    net->timeout = 20;
+    net->retransmits = 10;
+
+    printf("%s\n%8s %12.0f\n", protocol == CMoNetworkTCP ? "tcp" : "udp",
+	"single", OneAtATime(&handle, count / 4));
+    for (window = 1; window <= 64; window *= 2)
+    {
+	net->window = window;
+	memset(&net->stats, 0, sizeof(net->stats));
+	Fill(frames);
+	start = Now();
+	CMoNetwork_SendFrames(net, &frames[0], count);
+	rate = count / (Now() - start);
+	printf("%8d %12.0f %10d %12lu %10lu %10lu %10lu\n", window, rate,
+	    Wrong(frames), (unsigned long) net->stats.retransmits,
+	    (unsigned long) net->stats.duplicates,
+	    (unsigned long) net->stats.maxInFlight,
+	    (unsigned long) net->stats.reconnects);
+	fflush(stdout);
+    }
+    handle.transport.Close(handle.transport_data);
+}
+
+int
+main(int argc, char** argv)
+{
+    double rttUs = argc > 1 ? atof(argv[1]) : 500;
+    double serviceUs = argc > 2 ? atof(argv[2]) : 20;
+    double lossPercent = argc > 3 ? atof(argv[3]) : 1;
+    int count = argc > 4 ? atoi(argv[4]) : 5000;
+    pthread_t thread;
+    Emulator emu;
+
+    emu.rtt = rttUs * 1e-6;
+    emu.service = serviceUs * 1e-6;
+    emu.loss = lossPercent / 100;
+    emu.busyUntil = 0;
+    emu.repeats = 0;
+    emu.arrivals = 0;
+    emu.stop = false;
+    Listen(&emu);
+    pthread_create(&thread, 0L, EmulatorThread, &emu);
+
+    printf("GetPosition, %.0f us round trip, %.0f us per packet, "
+	"%.1f%% of UDP datagrams lost each way\n", rttUs, serviceUs, lossPercent);
+    printf("%8s %12s %10s %12s %10s %10s %10s\n", "window", "commands/s", "wrong",
+	"retransmits", "duplicates", "in flight", "reconnects");
+    Run(CMoNetworkTCP, emu.port, count);
+    Run(CMoNetworkUDP, emu.port, count);
+    printf("udp repeats answered from the reply cache: %lu\n", emu.repeats);
+
+    emu.stop = true;
+    pthread_join(thread, 0L);
+    return 0;
+}
@@ -0,0 +1,616 @@
+/*
+ * CMoReactorBench.cpp --
+ *
+ *	Throughput against number of ports for the epoll reactor.
+ *
+ * Every port is a pty with an emulated drive on the master side.  The
+ * emulator answers each well formed point-to-point packet with status 0
+ * and the reply words CMoOpcodes.hpp gives it, but only after the time
+ * the command and the reply would take on the wire at the chosen baud
+ * rate, one packet at a time per port, the way a real link would.
+ *
+ * For each port count it measures GetPosition round trips per second:
+ *
+ *   sequential	one thread going round the ports with blocking calls,
+ *		which is what a script does without the reactor
+ *   reactor	every port attached, with a few requests kept queued on
+ *		each one from the completion routine
+ *
+ * Then, on one port, the worst time an emergency stop (SetStopMode and
+ * Update) takes to be answered with that many GetPositions queued ahead
+ * of it, submitted like any other request and through Preempt the way
+ * [cmotion::estop] sends it (CMoStop.hpp).
+ *
+ * Last, on one port kept busy with background batches of GetPositions,
+ * like an upload or a trace, how long single calls take when they are
+ * queued in the same class as the batches and when they are interactive
+ * (CMoPriority.h), and how many frames a second the batches still get.
+ *
+ *	make bench TCL_PREFIX=/usr/local
+ *	bench/CMoReactorBench ?maxPorts? ?baud? ?seconds? ?depth?
+ */
+
+#include "CMoReactor.hpp"
+#include "CMoOpcodes.hpp"
+#include "c-motion/c-motion.h"
+#include "c-motion/PMDW32Ser.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+static double
+Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ------------------------------------------------------------------------
+// The emulated drives.
+// ------------------------------------------------------------------------
+
+struct Drive
+{
+    int master;
+    PMDuint8 rx[512];
+    int have;
+    double lineFree;		// when the wire is next idle
+};
+
+struct Reply
+{
+    double due;
+    Drive* drive;
+    PMDuint8 bytes[CMO_FRAME_BYTES];
+    int length;
+    bool operator<(const Reply& other) const { return due > other.due; }
+};
+
+struct Emulator
+{
+    std::vector<Drive*> drives;
+    std::priority_queue<Reply> replies;
+    double byteTime;
+    int epfd, timer;
+    volatile bool stop;
+};
+
+static void
+Arm(Emulator* emu)
+{
+    struct itimerspec its;
+    double due;
+
+    memset(&its, 0, sizeof(its));
+    if (!emu->replies.empty())
+    {
+	due = emu->replies.top().due;
+	its.it_value.tv_sec = static_cast<time_t>(due);
+	its.it_value.tv_nsec = static_cast<long>((due - its.it_value.tv_sec) * 1e9);
+	if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+	{
+	    its.it_value.tv_nsec = 1;
+	}
+    }
+    timerfd_settime(emu->timer, TFD_TIMER_ABSTIME, &its, 0L);
+}
+
+static void
+Decode(Emulator* emu, Drive* drive, double now)
+{
+    Reply reply;
+    int op, len, c, i;
+    PMDuint8 sum;
+
+    for (;;)
+    {
+	if (drive->have < 4) break;
+	op = drive->rx[3];
+	const CMoOpcode& d = CMoOpcodes[op];
+	len = 4 + 2 * d.xWords;
+	if (drive->have < len) break;
+
+	for (sum = 0, i = 0; i < len; i++) sum += drive->rx[i];
+	c = 0;
+	reply.bytes[c++] = (sum != 0 || d.name == 0L) ? (sum ? 9 : 2) : 0;
+	reply.bytes[c++] = 0;
+	if (reply.bytes[0] == 0)
+	{
+	    for (i = 0; i < d.rWords; i++)
+	    {
+		reply.bytes[c++] = 0x12;
+		reply.bytes[c++] = static_cast<PMDuint8>(0x34 + i);
+	    }
+	}
+	for (sum = 0, i = 0; i < c; i++) sum += reply.bytes[i];
+	reply.bytes[1] = static_cast<PMDuint8>(-sum);
+	reply.length = c;
+	reply.drive = drive;
+
+	// The packet takes its time on the wire, then the reply does.
+	if (drive->lineFree < now) drive->lineFree = now;
+	drive->lineFree += (len + c) * emu->byteTime;
+	reply.due = drive->lineFree;
+	emu->replies.push(reply);
+
+	memmove(drive->rx, drive->rx + len, drive->have - len);
+	drive->have -= len;
+    }
+}
+
+static void*
+EmulatorThread(void* clientData)
+{
+    Emulator* emu = static_cast<Emulator*>(clientData);
+    struct epoll_event events[64];
+    uint64_t expirations;
+    double now;
+    int n, i, got;
+
+    while (!emu->stop)
+    {
+	n = epoll_wait(emu->epfd, events, 64, 50);
+	now = Now();
+	for (i = 0; i < n; i++)
+	{
+	    if (events[i].data.ptr == 0L)
+	    {
+		if (read(emu->timer, &expirations, sizeof(expirations)) < 0) {}
+		continue;
+	    }
+	    Drive* drive = static_cast<Drive*>(events[i].data.ptr);
+	    got = read(drive->master, drive->rx + drive->have,
+		sizeof(drive->rx) - drive->have);
+	    if (got > 0)
+	    {
+		drive->have += got;
+		Decode(emu, drive, now);
+	    }
+	}
+	while (!emu->replies.empty() && emu->replies.top().due <= now)
+	{
+	    const Reply& reply = emu->replies.top();
+	    if (write(reply.drive->master, reply.bytes, reply.length) < 0) {}
+	    emu->replies.pop();
+	}
+	Arm(emu);
+    }
+    return 0L;
+}
+
+// ------------------------------------------------------------------------
+// The host side.
+// ------------------------------------------------------------------------
+
+struct Link
+{
+    PMDAxisHandle handle;
+    PMDSerialIOData sio;
+};
+
+static Link*
+OpenLink(Emulator* emu, PMDuint32 baud)
+{
+    struct epoll_event ev;
+    struct termios t;
+    Drive* drive = new Drive();
+    Link* link = new Link();
+
+    drive->master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    grantpt(drive->master);
+    unlockpt(drive->master);
+    tcgetattr(drive->master, &t);
+    cfmakeraw(&t);
+    tcsetattr(drive->master, TCSANOW, &t);
+    emu->drives.push_back(drive);
+    ev.events = EPOLLIN;
+    ev.data.ptr = drive;
+    epoll_ctl(emu->epfd, EPOLL_CTL_ADD, drive->master, &ev);
+
+    memset(link, 0, sizeof(*link));
+    PMDSerial_InitData(&link->sio);
+    link->sio.hPort = open(ptsname(drive->master), O_RDWR | O_NOCTTY);
+    PMDSerial_SetConfig(&link->sio, baud, PMDSerialParityNone);
+    PMDSerial_SetTimeout(&link->sio, 100);
+    link->handle.axis = PMDAxis1;
+    link->handle.InterfaceType = InterfaceSerial;
+    link->handle.transport.SendCommand = PMDSerial_Send;
+    link->handle.transport_data = &link->sio;
+    return link;
+}
+
+static void
+CloseLink(Link* link)
+{
+    close(link->sio.hPort);
+    delete link;
+}
+
+struct Posted
+{
+    CMoReactor::Request request;
+    CMoFrame frame;
+    Link* link;
+};
+
+static volatile bool running;
+static unsigned long completions, failures;
+static pthread_mutex_t counter = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+Submit(Posted* posted)
+{
+    memset(&posted->frame, 0, sizeof(posted->frame));
+    posted->frame.xCt = 1;
+    posted->frame.rCt = 2;
+    posted->frame.xDat[0] = static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::GetPosition);
+    posted->request.tx = 0L;
+    posted->request.txLen = 0;
+    posted->request.frames = &posted->frame;
+    posted->request.count = 1;
+    posted->request.priority = CMoInteractive;
+    posted->request.clientData = posted;
+    CMoReactor::Submit(&posted->link->handle, &posted->request);
+}
+
+static void
+Done(CMoReactor::Request* request)
+{
+    Posted* posted = static_cast<Posted*>(request->clientData);
+
+    pthread_mutex_lock(&counter);
+    if (request->result == PMD_ERR_OK) completions++; else failures++;
+    pthread_mutex_unlock(&counter);
+    if (running)
+    {
+	Submit(posted);
+    }
+}
+
+struct Stop
+{
+    CMoReactor::Request request;
+    CMoFrame frames[2];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool done;
+};
+
+static void
+StopDone(CMoReactor::Request* request)
+{
+    Stop* stop = static_cast<Stop*>(request->clientData);
+
+    pthread_mutex_lock(&stop->lock);
+    stop->done = true;
+    pthread_cond_signal(&stop->cond);
+    pthread_mutex_unlock(&stop->lock);
+}
+
+// Worst of trials, in ms.
+static double
+StopLatency(Link* link, int queued, bool preempt, int trials)
+{
+    std::vector<Posted> posted(queued);
+    Stop stop;
+    double start, took, worst = 0;
+    int t, i;
+
+    pthread_mutex_init(&stop.lock, 0L);
+    pthread_cond_init(&stop.cond, 0L);
+    running = false;
+    CMoReactor::Attach(&link->handle);
+    for (t = 0; t < trials; t++)
+    {
+	for (i = 0; i < queued; i++)
+	{
+	    posted[i].link = link;
+	    posted[i].request.done = Done;
+	    Submit(&posted[i]);
+	}
+	usleep(2000);
+
+	memset(stop.frames, 0, sizeof(stop.frames));
+	stop.frames[0].xCt = 2;
+	stop.frames[0].xDat[0] = static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::SetStopMode);
+	stop.frames[0].xDat[1] = PMDStopModeAbrupt;
+	stop.frames[1].xCt = 1;
+	stop.frames[1].xDat[0] = static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::Update);
+	stop.request.tx = 0L;
+	stop.request.txLen = 0;
+	stop.request.frames = stop.frames;
+	stop.request.count = 2;
+	stop.request.priority = CMoInteractive;
+	stop.request.done = StopDone;
+	stop.request.clientData = &stop;
+	stop.done = false;
+
+	start = Now();
+	if (preempt)
+	{
+	    CMoReactor::Preempt(&link->sio, &stop.request);
+	}
+	else
+	{
+	    CMoReactor::Submit(&link->handle, &stop.request);
+	}
+	pthread_mutex_lock(&stop.lock);
+	while (!stop.done)
+	{
+	    pthread_cond_wait(&stop.cond, &stop.lock);
+	}
+	pthread_mutex_unlock(&stop.lock);
+	took = Now() - start;
+	worst = took > worst ? took : worst;
+
+	// Whatever wasn't cancelled finishes before the next round.
+	CMoReactor::Detach(&link->handle);
+	CMoReactor::Attach(&link->handle);
+    }
+    CMoReactor::Detach(&link->handle);
+    return worst * 1e3;
+}
+
+struct Batch
+{
+    CMoReactor::Request request;
+    CMoFrame frames[64];
+    Link* link;
+};
+
+static unsigned long batchFrames;
+
+static void
+SubmitBatch(Batch* batch)
+{
+    int i;
+
+    memset(batch->frames, 0, sizeof(batch->frames));
+    for (i = 0; i < 64; i++)
+    {
+	batch->frames[i].xCt = 1;
+	batch->frames[i].rCt = 2;
+	batch->frames[i].xDat[0] =
+	    static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::GetPosition);
+    }
+    batch->request.tx = 0L;
+    batch->request.txLen = 0;
+    batch->request.frames = batch->frames;
+    batch->request.count = 64;
+    batch->request.priority = CMoBackground;
+    batch->request.clientData = batch;
+    CMoReactor::Submit(&batch->link->handle, &batch->request);
+}
+
+static void
+BatchDone(CMoReactor::Request* request)
+{
+    Batch* batch = static_cast<Batch*>(request->clientData);
+
+    pthread_mutex_lock(&counter);
+    batchFrames += request->count;
+    pthread_mutex_unlock(&counter);
+    if (running)
+    {
+	SubmitBatch(batch);
+    }
+}
+
+// Single GetPositions of the given class, one after another, behind two
+// background batches kept queued.  Their round trips in ms at the 50th
+// and 99th percentile, and the batches' frames per second.
+static void
+UnderLoad(Link* link, int priority, double seconds, double* p50, double* p99,
+	double* background)
+{
+    std::vector<double> took;
+    Batch batches[2];
+    Stop call;
+    double start, began;
+    int i;
+
+    pthread_mutex_init(&call.lock, 0L);
+    pthread_cond_init(&call.cond, 0L);
+    CMoReactor::Attach(&link->handle);
+    batchFrames = 0;
+    running = true;
+    for (i = 0; i < 2; i++)
+    {
+	batches[i].link = link;
+	batches[i].request.done = BatchDone;
+	SubmitBatch(&batches[i]);
+    }
+
+    start = Now();
+    while (Now() - start < seconds)
+    {
+	memset(call.frames, 0, sizeof(call.frames));
+	call.frames[0].xCt = 1;
+	call.frames[0].rCt = 2;
+	call.frames[0].xDat[0] =
+	    static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::GetPosition);
+	call.request.tx = 0L;
+	call.request.txLen = 0;
+	call.request.frames = call.frames;
+	call.request.count = 1;
+	call.request.priority = priority;
+	call.request.done = StopDone;
+	call.request.clientData = &call;
+	call.done = false;
+
+	began = Now();
+	CMoReactor::Submit(&link->handle, &call.request);
+	pthread_mutex_lock(&call.lock);
+	while (!call.done)
+	{
+	    pthread_cond_wait(&call.cond, &call.lock);
+	}
+	pthread_mutex_unlock(&call.lock);
+	took.push_back((Now() - began) * 1e3);
+	usleep(1000);
+    }
+    pthread_mutex_lock(&counter);
+    *background = batchFrames / (Now() - start);
+    pthread_mutex_unlock(&counter);
+    running = false;
+    CMoReactor::Detach(&link->handle);
+
+    std::sort(took.begin(), took.end());
+    *p50 = took[took.size() / 2];
+    *p99 = took[took.size() * 99 / 100];
+}
+
+static double
+Sequential(std::vector<Link*>& links, double seconds)
+{
+    unsigned long done = 0;
+    double start = Now();
+    PMDint32 position;
+    size_t i;
+
+    while (Now() - start < seconds)
+    {
+	for (i = 0; i < links.size(); i++)
+	{
+	    if (PMDGetPosition(&links[i]->handle, &position) == PMD_ERR_OK) done++;
+	}
+    }
+    return done / (Now() - start);
+}
+
+static double
+Reactor(std::vector<Link*>& links, double seconds, int depth,
+	CMoReactor::Stats* stats)
+{
+    std::vector<Posted*> posted;
+    CMoReactor::Stats before;
+    double start, elapsed;
+    size_t i;
+    int j;
+
+    CMoReactor::GetStats(&before);
+    for (i = 0; i < links.size(); i++)
+    {
+	CMoReactor::Attach(&links[i]->handle);
+    }
+    completions = failures = 0;
+    running = true;
+    start = Now();
+    for (i = 0; i < links.size(); i++)
+    {
+	for (j = 0; j < depth; j++)
+	{
+	    Posted* p = new Posted();
+	    p->link = links[i];
+	    p->request.done = Done;
+	    posted.push_back(p);
+	    Submit(p);
+	}
+    }
+    usleep(static_cast<useconds_t>(seconds * 1e6));
+    pthread_mutex_lock(&counter);
+    elapsed = Now() - start;
+    double rate = completions / elapsed;
+    pthread_mutex_unlock(&counter);
+    running = false;
+
+    // Detach waits for what is still queued.
+    for (i = 0; i < links.size(); i++)
+    {
+	CMoReactor::Detach(&links[i]->handle);
+    }
+    for (i = 0; i < posted.size(); i++)
+    {
+	delete posted[i];
+    }
+    CMoReactor::GetStats(stats);
+    stats->wakeups -= before.wakeups;
+    stats->requests -= before.requests;
+    return rate;
+}
+
+int
+main(int argc, char** argv)
+{
+    int maxPorts = argc > 1 ? atoi(argv[1]) : 64;
+    PMDuint32 baud = argc > 2 ? atoi(argv[2]) : 460800;
+    double seconds = argc > 3 ? atof(argv[3]) : 1.0;
+    int depth = argc > 4 ? atoi(argv[4]) : 4;
+    std::vector<Link*> links;
+    CMoReactor::Stats stats;
+    struct epoll_event ev;
+    pthread_t thread;
+    Emulator emu;
+    double seq, rea, wire, p50, p99, background;
+    int ports, queued, priority;
+
+    emu.byteTime = 10.0 / baud;
+    emu.epfd = epoll_create1(0);
+    emu.timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    emu.stop = false;
+    ev.events = EPOLLIN;
+    ev.data.ptr = 0L;
+    epoll_ctl(emu.epfd, EPOLL_CTL_ADD, emu.timer, &ev);
+    pthread_create(&thread, 0L, EmulatorThread, &emu);
+
+    // GetPosition is 4 bytes out and 6 back.
+    wire = 1.0 / (10 * emu.byteTime);
+    printf("GetPosition at %lu baud, %.0f round trips/s per link at most\n",
+	(unsigned long) baud, wire);
+    printf("%6s %12s %12s %10s %10s %10s\n", "ports", "sequential", "reactor",
+	"per link", "link use", "wakeups");
+
+    for (ports = 1; ports <= maxPorts; ports *= 2)
+    {
+	while (static_cast<int>(links.size()) < ports)
+	{
+	    links.push_back(OpenLink(&emu, baud));
+	}
+	seq = Sequential(links, seconds);
+	rea = Reactor(links, seconds, depth, &stats);
+	printf("%6d %12.0f %12.0f %10.0f %9.0f%% %10.2f\n", ports, seq, rea,
+	    rea / ports, 100.0 * rea / ports / wire,
+	    stats.requests ? static_cast<double>(stats.wakeups) / stats.requests : 0.0);
+	fflush(stdout);
+    }
+
+    printf("\nworst stop latency on one link, ms\n");
+    printf("%6s %12s %12s\n", "queued", "submitted", "preempted");
+    for (queued = 4; queued <= 256; queued *= 4)
+    {
+	printf("%6d %12.2f %12.2f\n", queued,
+	    StopLatency(links[0], queued, false, 10),
+	    StopLatency(links[0], queued, true, 10));
+	fflush(stdout);
+    }
+
+    printf("\nsingle calls behind background batches on one link\n");
+    printf("%12s %10s %10s %14s\n", "class", "p50 ms", "p99 ms", "background/s");
+    for (priority = CMoBackground; priority >= CMoInteractive; priority--)
+    {
+	UnderLoad(links[0], priority, seconds, &p50, &p99, &background);
+	printf("%12s %10.2f %10.2f %14.0f\n", CMoPriority_Names[priority],
+	    p50, p99, background);
+	fflush(stdout);
+    }
+
+    emu.stop = true;
+    pthread_join(thread, 0L);
+    for (size_t i = 0; i < links.size(); i++)
+    {
+	CloseLink(links[i]);
+    }
+    return 0;
+}
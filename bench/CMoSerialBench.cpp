@@ -0,0 +1,235 @@
+/*
+ * CMoSerialBench.cpp --
+ *
+ *	Round trip latency of blocking calls on one serial port.
+ *
+ * The port is a pty with an emulated drive on the master side that
+ * answers each well formed point-to-point packet at once, with status 0
+ * and the reply words CMoOpcodes.hpp gives it.  The host alternates
+ * SetVelocity and GetPosition through PMDSerial_Send, the way a script
+ * calling the C-Motion layer does, and reports the 50th and 99th
+ * percentile round trip and how many calls failed, for three kinds of
+ * line:
+ *
+ *   clean	every reply in one write
+ *   split	every reply in two writes 300 us apart, which a read that
+ *		gives up on the first short read reports as a timeout
+ *   drop	one reply in 100 never sent, so the 99th percentile is the
+ *		reply timeout the port is given
+ *
+ * It uses nothing of the serial port but PMDSerial_InitData, SetConfig,
+ * SetTimeout and Send, so the same file builds against the serial code
+ * from before the fast path (lazy flush, ppoll deadline, one read for the
+ * whole reply) for a comparison.  For system calls per command, run it
+ * under strace -c -f.
+ *
+ *	make bench TCL_PREFIX=/usr/local
+ *	bench/CMoSerialBench ?commands? ?timeoutMs?
+ */
+
+#include "CMoOpcodes.hpp"
+#include "c-motion/c-motion.h"
+#include "c-motion/PMDW32Ser.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+enum Line { Clean, Split, Drop };
+
+static const char* lineNames[] = {"clean", "split", "drop"};
+
+static double
+Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ------------------------------------------------------------------------
+// The emulated drive.
+// ------------------------------------------------------------------------
+
+struct Drive
+{
+    int master;
+    Line line;
+    unsigned long answered;
+    volatile bool stop;
+};
+
+// The reply to the packet at the front of rx, or 0 when there isn't a
+// whole one yet; *used is how much of rx it took.
+static int
+Answer(const PMDuint8* rx, int have, PMDuint8* reply, int* used)
+{
+    int op, len, c, i;
+    PMDuint8 sum;
+
+    if (have < 4)
+    {
+	return 0;
+    }
+    op = rx[3];
+    const CMoOpcode& d = CMoOpcodes[op];
+    len = 4 + 2 * d.xWords;
+    if (have < len)
+    {
+	return 0;
+    }
+    for (sum = 0, i = 0; i < len; i++) sum += rx[i];
+    c = 0;
+    reply[c++] = (sum != 0 || d.name == 0L) ? (sum ? 9 : 2) : 0;
+    reply[c++] = 0;
+    if (reply[0] == 0)
+    {
+	for (i = 0; i < d.rWords; i++)
+	{
+	    reply[c++] = 0x12;
+	    reply[c++] = static_cast<PMDuint8>(0x34 + i);
+	}
+    }
+    for (sum = 0, i = 0; i < c; i++) sum += reply[i];
+    reply[1] = static_cast<PMDuint8>(-sum);
+    *used = len;
+    return c;
+}
+
+static void*
+DriveThread(void* clientData)
+{
+    Drive* drive = static_cast<Drive*>(clientData);
+    PMDuint8 rx[512], reply[64];
+    struct pollfd pfd;
+    int have = 0, got, length, used, half;
+
+    pfd.fd = drive->master;
+    pfd.events = POLLIN;
+    while (!drive->stop)
+    {
+	if (poll(&pfd, 1, 50) <= 0)
+	{
+	    continue;
+	}
+	got = read(drive->master, rx + have, sizeof(rx) - have);
+	if (got <= 0)
+	{
+	    continue;
+	}
+	have += got;
+	while ((length = Answer(rx, have, reply, &used)) > 0)
+	{
+	    memmove(rx, rx + used, have - used);
+	    have -= used;
+	    drive->answered++;
+	    if (drive->line == Drop && drive->answered % 100 == 0)
+	    {
+		continue;
+	    }
+	    if (drive->line == Split)
+	    {
+		half = length / 2;
+		if (write(drive->master, reply, half) < 0) {}
+		usleep(300);
+		if (write(drive->master, reply + half, length - half) < 0) {}
+		continue;
+	    }
+	    if (write(drive->master, reply, length) < 0) {}
+	}
+    }
+    return 0L;
+}
+
+// ------------------------------------------------------------------------
+// The host side.
+// ------------------------------------------------------------------------
+
+// Round trips in us at the 50th and 99th percentile, and the failures.
+static void
+Run(Line line, int commands, long timeoutMs, double* p50, double* p99,
+	int* failed)
+{
+    std::vector<double> took;
+    PMDSerialIOData sio;
+    PMDuint16 xDat[3], rDat[2];
+    struct termios t;
+    pthread_t thread;
+    Drive drive;
+    double start;
+    int i;
+
+    drive.master = posix_openpt(O_RDWR | O_NOCTTY);
+    grantpt(drive.master);
+    unlockpt(drive.master);
+    tcgetattr(drive.master, &t);
+    cfmakeraw(&t);
+    tcsetattr(drive.master, TCSANOW, &t);
+    drive.line = line;
+    drive.answered = 0;
+    drive.stop = false;
+
+    memset(&sio, 0, sizeof(sio));
+    PMDSerial_InitData(&sio);
+    sio.hPort = open(ptsname(drive.master), O_RDWR | O_NOCTTY);
+    PMDSerial_SetConfig(&sio, 460800, PMDSerialParityNone);
+    PMDSerial_SetTimeout(&sio, timeoutMs);
+    pthread_create(&thread, 0L, DriveThread, &drive);
+
+    *failed = 0;
+    for (i = 0; i < commands; i++)
+    {
+	start = Now();
+	if (i % 2 == 0)
+	{
+	    xDat[0] = static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::SetVelocity);
+	    xDat[1] = 0;
+	    xDat[2] = static_cast<PMDuint16>(i);
+	    if (PMDSerial_Send(&sio, 3, xDat, 0, rDat) != PMD_ERR_OK) (*failed)++;
+	}
+	else
+	{
+	    xDat[0] = static_cast<PMDuint16>((PMDAxis1 << 8) | CMoOp::GetPosition);
+	    if (PMDSerial_Send(&sio, 1, xDat, 2, rDat) != PMD_ERR_OK) (*failed)++;
+	}
+	took.push_back((Now() - start) * 1e6);
+    }
+
+    drive.stop = true;
+    pthread_join(thread, 0L);
+    close(sio.hPort);
+    close(drive.master);
+
+    std::sort(took.begin(), took.end());
+    *p50 = took[took.size() / 2];
+    *p99 = took[took.size() * 99 / 100];
+}
+
+int
+main(int argc, char** argv)
+{
+    int commands = argc > 1 ? atoi(argv[1]) : 10000;
+    long timeoutMs = argc > 2 ? atol(argv[2]) : 10;
+    double p50, p99;
+    int line, failed;
+
+    printf("%d commands, SetVelocity and GetPosition, %ld ms reply timeout\n",
+	commands, timeoutMs);
+    printf("%8s %10s %10s %10s\n", "line", "p50 us", "p99 us", "failed");
+    for (line = Clean; line <= Drop; line++)
+    {
+	Run(static_cast<Line>(line), commands, timeoutMs, &p50, &p99, &failed);
+	printf("%8s %10.1f %10.1f %9.1f%%\n", lineNames[line], p50, p99,
+	    100.0 * failed / commands);
+	fflush(stdout);
+    }
+    return 0;
+}
@@ -3,20 +3,52 @@
 //  Performance Motion Devices, Inc.
 //
 
+#define _GNU_SOURCE             // ppoll
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
 
 #include "PMDtypes.h"
 #include "PMDecode.h"
 #include "PMDdevice.h"
 #include "PMDtrans.h"
 #include "PMDsys.h"
-#include "PMDW32ser.h"
+#include "PMDW32Ser.h"
 
 // only need to include this if diagnostics mode is used
 #include "PMDdiag.h"
 #define error_message printf
 
+// termios2 lets the UART run at any rate the driver can divide down to,
+// not just the Bnnn table.  glibc's <termios.h> and the kernel's
+// <asm/termbits.h> can't both be included, so declare the kernel struct
+// here for the architectures whose layout it matches.
+#if defined(TCGETS2) && (defined(__i386__) || defined(__x86_64__) || \
+    defined(__arm__) || defined(__aarch64__) || defined(__riscv))
+#define PMD_HAVE_TERMIOS2
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif
+#ifndef IBSHIFT
+#define IBSHIFT 16
+#endif
+struct termios2 {
+    tcflag_t c_iflag;
+    tcflag_t c_oflag;
+    tcflag_t c_cflag;
+    tcflag_t c_lflag;
+    cc_t c_line;
+    cc_t c_cc[19];
+    speed_t c_ispeed;
+    speed_t c_ospeed;
+};
+#endif
+
 // ------------------------------------------------------------------------
 PMDuint16 PMDSerial_GetStatus(void* transport_data)
 {
@@ -51,12 +83,10 @@ PMDresult PMDSerial_HardReset(void* transport_data)
 // ------------------------------------------------------------------------
 PMDuint16 PMDSerial_InitPort(void* transport_data)
 {
-    char szPort[10] = "/dev/ttyUSB";
-    char szPortNum[3];
+    char szPort[16];
     PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
 
-    itoa( SIOtransport_data->port, szPortNum, 10 );
-    strcat( szPort, szPortNum );
+    sprintf( szPort, "/dev/ttyUSB%u", SIOtransport_data->port );
 
     SIOtransport_data->hPort = open(szPort, O_RDWR | O_NOCTTY);
 
@@ -68,20 +98,26 @@ PMDuint16 PMDSerial_InitPort(void* transport_data)
     /* lock access so that another process can't also use the port */
     if (flock(SIOtransport_data->hPort, LOCK_EX | LOCK_NB) != 0)
     {
-        PMDSerial_Close( transport_data );
+        // PMDSerial_Close would also free transport_data, which the
+        // caller still owns, so just drop the descriptor.
+        close( SIOtransport_data->hPort );
+        SIOtransport_data->hPort = INVALID_HANDLE_VALUE;
         error_message("Another process has locked the comport.");
         return PMD_ERR_OpeningPort;
     }
 
-    if( !PMDSerial_SetConfig( transport_data, SIOtransport_data->baud, PMDSerialParityNone, PMDSerialStopBits1) )
+    if( !PMDSerial_SetConfig( transport_data, SIOtransport_data->baud, PMDSerialParityNone) )
     {
-        PMDSerial_Close( transport_data );
+        flock( SIOtransport_data->hPort, LOCK_UN );
+        close( SIOtransport_data->hPort );
+        SIOtransport_data->hPort = INVALID_HANDLE_VALUE;
         return PMD_ERR_InvalidSerialPort;
     }
 
     if( !PMDSerial_SetTimeout( transport_data, 100 ) )
     {
-        CloseHandle( SIOtransport_data->hPort );
+        flock( SIOtransport_data->hPort, LOCK_UN );
+        close( SIOtransport_data->hPort );
         SIOtransport_data->hPort = INVALID_HANDLE_VALUE;
         return PMD_ERR_InvalidSerialPort;
     }
@@ -99,8 +135,8 @@ PMDresult PMDSerial_Close(void* transport_data)
     {
         if ( SIOtransport_data->hPort!=INVALID_HANDLE_VALUE )
         {
-            close(SIOtransport_data->hPort);
             flock(SIOtransport_data->hPort, LOCK_UN); /* free the port so that others can use it. */
+            close(SIOtransport_data->hPort);
             SIOtransport_data->hPort = INVALID_HANDLE_VALUE;
 
         }
@@ -112,11 +148,101 @@ PMDresult PMDSerial_Close(void* transport_data)
 }
 
 // ------------------------------------------------------------------------
-BOOL PMDSerial_SetConfig(void* transport_data, PMDuint32 baud, PMDuint8 parity, PMDuint8 stopbits)
+// Program a rate that isn't in the Bnnn table.
+static BOOL SetCustomBaud(int fd, PMDuint32 baud)
+{
+#ifdef PMD_HAVE_TERMIOS2
+    struct termios2 tty2;
+
+    if (ioctl(fd, TCGETS2, &tty2) != 0)
+    {
+        error_message ("error %d from TCGETS2", errno);
+        return FALSE;
+    }
+    tty2.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tty2.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tty2.c_ispeed = baud;
+    tty2.c_ospeed = baud;
+    if (ioctl(fd, TCSETS2, &tty2) != 0)
+    {
+        error_message ("error %d from TCSETS2", errno);
+        return FALSE;
+    }
+    return TRUE;
+#else
+    error_message("invalid baudrate\n");
+    return FALSE;
+#endif
+}
+
+// ------------------------------------------------------------------------
+// VMIN is the length of the shortest reply (status and checksum, plus
+// the address byte in idle line mode): a wakeup before that many bytes
+// are in can't finish a reply.  Asking for the full expected length
+// instead would hold an error reply, which is only those bytes, for a
+// whole VTIME.  VTIME is the inter-character allowance and only matters
+// if a reply stops part way, the ppoll deadline still bounds the wait
+// for the first byte.
+static void SetReadLatency(PMDSerialIOData* SIOtransport_data)
+{
+    struct termios tty;
+    cc_t vmin = 0, vtime = 0;
+
+    if (SIOtransport_data->bLowLatency)
+    {
+        vmin = SIOtransport_data->protocol == PMDSerialProtocolMultiDropUsingIdleLineDetection ? 3 : 2;
+        vtime = 1;
+    }
+    if (tcgetattr(SIOtransport_data->hPort, &tty) != 0)
+        return;
+    if (tty.c_cc[VMIN] == vmin && tty.c_cc[VTIME] == vtime)
+        return;
+    tty.c_cc[VMIN] = vmin;
+    tty.c_cc[VTIME] = vtime;
+    tcsetattr(SIOtransport_data->hPort, TCSANOW, &tty);
+}
+
+// ------------------------------------------------------------------------
+// ASYNC_LOW_LATENCY makes the driver push received bytes to the line
+// discipline at once; USB adapters such as the FTDI ones also drop their
+// latency timer from 16 ms to 1 ms.  A pty or a driver without
+// TIOCSSERIAL just doesn't get it, which is not an error.
+static void SetLowLatency(PMDSerialIOData* SIOtransport_data)
+{
+    struct serial_struct serial;
+    int fd = SIOtransport_data->hPort;
+
+    if (ioctl(fd, TIOCGSERIAL, &serial) == 0)
+    {
+        if (SIOtransport_data->bLowLatency)
+            serial.flags |= ASYNC_LOW_LATENCY;
+        else
+            serial.flags &= ~ASYNC_LOW_LATENCY;
+        ioctl(fd, TIOCSSERIAL, &serial);
+    }
+    SetReadLatency(SIOtransport_data);
+}
+
+// ------------------------------------------------------------------------
+BOOL PMDSerial_SetLowLatency(void* transport_data, BOOL enable)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+
+    SIOtransport_data->bLowLatency = enable ? 1 : 0;
+    if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE ) return FALSE;
+
+    SetLowLatency(SIOtransport_data);
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------
+BOOL PMDSerial_SetConfig(void* transport_data, PMDuint32 baud, PMDuint8 parity)
 {
     struct termios tty;
-    int baudr;
+    speed_t baudr;
+    PMDuint8 stopbits = PMDSerialStopBits1;
     PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    int fd = SIOtransport_data->hPort;
 
     SIOtransport_data->baud   = baud;
     SIOtransport_data->parity = parity;
@@ -156,13 +282,19 @@ BOOL PMDSerial_SetConfig(void* transport_data, PMDuint32 baud, PMDuint8 parity,
             baudr = B230400;
             break;
         case  460800 : 
-            baudr = BB460800;
+            baudr = B460800;
             break;
 
         default      :
+#ifdef PMD_HAVE_TERMIOS2
+            // programmed through termios2 once the rest is set
+            baudr = B38400;
+            break;
+#else
             error_message("invalid baudrate\n");
             return FALSE;
             break;
+#endif
     }
 
     int cbits=CS8,
@@ -204,11 +336,11 @@ BOOL PMDSerial_SetConfig(void* transport_data, PMDuint32 baud, PMDuint8 parity,
             break;
     }
 
-    cfsetospeed (&tty, baudr);
-    cfsetispeed (&tty, baudr);
-
     tty.c_cflag = cbits | cpar | bstop;
     tty.c_cflag |= (CLOCAL | CREAD);// ignore modem controls, enable reading
+    // after c_cflag is assigned, the speed bits live in it
+    cfsetospeed (&tty, baudr);
+    cfsetispeed (&tty, baudr);
     tty.c_iflag = ipar;
     tty.c_oflag = 0;
     tty.c_lflag = 0;
@@ -222,46 +354,204 @@ BOOL PMDSerial_SetConfig(void* transport_data, PMDuint32 baud, PMDuint8 parity,
     VMIN > 0 and VTIME = 0
         This is a counted read that is satisfied only when at least VMIN characters have been transferred to the caller's buffer - there is no timing component involved. This read can be satisfied from the driver's input queue (where the call could return immediately), or by waiting for new data to arrive: in this respect the call could block indefinitely. We believe that it's undefined behavior if nbytes is less then VMIN. 
     */
-    tty.c_cc[VMIN] = 0;      /* 1=block until n bytes are received */
-    tty.c_cc[VTIME] = 5;     /* block until a timer expires (n * 100 mSec.) */
+    /*
+    Reads never block in the driver.  Each one is preceded by a ppoll()
+    against the reply deadline, which is far finer than VTIME's tenths.
+    The low latency mode changes this, see SetReadLatency.
+    */
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
 
-    int fd = SIOtransport_data->hPort;
-    int error;
-    if (error = tcsetattr (fd, TCSANOW, &tty) != 0)
+    if (tcsetattr (fd, TCSANOW, &tty) != 0)
     {
         error_message ("error %d from tcsetattr", errno);
         return FALSE;
     }
 
+    if (baudr == B38400 && baud != 38400 && !SetCustomBaud(fd, baud))
+        return FALSE;
+
+    if (SIOtransport_data->bLowLatency)
+        SetLowLatency(SIOtransport_data);
+
     return TRUE;
 }
 
 // ------------------------------------------------------------------------
 BOOL PMDSerial_SetTimeout(void* transport_data,long msec)
 {
-    struct termios tty;
-    int error;
-
     PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
 
     if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE ) return FALSE;
+    if( msec <= 0 ) return FALSE;
 
-    int fd = SIOtransport_data->hPort;
-    if (error = tcgetattr (fd, &tty) != 0)
+    SIOtransport_data->timeout = msec;
+
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------
+BOOL PMDSerial_SetAdaptive(void* transport_data, BOOL enable, long minMsec)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+
+    SIOtransport_data->bAdaptive = enable ? 1 : 0;
+    if( minMsec > 0 )
+        SIOtransport_data->minTimeout = minMsec;
+    return TRUE;
+}
+
+// ------------------------------------------------------------------------
+// How long to wait for the reply to a packet of this shape: the static
+// timeout until the class has been measured, then its rto.
+PMDuint32 PMDSerial_ReplyTimeoutUs(void* transport_data, PMDuint8 xCt, PMDuint8 rCt)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    PMDSerialRtt* rtt = &SIOtransport_data->rtt[PMD_SERIAL_RTT_CLASS(xCt, rCt)];
+    PMDuint32 maxUs = SIOtransport_data->timeout * 1000;
+    PMDuint32 minUs = SIOtransport_data->minTimeout * 1000;
+
+    if (!SIOtransport_data->bAdaptive || rtt->srtt == 0)
+        return maxUs;
+    if (minUs > maxUs)
+        minUs = maxUs;
+    if (rtt->rto < minUs)
+        return minUs;
+    if (rtt->rto > maxUs)
+        return maxUs;
+    return rtt->rto;
+}
+
+// ------------------------------------------------------------------------
+// A round trip, from the end of the write to the end of a good reply.
+// As RFC 6298: gains of 1/8 for srtt and 1/4 for rttvar, and the rto is
+// srtt + 4 rttvar, which also drops any backoff.
+void PMDSerial_RttSample(void* transport_data, PMDuint8 xCt, PMDuint8 rCt, PMDuint32 usec)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    PMDSerialRtt* rtt = &SIOtransport_data->rtt[PMD_SERIAL_RTT_CLASS(xCt, rCt)];
+    PMDuint32 delta;
+
+    if (usec == 0)
+        usec = 1;
+    if (rtt->srtt == 0)
     {
-        error_message ("error %d from tcgetattr", errno);
-        return FALSE;
+        rtt->srtt = usec;
+        rtt->rttvar = usec / 2;
+    }
+    else
+    {
+        delta = rtt->srtt > usec ? rtt->srtt - usec : usec - rtt->srtt;
+        rtt->rttvar = rtt->rttvar - rtt->rttvar / 4 + delta / 4;
+        rtt->srtt = rtt->srtt - rtt->srtt / 8 + usec / 8;
     }
+    rtt->rto = rtt->srtt + 4 * rtt->rttvar;
+    rtt->samples++;
+}
+
+// ------------------------------------------------------------------------
+// No reply in time.  Back off, so that a drive that has merely slowed
+// down isn't timed out over and over, until a good reply comes in.
+void PMDSerial_RttTimeout(void* transport_data, PMDuint8 xCt, PMDuint8 rCt)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    PMDSerialRtt* rtt = &SIOtransport_data->rtt[PMD_SERIAL_RTT_CLASS(xCt, rCt)];
+    PMDuint32 maxUs = SIOtransport_data->timeout * 1000;
+
+    rtt->timeouts++;
+    if (rtt->srtt != 0)
+        rtt->rto = rtt->rto < maxUs / 2 ? rtt->rto * 2 : maxUs;
+}
+
+// ------------------------------------------------------------------------
+// Microseconds since t on the monotonic clock.
+static PMDuint32 UsSince(const struct timespec* t)
+{
+    struct timespec now;
 
-    tty.c_cc[VTIME] = msec / 100;     /* block until a timer expires (n * 100 mSec.) */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (PMDuint32)((now.tv_sec - t->tv_sec) * 1000000L +
+                       (now.tv_nsec - t->tv_nsec) / 1000);
+}
 
-    if (error = tcsetattr (fd, TCSANOW, &tty) != 0)
+// ------------------------------------------------------------------------
+// A deadline usec from now on the monotonic clock.
+static void SetDeadlineUs(struct timespec* deadline, PMDuint32 usec)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += usec / 1000000;
+    deadline->tv_nsec += (usec % 1000000) * 1000L;
+    if (deadline->tv_nsec >= 1000000000L)
     {
-        error_message ("error %d from tcsetattr", errno);
-        return FALSE;
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
     }
+}
 
-    return TRUE;
+// ------------------------------------------------------------------------
+// The reply deadline, msec from now.
+static void SetDeadline(struct timespec* deadline, PMDuint32 msec)
+{
+    SetDeadlineUs(deadline, msec * 1000);
+}
+
+// ------------------------------------------------------------------------
+// Read until 'want' bytes are in, the deadline passes or, when 'status' is
+// set, the reply turns out to be an error (a status byte at data[status-2]
+// that isn't zero means only status and checksum follow).  Returns the
+// byte count, or -1 if the port failed.
+static ssize_t ReadUntil(int fd, PMDuint8* data, size_t want, size_t status,
+                         const struct timespec* deadline)
+{
+    struct pollfd pfd;
+    struct timespec now, left;
+    size_t got = 0;
+    ssize_t bytes;
+    int ready;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    while (got < want)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        left.tv_sec = deadline->tv_sec - now.tv_sec;
+        left.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+        if (left.tv_nsec < 0)
+        {
+            left.tv_sec--;
+            left.tv_nsec += 1000000000L;
+        }
+        if (left.tv_sec < 0)
+            break;
+
+        ready = ppoll(&pfd, 1, &left, NULL);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (ready == 0)
+            break;
+        if (pfd.revents & (POLLERR | POLLNVAL))
+            return -1;
+
+        bytes = read(fd, data + got, want - got);
+        if (bytes < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            return -1;
+        }
+        if (bytes == 0 && (pfd.revents & POLLHUP))
+            return -1;
+        got += bytes;
+
+        if (status && got >= status && data[status - 2] != 0)
+            break;
+    }
+    return got;
 }
 
 // ------------------------------------------------------------------------
@@ -270,6 +560,8 @@ void PMDSerial_SetProtocol(void* transport_data,PMDuint16 mode)
     PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
 
     SIOtransport_data->protocol = mode;
+    if (SIOtransport_data->bLowLatency && SIOtransport_data->hPort != INVALID_HANDLE_VALUE)
+        SetReadLatency(SIOtransport_data);
 }
 
 // ------------------------------------------------------------------------
@@ -280,6 +572,32 @@ void PMDSerial_SetMultiDropAddress(void* transport_data,PMDuint16 address)
     SIOtransport_data->multiDropAddress = address;
 }
 
+// ------------------------------------------------------------------------
+// Has the device behind the port gone (a USB adapter unplugged, the far
+// end of a pty closed)?  Only a hangup or an error says so; a port that
+// is merely quiet is still there.
+BOOL PMDSerial_IsLost(void* transport_data)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    struct pollfd pfd;
+
+    if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE )
+        return TRUE;
+    pfd.fd = SIOtransport_data->hPort;
+    pfd.events = 0;
+    if( poll(&pfd, 1, 0) < 0 )
+        return FALSE;
+    return (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
+}
+
+// ------------------------------------------------------------------------
+// A read or write failed: PMD_ERR_NotConnected if that's because the
+// port has gone, otherwise the I/O error.
+static PMDresult PortError(void* transport_data, PMDresult io)
+{
+    return PMDSerial_IsLost(transport_data) ? PMD_ERR_NotConnected : io;
+}
+
 // ------------------------------------------------------------------------
 PMDresult PMDSerial_Send(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat)
 {
@@ -287,28 +605,34 @@ PMDresult PMDSerial_Send(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PM
 
     unsigned int c=0;
     unsigned int i;
+    // rCt comes from the opcode's descriptor (CMoOpcodes.hpp), so the
+    // whole reply can be asked for at once.
     unsigned int nExpected = 2*rCt+2;
-    char sum;
-    DWORD bytes;
-    PMDuint8 buffer[20];
-    PMDuint8* pbuff = &buffer[0];
+    unsigned int nHeader = 2;
+    PMDuint8 sum;
+    ssize_t bytes;
+    PMDuint8* buffer = SIOtransport_data->frame;
+    PMDuint8* pbuff = buffer;
     PMDuint16 ProcessorError;
+    struct timespec sent, deadline;
 
     if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE ) return PMD_ERR_NotConnected;
+    if( 2*xCt+2 > PMD_SERIAL_FRAME_BYTES || nExpected+1 > PMD_SERIAL_FRAME_BYTES )
+        return PMD_ERR_InvalidParameter;
 
     /* Clear address byte & checksum byte */
-    buffer[ c++ ] = (char)(SIOtransport_data->multiDropAddress);
-    buffer[ c++ ] = (char)(0);
+    buffer[ c++ ] = (PMDuint8)(SIOtransport_data->multiDropAddress);
+    buffer[ c++ ] = 0;
 
     /* Add axis number and command code */
-    buffer[ c++ ] = (char)(xDat[0]>>8);
-    buffer[ c++ ] = (char)(xDat[0]&0xff);
+    buffer[ c++ ] = (PMDuint8)(xDat[0]>>8);
+    buffer[ c++ ] = (PMDuint8)(xDat[0]&0xff);
 
     /* add data (handling byte swapping) */
     for( i=1; i<xCt; i++ )
     {
-        buffer[ c++ ] = (char)(xDat[i] >> 8);
-        buffer[ c++ ] = (char)(xDat[i] & 0xFF);
+        buffer[ c++ ] = (PMDuint8)(xDat[i] >> 8);
+        buffer[ c++ ] = (PMDuint8)(xDat[i] & 0xFF);
     }
 
     /* calculate checksum */
@@ -316,36 +640,57 @@ PMDresult PMDSerial_Send(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PM
         sum += buffer[i];
     buffer[1] = -sum;
 
-    // Flush the receive buffer in case any unexpected bytes have been received
-    PMDSerial_FlushRecv(transport_data);
+    // Only flush when the last exchange left the line in doubt.  A clean
+    // reply leaves nothing behind, so the usual cost is write + ppoll + read.
+    if (SIOtransport_data->bFlush)
+        PMDSerial_FlushRecv(transport_data);
 
     bytes = write(SIOtransport_data->hPort, buffer, c);
 
-    if( bytes != c )
-        return PMD_ERR_CommPortWrite;
+    if( bytes != (ssize_t)c )
+    {
+        SIOtransport_data->bFlush = 1;
+        return PortError(transport_data, PMD_ERR_CommPortWrite);
+    }
+    PMDSerial_CountBytes(transport_data, c, 0);
 
     /* read return data */
-    if (SIOtransport_data->protocol != PMDSerialProtocolMultiDropUsingIdleLineDetection)
+    if (SIOtransport_data->protocol == PMDSerialProtocolMultiDropUsingIdleLineDetection)
     {
-        bytes = read(SIOtransport_data->hPort, buffer, nExpected);
+        // idle line returns an extra byte containing the slave address
+        nExpected++;
+        nHeader++;
+    }
 
-        if ( bytes == 0 )
-            return PMD_ERR_CommTimeoutError;
+    clock_gettime(CLOCK_MONOTONIC, &sent);
+    SetDeadlineUs(&deadline, PMDSerial_ReplyTimeoutUs(transport_data, xCt, rCt));
+    bytes = ReadUntil(SIOtransport_data->hPort, buffer, nExpected, nHeader, &deadline);
+    if ( bytes > 0 )
+        PMDSerial_CountBytes(transport_data, 0, bytes);
+
+    if ( bytes < 0 )
+    {
+        SIOtransport_data->bFlush = 1;
+        return PortError(transport_data, PMD_ERR_CommPortRead);
     }
-    else
+    if ( bytes < (ssize_t)nHeader )
     {
-        // idle line returns an extra byte containing the slave address
-        bytes = read(SIOtransport_data->hPort, buffer, nExpected+1);
-
-        if ( bytes == 0 )
-            return PMD_ERR_CommTimeoutError;
+        SIOtransport_data->bFlush = 1;
+        PMDSerial_RttTimeout(transport_data, xCt, rCt);
+        return PMD_ERR_CommTimeoutError;
+    }
 
+    if (SIOtransport_data->protocol == PMDSerialProtocolMultiDropUsingIdleLineDetection)
+    {
         if(buffer[0] != SIOtransport_data->multiDropAddress)
+        {
+            SIOtransport_data->bFlush = 1;
             return PMD_ERR_CommPortRead; // unexpected address  
+        }
     }
 
     // verify the checksum
-    for( sum=i=0; i<bytes; i++ )
+    for( sum=i=0; i<(unsigned)bytes; i++ )
         sum += buffer[i];
 
     if (SIOtransport_data->protocol == PMDSerialProtocolMultiDropUsingIdleLineDetection)
@@ -361,9 +706,22 @@ PMDresult PMDSerial_Send(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PM
     // if there was an error, don't attempt to receive any data
     if( ProcessorError && bytes==2 )
         rCt = 0;
+    else if ( bytes != (ssize_t)(2*rCt+2) )
+    {
+        SIOtransport_data->bFlush = 1;
+        PMDSerial_RttTimeout(transport_data, xCt, rCt);
+        return PMD_ERR_CommTimeoutError;
+    }
 
     if( sum )
+    {
+        SIOtransport_data->bFlush = 1;
         return PMD_ERR_ChecksumError;
+    }
+
+    // Only full replies are timed: an error reply is shorter.
+    if( !ProcessorError )
+        PMDSerial_RttSample(transport_data, xCt, rCt, UsSince(&sent));
 
     /* byte swap return data */
     for( i=0, c=2; i<rCt; i++ )
@@ -384,7 +742,7 @@ PMDresult PMDSerial_Send(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PM
         PMDprintf("\r\n");
     }
     // some errors require resyncing the serial port when in point-to-point serial mode.
-    if (ProcessorError && bytes == 2)
+    if (ProcessorError)
     {
         // we might be out of sync if any of these error codes are returned,
         // especially if the command contains parameters.
@@ -393,27 +751,206 @@ PMDresult PMDSerial_Send(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PM
             ProcessorError == PMD_ERR_InvalidInstruction ||
             ProcessorError == PMD_ERR_InvalidAxis)
         {
-            PMDSerial_Sync(transport_data);
+            PMDSerial_Resync(transport_data, ProcessorError);
         }
     }
-    else
+
+    return ( ProcessorError );
+}
+
+// ------------------------------------------------------------------------
+// Write a block of bytes with a single call.  Used to send a run of
+// packets back to back.
+PMDresult PMDSerial_Write(void* transport_data, const PMDuint8* data, PMDuint32 count)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    ssize_t bytes;
+
+    if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE ) return PMD_ERR_NotConnected;
+
+    if (SIOtransport_data->bFlush)
+        PMDSerial_FlushRecv(transport_data);
+
+    bytes = write(SIOtransport_data->hPort, data, count);
+
+    if( bytes != (ssize_t)count )
     {
-        if ( bytes != (unsigned)(nExpected) )
-            return PMD_ERR_CommTimeoutError;
+        SIOtransport_data->bFlush = 1;
+        return PortError(transport_data, PMD_ERR_CommPortWrite);
     }
+    PMDSerial_CountBytes(transport_data, count, 0);
 
-    return ( ProcessorError );
+    return PMD_ERR_OK;
+}
+
+// ------------------------------------------------------------------------
+// Read up to count bytes, returning what arrived before the timeout.
+PMDresult PMDSerial_Read(void* transport_data, PMDuint8* data, PMDuint32 count, PMDuint32* got)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    ssize_t bytes;
+    struct timespec deadline;
+
+    *got = 0;
+    if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE ) return PMD_ERR_NotConnected;
+
+    SetDeadline(&deadline, SIOtransport_data->timeout);
+    bytes = ReadUntil(SIOtransport_data->hPort, data, count, 0, &deadline);
+
+    if( bytes < 0 )
+    {
+        SIOtransport_data->bFlush = 1;
+        return PortError(transport_data, PMD_ERR_CommPortRead);
+    }
+    if( bytes < (ssize_t)count )
+        SIOtransport_data->bFlush = 1;
+    PMDSerial_CountBytes(transport_data, 0, bytes);
+
+    *got = bytes;
+    return PMD_ERR_OK;
+}
+
+// ------------------------------------------------------------------------
+// A second at a time, so that what is asked for is a rate over a whole
+// second and not whatever part of one has gone by.
+void PMDSerial_CountBytes(void* transport_data, PMDuint32 out, PMDuint32 in)
+{
+    PMDSerialLoad* load = &((PMDSerialIOData*)transport_data)->load;
+    struct timespec now;
+    PMDuint32 ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ms = (PMDuint32)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+    if (ms - load->secondMs >= 1000)
+    {
+        load->lastBytes = ms - load->secondMs < 2000 ? load->secondBytes : 0;
+        load->secondMs = ms;
+        load->secondBytes = 0;
+    }
+    load->bytesOut += out;
+    load->bytesIn += in;
+    load->secondBytes += out + in;
+}
+
+// ------------------------------------------------------------------------
+PMDuint32 PMDSerial_BytesPerSecond(void* transport_data)
+{
+    PMDSerialLoad* load = &((PMDSerialIOData*)transport_data)->load;
+    struct timespec now;
+    PMDuint32 ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ms = (PMDuint32)(now.tv_sec * 1000 + now.tv_nsec / 1000000) - load->secondMs;
+    if (ms < 1000)
+        return load->lastBytes;
+    return ms < 2000 ? load->secondBytes : 0;
+}
+
+// ------------------------------------------------------------------------
+PMDuint32 PMDSerial_BitsPerByte(void* transport_data)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+
+    return 1 + 8 + (SIOtransport_data->parity != PMDSerialParityNone ? 1 : 0)
+        + (SIOtransport_data->stop == PMDSerialStopBits2 ? 2 : 1);
 }
 
 // ------------------------------------------------------------------------
 PMDresult PMDSerial_Sync(void* transport_data)
+{
+    return PMDSerial_Resync(transport_data, PMD_ERR_OK);
+}
+
+// ------------------------------------------------------------------------
+// How long the drive takes to start answering, on top of the wire time.
+#define SYNC_TURNAROUND_US 500
+
+static int SyncCause(PMDresult cause)
+{
+    switch (cause)
+    {
+        case PMD_ERR_OK:                 return PMDSerialSyncRequested;
+        case PMD_ERR_ChecksumError:      return PMDSerialSyncChecksum;
+        case PMD_ERR_BadSerialChecksum:  return PMDSerialSyncBadSerialChecksum;
+        case PMD_ERR_InvalidInstruction: return PMDSerialSyncInvalidInstruction;
+        case PMD_ERR_InvalidAxis:        return PMDSerialSyncInvalidAxis;
+        case PMD_ERR_HardFault:          return PMDSerialSyncHardFault;
+        default:                         return PMDSerialSyncLostReply;
+    }
+}
+
+// ------------------------------------------------------------------------
+// Read until the line has been quiet for usec, keeping the first size
+// bytes.  Returns how many came in all, or -1 if the port failed.
+static ssize_t ReadQuiet(int fd, PMDuint8* data, size_t size, PMDuint32 usec)
+{
+    PMDuint8 junk[32];
+    struct timespec deadline;
+    ssize_t total = 0, bytes;
+
+    for (;;)
+    {
+        SetDeadlineUs(&deadline, usec);
+        if ((size_t)total < size)
+            bytes = ReadUntil(fd, data + total, size - total, 0, &deadline);
+        else
+            bytes = ReadUntil(fd, junk, sizeof(junk), 0, &deadline);
+        if (bytes < 0)
+            return -1;
+        if (bytes == 0)
+            return total;
+        total += bytes;
+    }
+}
+
+// ------------------------------------------------------------------------
+// GetVersion sends nothing but the opcode and always answers with two
+// words.  A drive that is at a packet boundary answers it with exactly
+// six good bytes; one that isn't reads part of it as something else.
+static int SyncConfirm(PMDSerialIOData* SIOtransport_data, PMDuint32 usec)
+{
+    static const PMDuint8 query[4] = {0, 0x71, 0, 0x8F};
+    PMDuint8 rx[6], sum;
+    struct timespec deadline;
+    ssize_t bytes;
+    int i;
+
+    if (write(SIOtransport_data->hPort, query, sizeof(query)) != sizeof(query))
+        return -1;
+    SetDeadlineUs(&deadline, usec);
+    bytes = ReadUntil(SIOtransport_data->hPort, rx, sizeof(rx), 2, &deadline);
+    if (bytes < 0)
+        return -1;
+    if (bytes != sizeof(rx) || rx[0] != 0)
+        return 0;
+    for (sum = 0, i = 0; i < (int)sizeof(rx); i++)
+        sum += rx[i];
+    return sum == 0;
+}
+
+// ------------------------------------------------------------------------
+// Get the drive's command parser back to the start of a packet.
+//
+// The receive queue is flushed once, up front; after that every byte
+// that comes back is read and accounted for.  Zero bytes go out one at a
+// time: whatever packet the drive is part way through, it answers the
+// byte that completes it (four zeros on their own are a NoOperation), so
+// the first reply marks a packet boundary.  A GetVersion, whose reply
+// length is known, then confirms it.  Every wait is a sub-timeout of a
+// few byte times, doubled each pass that gets nowhere, up to the port's
+// own timeout, so a glitch costs a handful of frame times rather than a
+// full timeout per byte.
+PMDresult PMDSerial_Resync(void* transport_data, PMDresult cause)
 {
     PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
-    const int maxSend = 15;
-    DWORD bytes;
+    PMDSerialSyncStats* stats = &SIOtransport_data->sync;
+    PMDresult result = PMD_ERR_CommTimeoutError;
+    PMDuint8 rx[PMD_SERIAL_FRAME_BYTES];
+    PMDuint32 usec, limit, byteUs, elapsed;
+    struct timespec start, end, deadline;
+    const PMDuint8 zero = 0;
+    ssize_t bytes, more;
     int i;
-    char tx = 0;
-    char rx[2];
 
     if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE ) return PMD_ERR_NotConnected;
 
@@ -422,32 +959,70 @@ PMDresult PMDSerial_Sync(void* transport_data)
     if (SIOtransport_data->protocol != Protocol_PointToPoint)
         return PMD_ERR_InvalidOperation;
 
-    // Flush the receive buffer in case any unexpected bytes have been received
+    clock_gettime(CLOCK_MONOTONIC, &start);
     PMDSerial_FlushRecv(transport_data);
 
-    for( i=0; i<maxSend; i++ )
-    {
-        /* write a zero character */
-        bytes = write(SIOtransport_data->hPort, &tx, 1);
+    // One byte out and a two byte reply back, at ten bits a byte.
+    byteUs = 10000000 / (SIOtransport_data->baud ? SIOtransport_data->baud : 9600);
+    usec = SYNC_TURNAROUND_US + 3 * byteUs;
+    limit = SIOtransport_data->timeout * 1000;
+    if (usec > limit)
+        usec = limit;
 
-        if( bytes != 1 )
-            return PMD_ERR_CommPortWrite;
+    for (;;)
+    {
+        for (i = 0, bytes = 0; i < PMD_SERIAL_FRAME_BYTES && bytes == 0; i++)
+        {
+            if (write(SIOtransport_data->hPort, &zero, 1) != 1)
+            {
+                bytes = -1;
+                break;
+            }
+            SetDeadlineUs(&deadline, usec);
+            bytes = ReadUntil(SIOtransport_data->hPort, rx, 2, 0, &deadline);
+        }
 
-        /* Attempt to read the 2 byte response */
-        bytes = read(SIOtransport_data->hPort, rx, 2);
+        // An error status, or a status of zero with a checksum that
+        // already adds up, is the whole reply.  Otherwise data words may
+        // follow, however many the packet the drive completed asked for.
+        if (bytes > 0 && !(bytes == 2 && (rx[0] != 0 || (PMDuint8)(rx[0] + rx[1]) == 0)))
+        {
+            more = ReadQuiet(SIOtransport_data->hPort, rx + bytes, sizeof(rx) - bytes, usec);
+            bytes = more < 0 ? -1 : bytes + more;
+        }
+        if (bytes > 0)
+            bytes = SyncConfirm(SIOtransport_data, usec + 7 * byteUs);
 
-        if ( bytes == 2 )
+        if (bytes < 0)
+        {
+            result = PMD_ERR_CommunicationsError;
+            break;
+        }
+        if (bytes > 0)
+        {
+            result = PMD_ERR_OK;
             break;
+        }
+        if (usec >= limit)
+            break;
+        usec = usec * 2 < limit ? usec * 2 : limit;
     }
 
-    /* If no data was seen, return an error */
-    if( i== maxSend ) 
-        return PMD_ERR_CommTimeoutError;
-
-    /* flush any other data read */
-    PMDSerial_FlushRecv(transport_data);
-
-    return PMD_ERR_OK;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (PMDuint32)((end.tv_sec - start.tv_sec) * 1000000L +
+                          (end.tv_nsec - start.tv_nsec) / 1000);
+    stats->count++;
+    stats->cause[SyncCause(cause)]++;
+    stats->lastUs = elapsed;
+    if (elapsed > stats->maxUs)
+        stats->maxUs = elapsed;
+    stats->totalUs += elapsed;
+    if (result != PMD_ERR_OK)
+    {
+        stats->failed++;
+        SIOtransport_data->bFlush = 1;
+    }
+    return result;
 }
 
 // ------------------------------------------------------------------------
@@ -459,10 +1034,50 @@ PMDresult PMDSerial_FlushRecv(void* transport_data)
 
     //flush_buffer(SIOtransport_data->hPort);
     tcflush(SIOtransport_data->hPort, TCIOFLUSH);
+    SIOtransport_data->bFlush = 0;
 
     return PMD_ERR_OK;
 }
 
+// ------------------------------------------------------------------------
+// Open the port again after the device behind it went away, with the rate,
+// parity, timeout and latency it had.  hPort is simply replaced, so close
+// the old descriptor first or keep it in another copy of the data.
+PMDresult PMDSerial_Reopen(void* transport_data)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    PMDuint32 timeout = SIOtransport_data->timeout;
+    PMDuint8 parity = SIOtransport_data->parity;
+    PMDresult result;
+
+    if( (result = PMDSerial_InitPort(transport_data)) != PMD_ERR_OK )
+        return result;
+    if( !PMDSerial_SetConfig(transport_data, SIOtransport_data->baud, parity) )
+    {
+        PMDSerial_ClosePort(transport_data);
+        return PMD_ERR_InvalidSerialPort;
+    }
+    PMDSerial_SetTimeout(transport_data, timeout);
+    if( SIOtransport_data->bLowLatency )
+        SetLowLatency(SIOtransport_data);
+    SIOtransport_data->bFlush = 1;
+    return PMD_ERR_OK;
+}
+
+// ------------------------------------------------------------------------
+// Let go of the port but keep transport_data, unlike PMDSerial_Close.
+void PMDSerial_ClosePort(void* transport_data)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+
+    if( SIOtransport_data->hPort != INVALID_HANDLE_VALUE )
+    {
+        flock(SIOtransport_data->hPort, LOCK_UN);
+        close(SIOtransport_data->hPort);
+        SIOtransport_data->hPort = INVALID_HANDLE_VALUE;
+    }
+}
+
 // ------------------------------------------------------------------------
 void PMDSerial_InitData(PMDSerialIOData* transport_data)
 {
@@ -478,6 +1093,20 @@ void PMDSerial_InitData(PMDSerialIOData* transport_data)
     transport_data->bVerifyChecksum = 1;
     // by default disable diagnostics
     transport_data->bDiagnostics = 0;
+    // nothing is known about the line until the first flush
+    transport_data->bFlush = 1;
+    transport_data->timeout = 100;
+    memset(&transport_data->sync, 0, sizeof(transport_data->sync));
+    // adaptive timeouts are off until asked for
+    transport_data->bAdaptive = 0;
+    transport_data->minTimeout = 2;
+    memset(transport_data->rtt, 0, sizeof(transport_data->rtt));
+    // one attempt, as before, until a policy is configured
+    memset(&transport_data->retry, 0, sizeof(transport_data->retry));
+    transport_data->retry.attempts = 1;
+    memset(&transport_data->reconnect, 0, sizeof(transport_data->reconnect));
+    // no ceiling on the polls until one is configured
+    memset(&transport_data->load, 0, sizeof(transport_data->load));
 }
 
 // ------------------------------------------------------------------------
@@ -156,6 +156,7 @@ BOOL PMDSerial_SetTimeout(void* transport_data,long msec)
 
     if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE ) return FALSE;
 
+    SIOtransport_data->timeout = msec;
     timeouts.ReadIntervalTimeout         = MAXDWORD;
     timeouts.ReadTotalTimeoutMultiplier  = 0;
     timeouts.ReadTotalTimeoutConstant    = msec;
@@ -165,6 +166,28 @@ BOOL PMDSerial_SetTimeout(void* transport_data,long msec)
     return SetCommTimeouts( SIOtransport_data->hPort, &timeouts );
 }
 
+// ------------------------------------------------------------------------
+// Win32 has no portable equivalent of ASYNC_LOW_LATENCY; USB adapters
+// expose their latency timer in the driver's own settings instead.
+BOOL PMDSerial_SetLowLatency(void* transport_data,BOOL enable)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+
+    SIOtransport_data->bLowLatency = 0;
+    return FALSE;
+}
+
+// ------------------------------------------------------------------------
+// ReadFile waits as long as the COMMTIMEOUTS say, so replies aren't timed
+// here and the adaptive timeouts stay off.
+BOOL PMDSerial_SetAdaptive(void* transport_data,BOOL enable,long minMsec)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+
+    SIOtransport_data->bAdaptive = 0;
+    return !enable;
+}
+
 // ------------------------------------------------------------------------
 void PMDSerial_SetProtocol(void* transport_data,PMDuint16 mode)
 {
@@ -223,13 +246,14 @@ PMDresult PMDSerial_Send(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PM
     PMDSerial_FlushRecv(transport_data);
 
     if( !WriteFile( SIOtransport_data->hPort, buffer, c, &bytes, NULL ) || bytes != c )
-        return PMD_ERR_CommPortWrite;
+        return PMDSerial_IsLost(transport_data) ? PMD_ERR_NotConnected : PMD_ERR_CommPortWrite;
+    PMDSerial_CountBytes(transport_data, c, 0);
 
     /* read return data */
     if (SIOtransport_data->protocol != PMDSerialProtocolMultiDropUsingIdleLineDetection)
     {
         if( !ReadFile( SIOtransport_data->hPort, buffer, nExpected, &bytes, NULL ) )
-            return PMD_ERR_CommPortRead;
+            return PMDSerial_IsLost(transport_data) ? PMD_ERR_NotConnected : PMD_ERR_CommPortRead;
 
         if ( bytes == 0 )
             return PMD_ERR_CommTimeoutError;
@@ -247,6 +271,8 @@ PMDresult PMDSerial_Send(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PM
             return PMD_ERR_CommPortRead; // unexpected address  
     }
 
+    PMDSerial_CountBytes(transport_data, 0, bytes);
+
     // verify the checksum
     for( sum=i=0; i<bytes; i++ )
         sum += buffer[i];
@@ -296,7 +322,7 @@ PMDresult PMDSerial_Send(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PM
             ProcessorError == PMD_ERR_InvalidInstruction ||
             ProcessorError == PMD_ERR_InvalidAxis)
         {
-            PMDSerial_Sync(transport_data);
+            PMDSerial_Resync(transport_data, ProcessorError);
         }
     }
     else
@@ -332,8 +358,89 @@ PMDresult PMDSerial_ReadByte(void* transport_data, PMDuint8* data)
     return PMD_ERR_OK;
 }
 
+// ------------------------------------------------------------------------
+// Write a block of bytes with a single call.  Used to send a run of
+// packets back to back.
+PMDresult PMDSerial_Write(void* transport_data, const PMDuint8* data, PMDuint32 count)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    DWORD bytes;
+
+    if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE ) return PMD_ERR_NotConnected;
+
+    if( !WriteFile( SIOtransport_data->hPort, data, count, &bytes, NULL ) || bytes != count )
+        return PMDSerial_IsLost(transport_data) ? PMD_ERR_NotConnected : PMD_ERR_CommPortWrite;
+    PMDSerial_CountBytes(transport_data, count, 0);
+
+    return PMD_ERR_OK;
+}
+
+// ------------------------------------------------------------------------
+// Read up to count bytes, returning what arrived before the timeout.
+PMDresult PMDSerial_Read(void* transport_data, PMDuint8* data, PMDuint32 count, PMDuint32* got)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    DWORD bytes;
+
+    *got = 0;
+    if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE ) return PMD_ERR_NotConnected;
+
+    if( !ReadFile( SIOtransport_data->hPort, data, count, &bytes, NULL ) )
+        return PMDSerial_IsLost(transport_data) ? PMD_ERR_NotConnected : PMD_ERR_CommPortRead;
+    PMDSerial_CountBytes(transport_data, 0, bytes);
+
+    *got = bytes;
+    return PMD_ERR_OK;
+}
+
+// ------------------------------------------------------------------------
+// A second at a time, as in PMDLinuxSer.c.
+void PMDSerial_CountBytes(void* transport_data, PMDuint32 out, PMDuint32 in)
+{
+    PMDSerialLoad* load = &((PMDSerialIOData*)transport_data)->load;
+    DWORD ms = GetTickCount();
+
+    if (ms - load->secondMs >= 1000)
+    {
+        load->lastBytes = ms - load->secondMs < 2000 ? load->secondBytes : 0;
+        load->secondMs = ms;
+        load->secondBytes = 0;
+    }
+    load->bytesOut += out;
+    load->bytesIn += in;
+    load->secondBytes += out + in;
+}
+
+// ------------------------------------------------------------------------
+PMDuint32 PMDSerial_BytesPerSecond(void* transport_data)
+{
+    PMDSerialLoad* load = &((PMDSerialIOData*)transport_data)->load;
+    DWORD ms = GetTickCount() - load->secondMs;
+
+    if (ms < 1000)
+        return load->lastBytes;
+    return ms < 2000 ? load->secondBytes : 0;
+}
+
+// ------------------------------------------------------------------------
+PMDuint32 PMDSerial_BitsPerByte(void* transport_data)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+
+    return 1 + 8 + (SIOtransport_data->parity != NOPARITY ? 1 : 0)
+        + (SIOtransport_data->stop == TWOSTOPBITS ? 2 : 1);
+}
+
 // ------------------------------------------------------------------------
 PMDresult PMDSerial_Sync(void* transport_data)
+{
+    return PMDSerial_Resync(transport_data, PMD_ERR_OK);
+}
+
+// ------------------------------------------------------------------------
+// Still the probe loop here, with each ReadFile bounded by the port's
+// COMMTIMEOUTS; only the statistics are kept.  See PMDLinuxSer.c.
+PMDresult PMDSerial_Resync(void* transport_data, PMDresult cause)
 {
     PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
     const int maxSend = 15;
@@ -341,6 +448,9 @@ PMDresult PMDSerial_Sync(void* transport_data)
     int i;
     char tx = 0;
     char rx[2];
+    DWORD start = GetTickCount(), elapsed;
+    PMDSerialSyncStats* stats = &SIOtransport_data->sync;
+    int index;
 
     if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE ) return PMD_ERR_NotConnected;
 
@@ -363,12 +473,36 @@ PMDresult PMDSerial_Sync(void* transport_data)
             break;
     }
 
+    if( i < maxSend )
+    {
+        /* flush any other data read */
+        PMDSerial_FlushRecv(transport_data);
+    }
+
+    switch (cause)
+    {
+        case PMD_ERR_OK:                 index = PMDSerialSyncRequested; break;
+        case PMD_ERR_ChecksumError:      index = PMDSerialSyncChecksum; break;
+        case PMD_ERR_BadSerialChecksum:  index = PMDSerialSyncBadSerialChecksum; break;
+        case PMD_ERR_InvalidInstruction: index = PMDSerialSyncInvalidInstruction; break;
+        case PMD_ERR_InvalidAxis:        index = PMDSerialSyncInvalidAxis; break;
+        case PMD_ERR_HardFault:          index = PMDSerialSyncHardFault; break;
+        default:                         index = PMDSerialSyncLostReply; break;
+    }
+    elapsed = (GetTickCount() - start) * 1000;
+    stats->count++;
+    stats->cause[index]++;
+    stats->lastUs = elapsed;
+    if (elapsed > stats->maxUs)
+        stats->maxUs = elapsed;
+    stats->totalUs += elapsed;
+
     /* If no data was seen, return an error */
     if( i== maxSend ) 
+    {
+        stats->failed++;
         return PMD_ERR_CommTimeoutError;
-
-    /* flush any other data read */
-    PMDSerial_FlushRecv(transport_data);
+    }
 
     return PMD_ERR_OK;
 }
@@ -385,6 +519,55 @@ PMDresult PMDSerial_FlushRecv(void* transport_data)
     return PMD_ERR_OK;
 }
 
+// ------------------------------------------------------------------------
+// Open the port again after the device behind it went away, with the rate,
+// parity and timeout it had.  hPort is simply replaced, so close the old
+// handle first or keep it in another copy of the data.
+PMDresult PMDSerial_Reopen(void* transport_data)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    PMDuint32 timeout = SIOtransport_data->timeout;
+    PMDuint8 parity = SIOtransport_data->parity;
+    PMDresult result;
+
+    if( (result = PMDSerial_InitPort(transport_data)) != PMD_ERR_OK )
+        return result;
+    if( !PMDSerial_SetConfig(transport_data, SIOtransport_data->baud, parity) )
+    {
+        PMDSerial_ClosePort(transport_data);
+        return PMD_ERR_InvalidSerialPort;
+    }
+    PMDSerial_SetTimeout(transport_data, timeout);
+    return PMD_ERR_OK;
+}
+
+// ------------------------------------------------------------------------
+// Let go of the port but keep transport_data, unlike PMDSerial_Close.
+void PMDSerial_ClosePort(void* transport_data)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+
+    if( SIOtransport_data->hPort != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( SIOtransport_data->hPort );
+        SIOtransport_data->hPort = INVALID_HANDLE_VALUE;
+    }
+}
+
+// ------------------------------------------------------------------------
+// Has the device behind the port gone?  A USB adapter that was unplugged
+// fails every call on its handle, this one included.
+BOOL PMDSerial_IsLost(void* transport_data)
+{
+    PMDSerialIOData* SIOtransport_data = (PMDSerialIOData*)transport_data;
+    DWORD errors;
+    COMSTAT status;
+
+    if( SIOtransport_data->hPort == INVALID_HANDLE_VALUE )
+        return TRUE;
+    return !ClearCommError( SIOtransport_data->hPort, &errors, &status );
+}
+
 // ------------------------------------------------------------------------
 void PMDSerial_InitData(PMDSerialIOData* transport_data)
 {
@@ -400,6 +583,20 @@ void PMDSerial_InitData(PMDSerialIOData* transport_data)
     transport_data->bVerifyChecksum = 1;
     // by default disable diagnostics
     transport_data->bDiagnostics = 0;
+    // PMDSerial_Send here flushes every time, so this never clears and
+    // the pipelined path in CMoTransport.c does the same.
+    transport_data->bFlush = 1;
+    transport_data->timeout = 100;
+    memset(&transport_data->sync, 0, sizeof(transport_data->sync));
+    transport_data->bAdaptive = 0;
+    transport_data->minTimeout = 2;
+    memset(transport_data->rtt, 0, sizeof(transport_data->rtt));
+    // one attempt, as before, until a policy is configured
+    memset(&transport_data->retry, 0, sizeof(transport_data->retry));
+    transport_data->retry.attempts = 1;
+    memset(&transport_data->reconnect, 0, sizeof(transport_data->reconnect));
+    // no ceiling on the polls until one is configured
+    memset(&transport_data->load, 0, sizeof(transport_data->load));
 }
 
 // ------------------------------------------------------------------------
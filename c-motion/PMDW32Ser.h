@@ -1,8 +1,18 @@
 #ifndef PMD_Serial
 #define	PMD_Serial
 
-// using the Win32 API for serial port access functions
+// using the Win32 API for serial port access functions.  The Linux
+// version (PMDLinuxSer.c) shares this header; PMDsys.h supplies HANDLE
+// and BOOL there.
+#if defined(_WIN32)
 #include <windows.h>
+#else
+#include "PMDsys.h"
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
 
 //  PMDw32ser.h -- Win32 serial IO
 //
@@ -11,6 +21,96 @@
 
 enum {Protocol_PointToPoint,Protocol_ModeAddressBit=2,Protocol_IdleLine};
 
+// Address, checksum and command word plus three data words out, or an
+// address, status, checksum and three data words back.
+#define PMD_SERIAL_FRAME_BYTES 20
+
+// Why PMDSerial_Resync was called, for PMDSerialSyncStats.cause.
+enum {
+	PMDSerialSyncRequested,		// PMDSerial_Sync
+	PMDSerialSyncChecksum,		// a reply failed the host's checksum
+	PMDSerialSyncLostReply,		// a reply went missing mid-batch
+	PMDSerialSyncBadSerialChecksum,	// the drive's status for the packet
+	PMDSerialSyncInvalidInstruction,
+	PMDSerialSyncInvalidAxis,
+	PMDSerialSyncHardFault,
+	PMDSerialSyncCauses
+};
+
+typedef struct tagPMDSerialSyncStats {
+
+	PMDuint32 count;
+	PMDuint32 failed;		// never found a packet boundary
+	PMDuint32 cause[PMDSerialSyncCauses];
+	// durations in microseconds
+	PMDuint32 lastUs;
+	PMDuint32 maxUs;
+	PMDuint32 totalUs;
+
+} PMDSerialSyncStats;
+
+// Adaptive reply timeouts (Linux only), learned TCP style from the round
+// trips seen for each packet shape: 1 to 4 command words out, 0 to 4
+// reply words back.  The shape sets the wire time, so it is the class.
+#define PMD_SERIAL_RTT_CLASSES 20
+#define PMD_SERIAL_RTT_CLASS(xCt, rCt) \
+	((((xCt) < 1 ? 1 : (xCt) > 4 ? 4 : (xCt)) - 1) * 5 + ((rCt) > 4 ? 4 : (rCt)))
+
+typedef struct tagPMDSerialRtt {
+
+	// microseconds; srtt is 0 until the first sample
+	PMDuint32 srtt;
+	PMDuint32 rttvar;
+	PMDuint32 rto;		// srtt + 4 rttvar, clamped, doubled by timeouts
+	PMDuint32 samples;
+	PMDuint32 timeouts;
+
+} PMDSerialRtt;
+
+// What CMoRetry.hpp does about a transient error on this port: how many
+// times in all a packet may go out, and what it has done so far.
+typedef struct tagPMDSerialRetry {
+
+	PMDuint32 attempts;	// 1 never sends a packet again
+	PMDuint32 backoffUs;	// wait before the second retry, doubled after
+	PMDuint32 retries;	// packets sent again
+	PMDuint32 recovered;	// calls that came good on a retry
+	PMDuint32 exhausted;	// calls that ran out of attempts
+	PMDuint32 refused;	// not sent again, it might apply twice
+
+} PMDSerialRetry;
+
+// Bringing the port back after the device behind it went away or the
+// drive reset (CMoReconnect.hpp), and what that has cost so far.
+typedef struct tagPMDSerialReconnect {
+
+	void* link;		// CMoReconnect's state, NULL while it's off
+	PMDuint32 waitMs;	// how long a call waits for the port to return
+	PMDuint32 losses;	// times the port went away
+	PMDuint32 resets;	// times the drive came back from a reset
+	PMDuint32 reopened;	// times the port was opened again
+	PMDuint32 replayed;	// settings sent again from the journal
+	PMDuint32 lastMs;	// from the loss to the port being back
+
+} PMDSerialReconnect;
+
+// How busy the line is: bytes each way, counted a second at a time, and
+// the periodic polls CMoLoad.hpp has let onto it under its ceiling.
+typedef struct tagPMDSerialLoad {
+
+	PMDuint32 bytesOut;
+	PMDuint32 bytesIn;
+	PMDuint32 secondMs;	// when the second being counted began
+	PMDuint32 secondBytes;	// both ways, so far in it
+	PMDuint32 lastBytes;	// in the whole second before it
+	PMDuint32 ceiling;	// percent of the line polls may fill, 0 for any
+	PMDuint32 pollBits;	// a second, booked by the polls let on
+	PMDuint32 admitted;
+	PMDuint32 downrated;	// let on at a longer period than asked for
+	PMDuint32 refused;
+
+} PMDSerialLoad;
+
 typedef struct tagPMDSerialIOData {
 
 	PMDuint16 multiDropAddress;
@@ -26,6 +126,26 @@ typedef struct tagPMDSerialIOData {
 	PMDuint16 bVerifyChecksum;
 	PMDuint16 bDiagnostics;
 
+	// Stale bytes may be waiting in the receive queue (after an error,
+	// a timeout or a resync), so flush before the next command goes out.
+	PMDuint16 bFlush;
+	// Ask the driver for low latency and tune the read thresholds
+	// (Linux only, see PMDSerial_SetLowLatency).
+	PMDuint16 bLowLatency;
+	// Reply deadline in milliseconds, counted from the end of the write.
+	PMDuint32 timeout;
+	// Command and reply are built and read here rather than on the stack.
+	PMDuint8 frame[PMD_SERIAL_FRAME_BYTES];
+	PMDSerialSyncStats sync;
+	// With bAdaptive set, the reply deadline is the class' rto, kept
+	// between minTimeout and timeout (both milliseconds).
+	PMDuint16 bAdaptive;
+	PMDuint32 minTimeout;
+	PMDSerialRtt rtt[PMD_SERIAL_RTT_CLASSES];
+	PMDSerialRetry retry;
+	PMDSerialReconnect reconnect;
+	PMDSerialLoad load;
+
 } PMDSerialIOData;
 
 // functions that can be called externally
@@ -40,13 +160,34 @@ PMDresult PMDSetupAxisInterface_Serial(PMDAxisHandle* axis_handle, PMDAxis axis_
 // once the port is initialized
 BOOL PMDSerial_SetConfig(void* transport_data,PMDuint32 b,PMDuint8 p);
 BOOL PMDSerial_SetTimeout(void* transport_data,long msec);
+BOOL PMDSerial_SetLowLatency(void* transport_data,BOOL enable);
+BOOL PMDSerial_SetAdaptive(void* transport_data,BOOL enable,long minMsec);
+PMDuint32 PMDSerial_ReplyTimeoutUs(void* transport_data,PMDuint8 xCt,PMDuint8 rCt);
+void PMDSerial_RttSample(void* transport_data,PMDuint8 xCt,PMDuint8 rCt,PMDuint32 usec);
+void PMDSerial_RttTimeout(void* transport_data,PMDuint8 xCt,PMDuint8 rCt);
 void PMDSerial_SetProtocol(void* transport_data,PMDuint16 mode);
 void PMDSerial_SetMultiDropAddress(void* transport_data,PMDuint16 address);
 PMDresult PMDSerial_WriteByte(void* transport_data, PMDuint8 data);
 PMDresult PMDSerial_ReadByte(void* transport_data, PMDuint8* data);
+PMDresult PMDSerial_Write(void* transport_data, const PMDuint8* data, PMDuint32 count);
+PMDresult PMDSerial_Read(void* transport_data, PMDuint8* data, PMDuint32 count, PMDuint32* got);
 PMDresult PMDSerial_FlushRecv(void* transport_data);
+PMDresult PMDSerial_Reopen(void* transport_data);
+void PMDSerial_ClosePort(void* transport_data);
+BOOL PMDSerial_IsLost(void* transport_data);
 PMDresult PMDSerial_Sync(void* transport_data);
+PMDresult PMDSerial_Resync(void* transport_data, PMDresult cause);
+PMDresult PMDSerial_Send(void* transport_data, PMDuint8 xCt, PMDuint16* xDat, PMDuint8 rCt, PMDuint16* rDat);
+// Bytes that went over the line, for those that write and read the port
+// themselves; Send, Write and Read count their own.
+void PMDSerial_CountBytes(void* transport_data, PMDuint32 out, PMDuint32 in);
+// Both ways, in the last whole second.
+PMDuint32 PMDSerial_BytesPerSecond(void* transport_data);
+// Start, data, parity and stop bits of each byte as configured.
+PMDuint32 PMDSerial_BitsPerByte(void* transport_data);
 
-
+#if defined(__cplusplus)
+}
+#endif
 
 #endif
@@ -39,6 +39,8 @@
 #define INVALID_HANDLE_VALUE      ((long)-1)
 #define HANDLE                    int
 #define BOOL                      int
+#define TRUE                      1
+#define FALSE                     0
 
 #include <stdint.h>
 #include <unistd.h>
@@ -1,7 +1,12 @@
-load [file join [file dirname [info script]] CMoTcl10.[info sharedlibextension]]
+load [file join [file dirname [info script]] CMoTcl10[info sharedlibextension]]
 
 itcl::class ::pmd::cmotion {
-    constructor {} { _init }
+    # Any arguments are SerialConfigure options for the new connection,
+    # e.g. [pmd::cmotion x -baud auto].
+    constructor {args} {
+	_init
+	if {[llength $args]} { SerialConfigure {*}$args }
+    }
     destructor { _destroy }
     public {
 	method GetCMotionVersion {} @CMo-GetCMotionVersion
@@ -251,9 +256,85 @@ itcl::class ::pmd::cmotion {
 	method GetRuntimeError {} @CMo-GetRuntimeError
 	method SetCurrentLimit {} @CMo-SetCurrentLimit
 	method GetCurrentLimit {} @CMo-GetCurrentLimit
+
+	# Move queue (breakpoint chained segments)
+	method QueueMove {} @CMo-QueueMove
+	method QueueStart {} @CMo-QueueStart
+	method QueueStop {} @CMo-QueueStop
+	method QueueService {} @CMo-QueueService
+	method QueueStatus {} @CMo-QueueStatus
+
+	# Host side serial port (like fconfigure)
+	method SerialConfigure {} @CMo-SerialConfigure
+	method SerialStats {} @CMo-SerialStats
+
+	# Host side network connection, instead of the serial port
+	method NetworkConnect {} @CMo-NetworkConnect
+	method NetworkConfigure {} @CMo-NetworkConfigure
+	method NetworkStats {} @CMo-NetworkStats
+
+	# Host side CAN bus (SocketCAN), instead of the serial port
+	method CanConnect {} @CMo-CanConnect
+	method CanConfigure {} @CMo-CanConfigure
+	method CanStats {} @CMo-CanStats
+
+	# Block transfers to and from device memory
+	method ReadMemory {} @CMo-ReadMemory
+	method WriteMemory {} @CMo-WriteMemory
+
+	# Waiting for events without polling from the script
+	method WaitForEvent {} @CMo-WaitForEvent
+
+	# State for any thread to read with [cmotion::snapshot]
+	method Publish {} @CMo-Publish
+
+	# Emergency stops, see [cmotion::estop]
+	method StopStats {} @CMo-StopStats
+
+	# How busy the port's wire is, see CMoLoad.hpp
+	method BusLoad {} @CMo-BusLoad
+
+	# Reading ahead what is read together, see CMoPrefetch.hpp
+	method PrefetchConfigure {} @CMo-PrefetchConfigure
+	method PrefetchStats {} @CMo-PrefetchStats
     }
     private {
 	method _init    {} @CMo-construct
 	method _destroy {} @CMo-destruct
     }
 }
+
+# A device with a C-Motion Engine, for the user code that runs on it.  Any
+# arguments are for Connect, e.g. [pmd::device x tcp 192.168.2.2].
+itcl::class ::pmd::device {
+    constructor {args} {
+	_init
+	if {[llength $args]} { Connect {*}$args }
+    }
+    destructor { _destroy }
+    public {
+	# Connection
+	method Connect {} @CMoDev-Connect
+	method Disconnect {} @CMoDev-Disconnect
+
+	# User code and its task
+	method StoreUserCode {} @CMoDev-StoreUserCode
+	method GetUserCodeFileName {} @CMoDev-GetUserCodeFileName
+	method GetUserCodeFileVersion {} @CMoDev-GetUserCodeFileVersion
+	method GetUserCodeFileDate {} @CMoDev-GetUserCodeFileDate
+	method TaskStart {} @CMoDev-TaskStart
+	method TaskStop {} @CMoDev-TaskStop
+	method TaskGetState {} @CMoDev-TaskGetState
+
+	# Parameters shared with the task
+	method ReadMemory {} @CMoDev-ReadMemory
+	method WriteMemory {} @CMoDev-WriteMemory
+
+	# Events its axes raise
+	method WaitForEvent {} @CMoDev-WaitForEvent
+    }
+    private {
+	method _init    {} @CMoDev-construct
+	method _destroy {} @CMoDev-destruct
+    }
+}
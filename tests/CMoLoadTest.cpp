@@ -0,0 +1,124 @@
+/*
+ * CMoLoadTest.cpp --
+ *
+ *	Admission of periodic polls on a serial line with a ceiling
+ *	(CMoLoad.hpp): let on as asked while they fit, at the shortest
+ *	period that still fits once they don't, and refused when the line
+ *	is full.
+ *
+ *	make test
+ */
+
+#include "CMoLoad.hpp"
+#include "CMoOpcodes.hpp"
+#include "c-motion/PMDW32Ser.h"
+#include "CMoTest.h"
+#include <string.h>
+#include <time.h>
+
+// A port at 115200 8N1, as PMDSerial_Open leaves it, that has carried
+// lastBytes in the second just gone.
+static void
+Port(PMDAxisHandle* handle, PMDSerialIOData* sio, PMDuint32 lastBytes)
+{
+    struct timespec now;
+
+    memset(handle, 0, sizeof(*handle));
+    memset(sio, 0, sizeof(*sio));
+    sio->baud = 115200;
+    sio->parity = PMDSerialParityNone;
+    sio->stop = PMDSerialStopBits1;
+    sio->protocol = PMDSerialProtocolPoint2Point;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    sio->load.secondMs = (PMDuint32)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+    sio->load.lastBytes = lastBytes;
+    handle->transport.SendCommand = PMDSerial_Send;
+    handle->transport_data = sio;
+}
+
+int
+main()
+{
+    PMDAxisHandle handle;
+    PMDSerialIOData sio;
+    CMoLoad::Booking a, b, c, d;
+    CMoLoad::Stats stats;
+    PMDuint32 bits, period, limit;
+
+    // Address, checksum and command word out, status and checksum and two
+    // words back, ten bits a byte.
+    Port(&handle, &sio, 0);
+    bits = CMoLoad::PacketBits(&handle, CMoOp::GetActualPosition);
+    CHECK(bits == (4 + 2 + 4) * 10);
+
+    // No ceiling: anything goes, as asked.
+    period = 1;
+    CHECK(CMoLoad::Admit(&handle, CMoOp::GetActualPosition, &period, &a));
+    CHECK(period == 1);
+    CMoLoad::Release(&a);
+
+    // A ceiling of 10% is 11520 bits a second.  One poll every 10 ms
+    // takes 10000 of them and goes on as asked.
+    CHECK(CMoLoad::SetCeiling(&handle, 10));
+    limit = 11520;
+    period = 10;
+    CHECK(CMoLoad::Admit(&handle, CMoOp::GetActualPosition, &period, &a));
+    CHECK(period == 10);
+    CHECK(a.bits == 10000);
+
+    // A second one doesn't fit at 10 ms, and is let on at the shortest
+    // period that fits in the 1520 left.
+    period = 10;
+    CHECK(CMoLoad::Admit(&handle, CMoOp::GetActualPosition, &period, &b));
+    CHECK(period > 10);
+    CHECK(10000 + (bits * 1000 + period - 1) / period <= limit);
+    CHECK(10000 + (bits * 1000 + period - 2) / (period - 1) > limit);
+    CHECK(b.bits <= limit - 10000);
+
+    // A third only fits the few bits left at a period of seconds, and
+    // after it the line is booked to the ceiling: a fourth is refused,
+    // with nothing booked.
+    period = 10;
+    CHECK(CMoLoad::Admit(&handle, CMoOp::GetActualPosition, &period, &c));
+    CHECK(period >= 1000);
+    CHECK(sio.load.pollBits == limit);
+    period = 1000;
+    CHECK(!CMoLoad::Admit(&handle, CMoOp::GetActualPosition, &period, &d));
+    CHECK(d.pollBits == 0L && d.bits == 0);
+    CHECK(period == 1000);
+
+    CHECK(CMoLoad::GetStats(&handle, &stats));
+    CHECK(stats.ceiling == 10);
+    CHECK(stats.pollBits == limit);
+    CHECK(stats.admitted == 4 && stats.downrated == 2 && stats.refused == 1);
+
+    // Releasing the bookings gives the line back.
+    CMoLoad::Release(&a);
+    CMoLoad::Release(&b);
+    CMoLoad::Release(&c);
+    CHECK(sio.load.pollBits == 0);
+
+    // Measured traffic counts as well: a line already at the ceiling
+    // refuses a poll, however slow.
+    Port(&handle, &sio, 1200);
+    CHECK(CMoLoad::SetCeiling(&handle, 10));
+    period = 60000;
+    CHECK(!CMoLoad::Admit(&handle, CMoOp::GetActualPosition, &period, &a));
+    CHECK(CMoLoad::GetStats(&handle, &stats));
+    CHECK(stats.bitsPerSecond == 12000);
+    CHECK(stats.refused == 1 && stats.admitted == 0);
+
+    // Half way there, a poll asked for at 1 ms is down-rated to fit the
+    // 5760 bits left.
+    Port(&handle, &sio, 576);
+    CHECK(CMoLoad::SetCeiling(&handle, 10));
+    period = 1;
+    CHECK(CMoLoad::Admit(&handle, CMoOp::GetActualPosition, &period, &a));
+    CHECK(period == (bits * 1000 + 5760 - 1) / 5760);
+    CHECK(a.bits <= 5760);
+    CHECK(CMoLoad::GetStats(&handle, &stats));
+    CHECK(stats.downrated == 1 && stats.admitted == 1);
+    CMoLoad::Release(&a);
+
+    return Finish();
+}
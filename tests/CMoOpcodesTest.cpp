@@ -0,0 +1,132 @@
+/*
+ * CMoOpcodesTest.cpp --
+ *
+ *	What the opcode table (CMoOpcodes.hpp) says may be sent twice, or
+ *	shared between callers, for the opcodes retry, reconnect, coalescing
+ *	and prefetch decide on, and what the reconnect journal
+ *	(CMoReconnect.hpp) keeps of them.
+ *
+ *	make test
+ */
+
+#include "CMoOpcodes.hpp"
+#include "CMoReconnect.hpp"
+#include "CMoTransport.h"
+#include "CMoTest.h"
+
+// Reads with no effect on the chip.
+static const PMDuint8 reads[] = {
+    CMoOp::NoOperation, CMoOp::GetActualPosition, CMoOp::GetActualVelocity,
+    CMoOp::GetEventStatus, CMoOp::GetActivityStatus, CMoOp::GetPositionError,
+    CMoOp::GetVersion, CMoOp::GetTraceCount, CMoOp::ReadIO, CMoOp::ReadAnalog
+};
+
+// Settings, where twice is the same as once.
+static const PMDuint8 sets[] = {
+    CMoOp::SetPosition, CMoOp::SetVelocity, CMoOp::SetProfileMode,
+    CMoOp::SetStopMode, CMoOp::Update, CMoOp::SetEventAction, CMoOp::WriteIO
+};
+
+// Once only, among them the reads that clear or re-arm what they return.
+static const PMDuint8 onces[] = {
+    CMoOp::Reset, CMoOp::ResetEventStatus, CMoOp::ClearInterrupt,
+    CMoOp::AdjustActualPosition, CMoOp::WriteBuffer, CMoOp::ReadBuffer,
+    CMoOp::ReadBuffer16, CMoOp::GetCaptureValue, CMoOp::GetInstructionError,
+    CMoOp::GetRuntimeError
+};
+
+// At compile time as well, since the table is built there.
+static_assert(CMoOpcodes[CMoOp::GetCaptureValue].repeat == CMoRepeatOnce,
+    "reading the capture re-arms it");
+static_assert(CMoOpcodes[CMoOp::GetInstructionError].repeat == CMoRepeatOnce,
+    "reading the instruction error clears it");
+static_assert(CMoOpcodeShape(CMoOp::GetActualPosition, 0, 2),
+    "GetActualPosition takes no arguments and returns a long");
+static_assert(CMoJournal[CMoOp::SetStopMode] == CMoNotJournalled,
+    "a stop mode replayed after a reconnect stops the axis at the next Update");
+static_assert(CMoJournal[CMoOp::SetBreakpoint] == CMoNotJournalled,
+    "a breakpoint that went off isn't armed again");
+
+// Commands and one-off states a reconnect mustn't replay.
+static const PMDuint8 momentary[] = {
+    CMoOp::SetStopMode, CMoOp::SetBreakpoint, CMoOp::SetBreakpointValue,
+    CMoOp::SetActualPosition, CMoOp::SetMotorCommand, CMoOp::Update,
+    CMoOp::Reset, CMoOp::ClearInterrupt, CMoOp::SetBufferReadIndex
+};
+
+// Setup it restores: plain, then one entry per parameter.
+static const PMDuint8 journalled[] = {
+    CMoOp::SetPosition, CMoOp::SetVelocity, CMoOp::SetProfileMode
+};
+static const PMDuint8 keyed[] = {
+    CMoOp::SetEventAction, CMoOp::SetProfileParameter,
+    CMoOp::SetBreakpointUpdateMask
+};
+
+int
+main()
+{
+    unsigned i;
+    int op;
+
+    for (i = 0; i < sizeof(reads); i++)
+    {
+	CHECK(CMoOpcodes[reads[i]].repeat == CMoRepeatRead);
+	CHECK(CMoOpcodes_IsRead(reads[i]));
+	CHECK(CMoOpcodes_CanRepeat(reads[i]));
+    }
+    for (i = 0; i < sizeof(sets); i++)
+    {
+	CHECK(CMoOpcodes[sets[i]].repeat == CMoRepeatSet);
+	CHECK(!CMoOpcodes_IsRead(sets[i]));
+	CHECK(CMoOpcodes_CanRepeat(sets[i]));
+    }
+    for (i = 0; i < sizeof(onces); i++)
+    {
+	CHECK(CMoOpcodes[onces[i]].repeat == CMoRepeatOnce);
+	CHECK(!CMoOpcodes_IsRead(onces[i]));
+	CHECK(!CMoOpcodes_CanRepeat(onces[i]));
+    }
+
+    // Opcodes the table doesn't know are never repeated.
+    for (op = 0; op < 256; op++)
+    {
+	if (CMoOpcodes[op].name == 0L)
+	{
+	    CHECK(CMoOpcodes[op].repeat == CMoRepeatOnce);
+	}
+    }
+
+    // Every read has a reply to share.
+    for (op = 0; op < 256; op++)
+    {
+	if (CMoOpcodes[op].repeat == CMoRepeatRead)
+	{
+	    CHECK(CMoOpcodes[op].rWords > 0 || op == CMoOp::NoOperation);
+	}
+    }
+
+    for (i = 0; i < sizeof(momentary); i++)
+    {
+	CHECK(CMoJournal[momentary[i]] == CMoNotJournalled);
+    }
+    for (i = 0; i < sizeof(journalled); i++)
+    {
+	CHECK(CMoJournal[journalled[i]] == CMoJournalled);
+    }
+    for (i = 0; i < sizeof(keyed); i++)
+    {
+	CHECK(CMoJournal[keyed[i]] == CMoJournalKeyed);
+    }
+
+    // Only settings go in the journal, never a read or a once-only packet.
+    for (op = 0; op < 256; op++)
+    {
+	if (CMoJournal[op] != CMoNotJournalled)
+	{
+	    CHECK(CMoOpcodes[op].repeat == CMoRepeatSet);
+	}
+    }
+
+    return Finish();
+}
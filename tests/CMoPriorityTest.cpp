@@ -0,0 +1,45 @@
+/*
+ * CMoPriorityTest.cpp --
+ *
+ *	How far a class that has been passed over moves up (CMoPriority.h):
+ *	background as far as interactive, never level with control, and
+ *	control first however long the others have waited.
+ *
+ *	make test
+ */
+
+#include "CMoPriority.h"
+#include "CMoTest.h"
+
+static const PMDuint32 age = CMO_PRIORITY_AGE_MS * 1000;
+
+int
+main()
+{
+    PMDuint32 waited;
+
+    // Each class where it starts.
+    CHECK(CMoPriority_Aged(CMoControl, 0) == CMoControl);
+    CHECK(CMoPriority_Aged(CMoInteractive, 0) == CMoInteractive);
+    CHECK(CMoPriority_Aged(CMoBackground, 0) == CMoBackground);
+
+    // Background moves up one class a period, as far as interactive.
+    CHECK(CMoPriority_Aged(CMoBackground, age - 1) == CMoBackground);
+    CHECK(CMoPriority_Aged(CMoBackground, age) == CMoInteractive);
+    CHECK(CMoPriority_Aged(CMoBackground, 2 * age) == CMoInteractive);
+
+    // However long they wait, neither is ever level with control.
+    for (waited = 0; waited < 100 * age; waited += age / 2)
+    {
+	CHECK(CMoPriority_Aged(CMoInteractive, waited) == CMoInteractive);
+	CHECK(CMoPriority_Aged(CMoBackground, waited) > CMoControl);
+	CHECK(CMoPriority_Aged(CMoBackground, waited) >
+	    CMoPriority_Aged(CMoControl, 0));
+    }
+    CHECK(CMoPriority_Aged(CMoBackground, 0xFFFFFFFFu) == CMoInteractive);
+
+    // Nor is control worse for having waited.
+    CHECK(CMoPriority_Aged(CMoControl, 10 * age) == CMoControl);
+
+    return Finish();
+}
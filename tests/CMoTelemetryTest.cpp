@@ -0,0 +1,76 @@
+/*
+ * CMoTelemetryTest.cpp --
+ *
+ *	The layout of the shared memory segment (CMoTelemetry.h) that
+ *	readers in other processes compile against: a header line, then
+ *	every array on a cache line of its own, and each slot's sequence
+ *	number alone on its line.
+ *
+ *	make test
+ */
+
+#include "CMoTelemetry.h"
+#include "CMoTest.h"
+#include <stddef.h>
+#include <string.h>
+
+#define LINE_ALIGNED(f) \
+    static_assert(offsetof(CMoTelemetry, f) % 64 == 0, \
+	#f " doesn't start on a cache line")
+
+LINE_ALIGNED(sequence);
+LINE_ALIGNED(live);
+LINE_ALIGNED(position);
+LINE_ALIGNED(velocity);
+LINE_ALIGNED(eventStatus);
+LINE_ALIGNED(activityStatus);
+LINE_ALIGNED(result);
+LINE_ALIGNED(reserved2);
+LINE_ALIGNED(stamp);
+LINE_ALIGNED(polls);
+LINE_ALIGNED(failures);
+
+#undef LINE_ALIGNED
+
+static_assert(offsetof(CMoTelemetry, sequence) == 64,
+    "the header is one cache line");
+static_assert(sizeof(((CMoTelemetry*)0)->sequence[0]) == 64,
+    "each sequence number has a cache line of its own");
+static_assert(sizeof(CMoTelemetry) % 64 == 0,
+    "the segment is whole cache lines");
+static_assert(offsetof(CMoTelemetry, failures) +
+	sizeof(((CMoTelemetry*)0)->failures) == sizeof(CMoTelemetry),
+    "nothing after the last array");
+
+int
+main()
+{
+    static CMoTelemetry t;
+    CMoTelemetryState state;
+    int slot = 5;
+
+    // Read copies out one slot, and says whether it is live.
+    memset(&t, 0, sizeof(t));
+    CHECK(!CMoTelemetry_Read(&t, slot, &state));
+    t.live[slot] = 1;
+    t.position[slot] = -1234;
+    t.velocity[slot] = 56;
+    t.eventStatus[slot] = 0x0100;
+    t.activityStatus[slot] = 0x0002;
+    t.stamp[slot] = 123456789ULL;
+    t.polls[slot] = 7;
+    t.failures[slot] = 1;
+    t.sequence[slot].value = 2;
+    CHECK(CMoTelemetry_Read(&t, slot, &state));
+    CHECK(state.position == -1234 && state.velocity == 56);
+    CHECK(state.eventStatus == 0x0100 && state.activityStatus == 0x0002);
+    CHECK(state.stamp == 123456789ULL);
+    CHECK(state.polls == 7 && state.failures == 1);
+
+    // Its neighbours, and slots that aren't there, are not.
+    CHECK(!CMoTelemetry_Read(&t, slot + 1, &state));
+    CHECK(!CMoTelemetry_Read(&t, -1, &state));
+    CHECK(!CMoTelemetry_Read(&t, CMO_TELEMETRY_AXES, &state));
+
+    return Finish();
+}
@@ -0,0 +1,23 @@
+#ifndef INC_CMoTest_h__
+#define INC_CMoTest_h__
+
+// What the unit tests in tests/ share: CHECK reports a condition that
+// doesn't hold, with where it is, and goes on; Finish prints the outcome
+// and is what main returns.
+
+#include <stdio.h>
+
+static int failures;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+	failures++; } } while (0)
+
+static inline int
+Finish()
+{
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures != 0;
+}
+
+#endif	// #ifndef INC_CMoTest_h__